@@ -80,6 +80,7 @@ gchar *string_table_insert_string(StringTable *table, const gchar *str)
 			   entry->ref_count);
 	} else {
 		entry = string_entry_new(str);
+		table->memusage += sizeof(StringEntry) + strlen(str) + 1;
 		XXX_DEBUG ("inserting %s\n", str);
 		/* insert entry->string instead of str, since it can be
 		 * invalid pointer after this. */
@@ -101,6 +102,8 @@ void string_table_free_string(StringTable *table, const gchar *str)
 			XXX_DEBUG ("refcount of string %s dropped to zero\n",
 				   entry->string);
 			g_hash_table_remove(table->hash_table, str);
+			table->memusage -= sizeof(StringEntry) +
+					   strlen(entry->string) + 1;
 			string_entry_free(entry);
 		} else {
 			XXX_DEBUG ("ref-- for %s (%d)\n", entry->string,
@@ -109,6 +112,31 @@ void string_table_free_string(StringTable *table, const gchar *str)
 	}
 }
 
+/* Returns the number of references to str if it is the table's own
+ * copy of the string, or 0 for any other pointer */
+gint string_table_get_ref_count(StringTable *table, const gchar *str)
+{
+	StringEntry *entry;
+
+	cm_return_val_if_fail(table != NULL, 0);
+
+	if (str == NULL)
+		return 0;
+
+	entry = g_hash_table_lookup(table->hash_table, str);
+	if (entry == NULL || entry->string != str)
+		return 0;
+
+	return entry->ref_count;
+}
+
+gsize string_table_get_memusage(StringTable *table)
+{
+	cm_return_val_if_fail(table != NULL, 0);
+
+	return table->memusage;
+}
+
 static gboolean string_table_remove_for_each_fn(gchar *key, StringEntry *entry,
 						gpointer user_data)
 {
@@ -23,6 +23,7 @@
 
 typedef struct {
 	GHashTable *hash_table;
+	gsize	    memusage;
 } StringTable;
 
 StringTable *string_table_new     (void);
@@ -30,6 +31,9 @@ void         string_table_free    (StringTable *table);
 
 gchar *string_table_insert_string (StringTable *table, const gchar *str);
 void   string_table_free_string   (StringTable *table, const gchar *str);
+gint   string_table_get_ref_count (StringTable *table, const gchar *str);
+
+gsize  string_table_get_memusage  (StringTable *table);
 
 void   string_table_get_stats     (StringTable *table);
 
@@ -467,6 +467,21 @@ gint subject_compare_for_sort(const gchar *s1, const gchar *s2)
 	return g_utf8_collate(str1, str2);
 }
 
+/* returns a key sorting like subject_compare_for_sort() with strcmp() */
+gchar *subject_collate_key_for_sort(const gchar *s)
+{
+	gchar *str, *key;
+
+	cm_return_val_if_fail(s != NULL, NULL);
+
+	str = g_strdup(s);
+	trim_subject_for_sort(str);
+	key = g_utf8_collate_key(str, -1);
+	g_free(str);
+
+	return key;
+}
+
 void trim_subject(gchar *str)
 {
 	register gchar *srcp;
@@ -4351,6 +4366,25 @@ void cm_mutex_free(GMutex *mutex) {
 #endif
 }
 
+GCond *cm_cond_new(void) {
+#if GLIB_CHECK_VERSION(2,32,0)
+	GCond *c = g_new0(GCond, 1);
+	g_cond_init(c);
+	return c;
+#else
+	return g_cond_new();
+#endif
+}
+
+void cm_cond_free(GCond *cond) {
+#if GLIB_CHECK_VERSION(2,32,0)
+	g_cond_clear(cond);
+	g_free(cond);
+#else
+	g_cond_free(cond);
+#endif
+}
+
 static gchar *canonical_list_to_file(GSList *list)
 {
 	GString *result = g_string_new(NULL);
@@ -302,6 +302,7 @@ gint subject_compare			(const gchar	*s1,
 					 const gchar	*s2);
 gint subject_compare_for_sort		(const gchar	*s1,
 					 const gchar	*s2);
+gchar *subject_collate_key_for_sort	(const gchar	*s);
 void trim_subject			(gchar		*str);
 void eliminate_parenthesis		(gchar		*str,
 					 gchar		 op,
@@ -525,6 +526,8 @@ gboolean sc_g_slist_bigger(GSList *list, gint max);
 
 GMutex *cm_mutex_new(void);
 void cm_mutex_free(GMutex *mutex);
+GCond *cm_cond_new(void);
+void cm_cond_free(GCond *cond);
 
 int cm_canonicalize_filename(const gchar *filename, gchar **canonical_name);
 
@@ -53,9 +53,9 @@ static int etpan_thread_op_cancelled(struct etpan_thread_op * op);
 static void etpan_thread_op_lock(struct etpan_thread_op * op);
 static void etpan_thread_op_unlock(struct etpan_thread_op * op);
 static void etpan_thread_stop(struct etpan_thread * thread);
+static void etpan_thread_bind(struct etpan_thread * thread);
 
 #if 0
-static void etpan_thread_bind(struct etpan_thread * thread);
 static int etpan_thread_manager_op_schedule(struct etpan_thread_manager * manager,
 	     struct etpan_thread_op * op);
 static void etpan_thread_manager_start(struct etpan_thread_manager * manager);
@@ -239,21 +239,25 @@ etpan_thread_manager_create_thread(struct etpan_thread_manager * manager)
 }
 
 static void
-etpan_thread_manager_terminate_thread(struct etpan_thread_manager * manager,
+etpan_thread_manager_retire_thread(struct etpan_thread_manager * manager,
     struct etpan_thread * thread)
 {
   unsigned int i;
+  int found;
   int r;
   
+  found = 0;
   for(i = 0 ; i < carray_count(manager->thread_pool) ; i ++) {
     if (carray_get(manager->thread_pool, i) == thread) {
       carray_delete(manager->thread_pool, i);
+      found = 1;
       break;
     }
   }
   
-  if (!etpan_thread_is_bound(thread))
-    manager->unbound_count --;
+  /* already stopped along with the manager */
+  if (!found)
+    return;
   
   r = carray_add(manager->thread_pending, thread, NULL);
   if (r < 0) {
@@ -263,6 +267,16 @@ etpan_thread_manager_terminate_thread(struct etpan_thread_manager * manager,
   etpan_thread_stop(thread);
 }
 
+static void
+etpan_thread_manager_terminate_thread(struct etpan_thread_manager * manager,
+    struct etpan_thread * thread)
+{
+  if (!etpan_thread_is_bound(thread))
+    manager->unbound_count --;
+  
+  etpan_thread_manager_retire_thread(manager, thread);
+}
+
 static void manager_notify(struct etpan_thread_manager * manager)
 {
   char ch;
@@ -464,6 +478,34 @@ etpan_thread_manager_get_thread(struct etpan_thread_manager * manager)
   return NULL;
 }
 
+/* A thread of its own, which get_thread() never hands out, for a
+   connection blocking in long operations (IDLE) or running alongside
+   the others. It is stopped by etpan_thread_manager_release_thread(). */
+struct etpan_thread *
+etpan_thread_manager_get_bound_thread(struct etpan_thread_manager * manager)
+{
+  struct etpan_thread * thread;
+  
+  thread = etpan_thread_manager_create_thread(manager);
+  if (thread == NULL)
+    return NULL;
+  
+  etpan_thread_bind(thread);
+  
+  return thread;
+}
+
+void etpan_thread_manager_release_thread(struct etpan_thread_manager * manager,
+    struct etpan_thread * thread)
+{
+  etpan_thread_unbind(thread);
+  if (etpan_thread_is_bound(thread))
+    return;
+  
+  /* its queued ops are run before it stops */
+  etpan_thread_manager_retire_thread(manager, thread);
+}
+
 static unsigned int etpan_thread_get_load(struct etpan_thread * thread)
 {
   unsigned int load;
@@ -475,12 +517,10 @@ static unsigned int etpan_thread_get_load(struct etpan_thread * thread)
   return load;
 }
 
-#if 0
 static void etpan_thread_bind(struct etpan_thread * thread)
 {
   thread->bound_count ++;
 }
-#endif
 
 void etpan_thread_unbind(struct etpan_thread * thread)
 {
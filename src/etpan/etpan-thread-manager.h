@@ -37,6 +37,11 @@ void etpan_thread_op_free(struct etpan_thread_op * op);
 struct etpan_thread *
 etpan_thread_manager_get_thread(struct etpan_thread_manager * manager);
 
+struct etpan_thread *
+etpan_thread_manager_get_bound_thread(struct etpan_thread_manager * manager);
+void etpan_thread_manager_release_thread(struct etpan_thread_manager * manager,
+    struct etpan_thread * thread);
+
 void etpan_thread_unbind(struct etpan_thread * thread);
 
 /* ** op schedule ** */
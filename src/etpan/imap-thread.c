@@ -57,6 +57,10 @@ static struct etpan_thread_manager * thread_manager = NULL;
 static chash * courier_workaround_hash = NULL;
 static chash * imap_hash = NULL;
 static chash * session_hash = NULL;
+static chash * pool_hash = NULL;
+#ifdef HAVE_MAILSTREAM_WAIT_IDLE
+static chash * idle_hash = NULL;
+#endif
 static guint thread_manager_signal = 0;
 static GIOChannel * io_channel = NULL;
 
@@ -313,6 +317,9 @@ static void imap_logger_append(int direction, const char * str, size_t size)
 
 #define ETPAN_DEFAULT_NETWORK_TIMEOUT 60
 gboolean etpan_skip_ssl_cert_check = FALSE;
+#ifdef HAVE_MAILIMAP_CUSTOM_COMMAND
+static struct mailimap_extension_api esearch_extension;
+#endif
 extern void mailsasl_ref(void);
 
 void imap_main_init(gboolean skip_ssl_cert_check)
@@ -327,9 +334,17 @@ void imap_main_init(gboolean skip_ssl_cert_check)
 	mailstream_logger = imap_logger_cmd;
 	mailsasl_ref();
 	
+#ifdef HAVE_MAILIMAP_CUSTOM_COMMAND
+	mailimap_extension_register(&esearch_extension);
+#endif
+
 	imap_hash = chash_new(CHASH_COPYKEY, CHASH_DEFAULTSIZE);
 	session_hash = chash_new(CHASH_COPYKEY, CHASH_DEFAULTSIZE);
 	courier_workaround_hash = chash_new(CHASH_COPYKEY, CHASH_DEFAULTSIZE);
+	pool_hash = chash_new(CHASH_COPYKEY, CHASH_DEFAULTSIZE);
+#ifdef HAVE_MAILSTREAM_WAIT_IDLE
+	idle_hash = chash_new(CHASH_COPYKEY, CHASH_DEFAULTSIZE);
+#endif
 	
 	thread_manager = etpan_thread_manager_new();
 	
@@ -366,6 +381,10 @@ void imap_main_done(gboolean have_connectivity)
 	
 	etpan_thread_manager_free(thread_manager);
 	
+#ifdef HAVE_MAILSTREAM_WAIT_IDLE
+	chash_free(idle_hash);
+#endif
+	chash_free(pool_hash);
 	chash_free(courier_workaround_hash);
 	chash_free(session_hash);
 	chash_free(imap_hash);
@@ -454,61 +473,118 @@ static gboolean cb_show_error(gpointer data)
 	return FALSE;
 }
 
-static void generic_cb(int cancelled, void * result, void * callback_data)
+static void check_alert(mailimap * imap)
 {
-	struct etpan_thread_op * op;
-	
-	op = (struct etpan_thread_op *) callback_data;
-
-	debug_print("generic_cb\n");
-	if (op->imap && op->imap->imap_response_info &&
-	    op->imap->imap_response_info->rsp_alert) {
+	if (imap && imap->imap_response_info &&
+	    imap->imap_response_info->rsp_alert) {
 		log_error(LOG_PROTOCOL, "IMAP< Alert: %s\n",
-			op->imap->imap_response_info->rsp_alert);
+			imap->imap_response_info->rsp_alert);
 		g_timeout_add(10, cb_show_error, NULL);
 	} 
-	op->finished = 1;
 }
 
-/* Please do *not* blindly use imap pointers after this function returns,
- * someone may have deleted it while this function was waiting for completion.
- * Check return value to see if imap is still valid.
- * Run get_imap(folder) again to get a fresh and valid pointer.
- */
-static int threaded_run(Folder * folder, void * param, void * result,
-			void (* func)(struct etpan_thread_op * ))
+/* An operation queued on the thread of a folder. */
+struct threaded_call {
+	Folder * folder;
+	mailimap * imap;
+	void (* done)(Folder * folder, gboolean stale, void * data);
+	void * data;
+};
+
+static void threaded_call_cb(int cancelled, void * result, void * callback_data)
+{
+	struct threaded_call * call = callback_data;
+	gboolean stale;
+
+	debug_print("threaded_call_cb\n");
+	stale = (call->imap != get_imap(call->folder));
+	if (stale)
+		g_warning("returning from operation on a stale imap %p", call->imap);
+	else
+		check_alert(call->imap);
+
+	call->done(call->folder, stale, call->data);
+
+	imap_folder_unref(call->folder);
+	g_free(call);
+}
+
+/* Queues func after the operations already queued on the thread of the
+ * folder, and returns at once. done() is called from the main loop once
+ * func has run, with stale set if the session of the folder was replaced
+ * meanwhile: the imap pointer it ran on must not be used then.
+ * param and result must stay valid until then. */
+static void threaded_run_async(Folder * folder, void * param, void * result,
+			       void (* func)(struct etpan_thread_op * ),
+			       void (* done)(Folder * folder, gboolean stale,
+					     void * data),
+			       void * data)
 {
 	struct etpan_thread_op * op;
-	struct etpan_thread * thread;
-	struct mailimap * imap = get_imap(folder);
-	
+	struct threaded_call * call;
+
 	imap_folder_ref(folder);
 
+	call = g_new0(struct threaded_call, 1);
+	call->folder = folder;
+	call->imap = get_imap(folder);
+	call->done = done;
+	call->data = data;
+
 	op = etpan_thread_op_new();
 	
-	op->imap = imap;
+	op->imap = call->imap;
 	op->param = param;
 	op->result = result;
 	
 	op->run = func;
-	op->callback = generic_cb;
-	op->callback_data = op;
+	op->callback = threaded_call_cb;
+	op->callback_data = call;
+	op->cleanup = etpan_thread_op_free;
 
-	thread = get_thread(folder);
-	etpan_thread_op_schedule(thread, op);
-	
-	while (!op->finished) {
+	etpan_thread_op_schedule(get_thread(folder), op);
+}
+
+/* Lets the main loop run until an asynchronous operation calls back,
+ * for the synchronous API. */
+static void threaded_wait(gboolean * finished)
+{
+	while (!* finished) {
 		gtk_main_iteration();
 	}
+}
+
+struct threaded_run_wait {
+	gboolean finished;
+	gboolean stale;
+};
 
-	etpan_thread_op_free(op);
+static void threaded_run_done(Folder * folder, gboolean stale, void * data)
+{
+	struct threaded_run_wait * wait = data;
+
+	wait->stale = stale;
+	wait->finished = TRUE;
+}
+
+/* Please do *not* blindly use imap pointers after this function returns,
+ * someone may have deleted it while this function was waiting for completion.
+ * Check return value to see if imap is still valid.
+ * Run get_imap(folder) again to get a fresh and valid pointer.
+ */
+static int threaded_run(Folder * folder, void * param, void * result,
+			void (* func)(struct etpan_thread_op * ))
+{
+	struct threaded_run_wait wait = { FALSE, FALSE };
+	mailimap * imap = get_imap(folder);
 
-	imap_folder_unref(folder);
+	threaded_run_async(folder, param, result, func,
+			   threaded_run_done, &wait);
+	threaded_wait(&wait.finished);
 
-	if (imap != get_imap(folder)) {
-		g_warning("returning from operation on a stale imap %p", imap);
+	/* the main loop may have run on after the callback */
+	if (wait.stale || imap != get_imap(folder))
 		return 1;
-	}
 
 	return 0;
 }
@@ -954,50 +1030,61 @@ struct login_result {
 	int error;
 };
 
-static void login_run(struct etpan_thread_op * op)
+static int do_mailimap_login(mailimap * imap, const char * login,
+			     const char * password, const char * type,
+			     const char * server)
 {
-	struct login_param * param;
-	struct login_result * result;
 	int r;
 #ifdef DISABLE_LOG_DURING_LOGIN
 	int old_debug;
 #endif
-	
-	param = op->param;
-	result = op->result;
-
-	CHECK_IMAP();
 
 #ifdef DISABLE_LOG_DURING_LOGIN
 	old_debug = mailstream_debug;
 	mailstream_debug = 0;
 #endif
-	if (!strcmp(param->type, "plaintext"))
-		r = mailimap_login(param->imap,
-			   param->login, param->password);
-	else if (!strcmp(param->type, "GSSAPI"))
-		r = mailimap_authenticate(param->imap,
-			param->type, param->server, NULL, NULL,
-			param->login, param->login,
-			param->password, NULL);
-	else if (!strcmp(param->type, "SCRAM-SHA-1"))
+	if (!strcmp(type, "plaintext"))
+		r = mailimap_login(imap,
+			   login, password);
+	else if (!strcmp(type, "GSSAPI"))
+		r = mailimap_authenticate(imap,
+			type, server, NULL, NULL,
+			login, login,
+			password, NULL);
+	else if (!strcmp(type, "SCRAM-SHA-1"))
 		/* 7th argument has to be NULL here, to stop libetpan sending the
 		 * a= attribute in its initial SCRAM-SHA-1 message to server. At least
 		 * Dovecot 2.2 doesn't seem to like that, and will not authenticate
 		 * successfully. */
-		r = mailimap_authenticate(param->imap,
-			param->type, NULL, NULL, NULL,
-			NULL, param->login,
-			param->password, NULL);
+		r = mailimap_authenticate(imap,
+			type, NULL, NULL, NULL,
+			NULL, login,
+			password, NULL);
 	else
-		r = mailimap_authenticate(param->imap,
-			param->type, NULL, NULL, NULL,
-			param->login, param->login,
-			param->password, NULL);
+		r = mailimap_authenticate(imap,
+			type, NULL, NULL, NULL,
+			login, login,
+			password, NULL);
 #ifdef DISABLE_LOG_DURING_LOGIN
 	mailstream_debug = old_debug;
 #endif
 	
+	return r;
+}
+
+static void login_run(struct etpan_thread_op * op)
+{
+	struct login_param * param;
+	struct login_result * result;
+	int r;
+	
+	param = op->param;
+	result = op->result;
+
+	CHECK_IMAP();
+
+	r = do_mailimap_login(param->imap, param->login, param->password,
+			      param->type, param->server);
 	result->error = r;
 	if (param->imap->imap_response)
 		imap_logger_cmd(0, param->imap->imap_response, strlen(param->imap->imap_response));
@@ -1063,16 +1150,10 @@ static void status_run(struct etpan_thread_op * op)
 	debug_print("imap status run - end %i\n", r);
 }
 
-int imap_threaded_status(Folder * folder, const char * mb,
-			 struct mailimap_mailbox_data_status ** data_status,
-			 guint mask)
+static struct mailimap_status_att_list * status_att_list_new(guint mask)
 {
-	struct status_param param;
-	struct status_result result;
 	struct mailimap_status_att_list * status_att_list;
-	
-	debug_print("imap status - begin\n");
-	
+
 	status_att_list = mailimap_status_att_list_new_empty();
 	if (mask & 1 << 0) {
 		mailimap_status_att_list_add(status_att_list,
@@ -1094,19 +1175,79 @@ int imap_threaded_status(Folder * folder, const char * mb,
 		mailimap_status_att_list_add(status_att_list,
 				     MAILIMAP_STATUS_ATT_UNSEEN);
 	}
-	param.imap = get_imap(folder);
-	param.mb = mb;
-	param.status_att_list = status_att_list;
-	
-	threaded_run(folder, &param, &result, status_run);
-	
+	return status_att_list;
+}
+
+struct status_call {
+	struct status_param param;
+	struct status_result result;
+	gchar * mb;
+	IMAPStatusFunc callback;
+	void * data;
+};
+
+static void status_done(Folder * folder, gboolean stale, void * data)
+{
+	struct status_call * call = data;
+
 	debug_print("imap status - end\n");
-	
-	* data_status = result.data_status;
-	
-	mailimap_status_att_list_free(status_att_list);
-	
-	return result.error;
+
+	mailimap_status_att_list_free(call->param.status_att_list);
+	call->callback(folder, call->result.error, call->result.data_status,
+		       call->data);
+	g_free(call->mb);
+	g_free(call);
+}
+
+void imap_threaded_status_async(Folder * folder, const char * mb, guint mask,
+				IMAPStatusFunc callback, void * data)
+{
+	struct status_call * call;
+
+	debug_print("imap status - begin\n");
+
+	call = g_new0(struct status_call, 1);
+	call->mb = g_strdup(mb);
+	call->callback = callback;
+	call->data = data;
+
+	call->param.imap = get_imap(folder);
+	call->param.mb = call->mb;
+	call->param.status_att_list = status_att_list_new(mask);
+
+	threaded_run_async(folder, &call->param, &call->result, status_run,
+			   status_done, call);
+}
+
+struct status_wait {
+	gboolean finished;
+	int error;
+	struct mailimap_mailbox_data_status * data_status;
+};
+
+static void status_wait_cb(Folder * folder, int error,
+			   struct mailimap_mailbox_data_status * data_status,
+			   void * data)
+{
+	struct status_wait * wait = data;
+
+	wait->error = error;
+	wait->data_status = data_status;
+	wait->finished = TRUE;
+}
+
+int imap_threaded_status(Folder * folder, const char * mb,
+			 struct mailimap_mailbox_data_status ** data_status,
+			 guint mask)
+{
+	struct status_wait wait = { FALSE, 0, NULL };
+
+	imap_threaded_status_async(folder, mb, mask, status_wait_cb, &wait);
+	threaded_wait(&wait.finished);
+
+	* data_status = wait.data_status;
+
+	return wait.error;
 }
 
 
@@ -1136,6 +1277,98 @@ static void noop_run(struct etpan_thread_op * op)
 	debug_print("imap noop run - end %i\n", r);
 }
 
+static void noop_get_info(mailimap * imap, int error, IMAPNoopInfo * info)
+{
+	memset(info, 0, sizeof(* info));
+
+	if (error != MAILIMAP_NO_ERROR || imap == NULL)
+		return;
+
+	if (imap->imap_selection_info != NULL) {
+		info->exists = imap->imap_selection_info->sel_exists;
+		info->recent = imap->imap_selection_info->sel_recent;
+		info->unseen = imap->imap_selection_info->sel_unseen;
+		info->uidnext = imap->imap_selection_info->sel_uidnext;
+		info->uidval = imap->imap_selection_info->sel_uidvalidity;
+	}
+	if (imap->imap_response_info != NULL &&
+	    imap->imap_response_info->rsp_expunged != NULL) {
+		info->expunge = clist_count(imap->imap_response_info->rsp_expunged);
+	}
+#ifdef HAVE_MAILIMAP_UID_FETCH_QRESYNC
+	/* with QRESYNC enabled, expunges are reported as VANISHED */
+	if (imap->imap_response_info != NULL &&
+	    imap->imap_response_info->rsp_extension_list != NULL) {
+		clistiter * cur;
+
+		for (cur = clist_begin(imap->imap_response_info->rsp_extension_list);
+		     cur != NULL; cur = clist_next(cur)) {
+			struct mailimap_extension_data * ext_data = clist_content(cur);
+
+			if (ext_data->ext_extension == &mailimap_extension_qresync &&
+			    ext_data->ext_type == MAILIMAP_QRESYNC_TYPE_VANISHED)
+				info->expunge++;
+		}
+	}
+#endif
+}
+
+struct noop_call {
+	struct noop_param param;
+	struct noop_result result;
+	IMAPNoopFunc callback;
+	void * data;
+};
+
+static void noop_done(Folder * folder, gboolean stale, void * data)
+{
+	struct noop_call * call = data;
+	IMAPNoopInfo info;
+	int error;
+
+	error = stale ? MAILIMAP_ERROR_INVAL : call->result.error;
+	noop_get_info(stale ? NULL : call->param.imap, error, &info);
+
+	debug_print("imap noop - end [EXISTS %d RECENT %d EXPUNGE %d UNSEEN %d UIDNEXT %d UIDVAL %d]\n",
+		info.exists, info.recent, info.expunge, info.unseen,
+		info.uidnext, info.uidval);
+
+	call->callback(folder, error, &info, call->data);
+	g_free(call);
+}
+
+void imap_threaded_noop_async(Folder * folder, IMAPNoopFunc callback,
+			      void * data)
+{
+	struct noop_call * call;
+
+	debug_print("imap noop - begin\n");
+
+	call = g_new0(struct noop_call, 1);
+	call->callback = callback;
+	call->data = data;
+	call->param.imap = get_imap(folder);
+
+	threaded_run_async(folder, &call->param, &call->result, noop_run,
+			   noop_done, call);
+}
+
+struct noop_wait {
+	gboolean finished;
+	int error;
+	IMAPNoopInfo info;
+};
+
+static void noop_wait_cb(Folder * folder, int error,
+			 const IMAPNoopInfo * info, void * data)
+{
+	struct noop_wait * wait = data;
+
+	wait->error = error;
+	wait->info = * info;
+	wait->finished = TRUE;
+}
+
 int imap_threaded_noop(Folder * folder, unsigned int * p_exists, 
 		       unsigned int *p_recent, 
 		       unsigned int *p_expunge,
@@ -1143,42 +1376,21 @@ int imap_threaded_noop(Folder * folder, unsigned int * p_exists,
 		       unsigned int *p_uidnext,
 		       unsigned int *p_uidval)
 {
-	struct noop_param param;
-	struct noop_result result;
-	mailimap * imap;
-	
-	debug_print("imap noop - begin\n");
-	
-	imap = get_imap(folder);
-	param.imap = imap;
+	struct noop_wait wait;
 
-	if (threaded_run(folder, &param, &result, noop_run))
-		return MAILIMAP_ERROR_INVAL;
+	memset(&wait, 0, sizeof(wait));
 
-	if (result.error == 0 && imap && imap->imap_selection_info != NULL) {
-		* p_exists = imap->imap_selection_info->sel_exists;
-		* p_recent = imap->imap_selection_info->sel_recent;
-		* p_unseen = imap->imap_selection_info->sel_unseen;
-		* p_uidnext = imap->imap_selection_info->sel_uidnext;
-		* p_uidval = imap->imap_selection_info->sel_uidvalidity;
-	} else {
-		* p_exists = 0;
-		* p_recent = 0;
-		* p_unseen = 0;
-		* p_uidnext = 0;
-		* p_uidval = 0;
-	}
-	if (result.error == 0 && imap && imap->imap_response_info != NULL &&
-	    imap->imap_response_info->rsp_expunged != NULL) {
-		* p_expunge = clist_count(imap->imap_response_info->rsp_expunged);
-	} else {
-		* p_expunge = 0;
-	}	
-	debug_print("imap noop - end [EXISTS %d RECENT %d EXPUNGE %d UNSEEN %d UIDNEXT %d UIDVAL %d]\n",
-		*p_exists, *p_recent, *p_expunge, *p_unseen,
-		*p_uidnext, *p_uidval);
-	
-	return result.error;
+	imap_threaded_noop_async(folder, noop_wait_cb, &wait);
+	threaded_wait(&wait.finished);
+
+	* p_exists = wait.info.exists;
+	* p_recent = wait.info.recent;
+	* p_expunge = wait.info.expunge;
+	* p_unseen = wait.info.unseen;
+	* p_uidnext = wait.info.uidnext;
+	* p_uidval = wait.info.uidval;
+
+	return wait.error;
 }
 
 #ifdef USE_GNUTLS
@@ -1186,45 +1398,47 @@ struct starttls_result {
 	int error;
 };
 
+static int do_mailimap_starttls(mailimap * imap, PrefsAccount * account)
+{
+	mailstream_low *plain_low = NULL;
+	mailstream_low *tls_low = NULL;
+	int fd = -1;
+	int r;
+
+	r = mailimap_starttls(imap);
+	debug_print("imap STARTTLS run - end %i\n", r);
+	if (r != 0)
+		return r;
+
+	plain_low = mailstream_get_low(imap->imap_stream);
+	fd = mailstream_low_get_fd(plain_low);
+	if (fd == -1) {
+		debug_print("imap STARTTLS run - can't get fd\n");
+		return MAILIMAP_ERROR_STREAM;
+	}
+
+	tls_low = mailstream_low_tls_open_with_callback(fd, etpan_connect_ssl_context_cb, account);
+	if (tls_low == NULL) {
+		debug_print("imap STARTTLS run - can't tls_open\n");
+		return MAILIMAP_ERROR_STREAM;
+	}
+	mailstream_low_free(plain_low);
+	mailstream_set_low(imap->imap_stream, tls_low);
+
+	return r;
+}
+
 static void starttls_run(struct etpan_thread_op * op)
 {
 	struct connect_param * param;
 	struct starttls_result * result;
-	int r;
 
 	param = op->param;
 	result = op->result;
 
 	CHECK_IMAP();
 
-	r = mailimap_starttls(param->imap);
-	
-	result->error = r;
-	debug_print("imap STARTTLS run - end %i\n", r);
-	
-	if (r == 0) {
-		mailimap *imap = param->imap;
-		mailstream_low *plain_low = NULL;
-		mailstream_low *tls_low = NULL;
-		int fd = -1;
-		
-		plain_low = mailstream_get_low(imap->imap_stream);
-		fd = mailstream_low_get_fd(plain_low);
-		if (fd == -1) {
-			debug_print("imap STARTTLS run - can't get fd\n");
-			result->error = MAILIMAP_ERROR_STREAM;
-			return;
-		}
-
-		tls_low = mailstream_low_tls_open_with_callback(fd, etpan_connect_ssl_context_cb, param->account);
-		if (tls_low == NULL) {
-			debug_print("imap STARTTLS run - can't tls_open\n");
-			result->error = MAILIMAP_ERROR_STREAM;
-			return;
-		}
-		mailstream_low_free(plain_low);
-		mailstream_set_low(imap->imap_stream, tls_low);
-	}
+	result->error = do_mailimap_starttls(param->imap, param->account);
 }
 
 int imap_threaded_starttls(Folder * folder, const gchar *host, int port)
@@ -1257,48 +1471,264 @@ int imap_threaded_starttls(Folder * folder, const gchar *host, int port)
 }
 #endif
 
-struct create_param {
-	mailimap * imap;
-	const char * mb;
+/* COMPRESS=DEFLATE (RFC 4978)
+ *
+ * To show what compression saves in the protocol log, the drivers of the
+ * stream below and above the deflate layer are swapped for copies whose
+ * read and write count the bytes. The counts are logged once the
+ * connection is closed. */
+
+#ifdef HAVE_MAILIMAP_COMPRESS
+
+struct compress_stats {
+	gchar * server;
+	gboolean enabled;
+	int refs;
+	/* on the wire */
+	guint64 wire_received;
+	guint64 wire_sent;
+	/* before compression */
+	guint64 received;
+	guint64 sent;
 };
 
-struct create_result {
-	int error;
+struct count_driver {
+	/* must come first, see count_driver_get() */
+	mailstream_low_driver driver;
+	mailstream_low_driver * orig;
+	struct compress_stats * stats;
+	gboolean wire;
 };
 
-static void create_run(struct etpan_thread_op * op)
+static struct count_driver * count_driver_get(mailstream_low * s)
 {
-	struct create_param * param;
-	struct create_result * result;
-	int r;
-	
-	param = op->param;
-	result = op->result;
+	return (struct count_driver *) s->driver;
+}
 
-	CHECK_IMAP();
+static gboolean compress_stats_log(gpointer data)
+{
+	struct compress_stats * stats = data;
 
-	r = mailimap_create(param->imap, param->mb);
-	
-	result->error = r;
-	debug_print("imap create run - end %i\n", r);
+	log_message(LOG_PROTOCOL, "IMAP compression on %s: received %"
+		    G_GUINT64_FORMAT " bytes (%" G_GUINT64_FORMAT
+		    " uncompressed), sent %" G_GUINT64_FORMAT " bytes (%"
+		    G_GUINT64_FORMAT " uncompressed)\n", stats->server,
+		    stats->wire_received, stats->received,
+		    stats->wire_sent, stats->sent);
+	g_free(stats->server);
+	g_free(stats);
+
+	return FALSE;
 }
 
-int imap_threaded_create(Folder * folder, const char * mb)
+static void compress_stats_unref(struct compress_stats * stats)
 {
-	struct create_param param;
-	struct create_result result;
-	
-	debug_print("imap create - begin\n");
-	
-	param.imap = get_imap(folder);
-	param.mb = mb;
-	
-	threaded_run(folder, &param, &result, create_run);
-	
-	debug_print("imap create - end\n");
-	
-	return result.error;
-}
+	if (--stats->refs > 0)
+		return;
+
+	/* the stream is freed on the thread of the connection */
+	if (stats->enabled) {
+		g_idle_add(compress_stats_log, stats);
+	} else {
+		g_free(stats->server);
+		g_free(stats);
+	}
+}
+
+static ssize_t count_read(mailstream_low * s, void * buf, size_t count)
+{
+	struct count_driver * d = count_driver_get(s);
+	ssize_t r;
+
+	r = d->orig->mailstream_read(s, buf, count);
+	if (r > 0) {
+		if (d->wire)
+			d->stats->wire_received += r;
+		else
+			d->stats->received += r;
+	}
+	return r;
+}
+
+static ssize_t count_write(mailstream_low * s, const void * buf, size_t count)
+{
+	struct count_driver * d = count_driver_get(s);
+	ssize_t r;
+
+	r = d->orig->mailstream_write(s, buf, count);
+	if (r > 0) {
+		if (d->wire)
+			d->stats->wire_sent += r;
+		else
+			d->stats->sent += r;
+	}
+	return r;
+}
+
+static void count_free(mailstream_low * s)
+{
+	struct count_driver * d = count_driver_get(s);
+
+	s->driver = d->orig;
+	s->driver->mailstream_free(s);
+
+	compress_stats_unref(d->stats);
+	g_free(d);
+}
+
+static void count_driver_install(mailstream_low * s,
+				 struct compress_stats * stats, gboolean wire)
+{
+	struct count_driver * d;
+
+	d = g_new0(struct count_driver, 1);
+	d->driver = * s->driver;
+	d->driver.mailstream_read = count_read;
+	d->driver.mailstream_write = count_write;
+	d->driver.mailstream_free = count_free;
+	d->orig = s->driver;
+	d->stats = stats;
+	d->wire = wire;
+
+	stats->refs++;
+	s->driver = &d->driver;
+}
+
+/* Enables compression if the server supports it; enabled tells whether
+ * it did. */
+static int do_mailimap_compress(mailimap * imap, const char * server,
+				gboolean * enabled)
+{
+	struct compress_stats * stats;
+	int r;
+
+	* enabled = FALSE;
+
+	if (imap->imap_connection_info == NULL ||
+	    imap->imap_connection_info->imap_capability == NULL) {
+		struct mailimap_capability_data * caps = NULL;
+
+		r = mailimap_capability(imap, &caps);
+		if (r != MAILIMAP_NO_ERROR)
+			return r;
+		mailimap_capability_data_free(caps);
+	}
+	if (!mailimap_has_compress_deflate(imap))
+		return MAILIMAP_NO_ERROR;
+
+	stats = g_new0(struct compress_stats, 1);
+	stats->server = g_strdup(server);
+	stats->refs = 1;
+	count_driver_install(mailstream_get_low(imap->imap_stream),
+			     stats, TRUE);
+
+	r = mailimap_compress(imap);
+	if (r == MAILIMAP_NO_ERROR) {
+		count_driver_install(mailstream_get_low(imap->imap_stream),
+				     stats, FALSE);
+		stats->enabled = TRUE;
+		* enabled = TRUE;
+	}
+	compress_stats_unref(stats);
+
+	return r;
+}
+
+#endif
+
+struct compress_param {
+	mailimap * imap;
+	const char * server;
+};
+
+struct compress_result {
+	int error;
+	gboolean enabled;
+};
+
+static void compress_run(struct etpan_thread_op * op)
+{
+	struct compress_param * param;
+	struct compress_result * result;
+
+	param = op->param;
+	result = op->result;
+
+	CHECK_IMAP();
+
+#ifdef HAVE_MAILIMAP_COMPRESS
+	result->error = do_mailimap_compress(param->imap, param->server,
+					     &result->enabled);
+#else
+	result->error = MAILIMAP_NO_ERROR;
+	result->enabled = FALSE;
+#endif
+	debug_print("imap compress run - end %i\n", result->error);
+}
+
+int imap_threaded_compress(Folder * folder, gboolean * enabled)
+{
+	struct compress_param param;
+	struct compress_result result;
+
+	debug_print("imap compress - begin\n");
+
+	param.imap = get_imap(folder);
+	param.server = folder->account ? folder->account->recv_server : "";
+	result.enabled = FALSE;
+
+	if (threaded_run(folder, &param, &result, compress_run))
+		return MAILIMAP_ERROR_INVAL;
+
+	debug_print("imap compress - end\n");
+
+	* enabled = result.enabled;
+
+	return result.error;
+}
+
+struct create_param {
+	mailimap * imap;
+	const char * mb;
+};
+
+struct create_result {
+	int error;
+};
+
+static void create_run(struct etpan_thread_op * op)
+{
+	struct create_param * param;
+	struct create_result * result;
+	int r;
+	
+	param = op->param;
+	result = op->result;
+
+	CHECK_IMAP();
+
+	r = mailimap_create(param->imap, param->mb);
+	
+	result->error = r;
+	debug_print("imap create run - end %i\n", r);
+}
+
+int imap_threaded_create(Folder * folder, const char * mb)
+{
+	struct create_param param;
+	struct create_result result;
+	
+	debug_print("imap create - begin\n");
+	
+	param.imap = get_imap(folder);
+	param.mb = mb;
+	
+	threaded_run(folder, &param, &result, create_run);
+	
+	debug_print("imap create - end\n");
+	
+	return result.error;
+}
 
 
 
@@ -1400,10 +1830,12 @@ int imap_threaded_delete(Folder * folder, const char * mb)
 struct select_param {
 	mailimap * imap;
 	const char * mb;
+	gboolean condstore;
 };
 
 struct select_result {
 	int error;
+	guint64 highestmodseq;
 };
 
 static void select_run(struct etpan_thread_op * op)
@@ -1417,7 +1849,16 @@ static void select_run(struct etpan_thread_op * op)
 
 	CHECK_IMAP();
 
-	r = mailimap_select(param->imap, param->mb);
+	result->highestmodseq = 0;
+#ifdef HAVE_MAILIMAP_UID_FETCH_QRESYNC
+	if (param->condstore) {
+		uint64_t modseq = 0;
+
+		r = mailimap_select_condstore(param->imap, param->mb, &modseq);
+		result->highestmodseq = modseq;
+	} else
+#endif
+		r = mailimap_select(param->imap, param->mb);
 	
 	result->error = r;
 	debug_print("imap select run - end %i\n", r);
@@ -1426,7 +1867,7 @@ static void select_run(struct etpan_thread_op * op)
 int imap_threaded_select(Folder * folder, const char * mb,
 			 gint * exists, gint * recent, gint * unseen,
 			 guint32 * uid_validity,gint *can_create_flags,
-			 GSList **ok_flags)
+			 GSList **ok_flags, guint64 *highestmodseq)
 {
 	struct select_param param;
 	struct select_result result;
@@ -1437,6 +1878,7 @@ int imap_threaded_select(Folder * folder, const char * mb,
 	imap = get_imap(folder);
 	param.imap = imap;
 	param.mb = mb;
+	param.condstore = (highestmodseq != NULL);
 	
 	if (threaded_run(folder, &param, &result, select_run))
 		return MAILIMAP_ERROR_INVAL;
@@ -1447,6 +1889,9 @@ int imap_threaded_select(Folder * folder, const char * mb,
 	if (!imap || imap->imap_selection_info == NULL)
 		return MAILIMAP_ERROR_PARSE;
 	
+	/* 0 if the server has no mod-sequences for this mailbox */
+	if (highestmodseq)
+		* highestmodseq = result.highestmodseq;
 	* exists = imap->imap_selection_info->sel_exists;
 	* recent = imap->imap_selection_info->sel_recent;
 	* unseen = imap->imap_selection_info->sel_unseen;
@@ -1767,6 +2212,408 @@ int imap_threaded_search(Folder * folder, int search_type, IMAPSearchKey* key,
 	return result.error;
 }
 
+/* ESEARCH (RFC 4731)
+ *
+ * libetpan neither sends RETURN options nor parses ESEARCH responses, so
+ * the search is written out here, sent as a custom command, and its
+ * answer picked up by the extension below. Only ALL is asked for: the
+ * matches then come as a compact set, where SEARCH sends every UID of a
+ * large folder one by one. Keys that can't be written on one line (non
+ * ASCII strings need a literal) are left to imap_threaded_search(). */
+
+#ifdef HAVE_MAILIMAP_CUSTOM_COMMAND
+
+static int esearch_parse(int calling_parser, mailstream * fd,
+			 MMAPString * buffer,
+			 struct mailimap_parser_context * parser_ctx,
+			 size_t * indx,
+			 struct mailimap_extension_data ** result,
+			 size_t progr_rate, progress_function * progr_fun);
+static void esearch_free(struct mailimap_extension_data * ext_data);
+
+static struct mailimap_extension_api esearch_extension = {
+	/* name */	"ESEARCH",
+	/* id */	-1,
+	/* parser */	esearch_parse,
+	/* free */	esearch_free
+};
+
+/* * ESEARCH [(TAG "tag")] [UID] *(name value), up to the CRLF */
+static int esearch_parse(int calling_parser, mailstream * fd,
+			 MMAPString * buffer,
+			 struct mailimap_parser_context * parser_ctx,
+			 size_t * indx,
+			 struct mailimap_extension_data ** result,
+			 size_t progr_rate, progress_function * progr_fun)
+{
+	const char * start = buffer->str + * indx;
+	const char * end;
+	gchar * line, ** words;
+	const gchar * all = "";
+	IMAPUidSet * uids;
+	int i = 0;
+
+	if (calling_parser != MAILIMAP_EXTENDED_PARSER_MAILBOX_DATA &&
+	    calling_parser != MAILIMAP_EXTENDED_PARSER_RESPONSE_DATA)
+		return MAILIMAP_ERROR_PARSE;
+	if (g_ascii_strncasecmp(start, "ESEARCH", 7) != 0 ||
+	    (start[7] != ' ' && start[7] != '\r'))
+		return MAILIMAP_ERROR_PARSE;
+	end = strchr(start, '\r');
+	if (end == NULL)
+		return MAILIMAP_ERROR_PARSE;
+
+	line = g_strndup(start + 7, end - start - 7);
+	words = g_strsplit(g_strstrip(line), " ", -1);
+	g_free(line);
+
+	if (words[i] != NULL && words[i][0] == '(') {
+		while (words[i] != NULL && !g_str_has_suffix(words[i], ")"))
+			i++;
+		if (words[i] != NULL)
+			i++;
+	}
+	if (words[i] != NULL && !g_ascii_strcasecmp(words[i], "UID"))
+		i++;
+	for (; words[i] != NULL && words[i + 1] != NULL; i += 2) {
+		if (!g_ascii_strcasecmp(words[i], "ALL"))
+			all = words[i + 1];
+	}
+
+	uids = imap_uid_set_new_from_string(all);
+	g_strfreev(words);
+	if (uids == NULL)
+		return MAILIMAP_ERROR_PARSE;
+
+	* result = mailimap_extension_data_new(&esearch_extension, 0, uids);
+	if (* result == NULL) {
+		imap_uid_set_free(uids);
+		return MAILIMAP_ERROR_MEMORY;
+	}
+	* indx = end - buffer->str;
+
+	return MAILIMAP_NO_ERROR;
+}
+
+static void esearch_free(struct mailimap_extension_data * ext_data)
+{
+	if (ext_data == NULL)
+		return;
+	imap_uid_set_free(ext_data->ext_data);
+	free(ext_data);
+}
+
+static gboolean esearch_append_set(GString * str, struct mailimap_set * set)
+{
+	IMAPUidSet * uids = imap_uid_set_new_from_lep_set(set);
+	gchar * set_str = imap_uid_set_to_string(uids);
+	gboolean ok = set_str[0] != '\0';
+
+	g_string_append(str, set_str);
+	g_free(set_str);
+	imap_uid_set_free(uids);
+
+	return ok;
+}
+
+/* a quoted string, which is 7 bit and has no CR or LF */
+static gboolean esearch_append_string(GString * str, const char * s)
+{
+	g_string_append_c(str, '"');
+	for (; * s != '\0'; s++) {
+		if ((guchar) * s >= 0x80 || * s == '\r' || * s == '\n')
+			return FALSE;
+		if (* s == '"' || * s == '\\')
+			g_string_append_c(str, '\\');
+		g_string_append_c(str, * s);
+	}
+	g_string_append_c(str, '"');
+
+	return TRUE;
+}
+
+static gboolean esearch_append_atom(GString * str, const char * s)
+{
+	if (* s == '\0')
+		return FALSE;
+	for (; * s != '\0'; s++) {
+		if ((guchar) * s <= ' ' || (guchar) * s >= 0x7f ||
+		    strchr("(){%*\"\\]", * s) != NULL)
+			return FALSE;
+		g_string_append_c(str, * s);
+	}
+
+	return TRUE;
+}
+
+static gboolean esearch_append_date(GString * str, const char * name,
+				    struct mailimap_date * date)
+{
+	static const char * months[] = {
+		"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+		"Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+	};
+
+	if (date->dt_month < 1 || date->dt_month > 12)
+		return FALSE;
+	g_string_append_printf(str, "%s %d-%s-%d", name, date->dt_day,
+			       months[date->dt_month - 1], date->dt_year);
+
+	return TRUE;
+}
+
+/* writes @key as sent by libetpan, for the keys imap_search_new() and
+ * friends make */
+static gboolean esearch_append_key(GString * str,
+				   struct mailimap_search_key * key)
+{
+	clistiter * cur;
+
+	switch (key->sk_type) {
+	case MAILIMAP_SEARCH_KEY_ALL:
+		g_string_append(str, "ALL");
+		return TRUE;
+	case MAILIMAP_SEARCH_KEY_ANSWERED:
+		g_string_append(str, "ANSWERED");
+		return TRUE;
+	case MAILIMAP_SEARCH_KEY_DELETED:
+		g_string_append(str, "DELETED");
+		return TRUE;
+	case MAILIMAP_SEARCH_KEY_FLAGGED:
+		g_string_append(str, "FLAGGED");
+		return TRUE;
+	case MAILIMAP_SEARCH_KEY_NEW:
+		g_string_append(str, "NEW");
+		return TRUE;
+	case MAILIMAP_SEARCH_KEY_SEEN:
+		g_string_append(str, "SEEN");
+		return TRUE;
+	case MAILIMAP_SEARCH_KEY_UNSEEN:
+		g_string_append(str, "UNSEEN");
+		return TRUE;
+	case MAILIMAP_SEARCH_KEY_KEYWORD:
+		g_string_append(str, "KEYWORD ");
+		return esearch_append_atom(str, key->sk_data.sk_keyword);
+	case MAILIMAP_SEARCH_KEY_BODY:
+		g_string_append(str, "BODY ");
+		return esearch_append_string(str, key->sk_data.sk_body);
+	case MAILIMAP_SEARCH_KEY_CC:
+		g_string_append(str, "CC ");
+		return esearch_append_string(str, key->sk_data.sk_cc);
+	case MAILIMAP_SEARCH_KEY_FROM:
+		g_string_append(str, "FROM ");
+		return esearch_append_string(str, key->sk_data.sk_from);
+	case MAILIMAP_SEARCH_KEY_SUBJECT:
+		g_string_append(str, "SUBJECT ");
+		return esearch_append_string(str, key->sk_data.sk_subject);
+	case MAILIMAP_SEARCH_KEY_TEXT:
+		g_string_append(str, "TEXT ");
+		return esearch_append_string(str, key->sk_data.sk_text);
+	case MAILIMAP_SEARCH_KEY_TO:
+		g_string_append(str, "TO ");
+		return esearch_append_string(str, key->sk_data.sk_to);
+	case MAILIMAP_SEARCH_KEY_HEADER:
+		g_string_append(str, "HEADER ");
+		if (!esearch_append_string(str,
+				key->sk_data.sk_header.sk_header_name))
+			return FALSE;
+		g_string_append_c(str, ' ');
+		return esearch_append_string(str,
+				key->sk_data.sk_header.sk_header_value);
+	case MAILIMAP_SEARCH_KEY_LARGER:
+		g_string_append_printf(str, "LARGER %u",
+				       key->sk_data.sk_larger);
+		return TRUE;
+	case MAILIMAP_SEARCH_KEY_SMALLER:
+		g_string_append_printf(str, "SMALLER %u",
+				       key->sk_data.sk_smaller);
+		return TRUE;
+	case MAILIMAP_SEARCH_KEY_SENTBEFORE:
+		return esearch_append_date(str, "SENTBEFORE",
+					   key->sk_data.sk_sentbefore);
+	case MAILIMAP_SEARCH_KEY_SENTSINCE:
+		return esearch_append_date(str, "SENTSINCE",
+					   key->sk_data.sk_sentsince);
+	case MAILIMAP_SEARCH_KEY_NOT:
+		g_string_append(str, "NOT ");
+		return esearch_append_key(str, key->sk_data.sk_not);
+	case MAILIMAP_SEARCH_KEY_OR:
+		g_string_append(str, "OR ");
+		if (!esearch_append_key(str, key->sk_data.sk_or.sk_or1))
+			return FALSE;
+		g_string_append_c(str, ' ');
+		return esearch_append_key(str, key->sk_data.sk_or.sk_or2);
+	case MAILIMAP_SEARCH_KEY_UID:
+		g_string_append(str, "UID ");
+		return esearch_append_set(str, key->sk_data.sk_uid);
+	case MAILIMAP_SEARCH_KEY_MULTIPLE:
+		if (clist_isempty(key->sk_data.sk_multiple))
+			return FALSE;
+		g_string_append_c(str, '(');
+		for (cur = clist_begin(key->sk_data.sk_multiple); cur != NULL;
+		     cur = clist_next(cur)) {
+			if (cur != clist_begin(key->sk_data.sk_multiple))
+				g_string_append_c(str, ' ');
+			if (!esearch_append_key(str, clist_content(cur)))
+				return FALSE;
+		}
+		g_string_append_c(str, ')');
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+/* the UID SEARCH command for the search types of imap_threaded_search(),
+ * or NULL if it can't be sent as a custom command */
+static gchar * esearch_command(int type, IMAPSearchKey * key,
+			       struct mailimap_set * set)
+{
+	GString * str = g_string_new("UID SEARCH RETURN (ALL)");
+	gboolean ok = TRUE;
+
+	if (set != NULL) {
+		g_string_append(str, " UID ");
+		ok = esearch_append_set(str, set);
+	} else if (type == IMAP_SEARCH_TYPE_SIMPLE) {
+		g_string_append(str, " ALL");
+	}
+
+	switch (type) {
+	case IMAP_SEARCH_TYPE_SIMPLE:
+		break;
+	case IMAP_SEARCH_TYPE_SEEN:
+		g_string_append(str, " SEEN");
+		break;
+	case IMAP_SEARCH_TYPE_UNSEEN:
+		g_string_append(str, " UNSEEN");
+		break;
+	case IMAP_SEARCH_TYPE_ANSWERED:
+		g_string_append(str, " ANSWERED");
+		break;
+	case IMAP_SEARCH_TYPE_FLAGGED:
+		g_string_append(str, " FLAGGED");
+		break;
+	case IMAP_SEARCH_TYPE_DELETED:
+		g_string_append(str, " DELETED");
+		break;
+	case IMAP_SEARCH_TYPE_FORWARDED:
+		g_string_append(str, " KEYWORD " RTAG_FORWARDED);
+		break;
+	case IMAP_SEARCH_TYPE_SPAM:
+		g_string_append(str, " KEYWORD " RTAG_JUNK);
+		break;
+	case IMAP_SEARCH_TYPE_KEYED:
+		g_string_append_c(str, ' ');
+		ok = ok && key != NULL && esearch_append_key(str, key);
+		break;
+	default:
+		ok = FALSE;
+	}
+
+	return g_string_free(str, !ok);
+}
+
+#endif
+
+struct esearch_param {
+	mailimap * imap;
+	int type;
+	struct mailimap_set * set;
+	IMAPSearchKey * key;
+};
+
+struct esearch_result {
+	int error;
+	IMAPUidSet * uids;
+};
+
+static void esearch_run(struct etpan_thread_op * op)
+{
+	struct esearch_param * param;
+	struct esearch_result * result;
+#ifdef HAVE_MAILIMAP_CUSTOM_COMMAND
+	gchar * command;
+	clistiter * cur;
+	int r;
+#endif
+
+	param = op->param;
+	result = op->result;
+
+	CHECK_IMAP();
+
+	result->uids = NULL;
+#ifdef HAVE_MAILIMAP_CUSTOM_COMMAND
+	command = esearch_command(param->type, param->key, param->set);
+	if (command == NULL) {
+		result->error = MAILIMAP_ERROR_EXTENSION;
+		return;
+	}
+
+	mailstream_logger = imap_logger_uid;
+
+	r = mailimap_custom_command(param->imap, command);
+
+	mailstream_logger = imap_logger_cmd;
+
+	g_free(command);
+
+	if (r == MAILIMAP_NO_ERROR &&
+	    param->imap->imap_response_info != NULL &&
+	    param->imap->imap_response_info->rsp_extension_list != NULL) {
+		for (cur = clist_begin(param->imap->imap_response_info->rsp_extension_list);
+		     cur != NULL; cur = clist_next(cur)) {
+			struct mailimap_extension_data * ext_data = clist_content(cur);
+
+			if (ext_data->ext_extension != &esearch_extension)
+				continue;
+			if (result->uids == NULL) {
+				result->uids = ext_data->ext_data;
+				ext_data->ext_data = NULL;
+			} else {
+				imap_uid_set_union(result->uids, ext_data->ext_data);
+			}
+		}
+	}
+	/* no match is an empty ESEARCH, but don't rely on it */
+	if (r == MAILIMAP_NO_ERROR && result->uids == NULL)
+		result->uids = imap_uid_set_new();
+
+	result->error = r;
+#else
+	result->error = MAILIMAP_ERROR_EXTENSION;
+#endif
+	debug_print("imap esearch run - end %i\n", result->error);
+}
+
+int imap_threaded_esearch(Folder * folder, int search_type,
+			  IMAPSearchKey * key, struct mailimap_set * set,
+			  IMAPUidSet ** result)
+{
+	struct esearch_param param;
+	struct esearch_result esearch_result;
+
+	debug_print("imap esearch - begin\n");
+
+	param.imap = get_imap(folder);
+	param.type = search_type;
+	param.set = set;
+	param.key = key;
+
+	if (threaded_run(folder, &param, &esearch_result, esearch_run))
+		return MAILIMAP_ERROR_INVAL;
+
+	if (esearch_result.error != MAILIMAP_NO_ERROR)
+		return esearch_result.error;
+
+	debug_print("imap esearch - end\n");
+
+	* result = esearch_result.uids;
+
+	return esearch_result.error;
+}
+
 
 struct _IMAPSearchKey {
 	struct mailimap_search_key* key;
@@ -2215,56 +3062,66 @@ result_to_uid_flags_list(clist * fetch_result, carray ** result)
 	return res;
 }
 
-static int imap_get_messages_flags_list(mailimap * imap,
-					uint32_t first_index,
-					carray ** result)
+static struct mailimap_fetch_type * imap_flags_fetch_type_new(void)
 {
-	carray * env_list;
-	int r;
 	struct mailimap_fetch_att * fetch_att;
 	struct mailimap_fetch_type * fetch_type;
-	struct mailimap_set * set;
-	clist * fetch_result;
-	int res;
-	
-	set = mailimap_set_new_interval(first_index, 0);
-	if (set == NULL) {
-		res = MAILIMAP_ERROR_MEMORY;
-		goto err;
-	}
+	int r;
 
 	fetch_type = mailimap_fetch_type_new_fetch_att_list_empty();
-	if (fetch_type == NULL) {
-		res = MAILIMAP_ERROR_MEMORY;
-		goto free_set;
-	}
+	if (fetch_type == NULL)
+		return NULL;
 
 	fetch_att = mailimap_fetch_att_new_flags();
-	if (fetch_att == NULL) {
-		res = MAILIMAP_ERROR_MEMORY;
+	if (fetch_att == NULL)
 		goto free_fetch_type;
-	}
 	
 	r = mailimap_fetch_type_new_fetch_att_list_add(fetch_type, fetch_att);
 	if (r != MAILIMAP_NO_ERROR) {
 		mailimap_fetch_att_free(fetch_att);
-		res = MAILIMAP_ERROR_MEMORY;
 		goto free_fetch_type;
 	}
 	
 	fetch_att = mailimap_fetch_att_new_uid();
-	if (fetch_att == NULL) {
-		res = MAILIMAP_ERROR_MEMORY;
+	if (fetch_att == NULL)
 		goto free_fetch_type;
-	}
 
 	r = mailimap_fetch_type_new_fetch_att_list_add(fetch_type, fetch_att);
 	if (r != MAILIMAP_NO_ERROR) {
 		mailimap_fetch_att_free(fetch_att);
-		res = MAILIMAP_ERROR_MEMORY;
 		goto free_fetch_type;
 	}
 
+	return fetch_type;
+
+ free_fetch_type:
+	mailimap_fetch_type_free(fetch_type);
+	return NULL;
+}
+
+static int imap_get_messages_flags_list(mailimap * imap,
+					uint32_t first_index,
+					carray ** result)
+{
+	carray * env_list;
+	int r;
+	struct mailimap_fetch_type * fetch_type;
+	struct mailimap_set * set;
+	clist * fetch_result;
+	int res;
+	
+	set = mailimap_set_new_interval(first_index, 0);
+	if (set == NULL) {
+		res = MAILIMAP_ERROR_MEMORY;
+		goto err;
+	}
+
+	fetch_type = imap_flags_fetch_type_new();
+	if (fetch_type == NULL) {
+		res = MAILIMAP_ERROR_MEMORY;
+		goto free_set;
+	}
+
 	mailstream_logger = imap_logger_fetch;
 	
 	r = mailimap_uid_fetch(imap, set,
@@ -2287,8 +3144,6 @@ static int imap_get_messages_flags_list(mailimap * imap,
 
 	return MAILIMAP_NO_ERROR;
 
- free_fetch_type:
-	mailimap_fetch_type_free(fetch_type);
  free_set:
 	mailimap_set_free(set);
  err:
@@ -2365,6 +3220,256 @@ void imap_fetch_uid_flags_list_free(carray * uid_flags_list)
 	carray_free(uid_flags_list);
 }
 
+struct fetch_changed_param {
+	mailimap * imap;
+	guint64 modseq;
+	gboolean vanished;
+};
+
+struct fetch_changed_result {
+	int error;
+	carray * fetch_result;
+	struct mailimap_set * vanished;
+	guint64 highestmodseq;
+};
+
+#ifdef HAVE_MAILIMAP_UID_FETCH_QRESYNC
+static guint64 imap_get_fetch_result_modseq(clist * fetch_result)
+{
+	clistiter * cur;
+	guint64 modseq = 0;
+
+	for (cur = clist_begin(fetch_result) ; cur != NULL ;
+	     cur = clist_next(cur)) {
+		struct mailimap_msg_att * msg_att;
+		clistiter * item_cur;
+
+		msg_att = clist_content(cur);
+		for (item_cur = clist_begin(msg_att->att_list) ; item_cur != NULL ;
+		     item_cur = clist_next(item_cur)) {
+			struct mailimap_msg_att_item * item;
+			struct mailimap_extension_data * ext_data;
+			struct mailimap_condstore_fetch_mod_resp * mod_resp;
+
+			item = clist_content(item_cur);
+			if (item->att_type != MAILIMAP_MSG_ATT_ITEM_EXTENSION)
+				continue;
+			ext_data = item->att_data.att_extension_data;
+			if (ext_data->ext_extension != &mailimap_extension_condstore ||
+			    ext_data->ext_type != MAILIMAP_CONDSTORE_TYPE_FETCH_DATA)
+				continue;
+			mod_resp = ext_data->ext_data;
+			if (mod_resp->cs_modseq_value > modseq)
+				modseq = mod_resp->cs_modseq_value;
+		}
+	}
+
+	return modseq;
+}
+
+static struct mailimap_set * imap_set_copy(struct mailimap_set * src)
+{
+	struct mailimap_set * set;
+	clistiter * cur;
+
+	set = mailimap_set_new_empty();
+	if (set == NULL)
+		return NULL;
+
+	for (cur = clist_begin(src->set_list) ; cur != NULL ;
+	     cur = clist_next(cur)) {
+		struct mailimap_set_item * item = clist_content(cur);
+
+		if (mailimap_set_add_interval(set, item->set_first,
+					      item->set_last) != MAILIMAP_NO_ERROR) {
+			mailimap_set_free(set);
+			return NULL;
+		}
+	}
+
+	return set;
+}
+#endif
+
+static void fetch_uid_flags_changed_run(struct etpan_thread_op * op)
+{
+	struct fetch_changed_param * param;
+	struct fetch_changed_result * result;
+	int r;
+	
+	param = op->param;
+	result = op->result;
+
+	CHECK_IMAP();
+
+	result->fetch_result = NULL;
+	result->vanished = NULL;
+	result->highestmodseq = 0;
+
+#ifdef HAVE_MAILIMAP_UID_FETCH_QRESYNC
+	{
+		struct mailimap_fetch_type * fetch_type;
+		struct mailimap_set * set;
+		struct mailimap_qresync_vanished * vanished = NULL;
+		clist * fetch_result = NULL;
+
+		set = mailimap_set_new_interval(1, 0);
+		fetch_type = imap_flags_fetch_type_new();
+		if (set == NULL || fetch_type == NULL) {
+			if (set != NULL)
+				mailimap_set_free(set);
+			if (fetch_type != NULL)
+				mailimap_fetch_type_free(fetch_type);
+			result->error = MAILIMAP_ERROR_MEMORY;
+			return;
+		}
+
+		mailstream_logger = imap_logger_fetch;
+
+		if (param->vanished)
+			r = mailimap_uid_fetch_qresync(param->imap, set, fetch_type,
+						       param->modseq, &fetch_result,
+						       &vanished);
+		else
+			r = mailimap_uid_fetch_changedsince(param->imap, set, fetch_type,
+							    param->modseq, &fetch_result);
+
+		mailstream_logger = imap_logger_cmd;
+		mailimap_fetch_type_free(fetch_type);
+		mailimap_set_free(set);
+
+		if (r == MAILIMAP_NO_ERROR) {
+			result->highestmodseq = imap_get_fetch_result_modseq(fetch_result);
+			r = result_to_uid_flags_list(fetch_result, &result->fetch_result);
+			if (r == MAILIMAP_NO_ERROR && vanished != NULL &&
+			    vanished->qr_known_uids != NULL) {
+				result->vanished = imap_set_copy(vanished->qr_known_uids);
+				if (result->vanished == NULL)
+					r = MAILIMAP_ERROR_MEMORY;
+			}
+			if (r != MAILIMAP_NO_ERROR && result->fetch_result != NULL) {
+				imap_fetch_uid_flags_list_free(result->fetch_result);
+				result->fetch_result = NULL;
+			}
+		}
+		if (fetch_result != NULL)
+			mailimap_fetch_list_free(fetch_result);
+		if (vanished != NULL)
+			mailimap_qresync_vanished_free(vanished);
+	}
+#else
+	r = MAILIMAP_ERROR_EXTENSION;
+#endif
+
+	result->error = r;
+	debug_print("imap fetch_uid_flags_changed run - end %i\n", r);
+}
+
+/* UID FETCH 1:* (FLAGS) (CHANGEDSINCE modseq), with the VANISHED
+ * modifier if QRESYNC was enabled. vanished gets the UIDs expunged
+ * since modseq (may be NULL), highestmodseq the highest mod-sequence
+ * of the returned messages. */
+int imap_threaded_fetch_uid_flags_changed(Folder * folder, guint64 modseq,
+					  gboolean with_vanished,
+					  carray ** fetch_result,
+					  struct mailimap_set ** vanished,
+					  guint64 * highestmodseq)
+{
+	struct fetch_changed_param param;
+	struct fetch_changed_result result;
+	
+	debug_print("imap fetch_uid_flags_changed - begin\n");
+	
+	param.imap = get_imap(folder);
+	param.modseq = modseq;
+	param.vanished = with_vanished;
+	
+	mailstream_logger = imap_logger_noop;
+	log_print(LOG_PROTOCOL, "IMAP- [fetching flags changed since %"G_GUINT64_FORMAT"...]\n",
+		  modseq);
+
+	if (threaded_run(folder, &param, &result, fetch_uid_flags_changed_run))
+		result.error = MAILIMAP_ERROR_INVAL;
+
+	mailstream_logger = imap_logger_cmd;
+
+	if (result.error != MAILIMAP_NO_ERROR)
+		return result.error;
+	
+	debug_print("imap fetch_uid_flags_changed - end\n");
+	
+	* fetch_result = result.fetch_result;
+	* vanished = result.vanished;
+	* highestmodseq = result.highestmodseq;
+	
+	return result.error;
+}
+
+struct enable_param {
+	mailimap * imap;
+	const char * capability;
+};
+
+struct enable_result {
+	int error;
+};
+
+static void enable_run(struct etpan_thread_op * op)
+{
+	struct enable_param * param;
+	struct enable_result * result;
+	int r;
+	
+	param = op->param;
+	result = op->result;
+
+	CHECK_IMAP();
+
+#ifdef HAVE_MAILIMAP_UID_FETCH_QRESYNC
+	{
+		struct mailimap_capability_data * caps;
+		struct mailimap_capability_data * enabled = NULL;
+		struct mailimap_capability * cap;
+		clist * cap_list;
+
+		cap_list = clist_new();
+		cap = mailimap_capability_new(MAILIMAP_CAPABILITY_NAME, NULL,
+					      strdup(param->capability));
+		clist_append(cap_list, cap);
+		caps = mailimap_capability_data_new(cap_list);
+
+		r = mailimap_enable(param->imap, caps, &enabled);
+
+		mailimap_capability_data_free(caps);
+		if (enabled != NULL)
+			mailimap_capability_data_free(enabled);
+	}
+#else
+	r = MAILIMAP_ERROR_EXTENSION;
+#endif
+	
+	result->error = r;
+	debug_print("imap enable run - end %i\n", r);
+}
+
+int imap_threaded_enable(Folder * folder, const char * capability)
+{
+	struct enable_param param;
+	struct enable_result result;
+	
+	debug_print("imap enable - begin\n");
+	
+	param.imap = get_imap(folder);
+	param.capability = capability;
+	
+	if (threaded_run(folder, &param, &result, enable_run))
+		return MAILIMAP_ERROR_INVAL;
+	
+	debug_print("imap enable - end\n");
+	
+	return result.error;
+}
+
 
 
 static int imap_fetch(mailimap * imap,
@@ -2593,133 +3698,373 @@ struct fetch_content_result {
 	int error;
 };
 
-static void fetch_content_run(struct etpan_thread_op * op)
+/* Writes a fetched message out to filename. */
+static int store_content(const char * filename, const char * content,
+			 size_t content_size)
 {
-	struct fetch_content_param * param;
-	struct fetch_content_result * result;
-	char * content;
-	size_t content_size;
 	int r;
 	int fd;
 	FILE * f;
+
+	fd = g_open(filename, O_RDWR | O_CREAT, 0600);
+	if (fd < 0)
+		return MAILIMAP_ERROR_FETCH;
 	
-	param = op->param;
-	result = op->result;
+	f = claws_fdopen(fd, "wb");
+	if (f == NULL) {
+		close(fd);
+		goto unlink;
+	}
+	
+	r = claws_fwrite(content, 1, content_size, f);
+	if (r < content_size) {
+		claws_fclose(f);
+		goto unlink;
+	}
+	
+	r = claws_safe_fclose(f);
+	if (r == EOF)
+		goto unlink;
 
-	CHECK_IMAP();
+	return MAILIMAP_NO_ERROR;
+
+unlink:
+	claws_unlink(filename);
+	return MAILIMAP_ERROR_FETCH;
+}
+
+static void free_content(char * content)
+{
+	/* mmap_string_unref is a simple free in libetpan
+	 * when it has MMAP_UNAVAILABLE defined */
+	if (mmap_string_unref(content) != 0)
+		free(content);
+}
+
+static int do_fetch_content(mailimap * imap, uint32_t msg_index,
+			    int with_body, const char * filename)
+{
+	char * content;
+	size_t content_size;
+	int r;
 
 	content = NULL;
 	content_size = 0;
-	if (param->with_body)
-		r = imap_fetch(param->imap, param->msg_index,
+	if (with_body)
+		r = imap_fetch(imap, msg_index,
 			       &content, &content_size);
 	else
-		r = imap_fetch_header(param->imap, param->msg_index,
+		r = imap_fetch_header(imap, msg_index,
 				      &content, &content_size);
 	
-	result->error = r;
-	
 	if (r == MAILIMAP_NO_ERROR) {
-		fd = g_open(param->filename, O_RDWR | O_CREAT, 0600);
-		if (fd < 0) {
-			result->error = MAILIMAP_ERROR_FETCH;
-			goto free;
-		}
-		
-		f = claws_fdopen(fd, "wb");
-		if (f == NULL) {
-			result->error = MAILIMAP_ERROR_FETCH;
-			goto close;
-		}
-		
-		r = claws_fwrite(content, 1, content_size, f);
-		if (r < content_size) {
-			result->error = MAILIMAP_ERROR_FETCH;
-			goto do_fclose;
-		}
-		
-		r = claws_safe_fclose(f);
-		if (r == EOF) {
-			result->error = MAILIMAP_ERROR_FETCH;
-			goto unlink;
-		}
-		goto free;
-		
-	do_fclose:
-		claws_fclose(f);
-		goto unlink;
-	close:
-		close(fd);
-	unlink:
-		claws_unlink(param->filename);
-	
-	free:
-		/* mmap_string_unref is a simple free in libetpan
-		 * when it has MMAP_UNAVAILABLE defined */
-		if (mmap_string_unref(content) != 0)
-			free(content);
+		r = store_content(filename, content, content_size);
+		free_content(content);
 	}
-	
-	debug_print("imap fetch_content run - end %i\n", result->error);
-}
 
-int imap_threaded_fetch_content(Folder * folder, uint32_t msg_index,
-				int with_body,
-				const char * filename)
-{
-	struct fetch_content_param param;
-	struct fetch_content_result result;
-	mailimap * imap;
-	
-	debug_print("imap fetch_content - begin\n");
-	
-	imap = get_imap(folder);
-	param.imap = imap;
-	param.msg_index = msg_index;
-	param.filename = filename;
-	param.with_body = with_body;
-	
-	threaded_run(folder, &param, &result, fetch_content_run);
-	
-	if (result.error != MAILIMAP_NO_ERROR)
-		return result.error;
-	
-	debug_print("imap fetch_content - end\n");
-	
-	return result.error;
+	return r;
 }
 
+/* Batched fetch: the bodies of a set of messages are fetched with one
+ * UID FETCH, the server sending them back to back. Each body is written
+ * out as soon as it has been parsed when libetpan allows it, so that
+ * only one of them is held in memory. */
 
+struct fetch_set_state {
+	int count;
+	const uint32_t * uids;
+	char * const * filenames;
+	int * errors;
+};
 
-static int imap_flags_to_flags(struct mailimap_msg_att_dynamic * att_dyn, GSList **s_tags)
+static void fetch_set_store(struct fetch_set_state * state,
+			    struct mailimap_msg_att * msg_att)
 {
-	int flags;
-	clist * flag_list;
+	struct mailimap_msg_att_body_section * body = NULL;
+	uint32_t uid = 0;
 	clistiter * cur;
-	GSList *tags = NULL;
+	int i;
 
-	flags = MSG_UNREAD;
-	
-	flag_list = att_dyn->att_list;
-	if (flag_list == NULL)
-		return flags;
-	
-	for(cur = clist_begin(flag_list) ; cur != NULL ;
-	    cur = clist_next(cur)) {
-		struct mailimap_flag_fetch * flag_fetch;
-			
-		flag_fetch = clist_content(cur);
-		if (flag_fetch->fl_type == MAILIMAP_FLAG_FETCH_RECENT)
-			flags |= MSG_NEW;
-		else {
-			switch (flag_fetch->fl_flag->fl_type) {
-			case MAILIMAP_FLAG_ANSWERED:
-				flags |= MSG_REPLIED;
-				break;
-			case MAILIMAP_FLAG_FLAGGED:
-				flags |= MSG_MARKED;
-				break;
-			case MAILIMAP_FLAG_DELETED:
+	if (msg_att->att_list == NULL)
+		return;
+
+	for (cur = clist_begin(msg_att->att_list); cur != NULL;
+	     cur = clist_next(cur)) {
+		struct mailimap_msg_att_item * item = clist_content(cur);
+
+		if (item->att_type != MAILIMAP_MSG_ATT_ITEM_STATIC)
+			continue;
+		if (item->att_data.att_static->att_type == MAILIMAP_MSG_ATT_UID)
+			uid = item->att_data.att_static->att_data.att_uid;
+		else if (item->att_data.att_static->att_type ==
+			 MAILIMAP_MSG_ATT_BODY_SECTION)
+			body = item->att_data.att_static->att_data.att_body_section;
+	}
+	if (uid == 0 || body == NULL || body->sec_body_part == NULL)
+		return;
+
+	for (i = 0; i < state->count; i++)
+		if (state->uids[i] == uid)
+			break;
+	if (i == state->count || state->errors[i] == MAILIMAP_NO_ERROR)
+		return;
+
+	state->errors[i] = store_content(state->filenames[i],
+					 body->sec_body_part,
+					 body->sec_length);
+	/* detach */
+	free_content(body->sec_body_part);
+	body->sec_body_part = NULL;
+}
+
+#ifdef HAVE_MAILIMAP_SET_MSG_ATT_HANDLER
+static void fetch_set_msg_att_handler(struct mailimap_msg_att * msg_att,
+				      void * context)
+{
+	fetch_set_store(context, msg_att);
+}
+#endif
+
+/* Fetches the bodies of count messages into their files. errors[] gets
+ * the outcome for each message; the return value is the error of the
+ * command itself. */
+static int do_fetch_content_set(mailimap * imap, int count,
+				const uint32_t * uids,
+				char * const * filenames, int * errors)
+{
+	struct fetch_set_state state;
+	struct mailimap_set * set;
+	struct mailimap_fetch_type * fetch_type;
+	struct mailimap_fetch_att * fetch_att;
+	struct mailimap_section * section;
+	clist * fetch_result = NULL;
+	clistiter * cur;
+	int i;
+	int r;
+
+	for (i = 0; i < count; i++)
+		errors[i] = MAILIMAP_ERROR_FETCH;
+
+	set = mailimap_set_new_empty();
+	for (i = 0; i < count; i++)
+		mailimap_set_add_single(set, uids[i]);
+
+	fetch_type = mailimap_fetch_type_new_fetch_att_list_empty();
+	mailimap_fetch_type_new_fetch_att_list_add(fetch_type,
+						   mailimap_fetch_att_new_uid());
+	section = mailimap_section_new(NULL);
+	fetch_att = mailimap_fetch_att_new_body_peek_section(section);
+	mailimap_fetch_type_new_fetch_att_list_add(fetch_type, fetch_att);
+
+	state.count = count;
+	state.uids = uids;
+	state.filenames = filenames;
+	state.errors = errors;
+
+#ifdef HAVE_MAILIMAP_SET_MSG_ATT_HANDLER
+	mailimap_set_msg_att_handler(imap, fetch_set_msg_att_handler, &state);
+#endif
+	mailstream_logger = imap_logger_fetch;
+
+	r = mailimap_uid_fetch(imap, set, fetch_type, &fetch_result);
+
+	mailstream_logger = imap_logger_cmd;
+#ifdef HAVE_MAILIMAP_SET_MSG_ATT_HANDLER
+	mailimap_set_msg_att_handler(imap, NULL, NULL);
+#endif
+
+	mailimap_fetch_type_free(fetch_type);
+	mailimap_set_free(set);
+
+	if (r != MAILIMAP_NO_ERROR) {
+		/* messages written before the failure are kept */
+		for (i = 0; i < count; i++)
+			if (errors[i] != MAILIMAP_NO_ERROR)
+				errors[i] = r;
+		return r;
+	}
+
+	/* the bodies not handled while parsing */
+	for (cur = clist_begin(fetch_result); cur != NULL;
+	     cur = clist_next(cur))
+		fetch_set_store(&state, clist_content(cur));
+	mailimap_fetch_list_free(fetch_result);
+
+	return MAILIMAP_NO_ERROR;
+}
+
+static void fetch_content_run(struct etpan_thread_op * op)
+{
+	struct fetch_content_param * param;
+	struct fetch_content_result * result;
+	
+	param = op->param;
+	result = op->result;
+
+	CHECK_IMAP();
+
+	result->error = do_fetch_content(param->imap, param->msg_index,
+					 param->with_body, param->filename);
+	
+	debug_print("imap fetch_content run - end %i\n", result->error);
+}
+
+struct fetch_content_call {
+	struct fetch_content_param param;
+	struct fetch_content_result result;
+	gchar * filename;
+	IMAPThreadedFunc callback;
+	void * data;
+};
+
+static void fetch_content_done(Folder * folder, gboolean stale, void * data)
+{
+	struct fetch_content_call * call = data;
+
+	debug_print("imap fetch_content - end\n");
+
+	call->callback(folder, call->result.error, call->data);
+	g_free(call->filename);
+	g_free(call);
+}
+
+void imap_threaded_fetch_content_async(Folder * folder, uint32_t msg_index,
+				       int with_body, const char * filename,
+				       IMAPThreadedFunc callback, void * data)
+{
+	struct fetch_content_call * call;
+
+	debug_print("imap fetch_content - begin\n");
+
+	call = g_new0(struct fetch_content_call, 1);
+	call->filename = g_strdup(filename);
+	call->callback = callback;
+	call->data = data;
+
+	call->param.imap = get_imap(folder);
+	call->param.msg_index = msg_index;
+	call->param.filename = call->filename;
+	call->param.with_body = with_body;
+
+	threaded_run_async(folder, &call->param, &call->result,
+			   fetch_content_run, fetch_content_done, call);
+}
+
+struct threaded_func_wait {
+	gboolean finished;
+	int error;
+};
+
+static void threaded_func_wait_cb(Folder * folder, int error, void * data)
+{
+	struct threaded_func_wait * wait = data;
+
+	wait->error = error;
+	wait->finished = TRUE;
+}
+
+int imap_threaded_fetch_content(Folder * folder, uint32_t msg_index,
+				int with_body,
+				const char * filename)
+{
+	struct threaded_func_wait wait = { FALSE, 0 };
+
+	imap_threaded_fetch_content_async(folder, msg_index, with_body,
+					  filename, threaded_func_wait_cb,
+					  &wait);
+	threaded_wait(&wait.finished);
+
+	return wait.error;
+}
+
+
+
+struct fetch_content_set_param {
+	mailimap * imap;
+	int count;
+	const uint32_t * uids;
+	char * const * filenames;
+	int * errors;
+};
+
+struct fetch_content_set_result {
+	int error;
+};
+
+static void fetch_content_set_run(struct etpan_thread_op * op)
+{
+	struct fetch_content_set_param * param;
+	struct fetch_content_set_result * result;
+
+	param = op->param;
+	result = op->result;
+
+	CHECK_IMAP();
+
+	result->error = do_fetch_content_set(param->imap, param->count,
+					     param->uids, param->filenames,
+					     param->errors);
+
+	debug_print("imap fetch_content_set run - end %i\n", result->error);
+}
+
+int imap_threaded_fetch_content_set(Folder * folder, int count,
+				    const uint32_t * uids,
+				    char * const * filenames, int * errors)
+{
+	struct fetch_content_set_param param;
+	struct fetch_content_set_result result;
+	int i;
+
+	debug_print("imap fetch_content_set - begin (%d messages)\n", count);
+
+	for (i = 0; i < count; i++)
+		errors[i] = MAILIMAP_ERROR_BAD_STATE;
+
+	param.imap = get_imap(folder);
+	param.count = count;
+	param.uids = uids;
+	param.filenames = filenames;
+	param.errors = errors;
+
+	threaded_run(folder, &param, &result, fetch_content_set_run);
+
+	debug_print("imap fetch_content_set - end\n");
+
+	return result.error;
+}
+
+
+
+static int imap_flags_to_flags(struct mailimap_msg_att_dynamic * att_dyn, GSList **s_tags)
+{
+	int flags;
+	clist * flag_list;
+	clistiter * cur;
+	GSList *tags = NULL;
+
+	flags = MSG_UNREAD;
+	
+	flag_list = att_dyn->att_list;
+	if (flag_list == NULL)
+		return flags;
+	
+	for(cur = clist_begin(flag_list) ; cur != NULL ;
+	    cur = clist_next(cur)) {
+		struct mailimap_flag_fetch * flag_fetch;
+			
+		flag_fetch = clist_content(cur);
+		if (flag_fetch->fl_type == MAILIMAP_FLAG_FETCH_RECENT)
+			flags |= MSG_NEW;
+		else {
+			switch (flag_fetch->fl_flag->fl_type) {
+			case MAILIMAP_FLAG_ANSWERED:
+				flags |= MSG_REPLIED;
+				break;
+			case MAILIMAP_FLAG_FLAGGED:
+				flags |= MSG_MARKED;
+				break;
+			case MAILIMAP_FLAG_DELETED:
 				flags |= MSG_DELETED;
 				break;
 			case MAILIMAP_FLAG_SEEN:
@@ -3083,6 +4428,97 @@ void imap_fetch_env_free(carray * env_list)
 	carray_free(env_list);
 }
 
+/* EXAMINE then UID FETCH of the envelopes, as one operation so that
+ * nothing else runs on the mailbox in between */
+struct examine_fetch_env_param {
+	mailimap * imap;
+	const char * mb;
+	struct mailimap_set * set;
+};
+
+struct examine_fetch_env_result {
+	int error;
+	guint32 uid_validity;
+	carray * env_list;
+};
+
+static void examine_fetch_env_run(struct etpan_thread_op * op)
+{
+	struct examine_fetch_env_param * param;
+	struct examine_fetch_env_result * result;
+	int r;
+
+	param = op->param;
+	result = op->result;
+
+	CHECK_IMAP();
+
+	r = mailimap_examine(param->imap, param->mb);
+	if (r == MAILIMAP_NO_ERROR &&
+	    param->imap->imap_selection_info == NULL)
+		r = MAILIMAP_ERROR_PARSE;
+	if (r == MAILIMAP_NO_ERROR) {
+		result->uid_validity =
+			param->imap->imap_selection_info->sel_uidvalidity;
+		r = imap_get_envelopes_list(param->imap, param->set,
+					    &result->env_list);
+	}
+
+	result->error = r;
+	debug_print("imap examine_fetch_env run - end %i\n", r);
+}
+
+struct examine_fetch_env_call {
+	struct examine_fetch_env_param param;
+	struct examine_fetch_env_result result;
+	gchar * mb;
+	IMAPFetchEnvFunc callback;
+	void * data;
+};
+
+static void examine_fetch_env_done(Folder * folder, gboolean stale,
+				   void * data)
+{
+	struct examine_fetch_env_call * call = data;
+
+	debug_print("imap examine_fetch_env - end\n");
+
+	/* what was fetched is not for the session of the folder */
+	if (stale && call->result.error == MAILIMAP_NO_ERROR) {
+		imap_fetch_env_free(call->result.env_list);
+		call->result.env_list = NULL;
+		call->result.error = MAILIMAP_ERROR_INVAL;
+	}
+
+	call->callback(folder, call->result.error, call->result.uid_validity,
+		       call->result.env_list, call->data);
+	mailimap_set_free(call->param.set);
+	g_free(call->mb);
+	g_free(call);
+}
+
+void imap_threaded_examine_fetch_env_async(Folder * folder, const char * mb,
+					   struct mailimap_set * set,
+					   IMAPFetchEnvFunc callback,
+					   void * data)
+{
+	struct examine_fetch_env_call * call;
+
+	debug_print("imap examine_fetch_env - begin\n");
+
+	call = g_new0(struct examine_fetch_env_call, 1);
+	call->mb = g_strdup(mb);
+	call->callback = callback;
+	call->data = data;
+
+	call->param.imap = get_imap(folder);
+	call->param.mb = call->mb;
+	call->param.set = set;
+
+	threaded_run_async(folder, &call->param, &call->result,
+			   examine_fetch_env_run, examine_fetch_env_done, call);
+}
+
 
 
 
@@ -3238,11 +4674,53 @@ int imap_threaded_expunge(Folder * folder)
 	return result.error;
 }
 
+struct uid_expunge_param {
+	mailimap * imap;
+	struct mailimap_set * set;
+};
+
+static void uid_expunge_run(struct etpan_thread_op * op)
+{
+	struct uid_expunge_param * param;
+	struct expunge_result * result;
+	int r;
+	
+	param = op->param;
+	result = op->result;
+
+	CHECK_IMAP();
+
+	r = mailimap_uidplus_uid_expunge(param->imap, param->set);
+	
+	result->error = r;
+	debug_print("imap uid expunge run - end %i\n", r);
+}
+
+/* UID EXPUNGE (RFC 4315) only removes the given messages, unlike
+ * EXPUNGE which removes everything flagged \Deleted. */
+int imap_threaded_uid_expunge(Folder * folder, struct mailimap_set * set)
+{
+	struct uid_expunge_param param;
+	struct expunge_result result;
+	
+	debug_print("imap uid expunge - begin\n");
+	
+	param.imap = get_imap(folder);
+	param.set = set;
+	
+	threaded_run(folder, &param, &result, uid_expunge_run);
+	
+	debug_print("imap uid expunge - end\n");
+	
+	return result.error;
+}
+
 
 struct copy_param {
 	mailimap * imap;
 	struct mailimap_set * set;
 	const char * mb;
+	gboolean move;
 };
 
 struct copy_result {
@@ -3264,8 +4742,17 @@ static void copy_run(struct etpan_thread_op * op)
 
 	CHECK_IMAP();
 
-	r = mailimap_uidplus_uid_copy(param->imap, param->set, param->mb,
-		&val, &source, &dest);
+	if (param->move) {
+#ifdef HAVE_MAILIMAP_UIDPLUS_UID_MOVE
+		r = mailimap_uidplus_uid_move(param->imap, param->set,
+			param->mb, &val, &source, &dest);
+#else
+		r = MAILIMAP_ERROR_EXTENSION;
+#endif
+	} else {
+		r = mailimap_uidplus_uid_copy(param->imap, param->set,
+			param->mb, &val, &source, &dest);
+	}
 	
 	result->error = r;
 	if (r == 0) {
@@ -3275,23 +4762,23 @@ static void copy_run(struct etpan_thread_op * op)
 		result->source = NULL;
 		result->dest = NULL;
 	}
-	debug_print("imap copy run - end %i\n", r);
+	debug_print("imap %s run - end %i\n", param->move ? "move" : "copy", r);
 }
 
-int imap_threaded_copy(Folder * folder, struct mailimap_set * set,
-		       const char * mb, struct mailimap_set **source,
-		       struct mailimap_set **dest)
+static int do_threaded_copy(Folder * folder, struct mailimap_set * set,
+			    const char * mb, gboolean move,
+			    struct mailimap_set **source,
+			    struct mailimap_set **dest)
 {
 	struct copy_param param;
 	struct copy_result result;
 	mailimap * imap;
 	
-	debug_print("imap copy - begin\n");
-	
 	imap = get_imap(folder);
 	param.imap = imap;
 	param.set = set;
 	param.mb = mb;
+	param.move = move;
 	
 	threaded_run(folder, &param, &result, copy_run);
 	*source = NULL;
@@ -3303,20 +4790,47 @@ int imap_threaded_copy(Folder * folder, struct mailimap_set * set,
 	*source = result.source;
 	*dest = result.dest;
 
-	debug_print("imap copy - end\n");
-	
 	return result.error;
 }
 
+int imap_threaded_copy(Folder * folder, struct mailimap_set * set,
+		       const char * mb, struct mailimap_set **source,
+		       struct mailimap_set **dest)
+{
+	int r;
 
+	debug_print("imap copy - begin\n");
+	r = do_threaded_copy(folder, set, mb, FALSE, source, dest);
+	debug_print("imap copy - end\n");
 
-struct store_param {
-	mailimap * imap;
-	struct mailimap_set * set;
-	struct mailimap_store_att_flags * store_att_flags;
-};
+	return r;
+}
 
-struct store_result {
+/* Moves the messages with MOVE (RFC 6851); fails with
+ * MAILIMAP_ERROR_EXTENSION if libetpan cannot do it, so only call it
+ * when the server advertises MOVE. */
+int imap_threaded_move(Folder * folder, struct mailimap_set * set,
+		       const char * mb, struct mailimap_set **source,
+		       struct mailimap_set **dest)
+{
+	int r;
+
+	debug_print("imap move - begin\n");
+	r = do_threaded_copy(folder, set, mb, TRUE, source, dest);
+	debug_print("imap move - end\n");
+
+	return r;
+}
+
+
+
+struct store_param {
+	mailimap * imap;
+	struct mailimap_set * set;
+	struct mailimap_store_att_flags * store_att_flags;
+};
+
+struct store_result {
 	int error;
 };
 
@@ -3558,6 +5072,1022 @@ void imap_threaded_cancel(Folder * folder)
 		mailstream_cancel(imap->imap_stream);
 }
 
+/* Extra connections
+ *
+ * Besides the session of a folder, which runs one operation at a time on
+ * the folder's thread, an account can use connections of its own: one
+ * watching the Inbox in IDLE, and a pool of them fetching messages
+ * concurrently. Each has a thread of its own, bound to it so that
+ * nothing else is ever queued there, and logs in with the credentials
+ * of the session. They are driven by ops whose callbacks run in the main
+ * loop. */
+
+struct aux_conn {
+	Folder * folder;
+	PrefsAccount * account;
+	struct etpan_thread * thread;
+	mailimap * imap;
+
+	gchar * server;
+	int port;
+	SSLType ssl_type;
+	gboolean accept_if_valid;
+	ProxyInfo * proxy_info;
+	gchar * login;
+	gchar * password;
+	gchar * type;
+	gboolean compress;
+
+	/* protected by lock, set from the main loop */
+	GMutex * lock;
+	gboolean cancelled;
+	gboolean logout;
+	gboolean idle_setup;
+
+	int error;
+	gboolean ready;
+	/* selected or examined mailbox */
+	gchar * mailbox;
+
+	void (* opened)(struct aux_conn * conn);
+	void * data;
+};
+
+static struct aux_conn * aux_conn_new(Folder * folder,
+				      const IMAPConnInfo * info)
+{
+	struct aux_conn * conn;
+
+	conn = g_new0(struct aux_conn, 1);
+	conn->folder = folder;
+	conn->account = folder->account;
+	/* never shared: IDLE blocks it for minutes, and pool fetches
+	 * must not hold up the session's commands */
+	conn->thread = etpan_thread_manager_get_bound_thread(thread_manager);
+	if (conn->thread == NULL) {
+		g_warning("couldn't start a thread for an imap connection");
+		g_free(conn);
+		return NULL;
+	}
+	conn->imap = mailimap_new(0, NULL);
+	conn->server = g_strdup(folder->account->recv_server);
+	conn->port = info->port;
+	conn->ssl_type = folder->account->ssl_imap;
+	conn->accept_if_valid = folder->account->ssl_certs_auto_accept;
+	conn->proxy_info = info->proxy_info;
+	conn->login = g_strdup(info->login);
+	conn->password = g_strdup(info->password);
+	conn->type = g_strdup(info->type);
+	conn->compress = info->compress;
+	conn->lock = cm_mutex_new();
+	conn->logout = TRUE;
+
+	return conn;
+}
+
+static void aux_conn_free(struct aux_conn * conn)
+{
+	etpan_thread_manager_release_thread(thread_manager, conn->thread);
+	g_free(conn->server);
+	if (conn->password != NULL) {
+		memset(conn->password, 0, strlen(conn->password));
+		g_free(conn->password);
+	}
+	g_free(conn->login);
+	g_free(conn->type);
+	g_free(conn->mailbox);
+	cm_mutex_free(conn->lock);
+	g_free(conn);
+}
+
+static gboolean aux_conn_cancelled(struct aux_conn * conn)
+{
+	gboolean cancelled;
+
+	g_mutex_lock(conn->lock);
+	cancelled = conn->cancelled;
+	g_mutex_unlock(conn->lock);
+
+	return cancelled;
+}
+
+static gboolean aux_conn_logout(struct aux_conn * conn)
+{
+	gboolean logout;
+
+	g_mutex_lock(conn->lock);
+	logout = conn->logout;
+	g_mutex_unlock(conn->lock);
+
+	return logout;
+}
+
+/* Makes the ops of the connection return early; the owner still closes
+ * it once the op in progress is over. */
+static void aux_conn_cancel(struct aux_conn * conn, gboolean logout)
+{
+	g_mutex_lock(conn->lock);
+	conn->cancelled = TRUE;
+	conn->logout = logout;
+#ifdef HAVE_MAILSTREAM_WAIT_IDLE
+	if (conn->idle_setup)
+		mailstream_interrupt_idle(conn->imap->imap_stream);
+#endif
+	g_mutex_unlock(conn->lock);
+}
+
+static void aux_conn_schedule(struct aux_conn * conn,
+			      void (* func)(struct etpan_thread_op *),
+			      void (* callback)(int, void *, void *))
+{
+	struct etpan_thread_op * op;
+
+	op = etpan_thread_op_new();
+
+	op->imap = conn->imap;
+	op->param = conn;
+	op->result = conn;
+
+	op->run = func;
+	op->callback = callback;
+	op->callback_data = conn;
+	op->cleanup = etpan_thread_op_free;
+
+	etpan_thread_op_schedule(conn->thread, op);
+}
+
+static void aux_conn_close_run(struct etpan_thread_op * op)
+{
+	struct aux_conn * conn = op->param;
+
+#ifdef HAVE_MAILSTREAM_WAIT_IDLE
+	if (conn->idle_setup)
+		mailstream_unsetup_idle(conn->imap->imap_stream);
+#endif
+	if (aux_conn_logout(conn) && conn->error == MAILIMAP_NO_ERROR &&
+	    conn->imap->imap_stream != NULL)
+		mailimap_logout(conn->imap);
+	mailimap_free(conn->imap);
+	conn->imap = NULL;
+}
+
+static void aux_conn_close_cb(int cancelled, void * result, void * callback_data)
+{
+	struct aux_conn * conn = callback_data;
+
+	debug_print("imap connection %p to %s closed\n", conn, conn->server);
+	aux_conn_free(conn);
+}
+
+/* The connection is freed once its thread is done with it. */
+static void aux_conn_close(struct aux_conn * conn)
+{
+	aux_conn_schedule(conn, aux_conn_close_run, aux_conn_close_cb);
+}
+
+static gboolean aux_conn_is_fatal(int error)
+{
+	switch (error) {
+	case MAILIMAP_ERROR_STREAM:
+	case MAILIMAP_ERROR_PROTOCOL:
+	case MAILIMAP_ERROR_PARSE:
+	case MAILIMAP_ERROR_BAD_STATE:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+static void aux_conn_login_run(struct etpan_thread_op * op)
+{
+	struct aux_conn * conn = op->param;
+	int r;
+
+	if (aux_conn_cancelled(conn))
+		return;
+
+	if (conn->imap->imap_state == MAILIMAP_STATE_NON_AUTHENTICATED) {
+		r = do_mailimap_login(conn->imap, conn->login, conn->password,
+				      conn->type, conn->server);
+		if (r != MAILIMAP_NO_ERROR) {
+			conn->error = r;
+			return;
+		}
+	}
+#ifdef HAVE_MAILIMAP_COMPRESS
+	if (conn->compress) {
+		gboolean enabled;
+
+		/* not worth failing the connection for */
+		r = do_mailimap_compress(conn->imap, conn->server, &enabled);
+		if (aux_conn_is_fatal(r))
+			conn->error = r;
+	}
+#endif
+	debug_print("imap connection login run - end %d\n", conn->error);
+}
+
+static void aux_conn_login_cb(int cancelled, void * result, void * callback_data)
+{
+	struct aux_conn * conn = callback_data;
+
+	conn->opened(conn);
+}
+
+static void aux_conn_connect_run(struct etpan_thread_op * op)
+{
+	struct aux_conn * conn = op->param;
+	int r;
+
+	if (aux_conn_cancelled(conn))
+		return;
+
+#ifdef USE_GNUTLS
+	if (conn->ssl_type == SSL_TUNNEL)
+		r = do_mailimap_ssl_connect_with_callback(conn->imap,
+				conn->server, conn->port,
+				etpan_connect_ssl_context_cb, conn->account,
+				conn->proxy_info);
+	else
+#endif
+		r = do_mailimap_socket_connect(conn->imap,
+				conn->server, conn->port, conn->proxy_info);
+
+	if (r != MAILIMAP_NO_ERROR_AUTHENTICATED &&
+	    r != MAILIMAP_NO_ERROR_NON_AUTHENTICATED) {
+		conn->error = r;
+		return;
+	}
+#ifdef USE_GNUTLS
+	if (conn->ssl_type == SSL_STARTTLS) {
+		r = do_mailimap_starttls(conn->imap, conn->account);
+		if (r != MAILIMAP_NO_ERROR) {
+			conn->error = r;
+			return;
+		}
+	}
+#endif
+	conn->error = MAILIMAP_NO_ERROR;
+}
+
+static void aux_conn_connect_cb(int cancelled, void * result, void * callback_data)
+{
+	struct aux_conn * conn = callback_data;
+
+	if (conn->error != MAILIMAP_NO_ERROR || aux_conn_cancelled(conn)) {
+		conn->opened(conn);
+		return;
+	}
+
+#ifdef USE_GNUTLS
+	/* the certificate is checked here, as it may need to ask the user */
+	if (conn->ssl_type != SSL_NONE && !etpan_skip_ssl_cert_check &&
+	    etpan_certificate_check(conn->imap->imap_stream, conn->server,
+				    conn->port, conn->accept_if_valid) != TRUE) {
+		conn->error = MAILIMAP_ERROR_SSL;
+		conn->opened(conn);
+		return;
+	}
+#endif
+	aux_conn_schedule(conn, aux_conn_login_run, aux_conn_login_cb);
+}
+
+/* Connects and logs in, then calls opened() from the main loop, with
+ * conn->error set if it failed. */
+static void aux_conn_open(struct aux_conn * conn,
+			  void (* opened)(struct aux_conn *))
+{
+	conn->opened = opened;
+	refresh_resolvers();
+	aux_conn_schedule(conn, aux_conn_connect_run, aux_conn_connect_cb);
+}
+
+/* Connection pool
+ *
+ * Message bodies are fetched on up to max connections per account. A
+ * request is split in jobs of at most window messages of one mailbox,
+ * each fetched with one command on whichever connection is free,
+ * preferably one that has the mailbox examined already. When the server
+ * refuses a new connection while others are open, the pool is limited
+ * to the ones it accepted. Each connection runs on a thread of its own,
+ * never the session's, so fetches don't hold up its commands. */
+
+/* seconds without trying again after the first connection failed */
+#define POOL_RETRY_DELAY 60
+
+struct pool_request {
+	IMAPPoolFetchFunc fetched;
+	IMAPPoolDoneFunc done;
+	void * data;
+	int pending;
+};
+
+struct pool_job {
+	struct pool_request * request;
+	gchar * mailbox;
+	int count;
+	uint32_t * uids;
+	gchar ** filenames;
+	int * errors;
+};
+
+struct imap_pool {
+	Folder * folder;
+	int port;
+	ProxyInfo * proxy_info;
+	gchar * login;
+	gchar * password;
+	gchar * type;
+	gboolean compress;
+	int max;
+	int limit;
+
+	time_t last_failure;
+
+	GList * conns;
+	GQueue * jobs;
+	int running;
+};
+
+static struct imap_pool * get_pool(Folder * folder)
+{
+	chashdatum key;
+	chashdatum value;
+	int r;
+
+	key.data = &folder;
+	key.len = sizeof(folder);
+
+	r = chash_get(pool_hash, &key, &value);
+	if (r < 0)
+		return NULL;
+
+	return value.data;
+}
+
+static void pool_job_free(struct pool_job * job)
+{
+	int i;
+
+	for (i = 0; i < job->count; i++)
+		g_free(job->filenames[i]);
+	g_free(job->filenames);
+	g_free(job->uids);
+	g_free(job->errors);
+	g_free(job->mailbox);
+	g_free(job);
+}
+
+/* Reports the messages of the job, and the end of its request after its
+ * last job. The job is detached from the request. */
+static void pool_job_report(Folder * folder, struct pool_job * job)
+{
+	struct pool_request * request = job->request;
+	int i;
+
+	job->request = NULL;
+	for (i = 0; i < job->count; i++)
+		if (request->fetched != NULL)
+			request->fetched(folder, job->uids[i],
+					 job->filenames[i], job->errors[i],
+					 request->data);
+
+	request->pending--;
+	if (request->pending == 0) {
+		if (request->done != NULL)
+			request->done(folder, request->data);
+		g_free(request);
+	}
+}
+
+static void pool_job_fail(Folder * folder, struct pool_job * job, int error)
+{
+	int i;
+
+	for (i = 0; i < job->count; i++)
+		job->errors[i] = error;
+	pool_job_report(folder, job);
+}
+
+static void pool_dispatch(struct imap_pool * pool);
+
+static void pool_remove_conn(struct imap_pool * pool, struct aux_conn * conn)
+{
+	pool->conns = g_list_remove(pool->conns, conn);
+	aux_conn_close(conn);
+}
+
+static void pool_job_run(struct etpan_thread_op * op)
+{
+	struct aux_conn * conn = op->param;
+	struct pool_job * job = conn->data;
+	int i;
+	int r;
+
+	if (conn->mailbox == NULL || strcmp(conn->mailbox, job->mailbox)) {
+		g_free(conn->mailbox);
+		conn->mailbox = NULL;
+		r = mailimap_examine(conn->imap, job->mailbox);
+		if (r != MAILIMAP_NO_ERROR) {
+			for (i = 0; i < job->count; i++)
+				job->errors[i] = r;
+			if (aux_conn_is_fatal(r))
+				conn->error = r;
+			return;
+		}
+		conn->mailbox = g_strdup(job->mailbox);
+	}
+
+	if (aux_conn_cancelled(conn)) {
+		for (i = 0; i < job->count; i++)
+			job->errors[i] = MAILIMAP_ERROR_STREAM;
+		return;
+	}
+
+	r = do_fetch_content_set(conn->imap, job->count, job->uids,
+				 job->filenames, job->errors);
+	if (aux_conn_is_fatal(r))
+		conn->error = r;
+	debug_print("imap pool job run - end %d\n", conn->error);
+}
+
+static void pool_job_cb(int cancelled, void * result, void * callback_data)
+{
+	struct aux_conn * conn = callback_data;
+	struct pool_job * job = conn->data;
+	struct imap_pool * pool;
+
+	conn->data = NULL;
+
+	if (job->request == NULL) {
+		/* the pool was stopped meanwhile */
+		pool_job_free(job);
+		aux_conn_close(conn);
+		return;
+	}
+
+	pool = get_pool(conn->folder);
+	pool->running--;
+	pool_job_report(pool->folder, job);
+	pool_job_free(job);
+
+	if (conn->error != MAILIMAP_NO_ERROR || aux_conn_cancelled(conn))
+		pool_remove_conn(pool, conn);
+
+	pool_dispatch(pool);
+}
+
+static void pool_run_job(struct imap_pool * pool, struct aux_conn * conn,
+			 struct pool_job * job)
+{
+	conn->data = job;
+	pool->running++;
+	aux_conn_schedule(conn, pool_job_run, pool_job_cb);
+}
+
+/* Without any connection, the jobs fail and the owner falls back to its
+ * own session. */
+static void pool_fail_jobs(struct imap_pool * pool, int error)
+{
+	pool->last_failure = time(NULL);
+	while (!g_queue_is_empty(pool->jobs)) {
+		struct pool_job * job = g_queue_pop_head(pool->jobs);
+
+		pool_job_fail(pool->folder, job, error);
+		pool_job_free(job);
+	}
+}
+
+static void pool_conn_opened(struct aux_conn * conn)
+{
+	struct imap_pool * pool = get_pool(conn->folder);
+	int error = conn->error;
+	int open;
+
+	if (pool == NULL || g_list_find(pool->conns, conn) == NULL) {
+		/* the pool was stopped meanwhile */
+		aux_conn_close(conn);
+		return;
+	}
+
+	if (error == MAILIMAP_NO_ERROR && !aux_conn_cancelled(conn)) {
+		debug_print("imap pool connection %p to %s ready\n",
+			    conn, conn->server);
+		conn->ready = TRUE;
+		pool_dispatch(pool);
+		return;
+	}
+
+	pool_remove_conn(pool, conn);
+
+	open = (int) g_list_length(pool->conns);
+	if (open > 0) {
+		if (open < pool->limit) {
+			log_warning(LOG_PROTOCOL, _("IMAP server %s refused more "
+				    "connections, using %d\n"), pool->folder->account->recv_server,
+				    open + 1);
+			pool->limit = open;
+		}
+		return;
+	}
+
+	if (error == MAILIMAP_NO_ERROR)
+		error = MAILIMAP_ERROR_CONNECTION_REFUSED;
+	pool_fail_jobs(pool, error);
+}
+
+/* Prefers a job on the mailbox the connection has examined. */
+static struct pool_job * pool_pick_job(struct imap_pool * pool,
+				       struct aux_conn * conn)
+{
+	GList * cur;
+
+	if (conn->mailbox != NULL) {
+		for (cur = pool->jobs->head; cur != NULL; cur = cur->next) {
+			struct pool_job * job = cur->data;
+
+			if (!strcmp(job->mailbox, conn->mailbox)) {
+				g_queue_delete_link(pool->jobs, cur);
+				return job;
+			}
+		}
+	}
+	return g_queue_pop_head(pool->jobs);
+}
+
+static void pool_dispatch(struct imap_pool * pool)
+{
+	GList * cur;
+	guint opening = 0;
+	IMAPConnInfo info;
+
+	for (cur = pool->conns; cur != NULL; cur = cur->next) {
+		struct aux_conn * conn = cur->data;
+
+		if (!conn->ready) {
+			opening++;
+			continue;
+		}
+		if (conn->data != NULL || g_queue_is_empty(pool->jobs))
+			continue;
+		pool_run_job(pool, conn, pool_pick_job(pool, conn));
+	}
+
+	info.port = pool->port;
+	info.proxy_info = pool->proxy_info;
+	info.login = pool->login;
+	info.password = pool->password;
+	info.type = pool->type;
+	info.compress = pool->compress;
+
+	while (g_queue_get_length(pool->jobs) > opening &&
+	       (int) g_list_length(pool->conns) < MIN(pool->max, pool->limit)) {
+		struct aux_conn * conn = aux_conn_new(pool->folder, &info);
+
+		if (conn == NULL) {
+			if (pool->conns == NULL)
+				pool_fail_jobs(pool, MAILIMAP_ERROR_MEMORY);
+			break;
+		}
+		debug_print("imap pool connection %p to %s - begin\n",
+			    conn, conn->server);
+		pool->conns = g_list_append(pool->conns, conn);
+		aux_conn_open(conn, pool_conn_opened);
+		opening++;
+	}
+}
+
+static void pool_set_credentials(struct imap_pool * pool,
+				 const IMAPConnInfo * info)
+{
+	pool->port = info->port;
+	pool->proxy_info = info->proxy_info;
+	g_free(pool->login);
+	pool->login = g_strdup(info->login);
+	if (pool->password != NULL) {
+		memset(pool->password, 0, strlen(pool->password));
+		g_free(pool->password);
+	}
+	pool->password = g_strdup(info->password);
+	g_free(pool->type);
+	pool->type = g_strdup(info->type);
+	pool->compress = info->compress;
+}
+
+void imap_threaded_pool_setup(Folder * folder, const IMAPConnInfo * info,
+			      int max)
+{
+	struct imap_pool * pool;
+	chashdatum key;
+	chashdatum value;
+
+	cm_return_if_fail(folder != NULL && folder->account != NULL);
+	cm_return_if_fail(info != NULL && info->login != NULL &&
+			  info->password != NULL && info->type != NULL);
+
+	pool = get_pool(folder);
+	if (pool == NULL) {
+		pool = g_new0(struct imap_pool, 1);
+		pool->folder = folder;
+		pool->jobs = g_queue_new();
+		pool->limit = G_MAXINT;
+
+		key.data = &folder;
+		key.len = sizeof(folder);
+		value.data = pool;
+		value.len = 0;
+		chash_set(pool_hash, &key, &value, NULL);
+	}
+	pool_set_credentials(pool, info);
+	pool->max = MAX(max, 0);
+}
+
+gboolean imap_threaded_pool_available(Folder * folder)
+{
+	struct imap_pool * pool = get_pool(folder);
+
+	return pool != NULL && MIN(pool->max, pool->limit) > 0 &&
+		time(NULL) - pool->last_failure >= POOL_RETRY_DELAY;
+}
+
+int imap_threaded_pool_fetch(Folder * folder, const char * mailbox,
+			     GSList * uids, GSList * filenames, int window,
+			     IMAPPoolFetchFunc fetched, IMAPPoolDoneFunc done,
+			     void * data)
+{
+	struct imap_pool * pool = get_pool(folder);
+	struct pool_request * request;
+
+	cm_return_val_if_fail(mailbox != NULL && uids != NULL,
+			      MAILIMAP_ERROR_INVAL);
+	cm_return_val_if_fail(g_slist_length(uids) == g_slist_length(filenames),
+			      MAILIMAP_ERROR_INVAL);
+
+	if (!imap_threaded_pool_available(folder))
+		return MAILIMAP_ERROR_INVAL;
+
+	request = g_new0(struct pool_request, 1);
+	request->fetched = fetched;
+	request->done = done;
+	request->data = data;
+
+	while (uids != NULL) {
+		struct pool_job * job = g_new0(struct pool_job, 1);
+		int count;
+		int i;
+
+		count = MIN(g_slist_length(uids), MAX(window, 1));
+		job->request = request;
+		job->mailbox = g_strdup(mailbox);
+		job->count = count;
+		job->uids = g_new(uint32_t, count);
+		job->filenames = g_new(gchar *, count);
+		job->errors = g_new0(int, count);
+		for (i = 0; i < count; i++) {
+			job->uids[i] = GPOINTER_TO_UINT(uids->data);
+			job->filenames[i] = g_strdup(filenames->data);
+			uids = uids->next;
+			filenames = filenames->next;
+		}
+		request->pending++;
+		g_queue_push_tail(pool->jobs, job);
+	}
+	debug_print("imap pool: %d jobs for %s queued\n",
+		    request->pending, mailbox);
+
+	pool_dispatch(pool);
+
+	return MAILIMAP_NO_ERROR;
+}
+
+gboolean imap_threaded_pool_busy(Folder * folder)
+{
+	struct imap_pool * pool = get_pool(folder);
+
+	return pool != NULL &&
+		(pool->running > 0 || !g_queue_is_empty(pool->jobs));
+}
+
+void imap_threaded_pool_wait(Folder * folder)
+{
+	while (imap_threaded_pool_busy(folder))
+		gtk_main_iteration();
+}
+
+void imap_threaded_pool_stop(Folder * folder, gboolean logout)
+{
+	struct imap_pool * pool = get_pool(folder);
+	chashdatum key;
+	GList * cur;
+
+	if (pool == NULL)
+		return;
+
+	debug_print("imap pool for %s - stop\n", folder->name);
+
+	key.data = &folder;
+	key.len = sizeof(folder);
+	chash_delete(pool_hash, &key, NULL);
+
+	while (!g_queue_is_empty(pool->jobs)) {
+		struct pool_job * job = g_queue_pop_head(pool->jobs);
+
+		pool_job_fail(folder, job, MAILIMAP_ERROR_STREAM);
+		pool_job_free(job);
+	}
+
+	/* jobs in progress are reported now, and freed with their
+	 * connection once they returned */
+	for (cur = pool->conns; cur != NULL; cur = cur->next) {
+		struct aux_conn * conn = cur->data;
+
+		aux_conn_cancel(conn, logout);
+		if (conn->data != NULL)
+			pool_job_fail(folder, conn->data, MAILIMAP_ERROR_STREAM);
+		else if (conn->ready)
+			aux_conn_close(conn);
+	}
+
+	g_list_free(pool->conns);
+	g_queue_free(pool->jobs);
+	g_free(pool->login);
+	memset(pool->password, 0, strlen(pool->password));
+	g_free(pool->password);
+	g_free(pool->type);
+	g_free(pool);
+}
+
+/* IDLE
+ *
+ * The Inbox of an account can be watched from a connection parked in
+ * IDLE (RFC 2177), so that new messages show up without waiting for the
+ * next check. Each IDLE cycle is one op; the folder is notified and the
+ * next cycle scheduled from its callback. */
+
+#ifdef HAVE_MAILSTREAM_WAIT_IDLE
+
+/* servers may log out clients idling for more than 30 minutes */
+#define IDLE_RENEW_DELAY (29 * 60)
+
+struct idle_watch {
+	struct aux_conn * conn;
+	gchar * mailbox;
+	IMAPIdleNotifyFunc notify;
+	gboolean changed;
+};
+
+static struct idle_watch * get_idle_watch(Folder * folder)
+{
+	chashdatum key;
+	chashdatum value;
+	int r;
+
+	key.data = &folder;
+	key.len = sizeof(folder);
+
+	r = chash_get(idle_hash, &key, &value);
+	if (r < 0)
+		return NULL;
+
+	return value.data;
+}
+
+/* Called when the watch ends, whether it was stopped or the connection
+ * failed. A failed watch leaves the folder to the periodic checks until
+ * the owner starts it again. */
+static void idle_watch_finish(struct idle_watch * watch)
+{
+	struct aux_conn * conn = watch->conn;
+
+	if (!aux_conn_cancelled(conn)) {
+		chashdatum key;
+
+		log_warning(LOG_PROTOCOL, _("IMAP IDLE connection to %s closed\n"),
+			    conn->server);
+		key.data = &conn->folder;
+		key.len = sizeof(conn->folder);
+		chash_delete(idle_hash, &key, NULL);
+	}
+	debug_print("imap idle %p on %s finished\n", watch, watch->mailbox);
+	aux_conn_close(conn);
+	g_free(watch->mailbox);
+	g_free(watch);
+}
+
+static void idle_cycle_run(struct etpan_thread_op * op)
+{
+	struct aux_conn * conn = op->param;
+	struct idle_watch * watch = conn->data;
+	mailimap * imap = conn->imap;
+	unsigned int exists;
+	int r;
+
+	watch->changed = FALSE;
+	if (aux_conn_cancelled(conn))
+		return;
+
+	exists = imap->imap_selection_info != NULL ?
+		imap->imap_selection_info->sel_exists : 0;
+
+	r = mailimap_idle(imap);
+	if (r != MAILIMAP_NO_ERROR) {
+		conn->error = r;
+		return;
+	}
+
+	r = mailstream_wait_idle(imap->imap_stream, IDLE_RENEW_DELAY);
+	if (r == MAILSTREAM_IDLE_ERROR || r == MAILSTREAM_IDLE_CANCELLED) {
+		conn->error = MAILIMAP_ERROR_STREAM;
+		return;
+	}
+	if (r == MAILSTREAM_IDLE_INTERRUPTED && !aux_conn_logout(conn))
+		return;
+
+	r = mailimap_idle_done(imap);
+	if (r != MAILIMAP_NO_ERROR) {
+		conn->error = r;
+		return;
+	}
+
+	/* untagged responses sent during IDLE are parsed by DONE; keepalive
+	 * OK responses leave the mailbox unchanged */
+	if (imap->imap_selection_info != NULL &&
+	    imap->imap_selection_info->sel_exists != exists)
+		watch->changed = TRUE;
+	if (imap->imap_response_info != NULL &&
+	    ((imap->imap_response_info->rsp_expunged != NULL &&
+	      !clist_isempty(imap->imap_response_info->rsp_expunged)) ||
+	     (imap->imap_response_info->rsp_fetch_list != NULL &&
+	      !clist_isempty(imap->imap_response_info->rsp_fetch_list))))
+		watch->changed = TRUE;
+	debug_print("imap idle cycle run - end %d\n", watch->changed);
+}
+
+static void idle_cycle_cb(int cancelled, void * result, void * callback_data)
+{
+	struct aux_conn * conn = callback_data;
+	struct idle_watch * watch = conn->data;
+
+	if (conn->error != MAILIMAP_NO_ERROR || aux_conn_cancelled(conn)) {
+		idle_watch_finish(watch);
+		return;
+	}
+
+	if (watch->changed && watch->notify != NULL)
+		watch->notify(conn->folder);
+
+	aux_conn_schedule(conn, idle_cycle_run, idle_cycle_cb);
+}
+
+static void idle_prepare_run(struct etpan_thread_op * op)
+{
+	struct aux_conn * conn = op->param;
+	struct idle_watch * watch = conn->data;
+	mailimap * imap = conn->imap;
+	int r;
+
+	if (aux_conn_cancelled(conn))
+		return;
+
+	if (!mailimap_has_idle(imap)) {
+		struct mailimap_capability_data * caps;
+
+		/* some servers only advertise IDLE once logged in */
+		r = mailimap_capability(imap, &caps);
+		if (r == MAILIMAP_NO_ERROR)
+			mailimap_capability_data_free(caps);
+		if (r != MAILIMAP_NO_ERROR || !mailimap_has_idle(imap)) {
+			conn->error = MAILIMAP_ERROR_EXTENSION;
+			return;
+		}
+	}
+
+	r = mailimap_examine(imap, watch->mailbox);
+	if (r != MAILIMAP_NO_ERROR) {
+		conn->error = r;
+		return;
+	}
+	conn->mailbox = g_strdup(watch->mailbox);
+
+	r = mailstream_setup_idle(imap->imap_stream);
+	if (r < 0) {
+		conn->error = MAILIMAP_ERROR_STREAM;
+		return;
+	}
+	g_mutex_lock(conn->lock);
+	conn->idle_setup = TRUE;
+	g_mutex_unlock(conn->lock);
+	debug_print("imap idle prepare run - end\n");
+}
+
+static void idle_prepare_cb(int cancelled, void * result, void * callback_data)
+{
+	struct aux_conn * conn = callback_data;
+	struct idle_watch * watch = conn->data;
+
+	if (conn->error != MAILIMAP_NO_ERROR || aux_conn_cancelled(conn)) {
+		idle_watch_finish(watch);
+		return;
+	}
+
+	log_message(LOG_PROTOCOL, _("IMAP IDLE connection to %s is watching %s\n"),
+		    conn->server, watch->mailbox);
+	aux_conn_schedule(conn, idle_cycle_run, idle_cycle_cb);
+}
+
+static void idle_conn_opened(struct aux_conn * conn)
+{
+	struct idle_watch * watch = conn->data;
+
+	if (conn->error != MAILIMAP_NO_ERROR || aux_conn_cancelled(conn)) {
+		idle_watch_finish(watch);
+		return;
+	}
+	aux_conn_schedule(conn, idle_prepare_run, idle_prepare_cb);
+}
+
+int imap_threaded_idle_start(Folder * folder, const IMAPConnInfo * info,
+			     const char * mailbox, IMAPIdleNotifyFunc notify)
+{
+	struct idle_watch * watch;
+	chashdatum key;
+	chashdatum value;
+
+	cm_return_val_if_fail(folder != NULL && folder->account != NULL,
+			      MAILIMAP_ERROR_INVAL);
+	cm_return_val_if_fail(info != NULL && info->login != NULL &&
+			      info->password != NULL && info->type != NULL &&
+			      mailbox != NULL, MAILIMAP_ERROR_INVAL);
+
+	if (get_idle_watch(folder) != NULL)
+		return MAILIMAP_NO_ERROR;
+
+	watch = g_new0(struct idle_watch, 1);
+	watch->conn = aux_conn_new(folder, info);
+	if (watch->conn == NULL) {
+		g_free(watch);
+		return MAILIMAP_ERROR_MEMORY;
+	}
+	watch->conn->data = watch;
+	watch->mailbox = g_strdup(mailbox);
+	watch->notify = notify;
+
+	key.data = &folder;
+	key.len = sizeof(folder);
+	value.data = watch;
+	value.len = 0;
+	chash_set(idle_hash, &key, &value, NULL);
+
+	debug_print("imap idle %p on %s - begin\n", watch, mailbox);
+
+	aux_conn_open(watch->conn, idle_conn_opened);
+
+	return MAILIMAP_NO_ERROR;
+}
+
+void imap_threaded_idle_stop(Folder * folder, gboolean logout)
+{
+	struct idle_watch * watch;
+	chashdatum key;
+
+	watch = get_idle_watch(folder);
+	if (watch == NULL)
+		return;
+
+	key.data = &folder;
+	key.len = sizeof(folder);
+	chash_delete(idle_hash, &key, NULL);
+
+	debug_print("imap idle %p on %s - stop\n", watch, watch->mailbox);
+
+	/* the watch is freed once its thread is done with it */
+	aux_conn_cancel(watch->conn, logout);
+}
+
+gboolean imap_threaded_idle_running(Folder * folder)
+{
+	return get_idle_watch(folder) != NULL;
+}
+
+#else
+
+int imap_threaded_idle_start(Folder * folder, const IMAPConnInfo * info,
+			     const char * mailbox, IMAPIdleNotifyFunc notify)
+{
+	return MAILIMAP_ERROR_EXTENSION;
+}
+
+void imap_threaded_idle_stop(Folder * folder, gboolean logout)
+{
+}
+
+gboolean imap_threaded_idle_running(Folder * folder)
+{
+	return FALSE;
+}
+
+#endif
+
 #else
 
 void imap_main_init(void)
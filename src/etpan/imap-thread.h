@@ -23,6 +23,7 @@
 
 #include <libetpan/libetpan.h>
 #include "folder.h"
+#include "imap-uidset.h"
 
 #define IMAP_SET_MAX_COUNT 500
 
@@ -48,6 +49,7 @@ void imap_done(Folder * folder);
 int imap_threaded_connect(Folder * folder, const char * server, int port, ProxyInfo *proxy_info);
 int imap_threaded_connect_ssl(Folder * folder, const char * server, int port, ProxyInfo *proxy_info);
 int imap_threaded_capability(Folder *folder, struct mailimap_capability_data ** caps);
+int imap_threaded_enable(Folder * folder, const char * capability);
 
 #ifndef G_OS_WIN32
 int imap_threaded_connect_cmd(Folder * folder, const char * command,
@@ -75,7 +77,40 @@ int imap_threaded_noop(Folder * folder, unsigned int * p_exists,
 		       unsigned int *p_unseen,
 		       unsigned int *p_uidnext,
 		       unsigned int *p_uidval);
+
+/* Asynchronous variants: the command is queued after those already
+ * queued for the folder and the call returns at once; the callback is
+ * called from the main loop with the outcome. imap_threaded_noop(),
+ * imap_threaded_status() and imap_threaded_fetch_content() wait for
+ * them. */
+typedef void (* IMAPThreadedFunc)(Folder * folder, int error, void * data);
+
+typedef struct _IMAPNoopInfo {
+	unsigned int exists;
+	unsigned int recent;
+	unsigned int expunge;
+	unsigned int unseen;
+	unsigned int uidnext;
+	unsigned int uidval;
+} IMAPNoopInfo;
+
+typedef void (* IMAPNoopFunc)(Folder * folder, int error,
+			      const IMAPNoopInfo * info, void * data);
+/* data_status belongs to the callback */
+typedef void (* IMAPStatusFunc)(Folder * folder, int error,
+				struct mailimap_mailbox_data_status * data_status,
+				void * data);
+
+void imap_threaded_noop_async(Folder * folder, IMAPNoopFunc callback,
+			      void * data);
+void imap_threaded_status_async(Folder * folder, const char * mb, guint mask,
+				IMAPStatusFunc callback, void * data);
+void imap_threaded_fetch_content_async(Folder * folder, uint32_t msg_index,
+				       int with_body, const char * filename,
+				       IMAPThreadedFunc callback, void * data);
+
 int imap_threaded_starttls(Folder * folder, const gchar *host, int port);
+int imap_threaded_compress(Folder * folder, gboolean * enabled);
 int imap_threaded_create(Folder * folder, const char * mb);
 int imap_threaded_rename(Folder * folder,
 			 const char * mb, const char * new_name);
@@ -83,7 +118,7 @@ int imap_threaded_delete(Folder * folder, const char * mb);
 int imap_threaded_select(Folder * folder, const char * mb,
 			 gint * exists, gint * recent, gint * unseen,
 			 guint32 * uid_validity, gint * can_create_flags,
-			 GSList **ok_flags);
+			 GSList **ok_flags, guint64 *highestmodseq);
 int imap_threaded_examine(Folder * folder, const char * mb,
 			  gint * exists, gint * recent, gint * unseen,
 			  guint32 * uid_validity);
@@ -138,6 +173,9 @@ void		imap_search_free(IMAPSearchKey* search);
 
 int imap_threaded_search(Folder * folder, int search_type, IMAPSearchKey* key,
 			 const char *charset, struct mailimap_set * set, clist ** result);
+int imap_threaded_esearch(Folder * folder, int search_type,
+			  IMAPSearchKey * key, struct mailimap_set * set,
+			  IMAPUidSet ** result);
 
 int imap_threaded_fetch_uid(Folder * folder, uint32_t first_index,
 			    carray ** result);
@@ -148,10 +186,20 @@ int imap_threaded_fetch_uid_flags(Folder * folder, uint32_t first_index,
 				  carray ** fetch_result);
 
 void imap_fetch_uid_flags_list_free(carray * uid_flags_list);
+int imap_threaded_fetch_uid_flags_changed(Folder * folder, guint64 modseq,
+					  gboolean with_vanished,
+					  carray ** fetch_result,
+					  struct mailimap_set ** vanished,
+					  guint64 * highestmodseq);
 
 int imap_threaded_fetch_content(Folder * folder, uint32_t msg_index,
 				int with_body,
 				const char * filename);
+/* one UID FETCH for the bodies of count messages, errors[] getting the
+ * outcome for each */
+int imap_threaded_fetch_content_set(Folder * folder, int count,
+				    const uint32_t * uids,
+				    char * const * filenames, int * errors);
 
 struct imap_fetch_env_info {
 	uint32_t uid;
@@ -165,20 +213,69 @@ int imap_threaded_fetch_env(Folder * folder, struct mailimap_set * set,
 
 void imap_fetch_env_free(carray * env_list);
 
+/* Selects mb read-only and fetches the envelopes of set, which it takes
+ * over. env_list belongs to the callback, NULL on error. */
+typedef void (* IMAPFetchEnvFunc)(Folder * folder, int error,
+				  guint32 uid_validity, carray * env_list,
+				  void * data);
+
+void imap_threaded_examine_fetch_env_async(Folder * folder, const char * mb,
+					   struct mailimap_set * set,
+					   IMAPFetchEnvFunc callback,
+					   void * data);
+
 int imap_threaded_append(Folder * folder, const char * mailbox,
 			 const char * filename,
 			 struct mailimap_flag_list * flag_list,
 			 int *uid);
 
 int imap_threaded_expunge(Folder * folder);
+int imap_threaded_uid_expunge(Folder * folder, struct mailimap_set * set);
 
 int imap_threaded_copy(Folder * folder, struct mailimap_set * set,
 		       const char * mb, struct mailimap_set **source,
 		       struct mailimap_set **dest);
+int imap_threaded_move(Folder * folder, struct mailimap_set * set,
+		       const char * mb, struct mailimap_set **source,
+		       struct mailimap_set **dest);
 
 int imap_threaded_store(Folder * folder, struct mailimap_set * set,
 			struct mailimap_store_att_flags * store_att_flags);
 
 void imap_threaded_cancel(Folder * folder);
 
+/* credentials for the connections besides the folder's session */
+typedef struct _IMAPConnInfo {
+	int port;
+	ProxyInfo * proxy_info;
+	const char * login;
+	const char * password;
+	const char * type;
+	/* use COMPRESS=DEFLATE if the server supports it */
+	gboolean compress;
+} IMAPConnInfo;
+
+typedef void (* IMAPIdleNotifyFunc)(Folder * folder);
+
+int imap_threaded_idle_start(Folder * folder, const IMAPConnInfo * info,
+			     const char * mailbox, IMAPIdleNotifyFunc notify);
+void imap_threaded_idle_stop(Folder * folder, gboolean logout);
+gboolean imap_threaded_idle_running(Folder * folder);
+
+typedef void (* IMAPPoolFetchFunc)(Folder * folder, uint32_t uid,
+				   const char * filename, int error,
+				   void * data);
+typedef void (* IMAPPoolDoneFunc)(Folder * folder, void * data);
+
+void imap_threaded_pool_setup(Folder * folder, const IMAPConnInfo * info,
+			      int max);
+gboolean imap_threaded_pool_available(Folder * folder);
+int imap_threaded_pool_fetch(Folder * folder, const char * mailbox,
+			     GSList * uids, GSList * filenames, int window,
+			     IMAPPoolFetchFunc fetched, IMAPPoolDoneFunc done,
+			     void * data);
+gboolean imap_threaded_pool_busy(Folder * folder);
+void imap_threaded_pool_wait(Folder * folder);
+void imap_threaded_pool_stop(Folder * folder, gboolean logout);
+
 #endif
@@ -0,0 +1,538 @@
+/*
+ * Claws Mail -- a GTK+ based, lightweight, and fast e-mail client
+ * Copyright (C) 2026 the Claws Mail team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#include "claws-features.h"
+#endif
+
+#ifdef HAVE_LIBETPAN
+
+#include <glib.h>
+#include <stdlib.h>
+
+#include "imap-uidset.h"
+
+#define RANGE(ranges, i) g_array_index((ranges), IMAPUidRange, (i))
+#define RANGE_COUNT(range) ((guint)((range).last - (range).first) + 1)
+
+IMAPUidSet *imap_uid_set_new(void)
+{
+	IMAPUidSet *set = g_new0(IMAPUidSet, 1);
+
+	set->ranges = g_array_new(FALSE, FALSE, sizeof(IMAPUidRange));
+
+	return set;
+}
+
+IMAPUidSet *imap_uid_set_copy(const IMAPUidSet *set)
+{
+	IMAPUidSet *copy;
+
+	g_return_val_if_fail(set != NULL, NULL);
+
+	copy = imap_uid_set_new();
+	g_array_append_vals(copy->ranges, set->ranges->data, set->ranges->len);
+	copy->count = set->count;
+
+	return copy;
+}
+
+void imap_uid_set_free(IMAPUidSet *set)
+{
+	if (set == NULL)
+		return;
+
+	g_array_free(set->ranges, TRUE);
+	g_free(set);
+}
+
+void imap_uid_set_clear(IMAPUidSet *set)
+{
+	g_return_if_fail(set != NULL);
+
+	g_array_set_size(set->ranges, 0);
+	set->count = 0;
+}
+
+/* index of the first range ending at or after uid */
+static guint imap_uid_set_find(GArray *ranges, guint32 uid)
+{
+	guint low = 0, high = ranges->len;
+
+	while (low < high) {
+		guint mid = low + (high - low) / 2;
+
+		if (RANGE(ranges, mid).last < uid)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+static guint imap_uid_set_recount(GArray *ranges)
+{
+	guint i, count = 0;
+
+	for (i = 0; i < ranges->len; i++)
+		count += RANGE_COUNT(RANGE(ranges, i));
+
+	return count;
+}
+
+/* appends a range starting after the last one, merging adjacent ones */
+static void imap_uid_set_append(GArray *ranges, IMAPUidRange range)
+{
+	if (ranges->len > 0) {
+		IMAPUidRange *prev = &RANGE(ranges, ranges->len - 1);
+
+		if ((guint64)prev->last + 1 >= range.first) {
+			if (range.last > prev->last)
+				prev->last = range.last;
+			return;
+		}
+	}
+	g_array_append_val(ranges, range);
+}
+
+void imap_uid_set_add_range(IMAPUidSet *set, guint32 first, guint32 last)
+{
+	IMAPUidRange range;
+	guint i, j;
+
+	g_return_if_fail(set != NULL);
+
+	if (first > last) {
+		guint32 tmp = first;
+		first = last;
+		last = tmp;
+	}
+	/* there is no UID 0 */
+	if (last == 0)
+		return;
+	if (first == 0)
+		first = 1;
+
+	range.first = first;
+	range.last = last;
+
+	/* UIDs mostly come in ascending order */
+	if (set->ranges->len == 0 ||
+	    RANGE(set->ranges, set->ranges->len - 1).last < first) {
+		imap_uid_set_append(set->ranges, range);
+		set->count += RANGE_COUNT(range);
+		return;
+	}
+
+	/* merge with all the ranges overlapping or touching the new one */
+	i = imap_uid_set_find(set->ranges, first - 1);
+	for (j = i; j < set->ranges->len; j++) {
+		IMAPUidRange cur = RANGE(set->ranges, j);
+
+		if ((guint64)last + 1 < cur.first)
+			break;
+		if (cur.first < range.first)
+			range.first = cur.first;
+		if (cur.last > range.last)
+			range.last = cur.last;
+		set->count -= RANGE_COUNT(cur);
+	}
+
+	if (j == i) {
+		g_array_insert_val(set->ranges, i, range);
+	} else {
+		RANGE(set->ranges, i) = range;
+		if (j > i + 1)
+			g_array_remove_range(set->ranges, i + 1, j - i - 1);
+	}
+	set->count += RANGE_COUNT(range);
+}
+
+void imap_uid_set_add(IMAPUidSet *set, guint32 uid)
+{
+	imap_uid_set_add_range(set, uid, uid);
+}
+
+void imap_uid_set_remove_range(IMAPUidSet *set, guint32 first, guint32 last)
+{
+	guint i, del_from, del_n = 0;
+
+	g_return_if_fail(set != NULL);
+
+	if (first > last) {
+		guint32 tmp = first;
+		first = last;
+		last = tmp;
+	}
+
+	i = imap_uid_set_find(set->ranges, first);
+	del_from = i;
+	for (; i < set->ranges->len; i++) {
+		IMAPUidRange *cur = &RANGE(set->ranges, i);
+
+		if (cur->first > last)
+			break;
+		if (cur->first < first && cur->last > last) {
+			/* punch a hole */
+			IMAPUidRange tail;
+
+			tail.first = last + 1;
+			tail.last = cur->last;
+			cur->last = first - 1;
+			g_array_insert_val(set->ranges, i + 1, tail);
+			set->count -= last - first + 1;
+			break;
+		} else if (cur->first < first) {
+			set->count -= cur->last - first + 1;
+			cur->last = first - 1;
+			del_from = i + 1;
+		} else if (cur->last > last) {
+			set->count -= last - cur->first + 1;
+			cur->first = last + 1;
+			break;
+		} else {
+			set->count -= RANGE_COUNT(*cur);
+			del_n++;
+		}
+	}
+	if (del_n > 0)
+		g_array_remove_range(set->ranges, del_from, del_n);
+}
+
+void imap_uid_set_remove(IMAPUidSet *set, guint32 uid)
+{
+	imap_uid_set_remove_range(set, uid, uid);
+}
+
+gboolean imap_uid_set_contains(const IMAPUidSet *set, guint32 uid)
+{
+	guint i;
+
+	if (set == NULL)
+		return FALSE;
+
+	i = imap_uid_set_find(set->ranges, uid);
+
+	return i < set->ranges->len && RANGE(set->ranges, i).first <= uid;
+}
+
+guint imap_uid_set_count(const IMAPUidSet *set)
+{
+	return set != NULL ? set->count : 0;
+}
+
+/* the highest UID, 0 if the set is empty */
+guint32 imap_uid_set_max(const IMAPUidSet *set)
+{
+	if (set == NULL || set->ranges->len == 0)
+		return 0;
+
+	return RANGE(set->ranges, set->ranges->len - 1).last;
+}
+
+/* adds the UIDs of other to set */
+void imap_uid_set_union(IMAPUidSet *set, const IMAPUidSet *other)
+{
+	GArray *ranges;
+	guint i = 0, j = 0;
+
+	g_return_if_fail(set != NULL);
+
+	if (other == NULL || other->ranges->len == 0)
+		return;
+
+	ranges = g_array_sized_new(FALSE, FALSE, sizeof(IMAPUidRange),
+				   set->ranges->len + other->ranges->len);
+	while (i < set->ranges->len || j < other->ranges->len) {
+		if (j == other->ranges->len ||
+		    (i < set->ranges->len &&
+		     RANGE(set->ranges, i).first < RANGE(other->ranges, j).first))
+			imap_uid_set_append(ranges, RANGE(set->ranges, i++));
+		else
+			imap_uid_set_append(ranges, RANGE(other->ranges, j++));
+	}
+
+	g_array_free(set->ranges, TRUE);
+	set->ranges = ranges;
+	set->count = imap_uid_set_recount(ranges);
+}
+
+/* removes the UIDs of other from set */
+void imap_uid_set_difference(IMAPUidSet *set, const IMAPUidSet *other)
+{
+	GArray *ranges;
+	guint i, j = 0;
+
+	g_return_if_fail(set != NULL);
+
+	if (other == NULL || other->ranges->len == 0)
+		return;
+
+	ranges = g_array_sized_new(FALSE, FALSE, sizeof(IMAPUidRange),
+				   set->ranges->len);
+	for (i = 0; i < set->ranges->len; i++) {
+		IMAPUidRange cur = RANGE(set->ranges, i);
+		gboolean done = FALSE;
+		guint k;
+
+		while (j < other->ranges->len &&
+		       RANGE(other->ranges, j).last < cur.first)
+			j++;
+
+		for (k = j; k < other->ranges->len; k++) {
+			IMAPUidRange hole = RANGE(other->ranges, k);
+
+			if (hole.first > cur.last)
+				break;
+			if (hole.first > cur.first) {
+				IMAPUidRange piece;
+
+				piece.first = cur.first;
+				piece.last = hole.first - 1;
+				g_array_append_val(ranges, piece);
+			}
+			if (hole.last >= cur.last) {
+				done = TRUE;
+				break;
+			}
+			cur.first = hole.last + 1;
+		}
+		if (!done)
+			g_array_append_val(ranges, cur);
+	}
+
+	g_array_free(set->ranges, TRUE);
+	set->ranges = ranges;
+	set->count = imap_uid_set_recount(ranges);
+}
+
+void imap_uid_set_foreach_range(const IMAPUidSet *set, IMAPUidRangeFunc func,
+				gpointer data)
+{
+	guint i;
+
+	g_return_if_fail(func != NULL);
+
+	if (set == NULL)
+		return;
+
+	for (i = 0; i < set->ranges->len; i++)
+		func(RANGE(set->ranges, i).first, RANGE(set->ranges, i).last,
+		     data);
+}
+
+/* IMAP sequence-set syntax (RFC 3501), e.g. "1:4,7,9:*" */
+gchar *imap_uid_set_to_string(const IMAPUidSet *set)
+{
+	GString *str = g_string_new(NULL);
+	guint i;
+
+	for (i = 0; set != NULL && i < set->ranges->len; i++) {
+		IMAPUidRange cur = RANGE(set->ranges, i);
+
+		if (i > 0)
+			g_string_append_c(str, ',');
+		g_string_append_printf(str, "%u", cur.first);
+		if (cur.last == G_MAXUINT32)
+			g_string_append(str, ":*");
+		else if (cur.last != cur.first)
+			g_string_append_printf(str, ":%u", cur.last);
+	}
+
+	return g_string_free(str, FALSE);
+}
+
+static gboolean imap_uid_set_parse_number(const gchar **p, guint32 *uid)
+{
+	gchar *end;
+	guint64 value;
+
+	if (**p == '*') {
+		*uid = G_MAXUINT32;
+		(*p)++;
+		return TRUE;
+	}
+	if (!g_ascii_isdigit(**p))
+		return FALSE;
+
+	value = g_ascii_strtoull(*p, &end, 10);
+	if (value == 0 || value > G_MAXUINT32)
+		return FALSE;
+
+	*uid = (guint32)value;
+	*p = end;
+	return TRUE;
+}
+
+/* parses a sequence-set, returns NULL if it isn't one */
+IMAPUidSet *imap_uid_set_new_from_string(const gchar *str)
+{
+	IMAPUidSet *set;
+	const gchar *p = str;
+
+	g_return_val_if_fail(str != NULL, NULL);
+
+	set = imap_uid_set_new();
+	while (*p != '\0') {
+		guint32 first, last;
+
+		if (!imap_uid_set_parse_number(&p, &first))
+			goto error;
+		last = first;
+		if (*p == ':') {
+			p++;
+			if (!imap_uid_set_parse_number(&p, &last))
+				goto error;
+		}
+		imap_uid_set_add_range(set, first, last);
+
+		if (*p == ',' && *(p + 1) != '\0')
+			p++;
+		else if (*p != '\0')
+			goto error;
+	}
+
+	return set;
+
+error:
+	imap_uid_set_free(set);
+	return NULL;
+}
+
+/* the UIDs in ascending order, as a MsgNumberList */
+GSList *imap_uid_set_to_list(const IMAPUidSet *set)
+{
+	GSList *list = NULL;
+	guint i;
+
+	if (set == NULL)
+		return NULL;
+
+	for (i = set->ranges->len; i > 0; i--) {
+		IMAPUidRange cur = RANGE(set->ranges, i - 1);
+		guint32 uid = cur.last;
+
+		while (TRUE) {
+			list = g_slist_prepend(list, GUINT_TO_POINTER(uid));
+			if (uid == cur.first)
+				break;
+			uid--;
+		}
+	}
+
+	return list;
+}
+
+IMAPUidSet *imap_uid_set_new_from_list(GSList *list)
+{
+	IMAPUidSet *set = imap_uid_set_new();
+
+	for (; list != NULL; list = list->next)
+		imap_uid_set_add(set, GPOINTER_TO_UINT(list->data));
+
+	return set;
+}
+
+/*
+ * Splits the set into libetpan sets of at most max_count UIDs each,
+ * 0 meaning no limit. Free the returned sets with mailimap_set_free().
+ */
+GSList *imap_uid_set_to_lep_sets(const IMAPUidSet *set, guint max_count)
+{
+	GSList *result = NULL;
+	struct mailimap_set *lep_set = NULL;
+	guint64 n = 0;
+	guint i;
+
+	if (set == NULL)
+		return NULL;
+
+	for (i = 0; i < set->ranges->len; i++) {
+		IMAPUidRange cur = RANGE(set->ranges, i);
+		guint32 first = cur.first;
+
+		while (TRUE) {
+			guint32 last = cur.last;
+
+			if (lep_set == NULL) {
+				lep_set = mailimap_set_new_empty();
+				n = 0;
+			}
+			if (max_count > 0 &&
+			    (guint64)last - first + 1 > max_count - n)
+				last = first + (guint32)(max_count - n) - 1;
+
+			/* 0 stands for '*' */
+			mailimap_set_add_interval(lep_set, first,
+				last == G_MAXUINT32 ? 0 : last);
+			n += (guint64)last - first + 1;
+
+			if (max_count > 0 && n >= max_count) {
+				result = g_slist_prepend(result, lep_set);
+				lep_set = NULL;
+			}
+			if (last == cur.last)
+				break;
+			first = last + 1;
+		}
+	}
+	if (lep_set != NULL)
+		result = g_slist_prepend(result, lep_set);
+
+	return g_slist_reverse(result);
+}
+
+IMAPUidSet *imap_uid_set_new_from_lep_set(struct mailimap_set *lep_set)
+{
+	IMAPUidSet *set = imap_uid_set_new();
+	clistiter *cur;
+
+	if (lep_set == NULL)
+		return set;
+
+	for (cur = clist_begin(lep_set->set_list); cur != NULL;
+	     cur = clist_next(cur)) {
+		struct mailimap_set_item *item = clist_content(cur);
+
+		/* 0 stands for '*' */
+		imap_uid_set_add_range(set,
+			item->set_first ? item->set_first : G_MAXUINT32,
+			item->set_last ? item->set_last : G_MAXUINT32);
+	}
+
+	return set;
+}
+
+/* from a list of uint32_t, like the result of a search */
+IMAPUidSet *imap_uid_set_new_from_lep_list(clist *list)
+{
+	IMAPUidSet *set = imap_uid_set_new();
+	clistiter *cur;
+
+	if (list == NULL)
+		return set;
+
+	for (cur = clist_begin(list); cur != NULL; cur = clist_next(cur))
+		imap_uid_set_add(set, *(uint32_t *)clist_content(cur));
+
+	return set;
+}
+
+#endif /* HAVE_LIBETPAN */
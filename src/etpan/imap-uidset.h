@@ -0,0 +1,88 @@
+/*
+ * Claws Mail -- a GTK+ based, lightweight, and fast e-mail client
+ * Copyright (C) 2026 the Claws Mail team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef IMAP_UIDSET_H
+
+#define IMAP_UIDSET_H
+
+#include <glib.h>
+#include <libetpan/libetpan.h>
+
+/*
+ * A set of UIDs stored as sorted, disjoint and non-adjacent ranges, the
+ * way IMAP sequence sets describe them. Mailboxes mostly hold long runs
+ * of consecutive UIDs, so this takes a few bytes where a GSList of the
+ * same UIDs takes 16 bytes per message.
+ */
+
+typedef struct _IMAPUidRange IMAPUidRange;
+typedef struct _IMAPUidSet IMAPUidSet;
+
+struct _IMAPUidRange
+{
+	guint32 first;
+	guint32 last;
+};
+
+struct _IMAPUidSet
+{
+	GArray *ranges;
+	guint count;
+};
+
+typedef void (*IMAPUidRangeFunc) (guint32 first, guint32 last,
+				  gpointer data);
+
+IMAPUidSet *imap_uid_set_new		(void);
+IMAPUidSet *imap_uid_set_copy		(const IMAPUidSet *set);
+void imap_uid_set_free			(IMAPUidSet *set);
+void imap_uid_set_clear			(IMAPUidSet *set);
+
+void imap_uid_set_add			(IMAPUidSet *set, guint32 uid);
+void imap_uid_set_add_range		(IMAPUidSet *set, guint32 first,
+					 guint32 last);
+void imap_uid_set_remove		(IMAPUidSet *set, guint32 uid);
+void imap_uid_set_remove_range		(IMAPUidSet *set, guint32 first,
+					 guint32 last);
+
+gboolean imap_uid_set_contains		(const IMAPUidSet *set, guint32 uid);
+guint imap_uid_set_count		(const IMAPUidSet *set);
+guint32 imap_uid_set_max		(const IMAPUidSet *set);
+
+void imap_uid_set_union			(IMAPUidSet *set,
+					 const IMAPUidSet *other);
+void imap_uid_set_difference		(IMAPUidSet *set,
+					 const IMAPUidSet *other);
+
+void imap_uid_set_foreach_range		(const IMAPUidSet *set,
+					 IMAPUidRangeFunc func,
+					 gpointer data);
+
+gchar *imap_uid_set_to_string		(const IMAPUidSet *set);
+IMAPUidSet *imap_uid_set_new_from_string(const gchar *str);
+
+GSList *imap_uid_set_to_list		(const IMAPUidSet *set);
+IMAPUidSet *imap_uid_set_new_from_list	(GSList *list);
+
+GSList *imap_uid_set_to_lep_sets	(const IMAPUidSet *set,
+					 guint max_count);
+IMAPUidSet *imap_uid_set_new_from_lep_set(struct mailimap_set *lep_set);
+IMAPUidSet *imap_uid_set_new_from_lep_list(clist *list);
+
+#endif
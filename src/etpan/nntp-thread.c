@@ -323,26 +323,64 @@ static newsnntp * get_nntp(Folder * folder)
 }
 
 
-static void generic_cb(int cancelled, void * result, void * callback_data)
+/* mailstream_logger is global: the traffic is logged as NNTP while
+ * NNTP operations are pending */
+static void (* previous_stream_logger)(int direction,
+	const char * str, size_t size);
+static guint stream_logger_users = 0;
+
+static void stream_logger_push(void)
 {
-	struct etpan_thread_op * op;
-	
-	op = (struct etpan_thread_op *) callback_data;
+	if (stream_logger_users++ == 0) {
+		previous_stream_logger = mailstream_logger;
+		mailstream_logger = nntp_logger;
+	}
+}
 
-	debug_print("generic_cb\n");
-	op->finished = 1;
+static void stream_logger_pop(void)
+{
+	if (--stream_logger_users == 0)
+		mailstream_logger = previous_stream_logger;
 }
 
-static void threaded_run(Folder * folder, void * param, void * result,
-			 void (* func)(struct etpan_thread_op * ))
+/* An operation queued on the thread of a folder. */
+struct threaded_call {
+	Folder * folder;
+	void (* done)(Folder * folder, void * data);
+	void * data;
+};
+
+static void threaded_call_cb(int cancelled, void * result, void * callback_data)
+{
+	struct threaded_call * call = callback_data;
+
+	debug_print("threaded_call_cb\n");
+	stream_logger_pop();
+
+	call->done(call->folder, call->data);
+
+	nntp_folder_unref(call->folder);
+	g_free(call);
+}
+
+/* Queues func after the operations already queued on the thread of the
+ * folder, and returns at once. done() is called from the main loop once
+ * func has run; param and result must stay valid until then. */
+static void threaded_run_async(Folder * folder, void * param, void * result,
+			       void (* func)(struct etpan_thread_op * ),
+			       void (* done)(Folder * folder, void * data),
+			       void * data)
 {
 	struct etpan_thread_op * op;
-	struct etpan_thread * thread;
-	void (*previous_stream_logger)(int direction,
-		const char * str, size_t size);
+	struct threaded_call * call;
 
 	nntp_folder_ref(folder);
 
+	call = g_new0(struct threaded_call, 1);
+	call->folder = folder;
+	call->done = done;
+	call->data = data;
+
 	op = etpan_thread_op_new();
 	
 	op->nntp = get_nntp(folder);
@@ -350,24 +388,39 @@ static void threaded_run(Folder * folder, void * param, void * result,
 	op->result = result;
 
 	op->run = func;
-	op->callback = generic_cb;
-	op->callback_data = op;
+	op->callback = threaded_call_cb;
+	op->callback_data = call;
+	op->cleanup = etpan_thread_op_free;
 	
-	previous_stream_logger = mailstream_logger;
-	mailstream_logger = nntp_logger;
+	stream_logger_push();
 
-	thread = get_thread(folder);
-	etpan_thread_op_schedule(thread, op);
-	
-	while (!op->finished) {
+	etpan_thread_op_schedule(get_thread(folder), op);
+}
+
+/* Lets the main loop run until an asynchronous operation calls back,
+ * for the synchronous API. */
+static void threaded_wait(gboolean * finished)
+{
+	while (!* finished) {
 		gtk_main_iteration();
 	}
-	
-	mailstream_logger = previous_stream_logger;
+}
+
+static void threaded_run_done(Folder * folder, void * data)
+{
+	gboolean * finished = data;
 
-	etpan_thread_op_free(op);
+	* finished = TRUE;
+}
 
-	nntp_folder_unref(folder);
+static void threaded_run(Folder * folder, void * param, void * result,
+			 void (* func)(struct etpan_thread_op * ))
+{
+	gboolean finished = FALSE;
+
+	threaded_run_async(folder, param, result, func,
+			   threaded_run_done, &finished);
+	threaded_wait(&finished);
 }
 
 
@@ -631,21 +684,66 @@ static void date_run(struct etpan_thread_op * op)
 	debug_print("nntp date run - end %i\n", r);
 }
 
-int nntp_threaded_date(Folder * folder, struct tm *lt)
-{
+struct date_call {
 	struct date_param param;
 	struct date_result result;
-	
-	debug_print("nntp date - begin\n");
-	
-	param.nntp = get_nntp(folder);
-	param.lt = lt;
+	struct tm lt;
+	NNTPDateFunc callback;
+	void * data;
+};
+
+static void date_done(Folder * folder, void * data)
+{
+	struct date_call * call = data;
 
-	threaded_run(folder, &param, &result, date_run);
-	
 	debug_print("nntp date - end\n");
-	
-	return result.error;
+
+	call->callback(folder, call->result.error, &call->lt, call->data);
+	g_free(call);
+}
+
+void nntp_threaded_date_async(Folder * folder, NNTPDateFunc callback,
+			      void * data)
+{
+	struct date_call * call;
+
+	debug_print("nntp date - begin\n");
+
+	call = g_new0(struct date_call, 1);
+	call->callback = callback;
+	call->data = data;
+
+	call->param.nntp = get_nntp(folder);
+	call->param.lt = &call->lt;
+
+	threaded_run_async(folder, &call->param, &call->result, date_run,
+			   date_done, call);
+}
+
+struct date_wait {
+	gboolean finished;
+	int error;
+	struct tm * lt;
+};
+
+static void date_wait_cb(Folder * folder, int error, const struct tm * lt,
+			 void * data)
+{
+	struct date_wait * wait = data;
+
+	wait->error = error;
+	* wait->lt = * lt;
+	wait->finished = TRUE;
+}
+
+int nntp_threaded_date(Folder * folder, struct tm *lt)
+{
+	struct date_wait wait = { FALSE, 0, lt };
+
+	nntp_threaded_date_async(folder, date_wait_cb, &wait);
+	threaded_wait(&wait.finished);
+
+	return wait.error;
 }
 
 struct list_param {
@@ -764,23 +862,74 @@ static void article_run(struct etpan_thread_op * op)
 	debug_print("nntp article run - end %i\n", r);
 }
 
-int nntp_threaded_article(Folder * folder, guint32 num, char **contents, size_t *len)
-{
+struct article_call {
 	struct article_param param;
 	struct article_result result;
-	
-	debug_print("nntp article - begin\n");
-	
-	param.nntp = get_nntp(folder);
-	param.num = num;
-	param.contents = contents;
-	param.len = len;
+	char * contents;
+	size_t len;
+	NNTPArticleFunc callback;
+	void * data;
+};
+
+static void article_done(Folder * folder, void * data)
+{
+	struct article_call * call = data;
 
-	threaded_run(folder, &param, &result, article_run);
-	
 	debug_print("nntp article - end\n");
-	
-	return result.error;
+
+	if (call->result.error != NEWSNNTP_NO_ERROR)
+		call->contents = NULL;
+	call->callback(folder, call->result.error, call->contents,
+		       call->len, call->data);
+	g_free(call);
+}
+
+void nntp_threaded_article_async(Folder * folder, guint32 num,
+				 NNTPArticleFunc callback, void * data)
+{
+	struct article_call * call;
+
+	debug_print("nntp article - begin\n");
+
+	call = g_new0(struct article_call, 1);
+	call->callback = callback;
+	call->data = data;
+
+	call->param.nntp = get_nntp(folder);
+	call->param.num = num;
+	call->param.contents = &call->contents;
+	call->param.len = &call->len;
+
+	threaded_run_async(folder, &call->param, &call->result, article_run,
+			   article_done, call);
+}
+
+struct article_wait {
+	gboolean finished;
+	int error;
+	char ** contents;
+	size_t * len;
+};
+
+static void article_wait_cb(Folder * folder, int error, char * contents,
+			    size_t len, void * data)
+{
+	struct article_wait * wait = data;
+
+	wait->error = error;
+	* wait->contents = contents;
+	* wait->len = len;
+	wait->finished = TRUE;
+}
+
+int nntp_threaded_article(Folder * folder, guint32 num, char **contents, size_t *len)
+{
+	struct article_wait wait = { FALSE, 0, contents, len };
+
+	nntp_threaded_article_async(folder, num, article_wait_cb, &wait);
+	threaded_wait(&wait.finished);
+
+	return wait.error;
 }
 
 struct group_param {
@@ -49,4 +49,18 @@ int nntp_threaded_mode_reader(Folder * folder);
 int nntp_threaded_xover(Folder * folder, guint32 beg, guint32 end, struct newsnntp_xover_resp_item **single_result, clist **multiple_result);
 int nntp_threaded_xhdr(Folder * folder, const char *header, guint32 beg, guint32 end, clist **hdrlist);
 
+/* Asynchronous variants: the command is queued after those already
+ * queued for the folder and the call returns at once; the callback is
+ * called from the main loop with the outcome. */
+typedef void (* NNTPDateFunc)(Folder * folder, int error,
+			      const struct tm * lt, void * data);
+/* contents belongs to the callback, see mmap_string_unref() */
+typedef void (* NNTPArticleFunc)(Folder * folder, int error,
+				 char * contents, size_t len, void * data);
+
+void nntp_threaded_date_async(Folder * folder, NNTPDateFunc callback,
+			      void * data);
+void nntp_threaded_article_async(Folder * folder, guint32 num,
+				 NNTPArticleFunc callback, void * data);
+
 #endif
@@ -54,6 +54,16 @@ GSList * filtering_rules = NULL;
 
 gboolean debug_filtering_session = FALSE;
 
+typedef struct _FilteringProgram FilteringProgram;
+
+struct _FilteringProgram {
+	GSList *matchers;	/* MatcherList of each rule, in order */
+	MatcherProgram *program;
+};
+
+/* compiled conditions of the filtering lists, keyed by list */
+static GHashTable *filtering_programs = NULL;
+
 static gboolean filtering_is_final_action(FilteringAction *filtering_action);
 
 FilteringAction * filteringaction_new(int type, int account_id,
@@ -851,6 +861,72 @@ static gboolean filter_msginfo(GSList * filtering_list, MsgInfo * info, PrefsAcc
 	return TRUE;
 }
 
+static void filtering_program_free(FilteringProgram *fprog)
+{
+	g_slist_free(fprog->matchers);
+	matcher_program_free(fprog->program);
+	g_free(fprog);
+}
+
+static gboolean filtering_program_is_current(FilteringProgram *fprog,
+					     GSList *flist)
+{
+	GSList *cur;
+
+	if (!matcher_program_is_valid(fprog->program))
+		return FALSE;
+
+	for (cur = fprog->matchers; cur != NULL && flist != NULL;
+	     cur = cur->next, flist = flist->next) {
+		FilteringProp *filtering = (FilteringProp *) flist->data;
+
+		if (filtering->matchers != cur->data)
+			return FALSE;
+	}
+
+	return cur == NULL && flist == NULL;
+}
+
+/*!
+ *\brief	Get the compiled conditions of a list of rules, compiling
+ *		them again if the rules changed.
+ */
+static MatcherProgram *filtering_get_program(GSList *flist)
+{
+	FilteringProgram *fprog;
+	GSList *cur;
+
+	if (flist == NULL)
+		return NULL;
+
+	if (filtering_programs == NULL)
+		filtering_programs = g_hash_table_new_full(g_direct_hash,
+				g_direct_equal, NULL,
+				(GDestroyNotify) filtering_program_free);
+
+	fprog = g_hash_table_lookup(filtering_programs, flist);
+	if (fprog != NULL && filtering_program_is_current(fprog, flist))
+		return fprog->program;
+
+	/* once a condition was freed, every program is outdated */
+	if (fprog != NULL && !matcher_program_is_valid(fprog->program))
+		g_hash_table_remove_all(filtering_programs);
+
+	fprog = g_new0(FilteringProgram, 1);
+	for (cur = flist; cur != NULL; cur = cur->next) {
+		FilteringProp *filtering = (FilteringProp *) cur->data;
+
+		fprog->matchers = g_slist_prepend(fprog->matchers,
+						  filtering->matchers);
+	}
+	fprog->matchers = g_slist_reverse(fprog->matchers);
+	fprog->program = matcher_program_new(fprog->matchers);
+
+	g_hash_table_replace(filtering_programs, flist, fprog);
+
+	return fprog->program;
+}
+
 /*!
  *\brief	Filter a message against a list of rules.
  *
@@ -867,6 +943,7 @@ static gboolean filter_msginfo(GSList * filtering_list, MsgInfo * info, PrefsAcc
 gboolean filter_message_by_msginfo(GSList *flist, MsgInfo *info, PrefsAccount* ac_prefs,
 								   FilteringInvocationType context, gchar *extra_info)
 {
+	MatcherProgram *program;
 	gboolean ret;
 
 	if (prefs_common.enable_filtering_debug) {
@@ -925,7 +1002,14 @@ gboolean filter_message_by_msginfo(GSList *flist, MsgInfo *info, PrefsAccount* a
 	} else
 		debug_filtering_session = FALSE;
 
+	program = filtering_get_program(flist);
+	if (program != NULL)
+		matcher_program_run(program, info);
+
 	ret = filter_msginfo(flist, info, ac_prefs);
+
+	if (program != NULL)
+		matcher_program_finish(program);
 	debug_filtering_session = FALSE;
 	return ret;
 }
@@ -1102,6 +1186,9 @@ void prefs_filtering_clear(void)
 	pre_global_processing = NULL;
 	prefs_filtering_free(post_global_processing);
 	post_global_processing = NULL;
+
+	if (filtering_programs != NULL)
+		g_hash_table_remove_all(filtering_programs);
 }
 
 void prefs_filtering_clear_folder(Folder *folder)
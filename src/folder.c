@@ -99,6 +99,9 @@ static void folder_get_persist_prefs_recursive
 					(GNode *node, GHashTable *pptable);
 static gboolean persist_prefs_free	(gpointer key, gpointer val, gpointer data);
 static void folder_item_read_cache		(FolderItem *item);
+static void folder_item_forget_prefetched_cache	(FolderItem *item);
+static void folder_item_set_cache		(FolderItem *item,
+						 MsgCache *cache);
 gint folder_item_scan_full		(FolderItem *item, gboolean filtering);
 static void folder_item_update_with_msg (FolderItem *item, FolderItemUpdateFlags update_flags,
                                          MsgInfo *msg);
@@ -503,6 +506,7 @@ void folder_item_destroy(FolderItem *item)
 			folder->trash = NULL;
 	}
 
+	folder_item_forget_prefetched_cache(item);
 	if (item->cache)
 		folder_item_free_cache(item, TRUE);
 	if (item->prefs)
@@ -1004,7 +1008,7 @@ FolderItem *folder_create_folder(FolderItem *parent, const gchar *name)
 	if (new_item) {
 		FolderUpdateData hookdata;
 
-		new_item->cache = msgcache_new();
+		folder_item_set_cache(new_item, msgcache_new());
 		new_item->cache_dirty = TRUE;
 		new_item->mark_dirty = TRUE;
 		new_item->tags_dirty = TRUE;
@@ -2197,7 +2201,7 @@ gint folder_item_scan_full(FolderItem *item, gboolean filtering)
 	} else {
 		if (item->cache)
 			msgcache_destroy(item->cache);
-		item->cache = msgcache_new();
+		folder_item_set_cache(item, msgcache_new());
 		item->cache_dirty = TRUE;
 		item->mark_dirty = TRUE;
 		item->tags_dirty = TRUE;
@@ -2522,42 +2526,47 @@ gint folder_item_scan(FolderItem *item)
 	return folder_item_scan_full(item, TRUE);
 }
 
-static void folder_count_total_cache_memusage(FolderItem *item, gpointer data)
+static void folder_item_set_cache(FolderItem *item, MsgCache *cache)
 {
-	gint *memusage = (gint *)data;
+	item->cache = cache;
+	if (cache != NULL)
+		msgcache_attach(cache, item);
+}
+
+/* The thread index of the messages in the cache of @item, if it is
+ * loaded. */
+MsgThreadIndex *folder_item_get_thread_index(FolderItem *item)
+{
+	cm_return_val_if_fail(item != NULL, NULL);
 
 	if (item->cache == NULL)
-		return;
-	
-	*memusage += msgcache_get_memory_usage(item->cache);
+		return NULL;
+
+	return msgcache_get_thread_index(item->cache);
 }
 
-static gint folder_cache_time_compare_func(gconstpointer a, gconstpointer b)
+/* The thread tree of @mlist as saved with the cache of @item, if the
+ * folder hasn't changed since and @mlist holds all of its messages. */
+GNode *folder_item_get_saved_thread_tree(FolderItem *item, GSList *mlist)
 {
-	FolderItem *fa = (FolderItem *)a;
-	FolderItem *fb = (FolderItem *)b;
-	
-	return (gint) (msgcache_get_last_access_time(fa->cache) - msgcache_get_last_access_time(fb->cache));
+	cm_return_val_if_fail(item != NULL, NULL);
+
+	if (item->cache == NULL)
+		return NULL;
+
+	return msgcache_get_thread_tree(item->cache, mlist);
 }
 
-static void folder_find_expired_caches(FolderItem *item, gpointer data)
+/* Saves the thread tree @root with the cache of @item, if it is one
+ * of the whole folder. */
+void folder_item_set_saved_thread_tree(FolderItem *item, GNode *root)
 {
-	GSList **folder_item_list = (GSList **)data;
-	gint difftime, expiretime;
-	
-	if (item->cache == NULL)
-		return;
+	cm_return_if_fail(item != NULL);
 
-	if (item->opened > 0)
+	if (item->cache == NULL)
 		return;
 
-	difftime = (gint) (time(NULL) - msgcache_get_last_access_time(item->cache));
-	expiretime = prefs_common.cache_min_keep_time * 60;
-	debug_print("Cache unused time: %d (Expire time: %d)\n", difftime, expiretime);
-
-	if (difftime > expiretime && !item->opened && !item->processing_pending) {
-		*folder_item_list = g_slist_insert_sorted(*folder_item_list, item, folder_cache_time_compare_func);
-	}
+	msgcache_set_thread_tree(item->cache, root);
 }
 
 gboolean folder_item_free_cache(FolderItem *item, gboolean force)
@@ -2592,34 +2601,60 @@ void folder_clean_cache_memory_force(void)
 
 void folder_clean_cache_memory(FolderItem *protected_item)
 {
-	gint memusage = 0;
+	gsize memusage, maxusage;
+	time_t expire;
+	MsgCacheStats stats;
+	gint pass;
 
-	folder_func_to_all_folders(folder_count_total_cache_memusage, &memusage);	
-	debug_print("Total cache memory usage: %d\n", memusage);
-	
-	if (memusage > (prefs_common.cache_max_mem_usage * 1024)) {
-		GSList *folder_item_list = NULL, *listitem;
-		
-		debug_print("Trying to free cache memory\n");
-
-		folder_func_to_all_folders(folder_find_expired_caches, &folder_item_list);	
-		listitem = folder_item_list;
-		while((listitem != NULL) && (memusage > (prefs_common.cache_max_mem_usage * 1024))) {
-			FolderItem *item = (FolderItem *)(listitem->data);
-			gint cache_size = 0;
-			if (item == protected_item) {
-				listitem = listitem->next;
+	/* strings shared between messages of any folder */
+	memusage = msgcache_get_total_memory_usage()
+		+ procmsg_msginfo_strings_memusage();
+	maxusage = (gsize) MAX(prefs_common.cache_max_mem_usage, 0) * 1024;
+	debug_print("Total cache memory usage: %" G_GSIZE_FORMAT "\n", memusage);
+
+	if (memusage <= maxusage)
+		return;
+
+	debug_print("Trying to free cache memory\n");
+	expire = time(NULL) - prefs_common.cache_min_keep_time * 60;
+
+	/* walk the caches from the least recently used one, first only
+	 * dropping what can be parsed again from the messages, then
+	 * freeing whole caches */
+	for (pass = 0; pass < 2 && memusage > maxusage; pass++) {
+		MsgCache *cache, *newer;
+
+		for (cache = msgcache_get_lru_oldest();
+		     cache != NULL && memusage > maxusage; cache = newer) {
+			FolderItem *item = msgcache_get_item(cache);
+			gsize cache_size;
+
+			newer = msgcache_get_lru_newer(cache);
+			if (msgcache_get_last_access_time(cache) >= expire)
+				break;
+			if (item == protected_item || item->opened > 0
+			    || item->processing_pending)
+				continue;
+
+			if (pass == 0) {
+				memusage -= MIN(memusage, msgcache_trim(cache));
 				continue;
 			}
-			debug_print("Freeing cache memory for %s\n", item->path ? item->path : item->name);
-			cache_size = msgcache_get_memory_usage(item->cache);
-		        if (folder_item_free_cache(item, FALSE))
-				memusage -= cache_size;
 
-			listitem = listitem->next;
+			debug_print("Freeing cache memory for %s\n", item->path ? item->path : item->name);
+			cache_size = msgcache_get_memory_usage(cache);
+			if (folder_item_free_cache(item, FALSE)) {
+				memusage -= MIN(memusage, cache_size);
+				msgcache_count_eviction();
+			}
 		}
-		g_slist_free(folder_item_list);
 	}
+
+	msgcache_get_stats(&stats);
+	debug_print("Cache memory usage now %" G_GSIZE_FORMAT ": %u hits, "
+		    "%u misses, %u loads, %u evictions, %u trims\n",
+		    memusage, stats.hits, stats.misses, stats.loads,
+		    stats.evictions, stats.trims);
 }
 
 static void folder_item_remove_cached_msg(FolderItem *item, MsgInfo *msginfo)
@@ -2654,17 +2689,402 @@ static void folder_item_clean_local_files(FolderItem *item, gint days)
 	}
 }
 
+/* Reading a big cache file is mostly spent parsing it, so caches that
+ * are about to be needed can be read ahead by a pool of threads. Jobs
+ * are only queued and collected from the main thread; the worker only
+ * fills in job->cache, and never touches the FolderItem itself. */
+typedef struct _FolderCacheJob FolderCacheJob;
+
+struct _FolderCacheJob {
+	FolderItem *item;
+	gchar *cache_file;
+	gchar *mark_file;
+	gchar *tags_file;
+	MsgTmpFlags tmp_flags;
+	MsgCache *cache;
+	gint refcnt;
+	gboolean started;
+	gboolean done;
+	/* FolderCacheWaiters, main thread only */
+	GSList *waiters;
+};
+
+typedef struct _FolderCacheWaiter {
+	FolderItemFunc func;
+	gpointer data;
+	FolderItem *item;
+} FolderCacheWaiter;
+
+static GThreadPool *folder_cache_pool = NULL;
+static GMutex *folder_cache_mutex = NULL;
+static GCond *folder_cache_cond = NULL;
+static GHashTable *folder_cache_jobs = NULL;
+static guint folder_cache_idle_id = 0;
+/* waiters whose job is over, called from folder_cache_install_idle() */
+static GSList *folder_cache_waiters_done = NULL;
+
+static void folder_cache_job_unref(FolderCacheJob *job)
+{
+	gboolean last;
+
+	g_mutex_lock(folder_cache_mutex);
+	last = --job->refcnt == 0;
+	g_mutex_unlock(folder_cache_mutex);
+
+	if (!last)
+		return;
+
+	if (job->cache)
+		msgcache_destroy(job->cache);
+	g_free(job->cache_file);
+	g_free(job->mark_file);
+	g_free(job->tags_file);
+	g_free(job);
+}
+
+static void folder_cache_job_load(FolderCacheJob *job)
+{
+	job->cache = msgcache_read_cache_full(job->item, job->cache_file,
+					      job->tmp_flags);
+	if (job->cache) {
+		msgcache_read_mark(job->cache, job->mark_file);
+		msgcache_read_tags(job->cache, job->tags_file);
+	}
+}
+
+static void folder_cache_job_install(FolderCacheJob *job)
+{
+	FolderItem *item = job->item;
+
+	if (item->cache != NULL || job->cache == NULL)
+		return;
+
+	folder_item_set_cache(item, job->cache);
+	job->cache = NULL;
+	item->cache_dirty = FALSE;
+	item->mark_dirty = FALSE;
+	item->tags_dirty = FALSE;
+}
+
+static gboolean folder_cache_install_idle(gpointer data);
+
+static void folder_cache_schedule_idle(void)
+{
+	g_mutex_lock(folder_cache_mutex);
+	if (folder_cache_idle_id == 0)
+		folder_cache_idle_id = g_idle_add(folder_cache_install_idle,
+						  NULL);
+	g_mutex_unlock(folder_cache_mutex);
+}
+
+/* Hands the waiters of @job to the idle handler, which calls them with
+ * the item, or with NULL if the item is gone. They are never called from
+ * here, as the cache may be taken deep inside folder code. */
+static void folder_cache_job_finish(FolderCacheJob *job, gboolean item_alive)
+{
+	GSList *cur;
+
+	if (job->waiters == NULL)
+		return;
+
+	for (cur = job->waiters; cur != NULL; cur = cur->next) {
+		FolderCacheWaiter *waiter = (FolderCacheWaiter *)cur->data;
+
+		waiter->item = item_alive ? job->item : NULL;
+	}
+	folder_cache_waiters_done = g_slist_concat(folder_cache_waiters_done,
+						   job->waiters);
+	job->waiters = NULL;
+	folder_cache_schedule_idle();
+}
+
+static gboolean folder_cache_take_done(gpointer key, gpointer value,
+				       gpointer data)
+{
+	FolderCacheJob *job = (FolderCacheJob *)value;
+	GSList **done = (GSList **)data;
+
+	if (!job->done)
+		return FALSE;
+
+	*done = g_slist_prepend(*done, job);
+	return TRUE;
+}
+
+static gboolean folder_cache_install_idle(gpointer data)
+{
+	GSList *done = NULL, *cur;
+
+	g_mutex_lock(folder_cache_mutex);
+	folder_cache_idle_id = 0;
+	g_hash_table_foreach_remove(folder_cache_jobs,
+				    folder_cache_take_done, &done);
+	g_mutex_unlock(folder_cache_mutex);
+
+	for (cur = done; cur != NULL; cur = cur->next) {
+		FolderCacheJob *job = (FolderCacheJob *)cur->data;
+
+		folder_cache_job_install(job);
+		folder_cache_job_finish(job, TRUE);
+		folder_cache_job_unref(job);
+	}
+	if (done != NULL) {
+		debug_print("installed %d prefetched caches\n",
+			    g_slist_length(done));
+		g_slist_free(done);
+		folder_clean_cache_memory(NULL);
+	}
+
+	/* the waiters may open folders and queue caches again */
+	done = folder_cache_waiters_done;
+	folder_cache_waiters_done = NULL;
+	for (cur = done; cur != NULL; cur = cur->next) {
+		FolderCacheWaiter *waiter = (FolderCacheWaiter *)cur->data;
+
+		waiter->func(waiter->item, waiter->data);
+		g_free(waiter);
+	}
+	g_slist_free(done);
+
+	return FALSE;
+}
+
+static void folder_cache_thread_func(gpointer data, gpointer user_data)
+{
+	FolderCacheJob *job = (FolderCacheJob *)data;
+	gboolean taken;
+
+	g_mutex_lock(folder_cache_mutex);
+	taken = job->started;
+	job->started = TRUE;
+	g_mutex_unlock(folder_cache_mutex);
+
+	/* the main thread needed it first and read it itself */
+	if (!taken)
+		folder_cache_job_load(job);
+
+	g_mutex_lock(folder_cache_mutex);
+	if (!taken) {
+		job->done = TRUE;
+		g_cond_broadcast(folder_cache_cond);
+		if (folder_cache_idle_id == 0)
+			folder_cache_idle_id = g_idle_add(
+					folder_cache_install_idle, NULL);
+	}
+	g_mutex_unlock(folder_cache_mutex);
+
+	folder_cache_job_unref(job);
+}
+
+static void folder_item_prefetch_cache_func(FolderItem *item)
+{
+	FolderCacheJob *job;
+	GError *error = NULL;
+
+	if (item->cache != NULL || item->path == NULL || item->no_select)
+		return;
+	if (g_hash_table_lookup(folder_cache_jobs, item) != NULL)
+		return;
+
+	job = g_new0(FolderCacheJob, 1);
+	job->item = item;
+	job->cache_file = folder_item_get_cache_file(item);
+	job->mark_file = folder_item_get_mark_file(item);
+	job->tags_file = folder_item_get_tags_file(item);
+	job->tmp_flags = msgcache_get_tmp_flags(item);
+	job->refcnt = 2;
+
+	if (job->cache_file == NULL || !is_file_exist(job->cache_file)) {
+		job->refcnt = 1;
+		folder_cache_job_unref(job);
+		return;
+	}
+
+	g_hash_table_insert(folder_cache_jobs, item, job);
+	g_thread_pool_push(folder_cache_pool, job, &error);
+	if (error) {
+		g_warning("couldn't queue cache of %s: %s", item->path,
+			  error->message);
+		g_error_free(error);
+		g_hash_table_remove(folder_cache_jobs, item);
+		job->refcnt = 1;
+		folder_cache_job_unref(job);
+	}
+}
+
+static gboolean folder_item_prefetch_cache_node(GNode *node, gpointer data)
+{
+	folder_item_prefetch_cache_func(FOLDER_ITEM(node->data));
+	return FALSE;
+}
+
+/**
+ * folder_item_prefetch_cache:
+ * @item: the folder item
+ * @subfolders: also read the caches of every folder below @item
+ *
+ * Starts reading the caches of folders that are about to be used in
+ * the background. A cache read ahead is installed from the main loop,
+ * or as soon as the folder needs it, whichever comes first.
+ */
+void folder_item_prefetch_cache(FolderItem *item, gboolean subfolders)
+{
+	cm_return_if_fail(item != NULL);
+
+	if (prefs_common.cache_read_threads <= 0)
+		return;
+
+	if (folder_cache_pool == NULL) {
+		GError *error = NULL;
+
+		folder_cache_mutex = cm_mutex_new();
+		folder_cache_cond = cm_cond_new();
+		folder_cache_jobs = g_hash_table_new(g_direct_hash,
+						     g_direct_equal);
+		folder_cache_pool = g_thread_pool_new(folder_cache_thread_func,
+				NULL, prefs_common.cache_read_threads,
+				FALSE, &error);
+		if (folder_cache_pool == NULL) {
+			g_warning("couldn't start cache readers: %s",
+				  error ? error->message : "unknown error");
+			if (error)
+				g_error_free(error);
+			prefs_common.cache_read_threads = 0;
+			return;
+		}
+	}
+
+	if (subfolders && item->node != NULL)
+		g_node_traverse(item->node, G_PRE_ORDER, G_TRAVERSE_ALL, -1,
+				folder_item_prefetch_cache_node, NULL);
+	else
+		folder_item_prefetch_cache_func(item);
+}
+
+/**
+ * folder_item_load_cache_in_background:
+ * @item: the folder item
+ * @func: called from the main loop once the cache is read
+ * @data: data for @func
+ *
+ * Reads the cache of @item with the cache readers, so that opening a
+ * big folder doesn't freeze the interface. @func gets @item once its
+ * cache is installed, or NULL if the item is removed meanwhile; it may
+ * also come after something else needed the cache and read it first.
+ *
+ * Returns: TRUE if @func is going to be called, FALSE if there is
+ * nothing to wait for and the cache is read as usual when first needed.
+ */
+gboolean folder_item_load_cache_in_background(FolderItem *item,
+					      FolderItemFunc func,
+					      gpointer data)
+{
+	FolderCacheJob *job;
+	FolderCacheWaiter *waiter;
+	gboolean started;
+
+	cm_return_val_if_fail(item != NULL, FALSE);
+	cm_return_val_if_fail(func != NULL, FALSE);
+
+	if (item->cache != NULL)
+		return FALSE;
+
+	folder_item_prefetch_cache(item, FALSE);
+	if (folder_cache_jobs == NULL)
+		return FALSE;
+	job = g_hash_table_lookup(folder_cache_jobs, item);
+	if (job == NULL)
+		return FALSE;
+
+	g_mutex_lock(folder_cache_mutex);
+	started = job->started;
+	g_mutex_unlock(folder_cache_mutex);
+
+	/* it may be queued behind the caches of many other folders */
+	if (!started) {
+#if GLIB_CHECK_VERSION(2,46,0)
+		g_thread_pool_move_to_front(folder_cache_pool, job);
+#else
+		/* then folder_item_read_cache() takes it over */
+		return FALSE;
+#endif
+	}
+
+	waiter = g_new0(FolderCacheWaiter, 1);
+	waiter->func = func;
+	waiter->data = data;
+	job->waiters = g_slist_append(job->waiters, waiter);
+
+	return TRUE;
+}
+
+/* Takes the prefetched cache of @item, waiting for it or reading it right
+ * away if needed. Returns whether the item now has a cache. */
+static gboolean folder_item_take_prefetched_cache(FolderItem *item)
+{
+	FolderCacheJob *job;
+	gboolean taken, loaded;
+
+	if (folder_cache_jobs == NULL)
+		return FALSE;
+	job = g_hash_table_lookup(folder_cache_jobs, item);
+	if (job == NULL)
+		return FALSE;
+	g_hash_table_remove(folder_cache_jobs, item);
+
+	g_mutex_lock(folder_cache_mutex);
+	taken = !job->started;
+	job->started = TRUE;
+	if (!taken) {
+		while (!job->done)
+			g_cond_wait(folder_cache_cond, folder_cache_mutex);
+	}
+	g_mutex_unlock(folder_cache_mutex);
+
+	if (taken)
+		folder_cache_job_load(job);
+
+	folder_cache_job_install(job);
+	loaded = item->cache != NULL;
+	folder_cache_job_finish(job, TRUE);
+	folder_cache_job_unref(job);
+
+	return loaded;
+}
+
+static void folder_item_forget_prefetched_cache(FolderItem *item)
+{
+	FolderCacheJob *job;
+
+	if (folder_cache_jobs == NULL)
+		return;
+	job = g_hash_table_lookup(folder_cache_jobs, item);
+	if (job == NULL)
+		return;
+
+	/* the worker may still be reading it; the last unref drops it */
+	g_hash_table_remove(folder_cache_jobs, item);
+	folder_cache_job_finish(job, FALSE);
+	folder_cache_job_unref(job);
+}
+
 static void folder_item_read_cache(FolderItem *item)
 {
 	gchar *cache_file, *mark_file, *tags_file;
 	START_TIMING("");
 	cm_return_if_fail(item != NULL);
 
+	if (folder_item_take_prefetched_cache(item)) {
+		END_TIMING();
+		folder_clean_cache_memory(item);
+		return;
+	}
+
 	if (item->path != NULL) {
 	        cache_file = folder_item_get_cache_file(item);
 		mark_file = folder_item_get_mark_file(item);
 		tags_file = folder_item_get_tags_file(item);
-		item->cache = msgcache_read_cache(item, cache_file);
+		folder_item_set_cache(item, msgcache_read_cache(item, cache_file));
 		item->cache_dirty = FALSE;
 		item->mark_dirty = FALSE;
 		item->tags_dirty = FALSE;
@@ -2677,7 +3097,7 @@ static void folder_item_read_cache(FolderItem *item)
 			guint watchedcnt = 0;
 			MsgInfo *msginfo;
 
-			item->cache = msgcache_new();
+			folder_item_set_cache(item, msgcache_new());
 			item->cache_dirty = TRUE;
 			item->mark_dirty = TRUE;
 			item->tags_dirty = TRUE;
@@ -2728,7 +3148,7 @@ static void folder_item_read_cache(FolderItem *item)
 		g_free(mark_file);
 		g_free(tags_file);
 	} else {
-		item->cache = msgcache_new();
+		folder_item_set_cache(item, msgcache_new());
 		item->cache_dirty = TRUE;
 		item->mark_dirty = TRUE;
 		item->tags_dirty = TRUE;
@@ -2795,6 +3215,55 @@ void folder_item_write_cache(FolderItem *item)
 	g_free(tags_file);
 }
 
+/* Looks a message up in the index of the on-disk cache, for when the
+ * folder's cache isn't loaded and only one message is needed. */
+static MsgInfo *folder_item_peek_msginfo(FolderItem *item, gint num,
+					 const gchar *msgid)
+{
+	gchar *cache_file, *mark_file, *tags_file;
+	MsgInfo *msginfo;
+
+	if (item->path == NULL)
+		return NULL;
+
+	cache_file = folder_item_get_cache_file(item);
+	mark_file = folder_item_get_mark_file(item);
+	tags_file = folder_item_get_tags_file(item);
+	if (msgid != NULL)
+		msginfo = msgcache_peek_msg_by_id(item, cache_file, mark_file,
+						  tags_file, msgid);
+	else
+		msginfo = msgcache_peek_msg(item, cache_file, mark_file,
+					    tags_file, num);
+	g_free(cache_file);
+	g_free(mark_file);
+	g_free(tags_file);
+
+	return msginfo;
+}
+
+/* The copy in the loaded cache of a message read through
+ * folder_item_peek_msginfo(), to bring up to date after a change to
+ * it. A cache being read is waited for, so that it doesn't miss the
+ * change; one that isn't loaded gets it from the mark or tags file. */
+static MsgInfo *folder_item_get_cached_copy(FolderItem *item, MsgInfo *msginfo)
+{
+	MsgInfo *cached;
+
+	if (item->cache == NULL)
+		folder_item_take_prefetched_cache(item);
+	if (item->cache == NULL)
+		return NULL;
+
+	cached = msgcache_get_msg(item->cache, msginfo->msgnum);
+	if (cached == msginfo) {
+		procmsg_msginfo_free(&cached);
+		return NULL;
+	}
+
+	return cached;
+}
+
 MsgInfo *folder_item_get_msginfo(FolderItem *item, gint num)
 {
 	MsgInfo *msginfo = NULL;
@@ -2802,8 +3271,11 @@ MsgInfo *folder_item_get_msginfo(FolderItem *item, gint num)
 	cm_return_val_if_fail(item != NULL, NULL);
 	if (item->no_select)
 		return NULL;
-	if (!item->cache)
+	if (!item->cache) {
+		if ((msginfo = folder_item_peek_msginfo(item, num, NULL)) != NULL)
+			return msginfo;
 		folder_item_read_cache(item);
+	}
 	
 	if ((msginfo = msgcache_get_msg(item->cache, num)) != NULL)
 		return msginfo;
@@ -2826,8 +3298,11 @@ MsgInfo *folder_item_get_msginfo_by_msgid(FolderItem *item, const gchar *msgid)
 	if (item->no_select)
 		return NULL;
 	
-	if (!item->cache)
+	if (!item->cache) {
+		if ((msginfo = folder_item_peek_msginfo(item, 0, msgid)) != NULL)
+			return msginfo;
 		folder_item_read_cache(item);
+	}
 	
 	if ((msginfo = msgcache_get_msg_by_id(item->cache, msgid)) != NULL)
 		return msginfo;
@@ -3452,6 +3927,7 @@ static gint do_copy_msgs(FolderItem *dest, GSList *msglist, gboolean remove_sour
 	GSList *not_moved = NULL;
 	gint total = 0, curmsg = 0;
 	MsgInfo *msginfo = NULL;
+	gboolean moved = FALSE, server_copy;
 
 	cm_return_val_if_fail(dest != NULL, -1);
 	cm_return_val_if_fail(msglist != NULL, -1);
@@ -3509,11 +3985,22 @@ static gint do_copy_msgs(FolderItem *dest, GSList *msglist, gboolean remove_sour
 		}
 	}
 
+	msginfo = (MsgInfo *)msglist->data;
+	server_copy = (FOLDER_TYPE(folder) == F_IMAP &&
+		       msginfo->folder->folder == folder);
+
 	/* 
 	 * Copy messages to destination folder and 
 	 * store new message numbers in newmsgnums
 	 */
-	if (folder->klass->copy_msgs != NULL) {
+	if (remove_source && folder->klass->move_msgs != NULL &&
+	    msginfo->folder->folder == folder) {
+		if (folder->klass->move_msgs(folder, dest, msglist, relation) < 0) {
+			g_hash_table_destroy(relation);
+			return -1;
+		}
+		moved = TRUE;
+	} else if (folder->klass->copy_msgs != NULL) {
 		if (folder->klass->copy_msgs(folder, dest, msglist, relation) < 0) {
 			g_hash_table_destroy(relation);
 			return -1;
@@ -3550,7 +4037,7 @@ static gint do_copy_msgs(FolderItem *dest, GSList *msglist, gboolean remove_sour
 		 * copying was successfull and update folder
 		 * message counts
 		 */
-		if (not_moved == NULL && item->folder->klass->remove_msgs) {
+		if (not_moved == NULL && !moved && item->folder->klass->remove_msgs) {
 			item->folder->klass->remove_msgs(item->folder,
 					    		        msginfo->folder,
 						    		msglist,
@@ -3570,7 +4057,7 @@ static gint do_copy_msgs(FolderItem *dest, GSList *msglist, gboolean remove_sour
 				continue;
 
 			if ((num >= 0) && (item->folder->klass->remove_msg != NULL)) {
-				if (!item->folder->klass->remove_msgs)
+				if (!moved && !item->folder->klass->remove_msgs)
 					item->folder->klass->remove_msg(item->folder,
 					    		        msginfo->folder,
 						    		msginfo->msgnum);
@@ -3594,7 +4081,10 @@ static gint do_copy_msgs(FolderItem *dest, GSList *msglist, gboolean remove_sour
 	statusbar_print_all(_("Updating cache for %s..."), dest->path ? dest->path : "(null)");
 	total = g_slist_length(msglist);
 	
-	if (FOLDER_TYPE(dest->folder) == F_IMAP && total > 1) {
+	/* Copies within an IMAP account got their UIDs from COPYUID and
+	 * are the same messages, so their MsgInfos are cloned instead of
+	 * being fetched from the server one by one. */
+	if (FOLDER_TYPE(dest->folder) == F_IMAP && total > 1 && !server_copy) {
 		folder_item_scan_full(dest, FALSE);
 		folderscan = TRUE;
 	}
@@ -3619,7 +4109,13 @@ static gint do_copy_msgs(FolderItem *dest, GSList *msglist, gboolean remove_sour
 			MsgInfo *newmsginfo = NULL;
 
 			if (!folderscan && num > 0) {
-				newmsginfo = get_msginfo(dest, num);
+				if (server_copy) {
+					newmsginfo = procmsg_msginfo_copy(msginfo);
+					newmsginfo->folder = dest;
+					newmsginfo->msgnum = num;
+					newmsginfo->to_folder = NULL;
+				} else
+					newmsginfo = get_msginfo(dest, num);
 				if (newmsginfo != NULL) {
 					add_msginfo_to_cache(dest, newmsginfo, msginfo);
 				}
@@ -3866,7 +4362,7 @@ gint folder_item_remove_all_msg(FolderItem *item)
 
 		if (result == 0) {
 			folder_item_free_cache(item, TRUE);
-			item->cache = msgcache_new();
+			folder_item_set_cache(item, msgcache_new());
 			item->cache_dirty = TRUE;
 			item->mark_dirty = TRUE;
 			item->tags_dirty = TRUE;
@@ -3897,26 +4393,138 @@ gint folder_item_remove_all_msg(FolderItem *item)
 	return result;
 }
 
+static guint folder_compact_cache_id = 0;
+
+static void folder_compact_cache_func(FolderItem *item, gpointer data)
+{
+	if (item->cache != NULL && msgcache_needs_compaction(item->cache))
+		folder_item_write_cache(item);
+}
+
+static gboolean folder_compact_cache_timeout(gpointer data)
+{
+	folder_compact_cache_id = 0;
+	folder_func_to_all_folders(folder_compact_cache_func, NULL);
+
+	return FALSE;
+}
+
+/* The mark and tags files grow with each change appended to them, and
+ * are rewritten in full a little while after too many were appended. */
+static void folder_compact_cache_later(void)
+{
+	if (folder_compact_cache_id == 0)
+		folder_compact_cache_id = g_timeout_add_seconds(10,
+				folder_compact_cache_timeout, NULL);
+}
+
+static void folder_item_append_mark(FolderItem *item, MsgInfo *msginfo)
+{
+	MsgInfo *cached;
+	gchar *mark_file;
+	gint ret;
+
+	if (item->cache == NULL && item->path != NULL) {
+		/* the record is applied when the cache is read */
+		mark_file = folder_item_get_mark_file(item);
+		ret = msgcache_append_mark(NULL, mark_file, msginfo);
+		g_free(mark_file);
+		if (ret == 0)
+			return;
+
+		/* otherwise the change is written with the cache */
+		folder_item_read_cache(item);
+		if ((cached = folder_item_get_cached_copy(item, msginfo)) != NULL) {
+			cached->flags.perm_flags = msginfo->flags.perm_flags;
+			procmsg_msginfo_free(&cached);
+		}
+	}
+
+	if (item->mark_dirty || item->cache == NULL || item->path == NULL) {
+		item->mark_dirty = TRUE;
+		return;
+	}
+
+	mark_file = folder_item_get_mark_file(item);
+	ret = msgcache_append_mark(item->cache, mark_file, msginfo);
+	g_free(mark_file);
+
+	if (ret < 0) {
+		item->mark_dirty = TRUE;
+		if (msgcache_needs_compaction(item->cache))
+			folder_compact_cache_later();
+	}
+}
+
+static void folder_item_append_tags(FolderItem *item, MsgInfo *msginfo)
+{
+	MsgInfo *cached;
+	gchar *tags_file;
+	gint ret;
+
+	if (item->cache == NULL && item->path != NULL) {
+		/* the record is applied when the cache is read */
+		tags_file = folder_item_get_tags_file(item);
+		ret = msgcache_append_tags(NULL, tags_file, msginfo);
+		g_free(tags_file);
+		if (ret == 0)
+			return;
+
+		/* otherwise the change is written with the cache */
+		folder_item_read_cache(item);
+		if ((cached = folder_item_get_cached_copy(item, msginfo)) != NULL) {
+			g_slist_free(cached->tags);
+			cached->tags = g_slist_copy(msginfo->tags);
+			procmsg_msginfo_free(&cached);
+		}
+	}
+
+	if (item->tags_dirty || item->cache == NULL || item->path == NULL) {
+		item->tags_dirty = TRUE;
+		return;
+	}
+
+	tags_file = folder_item_get_tags_file(item);
+	ret = msgcache_append_tags(item->cache, tags_file, msginfo);
+	g_free(tags_file);
+
+	if (ret < 0) {
+		item->tags_dirty = TRUE;
+		if (msgcache_needs_compaction(item->cache))
+			folder_compact_cache_later();
+	}
+}
+
 void folder_item_change_msg_flags(FolderItem *item, MsgInfo *msginfo, MsgPermFlags newflags)
 {
+	MsgInfo *cached;
+
 	cm_return_if_fail(item != NULL);
 	cm_return_if_fail(msginfo != NULL);
 	
-	item->mark_dirty = TRUE;
-
-	if (item->no_select)
+	if (item->no_select) {
+		item->mark_dirty = TRUE;
 		return;
+	}
 	
 	if (item->folder->klass->change_flags != NULL && item->scanning != ITEM_SCANNING_WITH_FLAGS) {
 		item->folder->klass->change_flags(item->folder, item, msginfo, newflags);
 	} else {
 		msginfo->flags.perm_flags = newflags;
 	}
+
+	if ((cached = folder_item_get_cached_copy(item, msginfo)) != NULL) {
+		cached->flags.perm_flags = msginfo->flags.perm_flags;
+		procmsg_msginfo_free(&cached);
+	}
+
+	folder_item_append_mark(item, msginfo);
 }
 
 void folder_item_commit_tags(FolderItem *item, MsgInfo *msginfo, GSList *tags_set, GSList *tags_unset)
 {
 	Folder *folder = NULL;
+	MsgInfo *cached;
 
 	if (!msginfo)
 		return;
@@ -3929,7 +4537,13 @@ void folder_item_commit_tags(FolderItem *item, MsgInfo *msginfo, GSList *tags_se
 	if (!folder)
 		return;
 	
-	item->tags_dirty = TRUE;
+	if ((cached = folder_item_get_cached_copy(item, msginfo)) != NULL) {
+		g_slist_free(cached->tags);
+		cached->tags = g_slist_copy(msginfo->tags);
+		procmsg_msginfo_free(&cached);
+	}
+
+	folder_item_append_tags(item, msginfo);
 
 	if (folder->klass->commit_tags == NULL)
 		return;
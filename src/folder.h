@@ -533,6 +533,23 @@ struct _FolderClass
 						 FolderItem	*dest,
 						 MsgInfoList	*msglist,
                                     		 GHashTable	*relation);
+	/**
+	 * Move multiple messages to a \c FolderItem of the same \c Folder
+	 * in one step, for example with a server side move. If \c NULL
+	 * the folder system will use \c copy_msgs and \c remove_msgs.
+	 * The messages are removed from the source folder but not from
+	 * its cache.
+	 *
+	 * \param folder The \c Folder of the source and destination
+	 * \param dest The destination \c FolderItem for the messages
+	 * \param msglist A list of \c MsgInfos from one \c FolderItem
+	 * \param relation Like for \c copy_msgs
+	 * \return 0 on success, a negative number otherwise
+	 */
+	gint    	(*move_msgs)		(Folder		*folder,
+						 FolderItem	*dest,
+						 MsgInfoList	*msglist,
+                                    		 GHashTable	*relation);
 
 	/**
 	 * Search the given FolderItem for messages matching \c predicate.
@@ -982,6 +999,16 @@ gboolean folder_want_synchronise	(Folder *folder);
 gboolean folder_subscribe		(const gchar *uri);
 gboolean folder_have_mailbox 		(void);
 gboolean folder_item_free_cache		(FolderItem *item, gboolean force);
+void folder_item_prefetch_cache		(FolderItem *item,
+					 gboolean subfolders);
+gboolean folder_item_load_cache_in_background	(FolderItem *item,
+						 FolderItemFunc func,
+						 gpointer data);
+MsgThreadIndex *folder_item_get_thread_index	(FolderItem *item);
+GNode *folder_item_get_saved_thread_tree	(FolderItem *item,
+						 GSList *mlist);
+void folder_item_set_saved_thread_tree	(FolderItem *item,
+					 GNode *root);
 void folder_item_change_type		(FolderItem *item,
 					 SpecialFolderItemType newtype);
 gboolean folder_get_sort_type		(Folder		*folder,
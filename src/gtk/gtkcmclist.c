@@ -1141,6 +1141,11 @@ gtk_cmclist_init (GtkCMCList *clist)
   clist->row_list = NULL;
   clist->row_list_end = NULL;
 
+  clist->format_func = NULL;
+  clist->format_data = NULL;
+  clist->format_cache_size = 0;
+  g_queue_init (&clist->formatted_rows);
+
   clist->columns = 0;
 
   clist->title_window = NULL;
@@ -1872,7 +1877,8 @@ gtk_cmclist_optimal_column_width (GtkCMCList *clist,
 
   for (list = clist->row_list; list; list = list->next)
     {
-  GTK_CMCLIST_GET_CLASS (clist)->cell_size_request
+      gtk_cmclist_format_row (clist, GTK_CMCLIST_ROW (list));
+      GTK_CMCLIST_GET_CLASS (clist)->cell_size_request
 	(clist, GTK_CMCLIST_ROW (list), column, &requisition);
       width = MAX (width, requisition.width);
     }
@@ -2344,6 +2350,7 @@ gtk_cmclist_get_cell_type (GtkCMCList *clist,
     return -1;
 
   clist_row = ROW_ELEMENT (clist, row)->data;
+  gtk_cmclist_format_row (clist, clist_row);
 
   return clist_row->cell[column].type;
 }
@@ -2393,6 +2400,7 @@ gtk_cmclist_get_text (GtkCMCList  *clist,
     return 0;
 
   clist_row = ROW_ELEMENT (clist, row)->data;
+  gtk_cmclist_format_row (clist, clist_row);
 
   if (clist_row->cell[column].type != GTK_CMCELL_TEXT)
     return 0;
@@ -2510,6 +2518,7 @@ gtk_cmclist_get_pixtext (GtkCMCList   *clist,
     return 0;
 
   clist_row = ROW_ELEMENT (clist, row)->data;
+  gtk_cmclist_format_row (clist, clist_row);
 
   if (clist_row->cell[column].type != GTK_CMCELL_PIXTEXT)
     return 0;
@@ -5795,6 +5804,8 @@ draw_row (GtkCMCList     *clist,
   if (!clist_row)
     clist_row = ROW_ELEMENT (clist, row)->data;
 
+  gtk_cmclist_format_row (clist, clist_row);
+
   style = clist_row->style ? clist_row->style : gtk_widget_get_style (widget);
 
   /* rectangle of the entire row */
@@ -6477,6 +6488,8 @@ row_new (GtkCMCList *clist)
   clist_row->state = GTK_STATE_NORMAL;
   clist_row->data = NULL;
   clist_row->destroy = NULL;
+  clist_row->format_link = NULL;
+  clist_row->unformatted = FALSE;
 
   return clist_row;
 }
@@ -6487,6 +6500,9 @@ row_delete (GtkCMCList    *clist,
 {
   gint i;
 
+  if (clist_row->format_link)
+    g_queue_delete_link (&clist->formatted_rows, clist_row->format_link);
+
   for (i = 0; i < clist->columns; i++)
     {
       GTK_CMCLIST_GET_CLASS (clist)->set_cell_contents
@@ -7262,6 +7278,120 @@ gtk_cmclist_set_compare_func (GtkCMCList            *clist,
   clist->compare = (cmp_func) ? cmp_func : default_compare;
 }
 
+void
+gtk_cmclist_set_row_format_func (GtkCMCList              *clist,
+			       GtkCMCListRowFormatFunc  func,
+			       gpointer                 data,
+			       guint                    cache_size)
+{
+  cm_return_if_fail (GTK_IS_CMCLIST (clist));
+
+  clist->format_func = func;
+  clist->format_data = data;
+  clist->format_cache_size = MAX (cache_size, 1);
+}
+
+static void
+row_drop_text (GtkCMCList    *clist,
+	       GtkCMCListRow *clist_row)
+{
+  gint i;
+
+  for (i = 0; i < clist->columns; i++)
+    switch (clist_row->cell[i].type)
+      {
+      case GTK_CMCELL_TEXT:
+	g_free (GTK_CMCELL_TEXT (clist_row->cell[i])->text);
+	clist_row->cell[i].type = GTK_CMCELL_EMPTY;
+	break;
+      case GTK_CMCELL_PIXTEXT:
+	/* keep the pixbuf, as the tree column always has one */
+	g_free (GTK_CMCELL_PIXTEXT (clist_row->cell[i])->text);
+	GTK_CMCELL_PIXTEXT (clist_row->cell[i])->text = NULL;
+	break;
+      default:
+	break;
+      }
+}
+
+void
+gtk_cmclist_unformat_row (GtkCMCList    *clist,
+			GtkCMCListRow *clist_row)
+{
+  cm_return_if_fail (GTK_IS_CMCLIST (clist));
+  cm_return_if_fail (clist_row != NULL);
+
+  if (clist_row->format_link)
+    {
+      g_queue_delete_link (&clist->formatted_rows, clist_row->format_link);
+      clist_row->format_link = NULL;
+    }
+  row_drop_text (clist, clist_row);
+  clist_row->unformatted = TRUE;
+}
+
+void
+gtk_cmclist_format_row (GtkCMCList    *clist,
+		      GtkCMCListRow *clist_row)
+{
+  GtkCMCListRow *old_row;
+
+  if (!clist->format_func || !clist_row)
+    return;
+
+  if (clist_row->format_link)
+    {
+      /* the most recently used row goes last */
+      g_queue_unlink (&clist->formatted_rows, clist_row->format_link);
+      g_queue_push_tail_link (&clist->formatted_rows, clist_row->format_link);
+      return;
+    }
+  if (!clist_row->unformatted)
+    return;
+
+  clist_row->unformatted = FALSE;
+  clist->format_func (clist, clist_row, clist->format_data);
+  g_queue_push_tail (&clist->formatted_rows, clist_row);
+  clist_row->format_link = g_queue_peek_tail_link (&clist->formatted_rows);
+
+  while (g_queue_get_length (&clist->formatted_rows) > clist->format_cache_size)
+    {
+      old_row = g_queue_pop_head (&clist->formatted_rows);
+      old_row->format_link = NULL;
+      row_drop_text (clist, old_row);
+      old_row->unformatted = TRUE;
+    }
+}
+
+void
+gtk_cmclist_row_set_text (GtkCMCList    *clist,
+			GtkCMCListRow *clist_row,
+			gint           column,
+			const gchar   *text)
+{
+  GtkCMCell *cell;
+  GdkPixbuf *pixbuf;
+
+  cm_return_if_fail (GTK_IS_CMCLIST (clist));
+  cm_return_if_fail (clist_row != NULL);
+
+  if (column < 0 || column >= clist->columns)
+    return;
+
+  cell = &clist_row->cell[column];
+  if (cell->type == GTK_CMCELL_PIXTEXT)
+    {
+      pixbuf = GTK_CMCELL_PIXTEXT (*cell)->pixbuf;
+      GTK_CMCLIST_GET_CLASS (clist)->set_cell_contents
+	(clist, clist_row, column, GTK_CMCELL_PIXTEXT, text,
+	 GTK_CMCELL_PIXTEXT (*cell)->spacing,
+	 pixbuf ? g_object_ref (pixbuf) : NULL);
+    }
+  else
+    GTK_CMCLIST_GET_CLASS (clist)->set_cell_contents
+      (clist, clist_row, column, GTK_CMCELL_TEXT, text, 0, NULL);
+}
+
 void       
 gtk_cmclist_set_auto_sort (GtkCMCList *clist,
 			 gboolean  auto_sort)
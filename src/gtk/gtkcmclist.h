@@ -132,6 +132,10 @@ typedef gint (*GtkCMCListCompareFunc) (GtkCMCList     *clist,
 				     gconstpointer ptr1,
 				     gconstpointer ptr2);
 
+typedef void (*GtkCMCListRowFormatFunc) (GtkCMCList     *clist,
+				       GtkCMCListRow  *clist_row,
+				       gpointer        data);
+
 typedef struct _GtkCMCListCellInfo GtkCMCListCellInfo;
 typedef struct _GtkCMCListDestInfo GtkCMCListDestInfo;
 
@@ -237,6 +241,13 @@ struct _GtkCMCList
 
   gint drag_highlight_row;
   GtkCMCListDragPos drag_highlight_pos;
+
+  /* rows whose text is set when they are first needed, the formatted
+   * ones in least recently used order */
+  GtkCMCListRowFormatFunc format_func;
+  gpointer format_data;
+  guint format_cache_size;
+  GQueue formatted_rows;
 };
 
 struct _GtkCMCListClass
@@ -347,10 +358,14 @@ struct _GtkCMCListRow
 
   gpointer data;
   GDestroyNotify destroy;
+
+  /* link in the formatted_rows of the list */
+  GList *format_link;
   
   guint fg_set     : 1;
   guint bg_set     : 1;
   guint selectable : 1;
+  guint unformatted : 1;
 };
 
 /* Cell Structures */
@@ -769,6 +784,28 @@ void gtk_cmclist_sort (GtkCMCList *clist);
 void gtk_cmclist_set_auto_sort (GtkCMCList *clist,
 			      gboolean  auto_sort);
 
+/* sets the function giving their text to the rows marked with
+ * gtk_cmclist_unformat_row(), called when a row is first drawn or
+ * queried; only the cache_size most recently used rows keep it */
+void gtk_cmclist_set_row_format_func (GtkCMCList              *clist,
+				    GtkCMCListRowFormatFunc  func,
+				    gpointer                 data,
+				    guint                    cache_size);
+
+/* drops the text of a row, to be set again by the format function */
+void gtk_cmclist_unformat_row (GtkCMCList    *clist,
+			     GtkCMCListRow *clist_row);
+
+/* makes sure a row has its text */
+void gtk_cmclist_format_row (GtkCMCList    *clist,
+			   GtkCMCListRow *clist_row);
+
+/* sets the text of a cell without redrawing, for format functions */
+void gtk_cmclist_row_set_text (GtkCMCList    *clist,
+			     GtkCMCListRow *clist_row,
+			     gint           column,
+			     const gchar   *text);
+
 /* Private function for clist, ctree */
 
 PangoLayout *_gtk_cmclist_create_cell_layout (GtkCMCList       *clist,
@@ -609,6 +609,8 @@ draw_row (GtkCMCList     *clist,
   if (!clist_row)
     clist_row = (g_list_nth (clist->row_list, row))->data;
 
+  gtk_cmclist_format_row (clist, clist_row);
+
   style = clist_row->style ? clist_row->style : gtk_widget_get_style (widget);
 
   if (greybg.pixel == 0 &&
@@ -2560,6 +2562,8 @@ row_new (GtkCMCTree *ctree)
   ctree_row->row.state      = GTK_STATE_NORMAL;
   ctree_row->row.data       = NULL;
   ctree_row->row.destroy    = NULL;
+  ctree_row->row.format_link = NULL;
+  ctree_row->row.unformatted = FALSE;
 
   ctree_row->level         = 0;
   ctree_row->expanded      = FALSE;
@@ -2581,6 +2585,9 @@ row_delete (GtkCMCTree    *ctree,
 
   clist = GTK_CMCLIST (ctree);
 
+  if (ctree_row->row.format_link)
+    g_queue_delete_link (&clist->formatted_rows, ctree_row->row.format_link);
+
   for (i = 0; i < clist->columns; i++)
     {
       GTK_CMCLIST_GET_CLASS (clist)->set_cell_contents
@@ -4182,6 +4189,8 @@ gtk_cmctree_node_get_cell_type (GtkCMCTree     *ctree,
   if (column < 0 || column >= GTK_CMCLIST (ctree)->columns)
     return -1;
 
+  gtk_cmclist_format_row (GTK_CMCLIST (ctree), &GTK_CMCTREE_ROW (node)->row);
+
   return GTK_CMCTREE_ROW (node)->row.cell[column].type;
 }
 
@@ -4197,6 +4206,8 @@ gtk_cmctree_node_get_text (GtkCMCTree      *ctree,
   if (column < 0 || column >= GTK_CMCLIST (ctree)->columns)
     return FALSE;
 
+  gtk_cmclist_format_row (GTK_CMCLIST (ctree), &GTK_CMCTREE_ROW (node)->row);
+
   if (GTK_CMCTREE_ROW (node)->row.cell[column].type != GTK_CMCELL_TEXT)
     return FALSE;
 
@@ -4241,6 +4252,8 @@ gtk_cmctree_node_get_pixtext (GtkCMCTree      *ctree,
   if (column < 0 || column >= GTK_CMCLIST (ctree)->columns)
     return FALSE;
   
+  gtk_cmclist_format_row (GTK_CMCLIST (ctree), &GTK_CMCTREE_ROW (node)->row);
+
   if (GTK_CMCTREE_ROW (node)->row.cell[column].type != GTK_CMCELL_PIXTEXT)
     return FALSE;
   
@@ -4270,8 +4283,12 @@ gtk_cmctree_get_node_info (GtkCMCTree      *ctree,
   cm_return_val_if_fail (node != NULL, FALSE);
   
   if (text)
-    *text = GTK_CMCELL_PIXTEXT 
-      (GTK_CMCTREE_ROW (node)->row.cell[ctree->tree_column])->text;
+    {
+      gtk_cmclist_format_row (GTK_CMCLIST (ctree),
+			    &GTK_CMCTREE_ROW (node)->row);
+      *text = GTK_CMCELL_PIXTEXT 
+	(GTK_CMCTREE_ROW (node)->row.cell[ctree->tree_column])->text;
+    }
   if (spacing)
     *spacing = GTK_CMCELL_PIXTEXT 
       (GTK_CMCTREE_ROW (node)->row.cell[ctree->tree_column])->spacing;
@@ -1607,6 +1607,8 @@ srow_new (GtkCMCTree *ctree)
   ctree_row->row.state      = GTK_STATE_NORMAL;
   ctree_row->row.data       = NULL;
   ctree_row->row.destroy    = NULL;
+  ctree_row->row.format_link = NULL;
+  ctree_row->row.unformatted = FALSE;
 
   ctree_row->level         = 0;
   ctree_row->expanded      = FALSE;
@@ -1628,6 +1630,9 @@ srow_delete (GtkCMCTree    *ctree,
 
   clist = GTK_CMCLIST (ctree);
 
+  if (ctree_row->row.format_link)
+    g_queue_delete_link (&clist->formatted_rows, ctree_row->row.format_link);
+
   for (i = 0; i < clist->columns; i++)
     {
       GTK_CMCLIST_GET_CLASS (clist)->set_cell_contents
@@ -0,0 +1,220 @@
+/*
+ * Claws Mail -- a GTK+ based, lightweight, and fast e-mail client
+ * Copyright (C) 1999-2026 Hiroyuki Yamamoto and the Claws Mail team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#include "claws-features.h"
+#endif
+
+#include <glib.h>
+#include <string.h>
+
+#include "headerblock.h"
+
+HeaderEntry header_block_entries[] = {
+				   {"Date:",		NULL, FALSE},
+				   {"From:",		NULL, TRUE},
+				   {"To:",		NULL, TRUE},
+				   {"Cc:",		NULL, TRUE},
+				   {"Newsgroups:",	NULL, TRUE},
+				   {"Subject:",		NULL, TRUE},
+				   {"Message-ID:",	NULL, FALSE},
+				   {"References:",	NULL, FALSE},
+				   {"In-Reply-To:",	NULL, FALSE},
+				   {"Content-Type:",	NULL, FALSE},
+				   {"Seen:",		NULL, FALSE},
+				   {"Status:",          NULL, FALSE},
+				   {"From ",		NULL, FALSE},
+				   {"SC-Marked-For-Download:", NULL, FALSE},
+				   {"SC-Message-Size:", NULL, FALSE},
+				   {"Face:",		NULL, FALSE},
+				   {"X-Face:",		NULL, FALSE},
+				   {"Disposition-Notification-To:", NULL, FALSE},
+				   {"Return-Receipt-To:", NULL, FALSE},
+				   {"SC-Partially-Retrieved:", NULL, FALSE},
+				   {"SC-Account-Server:", NULL, FALSE},
+				   {"SC-Account-Login:",NULL, FALSE},
+				   {"List-Post:",	NULL, TRUE},
+				   {"List-Subscribe:",	NULL, TRUE},
+				   {"List-Unsubscribe:",NULL, TRUE},
+				   {"List-Help:",	NULL, TRUE},
+ 				   {"List-Archive:",	NULL, TRUE},
+ 				   {"List-Owner:",	NULL, TRUE},
+ 				   {"Resent-From:",	NULL, TRUE},
+				   {NULL,		NULL, FALSE}};
+
+/* Perfect hash of the names in header_block_entries, "From " aside,
+ * lowercased: their length, first and last two characters give each a
+ * slot of its own in header_hash_slots. */
+static gint header_name_hash(const gchar *name, gsize len)
+{
+	return (len + (guchar)g_ascii_tolower(name[0])
+		+ 14 * (guchar)g_ascii_tolower(name[len - 2])
+		+ 4 * (guchar)g_ascii_tolower(name[len - 1])) & 63;
+}
+
+/* header_block_entries index + 1 of the header hashing to each slot */
+static const guint8 header_hash_slots[64] = {
+	[0]  = H_LIST_ARCHIVE + 1,
+	[2]  = H_SC_MESSAGE_SIZE + 1,
+	[3]  = H_RESENT_FROM + 1,
+	[4]  = H_LIST_OWNER + 1,
+	[5]  = H_MSG_ID + 1,
+	[8]  = H_IN_REPLY_TO + 1,
+	[10] = H_TO + 1,
+	[14] = H_REFERENCES + 1,
+	[15] = H_LIST_POST + 1,
+	[18] = H_SC_ACCOUNT_SERVER + 1,
+	[19] = H_DISPOSITION_NOTIFICATION_TO + 1,
+	[20] = H_DATE + 1,
+	[23] = H_RETURN_RECEIPT_TO + 1,
+	[27] = H_CC + 1,
+	[29] = H_LIST_HELP + 1,
+	[31] = H_SC_PARTIALLY_RETRIEVED + 1,
+	[35] = H_CONTENT_TYPE + 1,
+	[36] = H_NEWSGROUPS + 1,
+	[39] = H_SC_PLANNED_DOWNLOAD + 1,
+	[40] = H_FACE + 1,
+	[42] = H_LIST_SUBSCRIBE + 1,
+	[43] = H_STATUS + 1,
+	[44] = H_LIST_UNSUBSCRIBE + 1,
+	[48] = H_FROM + 1,
+	[52] = H_SUBJECT + 1,
+	[53] = H_SEEN + 1,
+	[57] = H_SC_ACCOUNT_LOGIN + 1,
+	[60] = H_X_FACE + 1,
+};
+
+/* Returns the header_block_entries index of the header named @name
+ * (@len bytes, without the colon), or -1 if it's not one of them. */
+gint header_block_lookup_name(const gchar *name, gsize len)
+{
+	gint hnum;
+
+	if (len < 2)
+		return -1;
+
+	hnum = header_hash_slots[header_name_hash(name, len)] - 1;
+	if (hnum < 0 || strlen(header_block_entries[hnum].name) != len + 1 ||
+	    g_ascii_strncasecmp(header_block_entries[hnum].name, name, len) != 0)
+		return -1;
+
+	return hnum;
+}
+
+/* Returns the end of the line starting at @p, that is its CR or LF (a
+ * lone CR ends a line too, as in fgets_crlf()), or @end. */
+static gchar *header_line_end(gchar *p, gchar *end)
+{
+	gchar *nl, *cr;
+
+	nl = memchr(p, '\n', end - p);
+	if (nl == NULL)
+		nl = end;
+	cr = memchr(p, '\r', nl - p);
+
+	return cr != NULL ? cr : nl;
+}
+
+gchar *header_block_next_line(gchar *eol, gchar *end)
+{
+	if (eol < end && *eol == '\r')
+		eol++;
+	if (eol < end && *eol == '\n')
+		eol++;
+
+	return eol;
+}
+
+/* Looks for the empty line closing the header block in the @len bytes
+ * of @buf, from offset *@scanned. Returns TRUE if found, with *@scanned
+ * at its start; otherwise *@scanned is left at the first line which may
+ * go on after @len, unless @complete. */
+gboolean header_block_find_end(gchar *buf, gsize len, gsize *scanned,
+			       gboolean complete)
+{
+	gchar *end = buf + len;
+	gchar *p, *eol;
+
+	while (*scanned < len) {
+		p = buf + *scanned;
+		eol = header_line_end(p, end);
+		if (eol == p)
+			return TRUE;
+		/* the line or its CRLF may be cut */
+		if (!complete && eol + 1 >= end)
+			return FALSE;
+		*scanned = header_block_next_line(eol, end) - buf;
+	}
+
+	return FALSE;
+}
+
+/* Returns the header_block_entries index of the next header of interest
+ * in the block at *@pos, pointing *@value at its body, unfolded in place
+ * like procheader_get_one_field() does, or -1 at @end. */
+gint header_block_next_field(gchar **pos, gchar *end, gboolean full,
+			     gchar **value)
+{
+	gchar *p = *pos;
+	gchar *line, *eol, *next_eol, *colon, *body, *w;
+	gint hnum;
+
+	while (p < end) {
+		line = p;
+		eol = header_line_end(line, end);
+		p = header_block_next_line(eol, end);
+
+		/* continuation of a header we don't want */
+		if (*line == ' ' || *line == '\t')
+			continue;
+
+		hnum = -1;
+		body = NULL;
+		if (!g_ascii_strncasecmp(line, "From ", 5)) {
+			hnum = H_FROM_SPACE;
+			body = line + 5;
+		} else if ((colon = memchr(line, ':', eol - line)) != NULL &&
+			   (hnum = header_block_lookup_name(line, colon - line)) >= 0)
+			body = colon + 1;
+		/* the short list stops at SC-Message-Size */
+		if (hnum < 0 || (!full && hnum > H_SC_MESSAGE_SIZE))
+			continue;
+
+		w = eol;
+		while (p < end && (*p == ' ' || *p == '\t')) {
+			next_eol = header_line_end(p, end);
+			if (!header_block_entries[hnum].unfold)
+				*w++ = '\n';
+			*p = ' ';
+			memmove(w, p, next_eol - p);
+			w += next_eol - p;
+			p = header_block_next_line(next_eol, end);
+		}
+		*w = '\0';
+
+		while (*body == ' ' || *body == '\t')
+			body++;
+		*pos = p;
+		*value = body;
+		return hnum;
+	}
+
+	*pos = p;
+	return -1;
+}
@@ -0,0 +1,77 @@
+/*
+ * Claws Mail -- a GTK+ based, lightweight, and fast e-mail client
+ * Copyright (C) 1999-2026 Hiroyuki Yamamoto and the Claws Mail team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HEADERBLOCK_H__
+#define __HEADERBLOCK_H__
+
+#include <glib.h>
+
+#include "procheader.h"
+
+/* The headers procheader_parse_*() keep, and the scanner splitting a
+ * header block read at once into them, in place. */
+
+enum
+{
+	H_DATE = 0,
+	H_FROM,
+	H_TO,
+	H_CC,
+	H_NEWSGROUPS,
+	H_SUBJECT,
+	H_MSG_ID,
+	H_REFERENCES,
+	H_IN_REPLY_TO,
+	H_CONTENT_TYPE,
+	H_SEEN,
+	H_STATUS,
+	H_FROM_SPACE,
+	H_SC_PLANNED_DOWNLOAD,
+	H_SC_MESSAGE_SIZE,
+	H_FACE,
+	H_X_FACE,
+	H_DISPOSITION_NOTIFICATION_TO,
+	H_RETURN_RECEIPT_TO,
+	H_SC_PARTIALLY_RETRIEVED,
+	H_SC_ACCOUNT_SERVER,
+	H_SC_ACCOUNT_LOGIN,
+	H_LIST_POST,
+	H_LIST_SUBSCRIBE,
+	H_LIST_UNSUBSCRIBE,
+	H_LIST_HELP,
+	H_LIST_ARCHIVE,
+	H_LIST_OWNER,
+	H_RESENT_FROM,
+};
+
+extern HeaderEntry header_block_entries[];
+
+gint header_block_lookup_name	(const gchar	*name,
+				 gsize		 len);
+gchar *header_block_next_line	(gchar		*eol,
+				 gchar		*end);
+gboolean header_block_find_end	(gchar		*buf,
+				 gsize		 len,
+				 gsize		*scanned,
+				 gboolean	 complete);
+gint header_block_next_field	(gchar		**pos,
+				 gchar		*end,
+				 gboolean	 full,
+				 gchar		**value);
+
+#endif /* __HEADERBLOCK_H__ */
@@ -67,6 +67,7 @@
 #include "statusbar.h"
 #include "msgcache.h"
 #include "imap-thread.h"
+#include "imap-uidset.h"
 #include "account.h"
 #include "tags.h"
 #include "main.h"
@@ -95,6 +96,17 @@ struct _IMAPFolder
 	guint max_set_size;
 	gchar *search_charset;
 	gboolean search_charset_supported;
+	/* IDLE watch on the Inbox */
+	time_t idle_last_start;
+	guint idle_scan_tag;
+	/* imap_cache_msgs() requests running in the pool */
+	GSList *cache_requests;
+	/* changed folders whose new envelopes are fetched in the background */
+	GSList *prefetch_queue;
+	guint prefetch_tag;
+	/* the folder whose envelopes are being fetched, if any */
+	FolderItem *prefetch_item;
+	gboolean prefetching;
 };
 
 struct _IMAPSession
@@ -117,6 +129,14 @@ struct _IMAPSession
 	guint unseen;
 	guint uid_validity;
 	guint uid_next;
+	/* HIGHESTMODSEQ of the selected mailbox, 0 without CONDSTORE */
+	guint64 highestmodseq;
+	gboolean qresync;
+	/* authentication that succeeded, reused by the extra connections */
+	const gchar *auth_type;
+	gboolean pool_set_up;
+	/* an asynchronous NOOP from imap_ping() is queued */
+	gboolean ping_pending;
 
 	Folder * folder;
 	gboolean busy;
@@ -133,6 +153,13 @@ struct _IMAPNameSpace
 
 #define IMAPBUFSIZE	8192
 
+/* seconds before a failed IDLE connection is tried again */
+#define IMAP_IDLE_RETRY_DELAY	300
+/* milliseconds to gather IDLE notifications before scanning */
+#define IMAP_IDLE_SCAN_DELAY	500
+/* milliseconds between two folders prefetched in the background */
+#define IMAP_PREFETCH_DELAY	2000
+
 #define IMAP_IS_SEEN(flags)	((flags & IMAP_FLAG_SEEN) != 0)
 #define IMAP_IS_ANSWERED(flags)	((flags & IMAP_FLAG_ANSWERED) != 0)
 #define IMAP_IS_FLAGGED(flags)	((flags & IMAP_FLAG_FLAGGED) != 0)
@@ -162,7 +189,7 @@ struct _IMAPFolderItem
 
 	guint lastuid;
 	guint uid_next;
-	GSList *uid_list;
+	IMAPUidSet *uid_set;
 	gboolean batching;
 
 	GHashTable *flags_set_table;
@@ -177,6 +204,17 @@ struct _IMAPFolderItem
 	GHashTable *tags_unset_table;
 	GSList *ok_flags;
 
+	/* mod-sequence the cached UIDs and flags are up to date with */
+	guint64 highestmodseq;
+	/* changes fetched by get_num_list, for the following get_flags */
+	guint64 resync_modseq;
+	GHashTable *changed_flags;
+	GHashTable *changed_tags;
+
+	/* MsgInfos of new messages fetched in the background, by UID,
+	 * for imap_get_msginfos(); valid for prefetched_uid_validity */
+	GHashTable *prefetched;
+	guint32 prefetched_uid_validity;
 };
 
 static XMLTag *imap_item_get_xml(Folder *folder, FolderItem *item);
@@ -223,6 +261,10 @@ static gint 	imap_copy_msgs		(Folder 	*folder,
 					 FolderItem 	*dest, 
 		    			 MsgInfoList 	*msglist, 
 					 GHashTable 	*relation);
+static gint 	imap_move_msgs		(Folder 	*folder, 
+					 FolderItem 	*dest, 
+		    			 MsgInfoList 	*msglist, 
+					 GHashTable 	*relation);
 
 static gint	search_msgs		(Folder			*folder,
 					 FolderItem		*container,
@@ -289,7 +331,8 @@ static gint imap_do_copy_msgs		(Folder		*folder,
 					 FolderItem	*dest,
 					 MsgInfoList	*msglist,
 					 GHashTable	*relation,
-					 gboolean	 same_dest_ok);
+					 gboolean	 same_dest_ok,
+					 gboolean	 move);
 
 static gint imap_do_remove_msgs		(Folder		*folder,
 					 FolderItem	*dest,
@@ -306,6 +349,12 @@ static gint imap_set_message_flags	(IMAPSession	*session,
 					 IMAPFlags	 flags,
 					 GSList		*tags,
 					 gboolean	 is_set);
+static gint imap_set_message_flags_uids	(IMAPSession	*session,
+					 IMAPFolderItem *item,
+					 IMAPUidSet	*uids,
+					 IMAPFlags	 flags,
+					 GSList		*tags,
+					 gboolean	 is_set);
 static gint imap_select			(IMAPSession	*session,
 					 IMAPFolder	*folder,
 					 FolderItem	*item,
@@ -339,6 +388,8 @@ static gchar *imap_get_real_path		(IMAPSession	*session,
 						 gint		*ok);
 #ifdef HAVE_LIBETPAN
 static void imap_synchronise		(FolderItem	*item, gint days);
+static void imap_cache_requests_forget	(Folder		*folder,
+					 FolderItem	*item);
 #endif
 static gboolean imap_is_busy		(Folder *folder);
 
@@ -350,6 +401,8 @@ static gint imap_cmd_login	(IMAPSession	*session,
 				 const gchar	*pass,
 				 const gchar 	*type);
 static gint imap_cmd_noop	(IMAPSession	*session);
+static void imap_noop_update	(IMAPSession	*session,
+				 const IMAPNoopInfo *info);
 #ifdef USE_GNUTLS
 static gint imap_cmd_starttls	(IMAPSession	*session);
 #endif
@@ -393,6 +446,11 @@ static gint imap_cmd_copy       (IMAPSession *session,
 				 const gchar *destfolder,
 				 struct mailimap_set ** source,
 				 struct mailimap_set ** dest);
+static gint imap_cmd_move       (IMAPSession *session,
+				 struct mailimap_set * set,
+				 const gchar *destfolder,
+				 struct mailimap_set ** source,
+				 struct mailimap_set ** dest);
 static gint imap_cmd_store	(IMAPSession	*session,
 			   	 IMAPFolderItem *item,
 				 struct mailimap_set * set,
@@ -400,6 +458,8 @@ static gint imap_cmd_store	(IMAPSession	*session,
 				 GSList *tags,
 				 int do_add);
 static gint imap_cmd_expunge	(IMAPSession	*session);
+static gint imap_cmd_uid_expunge(IMAPSession	*session,
+				 struct mailimap_set * set);
 
 static void imap_path_separator_subst		(gchar		*str,
 						 gchar		 separator);
@@ -436,18 +496,20 @@ static GSList * imap_list_from_lep(IMAPFolder * folder,
 				   clist * list, const gchar * real_path, gboolean all);
 static GSList * imap_get_lep_set_from_numlist(IMAPFolder *folder, MsgNumberList *numlist);
 static GSList * imap_get_lep_set_from_msglist(IMAPFolder *folder, MsgInfoList *msglist);
-static GSList * imap_uid_list_from_lep(clist * list, gint* length);
-static GSList * imap_uid_list_from_lep_tab(carray * list);
+static IMAPUidSet * imap_uid_set_from_lep_tab(carray * list);
 static void imap_flags_hash_from_lep_uid_flags_tab(carray * list,
 						   GHashTable * hash,
 						   GHashTable *tags_hash);
 static MsgInfo *imap_envelope_from_lep(struct imap_fetch_env_info * info,
 				       FolderItem *item);
+static MsgInfo *imap_msginfo_from_env(struct imap_fetch_env_info *info,
+				      GSList *tags, FolderItem *item,
+				      gboolean *got_alien_tags);
 static void imap_lep_set_free(GSList *seq_list);
 static struct mailimap_flag_list * imap_flag_to_lep(IMAPFolderItem *item, IMAPFlags flags, GSList *tags);
 
 typedef struct _hashtable_data {
-	GSList *msglist;
+	IMAPUidSet *uids;
 	IMAPFolderItem *item;
 } hashtable_data;
 
@@ -491,6 +553,7 @@ FolderClass *imap_get_class(void)
 		imap_class.add_msgs = imap_add_msgs;
 		imap_class.copy_msg = imap_copy_msg;
 		imap_class.copy_msgs = imap_copy_msgs;
+		imap_class.move_msgs = imap_move_msgs;
 		imap_class.search_msgs = search_msgs;
 		imap_class.remove_msg = imap_remove_msg;
 		imap_class.remove_msgs = imap_remove_msgs;
@@ -545,22 +608,43 @@ static void unlock_session(IMAPSession *session)
 	}
 }
 
+static void imap_ping_done(Folder *folder, int error,
+			   const IMAPNoopInfo *info, void *data)
+{
+	IMAPSession *session = (IMAPSession *)data;
+
+	/* the session may have been replaced meanwhile */
+	if (REMOTE_FOLDER(folder)->session != SESSION(session))
+		return;
+
+	session->ping_pending = FALSE;
+	if (error != MAILIMAP_NO_ERROR) {
+		debug_print("noop err %d\n", error);
+		session_register_ping(SESSION(session), NULL);
+		imap_handle_error(SESSION(session), NULL, error);
+		return;
+	}
+	imap_noop_update(session, info);
+}
+
+/* The NOOP is queued without waiting for it, so that the main loop isn't
+ * re-entered from this timeout. */
 static gboolean imap_ping(gpointer data)
 {
 	Session *session = (Session *)data;
 	IMAPSession *imap_session = IMAP_SESSION(session);
-	int r;
 
 	if (session->state != SESSION_READY)
 		return FALSE;
-	if (imap_session->busy || !imap_session->authenticated)
+	if (imap_session->busy || imap_session->ping_pending ||
+	    !imap_session->authenticated)
 		return TRUE;
 	
-	lock_session(imap_session);
-	r = imap_cmd_noop(imap_session);
-	unlock_session(imap_session);
+	imap_session->ping_pending = TRUE;
+	imap_threaded_noop_async(imap_session->folder, imap_ping_done,
+				 imap_session);
 
-	return r == MAILIMAP_NO_ERROR;
+	return TRUE;
 }
 
 static void imap_disc_session_destroy(IMAPSession *session)
@@ -766,6 +850,14 @@ static Folder *imap_folder_new(const gchar *name, const gchar *path)
 
 static void imap_folder_destroy(Folder *folder)
 {
+	imap_threaded_idle_stop(folder, TRUE);
+	imap_threaded_pool_stop(folder, TRUE);
+	if (IMAP_FOLDER(folder)->idle_scan_tag != 0)
+		g_source_remove(IMAP_FOLDER(folder)->idle_scan_tag);
+	if (IMAP_FOLDER(folder)->prefetch_tag != 0)
+		g_source_remove(IMAP_FOLDER(folder)->prefetch_tag);
+	g_slist_free(IMAP_FOLDER(folder)->prefetch_queue);
+
 	while (imap_folder_get_refcnt(folder) > 0)
 		gtk_main_iteration();
 
@@ -791,17 +883,60 @@ static FolderItem *imap_folder_item_new(Folder *folder)
 	item = g_new0(IMAPFolderItem, 1);
 	item->lastuid = 0;
 	item->uid_next = 0;
-	item->uid_list = NULL;
+	item->uid_set = NULL;
 
 	return (FolderItem *)item;
 }
 
+static void imap_tags_hash_free_func(gpointer key, gpointer value, gpointer data)
+{
+	slist_free_strings_full((GSList *)value);
+}
+
+static void imap_tags_hash_destroy(GHashTable *tags_hash)
+{
+	g_hash_table_foreach(tags_hash, imap_tags_hash_free_func, NULL);
+	g_hash_table_destroy(tags_hash);
+}
+
+static void imap_prefetched_free_func(gpointer data)
+{
+	MsgInfo *msginfo = (MsgInfo *)data;
+
+	procmsg_msginfo_free(&msginfo);
+}
+
+static void imap_prefetched_forget(IMAPFolderItem *item)
+{
+	if (item->prefetched != NULL)
+		g_hash_table_destroy(item->prefetched);
+	item->prefetched = NULL;
+}
+
+static void imap_folder_item_forget_changes(IMAPFolderItem *item)
+{
+	if (item->changed_flags != NULL)
+		g_hash_table_destroy(item->changed_flags);
+	if (item->changed_tags != NULL)
+		imap_tags_hash_destroy(item->changed_tags);
+	item->changed_flags = NULL;
+	item->changed_tags = NULL;
+	item->resync_modseq = 0;
+}
+
 static void imap_folder_item_destroy(Folder *folder, FolderItem *_item)
 {
 	IMAPFolderItem *item = (IMAPFolderItem *)_item;
 
 	g_return_if_fail(item != NULL);
-	g_slist_free(item->uid_list);
+	imap_uid_set_free(item->uid_set);
+	imap_folder_item_forget_changes(item);
+	imap_cache_requests_forget(folder, _item);
+	IMAP_FOLDER(folder)->prefetch_queue =
+		g_slist_remove(IMAP_FOLDER(folder)->prefetch_queue, _item);
+	if (IMAP_FOLDER(folder)->prefetch_item == _item)
+		IMAP_FOLDER(folder)->prefetch_item = NULL;
+	imap_prefetched_forget(item);
 
 	g_free(_item);
 }
@@ -811,8 +946,9 @@ static gboolean imap_reset_uid_lists_func(GNode *node, gpointer data)
 	IMAPFolderItem *item = (IMAPFolderItem *)node->data;
 	
 	item->lastuid = 0;
-	g_slist_free(item->uid_list);
-	item->uid_list = NULL;
+	imap_uid_set_free(item->uid_set);
+	item->uid_set = NULL;
+	imap_folder_item_forget_changes(item);
 	
 	return FALSE;
 }
@@ -870,6 +1006,46 @@ static gboolean imap_has_capability(IMAPSession *session, const gchar *cap)
 	return FALSE;
 }
 
+/* QRESYNC implies CONDSTORE (RFC 7162) */
+static gboolean imap_has_condstore(IMAPSession *session)
+{
+	return imap_has_capability(session, "CONDSTORE") ||
+	       imap_has_capability(session, "QRESYNC");
+}
+
+static void imap_enable_qresync(IMAPSession *session)
+{
+	session->qresync = FALSE;
+
+	if (!imap_has_capability(session, "QRESYNC"))
+		return;
+
+	if (imap_threaded_enable(session->folder, "QRESYNC") == MAILIMAP_NO_ERROR) {
+		debug_print("QRESYNC enabled\n");
+		session->qresync = TRUE;
+	}
+}
+
+/* COMPRESS=DEFLATE (RFC 4978), once authenticated */
+static void imap_enable_compress(IMAPSession *session)
+{
+	gboolean enabled = FALSE;
+	int r;
+
+	if (!prefs_common.imap_compress)
+		return;
+
+	r = imap_threaded_compress(session->folder, &enabled);
+	if (r != MAILIMAP_NO_ERROR) {
+		imap_handle_error(SESSION(session), NULL, r);
+		debug_print("compress err %d\n", r);
+		return;
+	}
+	if (enabled)
+		log_message(LOG_PROTOCOL, "IMAP compression enabled on %s\n",
+			    SESSION(session)->server);
+}
+
 static gint imap_auth(IMAPSession *session, const gchar *user, const gchar *pass,
 		      IMAPAuthType type)
 {
@@ -1025,6 +1201,254 @@ static IMAPSession *imap_reconnect_if_possible(Folder *folder, IMAPSession *sess
 	return session;
 }
 
+static gboolean imap_idle_scan_func(gpointer data)
+{
+	Folder *folder = (Folder *)data;
+	RemoteFolder *rfolder = REMOTE_FOLDER(folder);
+
+	/* don't scan from within another operation */
+	if (rfolder->session != NULL && IMAP_SESSION(rfolder->session)->busy)
+		return TRUE;
+
+	IMAP_FOLDER(folder)->idle_scan_tag = 0;
+	if (folder->inbox != NULL && !prefs_common.work_offline) {
+		debug_print("IDLE: scanning %s\n", folder->inbox->path);
+		folder_item_scan_full(folder->inbox, TRUE);
+	}
+
+	return FALSE;
+}
+
+static void imap_idle_notify(Folder *folder)
+{
+	if (IMAP_FOLDER(folder)->idle_scan_tag == 0)
+		IMAP_FOLDER(folder)->idle_scan_tag =
+			g_timeout_add(IMAP_IDLE_SCAN_DELAY, imap_idle_scan_func, folder);
+}
+
+static void imap_prefetch_done(Folder *folder, int error,
+			       guint32 uid_validity, carray *env_list,
+			       void *data)
+{
+	IMAPFolder *imap_folder = IMAP_FOLDER(folder);
+	Session *session = REMOTE_FOLDER(folder)->session;
+	FolderItem *item = imap_folder->prefetch_item;
+	IMAPFolderItem *imap_item = (IMAPFolderItem *)item;
+	gboolean got_alien_tags = FALSE;
+	guint i;
+
+	imap_folder->prefetching = FALSE;
+	imap_folder->prefetch_item = NULL;
+
+	if (error != MAILIMAP_NO_ERROR) {
+		debug_print("prefetch err %d\n", error);
+		if (session != NULL && error != MAILIMAP_ERROR_INVAL &&
+		    error != MAILIMAP_ERROR_FETCH)
+			imap_handle_error(session, NULL, error);
+		return;
+	}
+
+	/* gone, opened or checked meanwhile, or renumbered */
+	if (item == NULL || item->opened || !imap_item->should_update ||
+	    uid_validity != item->mtime) {
+		for (i = 1; i < carray_count(env_list); i += 2)
+			slist_free_strings_full(carray_get(env_list, i));
+		imap_fetch_env_free(env_list);
+		return;
+	}
+
+	imap_prefetched_forget(imap_item);
+	imap_item->prefetched = g_hash_table_new_full(g_direct_hash,
+			g_direct_equal, NULL, imap_prefetched_free_func);
+	imap_item->prefetched_uid_validity = uid_validity;
+
+	for (i = 0; i < carray_count(env_list); i += 2) {
+		GSList *tags = carray_get(env_list, i + 1);
+		MsgInfo *msginfo;
+
+		msginfo = imap_msginfo_from_env(carray_get(env_list, i), tags,
+						item, &got_alien_tags);
+		slist_free_strings_full(tags);
+		if (msginfo != NULL)
+			g_hash_table_insert(imap_item->prefetched,
+					    GUINT_TO_POINTER(msginfo->msgnum),
+					    msginfo);
+	}
+	imap_fetch_env_free(env_list);
+
+	if (got_alien_tags) {
+		tags_write_tags();
+		main_window_reflect_tags_changes(mainwindow_get_mainwindow());
+	}
+	debug_print("prefetched %d envelopes of %s\n",
+		    g_hash_table_size(imap_item->prefetched), item->path);
+}
+
+/* Queues the fetch of the envelopes past the last known message of
+ * @item, on the session but without waiting for it. They are kept
+ * for when the folder is scanned, so scanning it doesn't fetch them
+ * then; no message enters the cache, and no filtering runs, before. */
+static void imap_prefetch_start(Folder *folder, FolderItem *item)
+{
+	IMAPFolder *imap_folder = IMAP_FOLDER(folder);
+	Session *session = REMOTE_FOLDER(folder)->session;
+	IMAPSession *imap_session = IMAP_SESSION(session);
+	gchar *real_path;
+	gint ok = MAILIMAP_NO_ERROR;
+
+	if (session == NULL || session->state != SESSION_READY ||
+	    !imap_session->authenticated)
+		return;
+
+	real_path = imap_get_real_path(imap_session, imap_folder, item->path,
+				       &ok);
+	if (ok != MAILIMAP_NO_ERROR) {
+		g_free(real_path);
+		return;
+	}
+
+	/* the next command on the folder has to select it again */
+	g_free(imap_session->mbox);
+	imap_session->mbox = NULL;
+	imap_session->exists = 0;
+	imap_session->recent = 0;
+	imap_session->expunge = 0;
+
+	debug_print("prefetching new envelopes of %s\n", item->path);
+	imap_folder->prefetching = TRUE;
+	imap_folder->prefetch_item = item;
+	imap_threaded_examine_fetch_env_async(folder, real_path,
+			mailimap_set_new_interval(MAX(item->last_num, 0) + 1, 0),
+			imap_prefetch_done, NULL);
+	g_free(real_path);
+}
+
+static gboolean imap_prefetch_func(gpointer data)
+{
+	Folder *folder = (Folder *)data;
+	IMAPFolder *imap_folder = IMAP_FOLDER(folder);
+	RemoteFolder *rfolder = REMOTE_FOLDER(folder);
+	FolderItem *item;
+
+	/* one folder at a time, and the user's own operations first */
+	if (imap_folder->prefetching)
+		return TRUE;
+	if (rfolder->session != NULL && IMAP_SESSION(rfolder->session)->busy)
+		return TRUE;
+
+	if (imap_folder->prefetch_queue == NULL || prefs_common.work_offline) {
+		g_slist_free(imap_folder->prefetch_queue);
+		imap_folder->prefetch_queue = NULL;
+		imap_folder->prefetch_tag = 0;
+		return FALSE;
+	}
+
+	item = (FolderItem *)imap_folder->prefetch_queue->data;
+	imap_folder->prefetch_queue =
+		g_slist_delete_link(imap_folder->prefetch_queue,
+				    imap_folder->prefetch_queue);
+
+	/* opening or checking the folder may have been quicker */
+	if (!item->opened && IMAP_FOLDER_ITEM(item)->should_update)
+		imap_prefetch_start(folder, item);
+
+	if (imap_folder->prefetch_queue == NULL) {
+		imap_folder->prefetch_tag = 0;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* Fetches ahead the envelopes of the new messages of a folder which is
+ * not open, one folder at a time and only when the session is idle, so
+ * that scanning the folder when it is opened doesn't wait for them. */
+static void imap_prefetch_queue(Folder *folder, FolderItem *item)
+{
+	IMAPFolder *imap_folder = IMAP_FOLDER(folder);
+
+	if (g_slist_find(imap_folder->prefetch_queue, item) != NULL)
+		return;
+
+	imap_folder->prefetch_queue =
+		g_slist_append(imap_folder->prefetch_queue, item);
+	if (imap_folder->prefetch_tag == 0)
+		imap_folder->prefetch_tag =
+			g_timeout_add_full(G_PRIORITY_LOW, IMAP_PREFETCH_DELAY,
+					   imap_prefetch_func, folder, NULL);
+}
+
+/* Opens the connections used besides the session: one watching the Inbox
+ * when the server supports IDLE, and the pool downloading messages
+ * (see imap_cache_msgs()). Without them, new mail is found by the
+ * periodic checks and messages are fetched by the session. */
+static void imap_extra_conns_start(Folder *folder, IMAPSession *session)
+{
+	PrefsAccount *account = folder->account;
+	IMAPFolder *ifolder = IMAP_FOLDER(folder);
+	IMAPConnInfo info;
+	gboolean has_idle, want_idle, want_pool;
+	gchar *pass = NULL;
+	gchar *inbox = NULL;
+	gint ok;
+
+	if (session->auth_type == NULL)
+		return;
+#ifndef G_OS_WIN32
+	if (account->set_tunnelcmd)
+		return;
+#endif
+
+	has_idle = prefs_common.imap_idle && account->imap_max_connections > 1 &&
+		   imap_has_capability(session, "IDLE");
+	want_idle = has_idle && folder->inbox != NULL &&
+		    folder->inbox->path != NULL &&
+		    !imap_threaded_idle_running(folder) &&
+		    time(NULL) - ifolder->idle_last_start >= IMAP_IDLE_RETRY_DELAY;
+	want_pool = !session->pool_set_up &&
+		    account->imap_max_connections > (has_idle ? 2 : 1);
+	if (!want_idle && !want_pool)
+		return;
+
+	if (account->imap_auth_type == IMAP_AUTH_ANON ||
+	    account->imap_auth_type == IMAP_AUTH_GSSAPI) {
+		pass = g_strdup("");
+	} else if (!password_get(account->userid, account->recv_server, "imap",
+				 SESSION(session)->port, &pass)) {
+		pass = passwd_store_get_account(account->account_id,
+				PWS_ACCOUNT_RECV);
+		if (pass == NULL)
+			pass = g_strdup(account->session_passwd);
+	}
+	if (pass == NULL)
+		return;
+
+	info.port = SESSION(session)->port;
+	info.proxy_info = SESSION(session)->proxy_info;
+	info.login = account->userid;
+	info.password = pass;
+	info.type = session->auth_type;
+	/* the IDLE connection carries next to nothing */
+	info.compress = FALSE;
+
+	if (want_idle)
+		inbox = imap_get_real_path(session, ifolder, folder->inbox->path, &ok);
+	if (inbox != NULL && ok == MAILIMAP_NO_ERROR) {
+		ifolder->idle_last_start = time(NULL);
+		imap_threaded_idle_start(folder, &info, inbox, imap_idle_notify);
+	}
+	g_free(inbox);
+
+	if (want_pool) {
+		info.compress = prefs_common.imap_compress;
+		imap_threaded_pool_setup(folder, &info,
+			account->imap_max_connections - (has_idle ? 2 : 1));
+		session->pool_set_up = TRUE;
+	}
+
+	memset(pass, 0, strlen(pass));
+	g_free(pass);
+}
+
 static IMAPSession *imap_session_get(Folder *folder)
 {
 	RemoteFolder *rfolder = REMOTE_FOLDER(folder);
@@ -1125,6 +1549,8 @@ new_conn:
 	rfolder->session = SESSION(session);
 	rfolder->connecting = FALSE;
 
+	imap_extra_conns_start(folder, IMAP_SESSION(session));
+
 	return IMAP_SESSION(session);
 }
 
@@ -1352,6 +1778,8 @@ try_again:
 	}
 	statusbar_pop_all();
 	session->authenticated = TRUE;
+	imap_enable_compress(session);
+	imap_enable_qresync(session);
 	return MAILIMAP_NO_ERROR;
 }
 
@@ -1432,7 +1860,7 @@ static void imap_remove_cached_msg(Folder *folder, FolderItem *item, MsgInfo *ms
 
 typedef struct _TagsData {
 	gchar *str;
-	GSList *msglist;
+	IMAPUidSet *uids;
 	IMAPFolderItem *item;
 } TagsData;
 
@@ -1482,11 +1910,12 @@ static void imap_commit_tags(FolderItem *item, MsgInfo *msginfo, GSList *tags_se
 				if (ht_data == NULL) {
 					ht_data = g_new0(TagsData, 1);
 					ht_data->str = g_strdup(tags_get_tag(cur_tag));
+					ht_data->uids = imap_uid_set_new();
 					ht_data->item = IMAP_FOLDER_ITEM(item);
 					g_hash_table_insert(IMAP_FOLDER_ITEM(item)->tags_set_table, 
 						GINT_TO_POINTER(cur_tag), ht_data);
 				}
-				ht_data->msglist = g_slist_prepend(ht_data->msglist, GINT_TO_POINTER(msginfo->msgnum));
+				imap_uid_set_add(ht_data->uids, msginfo->msgnum);
 			} 
 		}
 		for (cur = tags_unset; cur; cur = cur->next) {
@@ -1497,11 +1926,12 @@ static void imap_commit_tags(FolderItem *item, MsgInfo *msginfo, GSList *tags_se
 				if (ht_data == NULL) {
 					ht_data = g_new0(TagsData, 1);
 					ht_data->str = g_strdup(tags_get_tag(cur_tag));
+					ht_data->uids = imap_uid_set_new();
 					ht_data->item = IMAP_FOLDER_ITEM(item);
 					g_hash_table_insert(IMAP_FOLDER_ITEM(item)->tags_unset_table, 
 						GINT_TO_POINTER(cur_tag), ht_data);
 				}
-				ht_data->msglist = g_slist_prepend(ht_data->msglist, GINT_TO_POINTER(msginfo->msgnum));
+				imap_uid_set_add(ht_data->uids, msginfo->msgnum);
 			}
 		}
 	} else {
@@ -1717,6 +2147,218 @@ void imap_cache_msg(FolderItem *item, gint msgnum)
 	}
 }
 
+typedef struct _IMAPCacheRequest {
+	FolderItem *item;
+} IMAPCacheRequest;
+
+static void imap_cache_requests_forget(Folder *folder, FolderItem *item)
+{
+	GSList *cur;
+
+	for (cur = IMAP_FOLDER(folder)->cache_requests; cur != NULL; cur = cur->next) {
+		IMAPCacheRequest *request = (IMAPCacheRequest *)cur->data;
+
+		if (request->item == item)
+			request->item = NULL;
+	}
+}
+
+/* Updates the cache of item after the body of uid was fetched to
+ * filename. */
+static void imap_cache_msg_stored(FolderItem *item, guint32 uid,
+				  const gchar *filename, int error)
+{
+	MsgInfo *cached;
+	gint ok;
+
+	if (error != MAILIMAP_NO_ERROR) {
+		debug_print("can't fetch message %d (%d)\n", uid, error);
+		return;
+	}
+
+	ok = file_strip_crs(filename);
+	if (item->cache == NULL)
+		return;
+	cached = msgcache_get_msg(item->cache, uid);
+	if (cached) {
+		if (ok == 0)
+			procmsg_msginfo_set_flags(cached, MSG_FULLY_CACHED, 0);
+		else
+			procmsg_msginfo_unset_flags(cached, MSG_FULLY_CACHED, 0);
+		procmsg_msginfo_free(&cached);
+	}
+}
+
+static void imap_cache_msgs_fetched(Folder *folder, uint32_t uid,
+				    const char *filename, int error, void *data)
+{
+	IMAPCacheRequest *request = (IMAPCacheRequest *)data;
+
+	if (request->item == NULL)
+		return;
+
+	imap_cache_msg_stored(request->item, uid, filename, error);
+}
+
+static void imap_cache_msgs_done(Folder *folder, void *data)
+{
+	IMAP_FOLDER(folder)->cache_requests =
+		g_slist_remove(IMAP_FOLDER(folder)->cache_requests, data);
+	g_free(data);
+}
+
+/* Fetches the given messages on the session, prefs_common.imap_fetch_window
+ * of them per command. */
+static void imap_cache_msgs_session(Folder *folder, FolderItem *item,
+				    GSList *uids, GSList *filenames)
+{
+	IMAPSession *session;
+	gint window = MAX(prefs_common.imap_fetch_window, 1);
+	guint32 *uid_array;
+	gchar **filename_array;
+	int *errors;
+	gint total = g_slist_length(uids);
+	gint done = 0;
+	gint ok;
+
+	session = imap_session_get(folder);
+	if (session == NULL)
+		return;
+
+	lock_session(session); /* unlocked later in the function */
+
+	ok = imap_select(session, IMAP_FOLDER(folder), item,
+			 NULL, NULL, NULL, NULL, NULL, FALSE);
+	if (ok != MAILIMAP_NO_ERROR) {
+		g_warning("can't select mailbox %s", item->path);
+		return;
+	}
+
+	uid_array = g_new(guint32, window);
+	filename_array = g_new(gchar *, window);
+	errors = g_new(int, window);
+
+	statusbar_print_all(_("Fetching messages..."));
+	while (uids != NULL) {
+		gint count, i;
+
+		for (count = 0; count < window && uids != NULL; count++) {
+			uid_array[count] = GPOINTER_TO_UINT(uids->data);
+			filename_array[count] = (gchar *)filenames->data;
+			uids = uids->next;
+			filenames = filenames->next;
+		}
+
+		ok = imap_threaded_fetch_content_set(folder, count, uid_array,
+						     filename_array, errors);
+		for (i = 0; i < count; i++)
+			imap_cache_msg_stored(item, uid_array[i],
+					      filename_array[i], errors[i]);
+		if (ok != MAILIMAP_NO_ERROR) {
+			imap_handle_error(SESSION(session), NULL, ok);
+			debug_print("fetch err %d\n", ok);
+			if (is_fatal(ok))
+				break;
+		}
+		session_set_access_time(SESSION(session));
+		done += count;
+		statusbar_progress_all(done, total, window);
+	}
+	statusbar_progress_all(0, 0, 0);
+	statusbar_pop_all();
+
+	g_free(uid_array);
+	g_free(filename_array);
+	g_free(errors);
+
+	if (!is_fatal(ok))
+		unlock_session(session);
+}
+
+/* Caches the given messages. Their bodies are fetched by batches of
+ * prefs_common.imap_fetch_window with one UID FETCH each, in the
+ * background on the connection pool when the account has one, the
+ * messages of several folders then being fetched concurrently.
+ * Otherwise they are fetched right away by the session. */
+void imap_cache_msgs(FolderItem *item, GSList *msgnum_list)
+{
+	Folder *folder;
+	IMAPSession *session;
+	IMAPCacheRequest *request;
+	GSList *cur, *uids = NULL, *filenames = NULL;
+	gchar *path, *real_path = NULL;
+	gint ok = MAILIMAP_NO_ERROR;
+
+	cm_return_if_fail(item != NULL && item->folder != NULL);
+	folder = item->folder;
+
+	if (msgnum_list == NULL || item->path == NULL)
+		return;
+
+	if (prefs_common.work_offline && 
+	    !inc_offline_should_override(FALSE,
+		_("Claws Mail needs network access in order "
+		  "to access the IMAP server."))) {
+		return;
+	}
+
+	path = folder_item_get_path(item);
+	if (!is_dir_exist(path)) {
+		if (is_file_exist(path))
+			claws_unlink(path);
+		make_dir_hier(path);
+	}
+	g_free(path);
+
+	for (cur = msgnum_list; cur != NULL; cur = cur->next) {
+		gint msgnum = GPOINTER_TO_INT(cur->data);
+		gchar *filename;
+
+		if (msgnum <= 0 || imap_is_msg_fully_cached(folder, item, msgnum))
+			continue;
+		filename = imap_get_cached_filename(item, msgnum);
+		if (filename == NULL)
+			continue;
+		uids = g_slist_prepend(uids, GINT_TO_POINTER(msgnum));
+		filenames = g_slist_prepend(filenames, filename);
+	}
+	if (uids == NULL)
+		return;
+
+	uids = g_slist_reverse(uids);
+	filenames = g_slist_reverse(filenames);
+
+	if (imap_threaded_pool_available(folder)) {
+		session = imap_session_get(folder);
+		if (session != NULL)
+			real_path = imap_get_real_path(session, IMAP_FOLDER(folder),
+						       item->path, &ok);
+	}
+
+	if (real_path != NULL && ok == MAILIMAP_NO_ERROR) {
+		request = g_new0(IMAPCacheRequest, 1);
+		request->item = item;
+		ok = imap_threaded_pool_fetch(folder, real_path, uids, filenames,
+					      prefs_common.imap_fetch_window,
+					      imap_cache_msgs_fetched,
+					      imap_cache_msgs_done, request);
+		if (ok == MAILIMAP_NO_ERROR)
+			IMAP_FOLDER(folder)->cache_requests =
+				g_slist_prepend(IMAP_FOLDER(folder)->cache_requests, request);
+		else
+			g_free(request);
+	} else {
+		ok = MAILIMAP_ERROR_INVAL;
+	}
+	g_free(real_path);
+
+	if (ok != MAILIMAP_NO_ERROR)
+		imap_cache_msgs_session(folder, item, uids, filenames);
+
+	g_slist_free(uids);
+	slist_free_strings_full(filenames);
+}
+
 static gint imap_add_msg(Folder *folder, FolderItem *dest, 
 			 const gchar *file, MsgFlags *flags)
 {
@@ -1897,7 +2539,7 @@ static GSList *flatten_mailimap_set(struct mailimap_set * set)
 }
 static gint imap_do_copy_msgs(Folder *folder, FolderItem *dest, 
 			      MsgInfoList *msglist, GHashTable *relation,
-			      gboolean same_dest_ok)
+			      gboolean same_dest_ok, gboolean move)
 {
 	FolderItem *src;
 	gchar *destdir;
@@ -1905,8 +2547,9 @@ static gint imap_do_copy_msgs(Folder *folder, FolderItem *dest,
 	MsgInfo *msginfo;
 	IMAPSession *session;
 	gint ok = MAILIMAP_NO_ERROR;
-	GHashTable *uid_hash;
+	GHashTable *uid_hash, *copied = NULL;
 	gint last_num = 0;
+	gboolean server_move = FALSE, uid_expunge = FALSE;
 
 	g_return_val_if_fail(folder != NULL, -1);
 	g_return_val_if_fail(dest != NULL, -1);
@@ -1964,22 +2607,57 @@ static gint imap_do_copy_msgs(Folder *folder, FolderItem *dest,
 		return ok;
 	}
 
+	if (move) {
+		/* MOVE (RFC 6851) is atomic on the server; otherwise the
+		 * copies are flagged \Deleted and, with UIDPLUS, only they
+		 * are expunged instead of everything flagged in the folder. */
+#ifdef HAVE_MAILIMAP_UIDPLUS_UID_MOVE
+		server_move = imap_has_capability(session, "MOVE");
+#endif
+		uid_expunge = imap_has_capability(session, "UIDPLUS");
+		copied = g_hash_table_new(g_direct_hash, g_direct_equal);
+	}
+
 	seq_list = imap_get_lep_set_from_msglist(IMAP_FOLDER(folder), msglist);
 	uid_hash = g_hash_table_new(g_direct_hash, g_direct_equal);
 	
-	statusbar_print_all(_("Copying messages..."));
+	statusbar_print_all(move ? _("Moving messages...") : _("Copying messages..."));
 	for (cur = seq_list; cur != NULL; cur = g_slist_next(cur)) {
 		struct mailimap_set * seq_set;
 		struct mailimap_set * source = NULL;
 		struct mailimap_set * dest = NULL;
 		seq_set = cur->data;
 
-		debug_print("Copying messages from %s to %s ...\n",
-			    src->path, destdir);
+		debug_print("%s messages from %s to %s ...\n",
+			    move ? "Moving" : "Copying", src->path, destdir);
 
 		lock_session(session); /* unlocked later in the function */
-		ok = imap_cmd_copy(session, seq_set, destdir,
-			&source, &dest);
+		if (server_move)
+			ok = imap_cmd_move(session, seq_set, destdir,
+				&source, &dest);
+		else
+			ok = imap_cmd_copy(session, seq_set, destdir,
+				&source, &dest);
+
+		if (ok == MAILIMAP_NO_ERROR && move && !server_move) {
+			gint cleanup;
+
+			/* the copies are made: if the originals can't be
+			 * removed they stay in the source folder, and its
+			 * rescan brings them back */
+			cleanup = imap_cmd_store(session, IMAP_FOLDER_ITEM(src),
+						 seq_set, IMAP_FLAG_DELETED,
+						 NULL, TRUE);
+			if (cleanup == MAILIMAP_NO_ERROR && uid_expunge)
+				cleanup = imap_cmd_uid_expunge(session, seq_set);
+			if (cleanup != MAILIMAP_NO_ERROR) {
+				log_warning(LOG_PROTOCOL,
+					    _("can't remove moved messages from %s\n"),
+					    src->path);
+				if (is_fatal(cleanup))
+					session = NULL;
+			}
+		}
 		
 		if (is_fatal(ok)) {
 			session = NULL;
@@ -1987,6 +2665,15 @@ static gint imap_do_copy_msgs(Folder *folder, FolderItem *dest,
 
 		if (ok == MAILIMAP_NO_ERROR) {
 			unlock_session(session);
+			if (copied) {
+				GSList *c_list = flatten_mailimap_set(seq_set);
+				GSList *c_cur;
+
+				for (c_cur = c_list; c_cur; c_cur = c_cur->next)
+					g_hash_table_insert(copied, c_cur->data,
+							    GINT_TO_POINTER(1));
+				g_slist_free(c_list);
+			}
 			if (relation && source && dest) {
 				GSList *s_list = flatten_mailimap_set(source);
 				GSList *d_list = flatten_mailimap_set(dest);
@@ -2015,10 +2702,17 @@ static gint imap_do_copy_msgs(Folder *folder, FolderItem *dest,
 
 		if (ok != MAILIMAP_NO_ERROR) {
 			g_hash_table_destroy(uid_hash);
+			if (copied)
+				g_hash_table_destroy(copied);
 			imap_lep_set_free(seq_list);
 			statusbar_pop_all();
 			return -1;
 		}
+
+		/* the connection went away while cleaning up: the
+		 * remaining messages weren't moved */
+		if (session == NULL)
+			break;
 	}
 
 	for (cur = msglist; cur != NULL; cur = g_slist_next(cur)) {
@@ -2033,7 +2727,8 @@ static gint imap_do_copy_msgs(Folder *folder, FolderItem *dest,
 					  GINT_TO_POINTER(num));
 			if (num > last_num)
 				last_num = num;
-			debug_print("copied message %d as %d\n", msginfo->msgnum, num);
+			debug_print("%s message %d as %d\n", move ? "moved" : "copied",
+				    msginfo->msgnum, num);
 			/* put the local file in the imapcache, so that we don't
 			 * have to fetch it back later. */
 			if (num > 0) {
@@ -2060,21 +2755,55 @@ static gint imap_do_copy_msgs(Folder *folder, FolderItem *dest,
 				g_free(cache_file);
 				g_free(cache_path);
 			}
-		} else
+		} else if (copied && !g_hash_table_lookup(copied,
+					GINT_TO_POINTER(msginfo->msgnum)))
+			g_hash_table_insert(relation, msginfo,
+					  GINT_TO_POINTER(-1));
+		else
 			g_hash_table_insert(relation, msginfo,
 					  GINT_TO_POINTER(0));
 	}
 	statusbar_pop_all();
 
 	g_hash_table_destroy(uid_hash);
+	if (copied)
+		g_hash_table_destroy(copied);
 	imap_lep_set_free(seq_list);
 
 	g_free(destdir);
+
+	if (move) {
+		gchar *dir;
+
+		if (session != NULL && !server_move && !uid_expunge) {
+			gint cleanup;
+
+			lock_session(session);
+			cleanup = imap_cmd_expunge(session);
+			if (cleanup != MAILIMAP_NO_ERROR)
+				log_warning(LOG_PROTOCOL, _("can't expunge\n"));
+			if (is_fatal(cleanup))
+				session = NULL;
+			unlock_session(session);
+		}
+		if (session != NULL)
+			session->folder_content_changed = TRUE;
+
+		dir = folder_item_get_path(src);
+		if (is_dir_exist(dir)) {
+			for (cur = msglist; cur; cur = cur->next) {
+				msginfo = (MsgInfo *)cur->data;
+				remove_numbered_files(dir, msginfo->msgnum, msginfo->msgnum);
+			}
+		}
+		g_free(dir);
+		imap_scan_required(folder, src);
+	}
 	
 	IMAP_FOLDER_ITEM(dest)->lastuid = 0;
 	IMAP_FOLDER_ITEM(dest)->uid_next = 0;
-	g_slist_free(IMAP_FOLDER_ITEM(dest)->uid_list);
-	IMAP_FOLDER_ITEM(dest)->uid_list = NULL;
+	imap_uid_set_free(IMAP_FOLDER_ITEM(dest)->uid_set);
+	IMAP_FOLDER_ITEM(dest)->uid_set = NULL;
 
 	imap_scan_required(folder, dest);
 	if (ok == MAILIMAP_NO_ERROR)
@@ -2089,17 +2818,33 @@ static gint imap_copy_msg(Folder *folder, FolderItem *dest, MsgInfo *msginfo)
 
 	g_return_val_if_fail(msginfo != NULL, -1);
 
-	msglist.data = msginfo;
-	msglist.next = NULL;
+	msglist.data = msginfo;
+	msglist.next = NULL;
+
+	return imap_copy_msgs(folder, dest, &msglist, NULL);
+}
+
+static gint imap_copy_msgs(Folder *folder, FolderItem *dest, 
+		    MsgInfoList *msglist, GHashTable *relation)
+{
+	MsgInfo *msginfo;
+	gint ret;
+
+	g_return_val_if_fail(folder != NULL, -1);
+	g_return_val_if_fail(dest != NULL, -1);
+	g_return_val_if_fail(msglist != NULL, -1);
+
+	msginfo = (MsgInfo *)msglist->data;
+	g_return_val_if_fail(msginfo->folder != NULL, -1);
 
-	return imap_copy_msgs(folder, dest, &msglist, NULL);
+	ret = imap_do_copy_msgs(folder, dest, msglist, relation, FALSE, FALSE);
+	return ret;
 }
 
-static gint imap_copy_msgs(Folder *folder, FolderItem *dest, 
+static gint imap_move_msgs(Folder *folder, FolderItem *dest, 
 		    MsgInfoList *msglist, GHashTable *relation)
 {
 	MsgInfo *msginfo;
-	gint ret;
 
 	g_return_val_if_fail(folder != NULL, -1);
 	g_return_val_if_fail(dest != NULL, -1);
@@ -2107,9 +2852,9 @@ static gint imap_copy_msgs(Folder *folder, FolderItem *dest,
 
 	msginfo = (MsgInfo *)msglist->data;
 	g_return_val_if_fail(msginfo->folder != NULL, -1);
+	g_return_val_if_fail(msginfo->folder->folder == folder, -1);
 
-	ret = imap_do_copy_msgs(folder, dest, msglist, relation, FALSE);
-	return ret;
+	return imap_do_copy_msgs(folder, dest, msglist, relation, FALSE, TRUE);
 }
 
 static gboolean imap_matcher_type_is_local(gint matchertype)
@@ -2391,6 +3136,39 @@ static MatcherProp *imap_matcher_prop_set_charset(IMAPFolder *folder,
 	}
 }
 
+/* UID SEARCH, for the search types of imap_threaded_search(). With
+ * ESEARCH (RFC 4731) the matches come as a compact set, so a search
+ * over a large folder doesn't transfer one number per message. @key is
+ * freed. */
+static gint imap_search_uids(IMAPSession *session, int search_type,
+			     IMAPSearchKey *key, const gchar *charset,
+			     struct mailimap_set *set, IMAPUidSet **uids)
+{
+	clist *lep_uidlist;
+	gint r;
+
+	if (imap_has_capability(session, "ESEARCH")) {
+		r = imap_threaded_esearch(session->folder, search_type, key,
+					  set, uids);
+		if (r == MAILIMAP_NO_ERROR || is_fatal(r)) {
+			if (key != NULL)
+				imap_search_free(key);
+			return r;
+		}
+		if (r != MAILIMAP_ERROR_EXTENSION)
+			debug_print("ESEARCH failed (%d), searching again\n", r);
+	}
+
+	r = imap_threaded_search(session->folder, search_type, key, charset,
+				 set, &lep_uidlist);
+	if (r == MAILIMAP_NO_ERROR) {
+		*uids = imap_uid_set_new_from_lep_list(lep_uidlist);
+		mailimap_search_result_free(lep_uidlist);
+	}
+
+	return r;
+}
+
 static gint	search_msgs		(Folder			*folder,
 					 FolderItem		*container,
 					 MsgNumberList		**msgs,
@@ -2402,7 +3180,7 @@ static gint	search_msgs		(Folder			*folder,
 	IMAPSearchKey* key = NULL;
 	GSList* cur;
 	int result = -1;
-	clist* uidlist = NULL;
+	IMAPUidSet *uids = NULL;
 	gboolean server_filtering_useless = FALSE;
         IMAPSession *session;
 	gchar *charset_to_use = NULL;
@@ -2482,7 +3260,7 @@ static gint	search_msgs		(Folder			*folder,
 
 	if (progress_cb)
 		progress_cb(progress_data, TRUE, 0, 0, container->total_msgs);
-	result = imap_threaded_search(folder, IMAP_SEARCH_TYPE_KEYED, key, charset_to_use, NULL, &uidlist);
+	result = imap_search_uids(session, IMAP_SEARCH_TYPE_KEYED, key, charset_to_use, NULL, &uids);
 	if (progress_cb)
 		progress_cb(progress_data, TRUE, container->total_msgs, 0, container->total_msgs);
 
@@ -2494,9 +3272,9 @@ static gint	search_msgs		(Folder			*folder,
 	} if (result == MAILIMAP_NO_ERROR) {
 		gint result = 0;
 
-		*msgs = imap_uid_list_from_lep(uidlist, &result);
-
-		mailimap_search_result_free(uidlist);
+		*msgs = imap_uid_set_to_list(uids);
+		result = imap_uid_set_count(uids);
+		imap_uid_set_free(uids);
 
 		if (charset_to_use != NULL)
 			g_free(charset_to_use);
@@ -2573,7 +3351,16 @@ static gint imap_do_remove_msgs(Folder *folder, FolderItem *dest,
 			return ok;
 		}
 	} /* else we just need to expunge */
-	ok = imap_cmd_expunge(session);
+	if (imap_has_capability(session, "UIDPLUS")) {
+		/* leave other messages flagged \Deleted alone */
+		GSList *seq_list = imap_get_lep_set_from_msglist(IMAP_FOLDER(folder), msglist);
+
+		ok = MAILIMAP_NO_ERROR;
+		for (cur = seq_list; cur && ok == MAILIMAP_NO_ERROR; cur = cur->next)
+			ok = imap_cmd_uid_expunge(session, cur->data);
+		imap_lep_set_free(seq_list);
+	} else
+		ok = imap_cmd_expunge(session);
 	if (ok != MAILIMAP_NO_ERROR) {
 		log_warning(LOG_PROTOCOL, _("can't expunge\n"));
 		g_free(destdir);
@@ -3510,6 +4297,43 @@ static gint imap_remove_folder(Folder *folder, FolderItem *item)
 	return imap_remove_folder_real(folder, item);
 }
 
+/* The MsgInfo of a fetched envelope, NULL if it can't be parsed. Sets
+ * *got_alien_tags if tags unknown so far were added. */
+static MsgInfo *imap_msginfo_from_env(struct imap_fetch_env_info *info,
+				      GSList *tags, FolderItem *item,
+				      gboolean *got_alien_tags)
+{
+	MsgInfo *msginfo;
+	GSList *cur;
+
+	msginfo = imap_envelope_from_lep(info, item);
+	if (msginfo == NULL)
+		return NULL;
+	g_slist_free(msginfo->tags);
+	msginfo->tags = NULL;
+
+	for (cur = tags; cur; cur = cur->next) {
+		gchar *real_tag = imap_modified_utf7_to_utf8(cur->data, TRUE);
+		gint id = 0;
+		id = tags_get_id_for_str(real_tag);
+		if (id == -1) {
+			id = tags_add_tag(real_tag);
+			*got_alien_tags = TRUE;
+		}
+		if (!g_slist_find(msginfo->tags, GINT_TO_POINTER(id))) {
+			msginfo->tags = g_slist_prepend(
+					msginfo->tags,
+					GINT_TO_POINTER(id));
+		}
+		g_free(real_tag);
+	}
+	if (msginfo->tags)
+		msginfo->tags = g_slist_reverse(msginfo->tags);
+	msginfo->folder = item;
+
+	return msginfo;
+}
+
 typedef struct _uncached_data {
 	IMAPSession *session;
 	FolderItem *item;
@@ -3570,36 +4394,14 @@ static void *imap_get_uncached_messages_thread(void *data)
 		for(i = 0 ; i < carray_count(env_list) ; i += 2) {
 			struct imap_fetch_env_info * info;
 			MsgInfo * msginfo;
-			GSList *tags = NULL, *cur = NULL;
+			GSList *tags = NULL;
 			info = carray_get(env_list, i);
 			tags = carray_get(env_list, i+1);
-			msginfo = imap_envelope_from_lep(info, item);
-			if (msginfo == NULL) {
-				slist_free_strings_full(tags);
-				continue;
-			}
-			g_slist_free(msginfo->tags);
-			msginfo->tags = NULL;
-
-			for (cur = tags; cur; cur = cur->next) {
-				gchar *real_tag = imap_modified_utf7_to_utf8(cur->data, TRUE);
-				gint id = 0;
-				id = tags_get_id_for_str(real_tag);
-				if (id == -1) {
-					id = tags_add_tag(real_tag);
-					got_alien_tags = TRUE;
-				}
-				if (!g_slist_find(msginfo->tags, GINT_TO_POINTER(id))) {
-					msginfo->tags = g_slist_prepend(
-							msginfo->tags,
-							GINT_TO_POINTER(id));
-				}
-				g_free(real_tag);
-			}
-			if (msginfo->tags)
-				msginfo->tags = g_slist_reverse(msginfo->tags);
+			msginfo = imap_msginfo_from_env(info, tags, item,
+							&got_alien_tags);
 			slist_free_strings_full(tags);
-			msginfo->folder = item;
+			if (msginfo == NULL)
+				continue;
 			if (!newlist)
 				llast = newlist = g_slist_append(newlist, msginfo);
 			else {
@@ -3815,28 +4617,40 @@ static gint imap_set_message_flags(IMAPSession *session,
 				   IMAPFlags flags,
 				   GSList *tags,
 				   gboolean is_set)
+{
+	IMAPUidSet *uids;
+	gint ok;
+
+	if (numlist == NULL || session == NULL)
+		return MAILIMAP_ERROR_BAD_STATE;
+
+	uids = imap_uid_set_new_from_list(numlist);
+	ok = imap_set_message_flags_uids(session, item, uids, flags, tags, is_set);
+	imap_uid_set_free(uids);
+
+	return ok;
+}
+
+static gint imap_set_message_flags_uids(IMAPSession *session,
+					IMAPFolderItem *item,
+					IMAPUidSet *uids,
+					IMAPFlags flags,
+					GSList *tags,
+					gboolean is_set)
 {
 	gint ok = 0;
 	GSList *seq_list;
 	GSList * cur;
 	gint total = 0;
 	IMAPFolder *folder = NULL;
-	GSList *sorted_list = NULL;
 
-	if (numlist == NULL || session == NULL)
+	if (uids == NULL || session == NULL)
 		return MAILIMAP_ERROR_BAD_STATE;
 	
 	folder = IMAP_FOLDER(session->folder);
 	
-	sorted_list = g_slist_copy(numlist);
-	sorted_list = g_slist_sort(sorted_list, g_int_compare);
-	
-	cur = g_slist_last(sorted_list);
-
-	if (cur)
-		total = GPOINTER_TO_INT(cur->data);
-	
-	seq_list = imap_get_lep_set_from_numlist(IMAP_FOLDER(session->folder), sorted_list);
+	total = imap_uid_set_max(uids);
+	seq_list = imap_uid_set_to_lep_sets(uids, folder->max_set_size);
 
 	statusbar_print_all(_("Flagging messages..."));
 
@@ -3865,8 +4679,6 @@ static gint imap_set_message_flags(IMAPSession *session,
 			break;
 		}
 	}
-	
-	g_slist_free(sorted_list);
 
 	statusbar_progress_all(0,0,0);
 	statusbar_pop_all();
@@ -3950,9 +4762,9 @@ static gint imap_select(IMAPSession *session, IMAPFolder *folder,
 		session->expunge = 0;
 		session->unseen = *unseen;
 		session->uid_validity = *uid_validity;
-		debug_print("select: exists %d recent %d expunge %d uid_validity %d can_create_flags %d\n", 
+		debug_print("select: exists %d recent %d expunge %d uid_validity %d can_create_flags %d highestmodseq %"G_GUINT64_FORMAT"\n", 
 			session->exists, session->recent, session->expunge,
-			session->uid_validity, *can_create_flags);
+			session->uid_validity, *can_create_flags, session->highestmodseq);
 	}
 	if (*can_create_flags) {
 		IMAP_FOLDER_ITEM(item)->can_create_flags = ITEM_CAN_CREATE_FLAGS;
@@ -4134,44 +4946,52 @@ static gint imap_cmd_login(IMAPSession *session,
 	} else {
 		log_print(LOG_PROTOCOL, "IMAP< Login to %s successful\n",
 				SESSION(session)->server);
+		session->auth_type = type;
 		ok = MAILIMAP_NO_ERROR;
 	}
 	return ok;
 }
 
-static gint imap_cmd_noop(IMAPSession *session)
+static void imap_noop_update(IMAPSession *session, const IMAPNoopInfo *info)
 {
-	int r;
-	unsigned int exists, recent, expunge, unseen, uidnext, uidval;
-	
-	r = imap_threaded_noop(session->folder, &exists, &recent, &expunge, &unseen, &uidnext, &uidval);
-	if (r != MAILIMAP_NO_ERROR) {
-		imap_handle_error(SESSION(session), NULL, r);
-		debug_print("noop err %d\n", r);
-		return r;
-	}
-
-	if ((exists && exists != session->exists)
-	 || (recent && recent != session->recent)
-	 || (expunge && expunge != session->expunge)
-	 || (unseen && unseen != session->unseen)) {
+	if ((info->exists && info->exists != session->exists)
+	 || (info->recent && info->recent != session->recent)
+	 || (info->expunge && info->expunge != session->expunge)
+	 || (info->unseen && info->unseen != session->unseen)) {
 		session->folder_content_changed = TRUE;
 	}
-	if (uidnext != 0 && uidnext != session->uid_next) {
-		session->uid_next = uidnext;
+	if (info->uidnext != 0 && info->uidnext != session->uid_next) {
+		session->uid_next = info->uidnext;
 		session->folder_content_changed = TRUE;
 	}
-	if (uidval != 0 && uidval != session->uid_validity) {
-		session->uid_validity = uidval;
+	if (info->uidval != 0 && info->uidval != session->uid_validity) {
+		session->uid_validity = info->uidval;
 		session->folder_content_changed = TRUE;
 	}
 
-	session->exists = exists;
-	session->recent = recent;
-	session->expunge = expunge;
-	session->unseen = unseen;
+	session->exists = info->exists;
+	session->recent = info->recent;
+	session->expunge = info->expunge;
+	session->unseen = info->unseen;
 
 	session_set_access_time(SESSION(session));
+}
+
+static gint imap_cmd_noop(IMAPSession *session)
+{
+	int r;
+	IMAPNoopInfo info;
+	
+	r = imap_threaded_noop(session->folder, &info.exists, &info.recent,
+			       &info.expunge, &info.unseen, &info.uidnext,
+			       &info.uidval);
+	if (r != MAILIMAP_NO_ERROR) {
+		imap_handle_error(SESSION(session), NULL, r);
+		debug_print("noop err %d\n", r);
+		return r;
+	}
+
+	imap_noop_update(session, &info);
 
 	return MAILIMAP_NO_ERROR;
 }
@@ -4199,8 +5019,10 @@ static gint imap_cmd_select(IMAPSession *session, const gchar *folder,
 {
 	int r;
 
+	session->highestmodseq = 0;
 	r = imap_threaded_select(session->folder, folder,
-				 exists, recent, unseen, uid_validity, can_create_flags, ok_flags);
+				 exists, recent, unseen, uid_validity, can_create_flags, ok_flags,
+				 imap_has_condstore(session) ? &session->highestmodseq : NULL);
 	if (r != MAILIMAP_NO_ERROR) {
 		imap_handle_error(SESSION(session), NULL, r);
 		debug_print("select err %d\n", r);
@@ -4224,6 +5046,7 @@ static gint imap_cmd_close(IMAPSession *session)
 	session->exists = 0;
 	session->recent = 0;
 	session->expunge = 0;
+	session->highestmodseq = 0;
 	return MAILIMAP_NO_ERROR;
 }
 
@@ -4394,6 +5217,25 @@ static gint imap_cmd_copy(IMAPSession *session, struct mailimap_set * set,
 	return MAILIMAP_NO_ERROR;
 }
 
+static gint imap_cmd_move(IMAPSession *session, struct mailimap_set * set,
+			  const gchar *destfolder,
+			  struct mailimap_set **source, struct mailimap_set **dest)
+{
+	int r;
+	
+	g_return_val_if_fail(session != NULL, MAILIMAP_ERROR_BAD_STATE);
+	g_return_val_if_fail(set != NULL, MAILIMAP_ERROR_BAD_STATE);
+	g_return_val_if_fail(destfolder != NULL, MAILIMAP_ERROR_BAD_STATE);
+
+	r = imap_threaded_move(session->folder, set, destfolder, source, dest);
+	if (r != MAILIMAP_NO_ERROR) {
+		imap_handle_error(SESSION(session), NULL, r);
+		return r;
+	}
+
+	return MAILIMAP_NO_ERROR;
+}
+
 static gint imap_cmd_store(IMAPSession *session, 
 			   IMAPFolderItem *item,
 			   struct mailimap_set * set,
@@ -4442,6 +5284,26 @@ static gint imap_cmd_expunge(IMAPSession *session)
 	return MAILIMAP_NO_ERROR;
 }
 
+static gint imap_cmd_uid_expunge(IMAPSession *session, struct mailimap_set *set)
+{
+	int r;
+	
+	if (prefs_common.work_offline && 
+	    !inc_offline_should_override(FALSE,
+		_("Claws Mail needs network access in order "
+		  "to access the IMAP server."))) {
+		return -1;
+	}
+
+	r = imap_threaded_uid_expunge(session->folder, set);
+	if (r != MAILIMAP_NO_ERROR) {
+		imap_handle_error(SESSION(session), NULL, r);
+		return r;
+	}
+
+	return MAILIMAP_NO_ERROR;
+}
+
 gint imap_expunge(Folder *folder, FolderItem *item)
 {
 	IMAPSession *session = imap_session_get(folder);
@@ -4508,37 +5370,146 @@ static gboolean imap_rename_folder_func(GNode *node, gpointer data)
 	return FALSE;
 }
 
+/* CONDSTORE alone doesn't report expunged messages: k of them gone and k
+ * new ones would go unnoticed, so it takes QRESYNC. */
+static gboolean imap_can_resync(IMAPSession *session, IMAPFolderItem *item)
+{
+	return session->qresync && item->highestmodseq != 0
+		&& !item->should_trash_cache;
+}
+
+/*
+ * Update the list of UIDs from the changes since the last synchronisation
+ * (RFC 7162): the messages expunged since are reported as VANISHED as
+ * QRESYNC is enabled, the new messages are among the changed ones. The
+ * changed flags are kept for the following imap_get_flags().
+ * Returns the number of messages, -1 on error, or -2 if the whole list
+ * has to be fetched.
+ */
+static gint imap_resync_uids(IMAPSession *session, Folder *folder,
+			     IMAPFolderItem *item, gint exists,
+			     GSList **msgnum_list)
+{
+	carray *lep_uidtab = NULL;
+	struct mailimap_set *vanished = NULL;
+	GHashTable *flags_hash, *tags_hash;
+	GHashTableIter iter;
+	gpointer key;
+	IMAPUidSet *known;
+	guint64 modseq = 0;
+	gint nummsgs = 0, nvanished = 0, nnew = 0;
+	int r;
+
+	if (session->highestmodseq == 0 ||
+	    session->uid_validity != item->item.mtime)
+		return -2;
+
+	r = imap_threaded_fetch_uid_flags_changed(folder, item->highestmodseq,
+						  session->qresync, &lep_uidtab,
+						  &vanished, &modseq);
+	if (r != MAILIMAP_NO_ERROR) {
+		imap_handle_error(SESSION(session), NULL, r);
+		return is_fatal(r) ? -1 : -2;
+	}
+
+	flags_hash = g_hash_table_new(g_direct_hash, g_direct_equal);
+	tags_hash = g_hash_table_new(g_direct_hash, g_direct_equal);
+	imap_flags_hash_from_lep_uid_flags_tab(lep_uidtab, flags_hash, tags_hash);
+	imap_fetch_uid_flags_list_free(lep_uidtab);
+
+	if (item->uid_set != NULL) {
+		known = imap_uid_set_copy(item->uid_set);
+	} else {
+		GSList *numlist = folder_item_get_number_list(FOLDER_ITEM(item));
+
+		known = imap_uid_set_new_from_list(numlist);
+		g_slist_free(numlist);
+	}
+
+	if (vanished != NULL) {
+		IMAPUidSet *vanished_set = imap_uid_set_new_from_lep_set(vanished);
+
+		mailimap_set_free(vanished);
+		nvanished = imap_uid_set_count(known);
+		imap_uid_set_difference(known, vanished_set);
+		nvanished -= imap_uid_set_count(known);
+		imap_uid_set_free(vanished_set);
+	}
+
+	/* changed messages we don't know about are new ones */
+	g_hash_table_iter_init(&iter, flags_hash);
+	while (g_hash_table_iter_next(&iter, &key, NULL)) {
+		if (imap_uid_set_contains(known, GPOINTER_TO_UINT(key)))
+			continue;
+		imap_uid_set_add(known, GPOINTER_TO_UINT(key));
+		nnew++;
+	}
+	nummsgs = imap_uid_set_count(known);
+
+	debug_print("resync since %"G_GUINT64_FORMAT": %d changed, %d new, %d vanished, "
+		    "%d messages (EXISTS %d)\n", item->highestmodseq,
+		    g_hash_table_size(flags_hash), nnew, nvanished, nummsgs, exists);
+
+	/* the server forgot about some changes */
+	if (nummsgs != exists) {
+		debug_print("resync: message count mismatch, listing all UIDs\n");
+		imap_uid_set_free(known);
+		g_hash_table_destroy(flags_hash);
+		imap_tags_hash_destroy(tags_hash);
+		return -2;
+	}
+
+	item->changed_flags = flags_hash;
+	item->changed_tags = tags_hash;
+	item->resync_modseq = MAX(session->highestmodseq, modseq);
+
+	imap_uid_set_free(item->uid_set);
+	item->uid_set = known;
+	*msgnum_list = g_slist_concat(imap_uid_set_to_list(known), *msgnum_list);
+
+	return nummsgs;
+}
+
 static gint get_list_of_uids(IMAPSession *session, Folder *folder, IMAPFolderItem *item, GSList **msgnum_list)
 {
-	GSList *uidlist, *elem;
+	IMAPUidSet *uids = NULL;
 	int r = -1;
-	clist * lep_uidlist;
-	gint ok, nummsgs = 0;
+	gint ok, nummsgs = 0, exists = 0;
+	gboolean resync;
 
 	if (session == NULL) {
 		return -1;
 	}
 
+	/* resynchronising needs a fresh EXISTS and HIGHESTMODSEQ */
+	resync = imap_can_resync(session, item);
 	ok = imap_select(session, IMAP_FOLDER(folder), FOLDER_ITEM(item),
-			 NULL, NULL, NULL, NULL, NULL, TRUE);
+			 resync ? &exists : NULL, NULL, NULL, NULL, NULL, TRUE);
 	if (ok != MAILIMAP_NO_ERROR) {
 		return -1;
 	}
 
-	g_slist_free(item->uid_list);
-	item->uid_list = NULL;
+	imap_folder_item_forget_changes(item);
+	if (resync) {
+		nummsgs = imap_resync_uids(session, folder, item, exists, msgnum_list);
+		if (nummsgs != -2)
+			return nummsgs;
+		nummsgs = 0;
+	}
+
+	/* the flags of all messages have to be fetched again too */
+	item->highestmodseq = 0;
+	item->resync_modseq = session->highestmodseq;
+
+	imap_uid_set_free(item->uid_set);
+	item->uid_set = NULL;
 
-	uidlist = NULL;
-	
 	if (folder->account && folder->account->low_bandwidth) {
-		r = imap_threaded_search(folder, IMAP_SEARCH_TYPE_SIMPLE,
-				NULL, NULL, NULL, &lep_uidlist);
+		r = imap_search_uids(session, IMAP_SEARCH_TYPE_SIMPLE,
+				NULL, NULL, NULL, &uids);
 	}
 	
-	if (r == MAILIMAP_NO_ERROR) {
-		uidlist = imap_uid_list_from_lep(lep_uidlist, NULL);
-		mailimap_search_result_free(lep_uidlist);
-	} else {
+	if (r != MAILIMAP_NO_ERROR) {
 		carray * lep_uidtab;
 		if (r != -1) { /* inited */
 			imap_handle_error(SESSION(session), NULL, r);
@@ -4548,7 +5519,7 @@ static gint get_list_of_uids(IMAPSession *session, Folder *folder, IMAPFolderIte
 		r = imap_threaded_fetch_uid(folder, 1,
 				    &lep_uidtab);
 		if (r == MAILIMAP_NO_ERROR) {
-			uidlist = imap_uid_list_from_lep_tab(lep_uidtab);
+			uids = imap_uid_set_from_lep_tab(lep_uidtab);
 			imap_fetch_uid_list_free(lep_uidtab);
 		}
 	}
@@ -4558,16 +5529,9 @@ static gint get_list_of_uids(IMAPSession *session, Folder *folder, IMAPFolderIte
 		return -1;
 	}
 
-	for (elem = uidlist; elem != NULL; elem = g_slist_next(elem)) {
-		guint msgnum;
-
-		msgnum = GPOINTER_TO_INT(elem->data);
-
-		*msgnum_list = g_slist_prepend(*msgnum_list, GINT_TO_POINTER(msgnum));
-		item->uid_list = g_slist_prepend(item->uid_list, GINT_TO_POINTER(msgnum));
-		nummsgs++;
-	}
-	g_slist_free(uidlist);
+	item->uid_set = uids;
+	nummsgs = imap_uid_set_count(uids);
+	*msgnum_list = g_slist_concat(imap_uid_set_to_list(uids), *msgnum_list);
 
 	return nummsgs;
 
@@ -4591,13 +5555,13 @@ gint imap_get_num_list(Folder *folder, FolderItem *_item, GSList **msgnum_list,
 	g_return_val_if_fail(FOLDER_CLASS(folder) == &imap_class, -1);
 	g_return_val_if_fail(folder->account != NULL, -1);
 
-	known_list_len = g_slist_length(item->uid_list);
+	known_list_len = imap_uid_set_count(item->uid_set);
 	if (!item->should_update) {
 		debug_print("get_num_list: nothing to update\n");
 		*old_uids_valid = TRUE;
 		if (known_list_len == item->item.total_msgs
 		 && known_list_len > 0) {
-			*msgnum_list = g_slist_copy(item->uid_list);
+			*msgnum_list = imap_uid_set_to_list(item->uid_set);
 			return known_list_len;
 		} else {
 			debug_print("don't know the list length...\n");
@@ -4637,8 +5601,8 @@ gint imap_get_num_list(Folder *folder, FolderItem *_item, GSList **msgnum_list,
 		debug_print("get_num_list: trashing num list\n");
 		debug_print("Freeing imap uid cache\n");
 		item->lastuid = 0;
-		g_slist_free(item->uid_list);
-		item->uid_list = NULL;
+		imap_uid_set_free(item->uid_set);
+		item->uid_set = NULL;
 
 		imap_delete_all_cached_messages((FolderItem *)item);
 	} else {
@@ -4699,6 +5663,38 @@ static MsgInfo *imap_parse_msg(const gchar *file, FolderItem *item)
 	return msginfo;
 }
 
+/* Moves the MsgInfos of @msgnum_list fetched in the background to
+ * *@msginfos, and returns the numbers left to fetch */
+static MsgNumberList *imap_take_prefetched(IMAPFolderItem *item,
+					   MsgNumberList *msgnum_list,
+					   MsgInfoList **msginfos)
+{
+	MsgNumberList *uncached = NULL, *cur;
+	MsgInfo *msginfo;
+
+	if (item->prefetched == NULL ||
+	    item->prefetched_uid_validity != item->item.mtime) {
+		imap_prefetched_forget(item);
+		return g_slist_copy(msgnum_list);
+	}
+
+	for (cur = msgnum_list; cur != NULL; cur = cur->next) {
+		msginfo = g_hash_table_lookup(item->prefetched, cur->data);
+		if (msginfo != NULL) {
+			g_hash_table_steal(item->prefetched, cur->data);
+			*msginfos = g_slist_prepend(*msginfos, msginfo);
+		} else {
+			uncached = g_slist_prepend(uncached, cur->data);
+		}
+	}
+	debug_print("%d prefetched envelopes used\n",
+		    g_slist_length(*msginfos));
+	imap_prefetched_forget(item);
+
+	*msginfos = g_slist_reverse(*msginfos);
+	return g_slist_reverse(uncached);
+}
+
 GSList *imap_get_msginfos(Folder *folder, FolderItem *item,
 			  GSList *msgnum_list)
 {
@@ -4726,11 +5722,19 @@ GSList *imap_get_msginfos(Folder *folder, FolderItem *item,
 	}
 	if (!(folder_has_parent_of_type(item, F_DRAFT) || 
 	      folder_has_parent_of_type(item, F_QUEUE))) {
-		ret = g_slist_concat(ret,
-			imap_get_uncached_messages(session, item,
-						   msgnum_list, &ok));
-		if (ok != MAILIMAP_NO_ERROR)
+		MsgNumberList *uncached;
+
+		uncached = imap_take_prefetched(IMAP_FOLDER_ITEM(item),
+						msgnum_list, &ret);
+		if (uncached != NULL)
+			ret = g_slist_concat(ret,
+				imap_get_uncached_messages(session, item,
+							   uncached, &ok));
+		g_slist_free(uncached);
+		if (ok != MAILIMAP_NO_ERROR) {
+			procmsg_msg_list_free(ret);
 			return NULL;
+		}
 		unlock_session(session);
 	} else {
 		MsgNumberList *sorted_list, *elem, *llast = NULL;
@@ -4806,6 +5810,7 @@ gboolean imap_scan_required(Folder *folder, FolderItem *_item)
 	IMAPFolderItem *item = (IMAPFolderItem *)_item;
 	gint ok, exists = 0, unseen = 0;
 	guint32 uid_next = 0, uid_val = 0;
+	gint new_msgs = 0;
 	gboolean selected_folder;
 	
 	g_return_val_if_fail(folder != NULL, FALSE);
@@ -4879,6 +5884,15 @@ gboolean imap_scan_required(Folder *folder, FolderItem *_item)
 		    || uid_next != item->uid_next
 		    || uid_val != item->item.mtime) {
 			debug_print("CHANGED (status)! scan_required\n");
+			if (uid_val == item->item.mtime && item->uid_next != 0)
+				new_msgs = uid_next > item->uid_next
+					   ? uid_next - item->uid_next : 0;
+			else if (uid_val == item->item.mtime)
+				new_msgs = MAX(exists - item->item.total_msgs, 0);
+			if (new_msgs > 0 && new_msgs <= prefs_common.imap_prefetch_max
+			    && !item->item.opened
+			    && !folder->account->low_bandwidth)
+				imap_prefetch_queue(folder, _item);
 			item->last_change = time(NULL);
 			item->should_update = TRUE;
 			item->uid_next = uid_next;
@@ -4976,23 +5990,24 @@ void imap_change_flags(Folder *folder, FolderItem *item, MsgInfo *msginfo, MsgPe
 				GINT_TO_POINTER(flags_set));
 			if (ht_data == NULL) {
 				ht_data = g_new0(hashtable_data, 1);
+				ht_data->uids = imap_uid_set_new();
 				ht_data->item = IMAP_FOLDER_ITEM(item);
 				g_hash_table_insert(IMAP_FOLDER_ITEM(item)->flags_set_table, 
 					GINT_TO_POINTER(flags_set), ht_data);
 			}
-			ht_data->msglist = g_slist_prepend(ht_data->msglist, GINT_TO_POINTER(msginfo->msgnum));
+			imap_uid_set_add(ht_data->uids, msginfo->msgnum);
 		} 
 		if (flags_unset) {
 			ht_data = g_hash_table_lookup(IMAP_FOLDER_ITEM(item)->flags_unset_table, 
 				GINT_TO_POINTER(flags_unset));
 			if (ht_data == NULL) {
 				ht_data = g_new0(hashtable_data, 1);
+				ht_data->uids = imap_uid_set_new();
 				ht_data->item = IMAP_FOLDER_ITEM(item);
 				g_hash_table_insert(IMAP_FOLDER_ITEM(item)->flags_unset_table, 
 					GINT_TO_POINTER(flags_unset), ht_data);
 			}
-			ht_data->msglist = g_slist_prepend(ht_data->msglist, 
-					GINT_TO_POINTER(msginfo->msgnum));		
+			imap_uid_set_add(ht_data->uids, msginfo->msgnum);
 		}
 	} else {
 		debug_print("IMAP changing flags\n");
@@ -5051,8 +6066,8 @@ static gint imap_remove_msg(Folder *folder, FolderItem *item, gint uid)
 		return ok;
 	}
 
-	IMAP_FOLDER_ITEM(item)->uid_list = g_slist_remove(
-	    IMAP_FOLDER_ITEM(item)->uid_list, numlist.data);
+	if (IMAP_FOLDER_ITEM(item)->uid_set != NULL)
+		imap_uid_set_remove(IMAP_FOLDER_ITEM(item)->uid_set, uid);
 	dir = folder_item_get_path(item);
 	if (is_dir_exist(dir))
 		remove_numbered_files(dir, uid, uid);
@@ -5060,24 +6075,6 @@ static gint imap_remove_msg(Folder *folder, FolderItem *item, gint uid)
 	return MAILIMAP_NO_ERROR;
 }
 
-static gint compare_msginfo(gconstpointer a, gconstpointer b)
-{
-	return ((MsgInfo *)a)->msgnum - ((MsgInfo *)b)->msgnum;
-}
-
-static guint gslist_find_next_num(MsgNumberList **list, guint num)
-{
-	GSList *elem;
-
-	g_return_val_if_fail(list != NULL, -1);
-
-	for (elem = *list; elem != NULL; elem = g_slist_next(elem))
-		if (GPOINTER_TO_INT(elem->data) >= num)
-			break;
-	*list = elem;
-	return elem != NULL ? GPOINTER_TO_INT(elem->data) : (gint)-1;
-}
-
 static gboolean flag_ok(IMAPFolderItem *item, guint flag)
 {
 	if (item->ok_flags && g_slist_find(item->ok_flags, GUINT_TO_POINTER(flag))) {
@@ -5124,13 +6121,13 @@ static /*gint*/ void *imap_get_flags_thread(void *data)
 	GHashTable *flags_hash = NULL;
 	GHashTable *tags_hash = NULL;
 	gboolean full_search = stuff->full_search;
-	GSList *sorted_list = NULL;
-	GSList *unseen = NULL, *answered = NULL, *flagged = NULL, *deleted = NULL, *forwarded = NULL, *spam = NULL;
+	IMAPUidSet *unseen, *answered, *flagged, *deleted, *forwarded, *spam;
 	GSList *seq_list, *cur;
 	gboolean reverse_seen = FALSE;
 	gboolean selected_folder;
 	gint exists_cnt, unseen_cnt;
 	gboolean got_alien_tags = FALSE;
+	gboolean changed_only = FALSE;
 
 	session = imap_session_get(folder);
 
@@ -5158,7 +6155,13 @@ static /*gint*/ void *imap_get_flags_thread(void *data)
 			reverse_seen = TRUE;
 	}
 
-	sorted_list = g_slist_sort(g_slist_copy(msginfo_list), compare_msginfo);
+	unseen = imap_uid_set_new();
+	answered = imap_uid_set_new();
+	flagged = imap_uid_set_new();
+	deleted = imap_uid_set_new();
+	forwarded = imap_uid_set_new();
+	spam = imap_uid_set_new();
+
 	if (!full_search) {
 		seq_list = imap_get_lep_set_from_msglist(IMAP_FOLDER(folder), msginfo_list);
 	} else {
@@ -5170,70 +6173,54 @@ static /*gint*/ void *imap_get_flags_thread(void *data)
 	if (folder->account && folder->account->low_bandwidth) {
 		for (cur = seq_list; cur != NULL; cur = g_slist_next(cur)) {
 			struct mailimap_set * imapset;
-			clist * lep_uidlist;
+			IMAPUidSet * uids;
 			int r;
 
 			imapset = cur->data;
 			if (reverse_seen) {
-				r = imap_threaded_search(folder, IMAP_SEARCH_TYPE_SEEN, NULL,
-							 NULL, full_search ? NULL:imapset, &lep_uidlist);
+				r = imap_search_uids(session, IMAP_SEARCH_TYPE_SEEN, NULL,
+							 NULL, full_search ? NULL:imapset, &uids);
 			}
 			else {
-				r = imap_threaded_search(folder,
+				r = imap_search_uids(session,
 							 IMAP_SEARCH_TYPE_UNSEEN, NULL,
-							 NULL, full_search ? NULL:imapset, &lep_uidlist);
+							 NULL, full_search ? NULL:imapset, &uids);
 			}
 			if (r == MAILIMAP_NO_ERROR) {
-				GSList * uidlist;
-
-				uidlist = imap_uid_list_from_lep(lep_uidlist, NULL);
-				mailimap_search_result_free(lep_uidlist);
-
-				unseen = g_slist_concat(unseen, uidlist);
+				imap_uid_set_union(unseen, uids);
+				imap_uid_set_free(uids);
 			} else {
 				imap_handle_error(SESSION(session), NULL, r);
 				goto bail;
 			}
 
-			r = imap_threaded_search(folder, IMAP_SEARCH_TYPE_FLAGGED, NULL,
-						 NULL, full_search ? NULL:imapset, &lep_uidlist);
+			r = imap_search_uids(session, IMAP_SEARCH_TYPE_FLAGGED, NULL,
+						 NULL, full_search ? NULL:imapset, &uids);
 			if (r == MAILIMAP_NO_ERROR) {
-				GSList * uidlist;
-
-				uidlist = imap_uid_list_from_lep(lep_uidlist, NULL);
-				mailimap_search_result_free(lep_uidlist);
-
-				flagged = g_slist_concat(flagged, uidlist);
+				imap_uid_set_union(flagged, uids);
+				imap_uid_set_free(uids);
 			} else {
 				imap_handle_error(SESSION(session), NULL, r);
 				goto bail;
 			}
 
 			if (fitem->opened || fitem->processing_pending || fitem == folder->inbox) {
-				r = imap_threaded_search(folder, IMAP_SEARCH_TYPE_ANSWERED, NULL,
-							 NULL, full_search ? NULL:imapset, &lep_uidlist);
+				r = imap_search_uids(session, IMAP_SEARCH_TYPE_ANSWERED, NULL,
+							 NULL, full_search ? NULL:imapset, &uids);
 				if (r == MAILIMAP_NO_ERROR) {
-					GSList * uidlist;
-
-					uidlist = imap_uid_list_from_lep(lep_uidlist, NULL);
-					mailimap_search_result_free(lep_uidlist);
-
-					answered = g_slist_concat(answered, uidlist);
+					imap_uid_set_union(answered, uids);
+					imap_uid_set_free(uids);
 				} else {
 					imap_handle_error(SESSION(session), NULL, r);
 					goto bail;
 				}
 
 				if (flag_ok(IMAP_FOLDER_ITEM(fitem), IMAP_FLAG_FORWARDED)) {
-					r = imap_threaded_search(folder, IMAP_SEARCH_TYPE_FORWARDED, NULL,
-								 NULL, full_search ? NULL:imapset, &lep_uidlist);
+					r = imap_search_uids(session, IMAP_SEARCH_TYPE_FORWARDED, NULL,
+								 NULL, full_search ? NULL:imapset, &uids);
 					if (r == MAILIMAP_NO_ERROR) {
-						GSList * uidlist;
-
-						uidlist = imap_uid_list_from_lep(lep_uidlist, NULL);
-						mailimap_search_result_free(lep_uidlist);
-
-						forwarded = g_slist_concat(forwarded, uidlist);
+						imap_uid_set_union(forwarded, uids);
+						imap_uid_set_free(uids);
 					} else {
 						imap_handle_error(SESSION(session), NULL, r);
 						goto bail;
@@ -5241,30 +6228,22 @@ static /*gint*/ void *imap_get_flags_thread(void *data)
 				}
 
 				if (flag_ok(IMAP_FOLDER_ITEM(fitem), IMAP_FLAG_SPAM)) {
-					r = imap_threaded_search(folder, IMAP_SEARCH_TYPE_SPAM, NULL,
-								 NULL, full_search ? NULL:imapset, &lep_uidlist);
+					r = imap_search_uids(session, IMAP_SEARCH_TYPE_SPAM, NULL,
+								 NULL, full_search ? NULL:imapset, &uids);
 					if (r == MAILIMAP_NO_ERROR) {
-						GSList * uidlist;
-
-						uidlist = imap_uid_list_from_lep(lep_uidlist, NULL);
-						mailimap_search_result_free(lep_uidlist);
-
-						spam = g_slist_concat(spam, uidlist);
+						imap_uid_set_union(spam, uids);
+						imap_uid_set_free(uids);
 					} else {
 						imap_handle_error(SESSION(session), NULL, r);
 						goto bail;
 					}
 				}
 
-				r = imap_threaded_search(folder, IMAP_SEARCH_TYPE_DELETED, NULL,
-							 NULL, full_search ? NULL:imapset, &lep_uidlist);
+				r = imap_search_uids(session, IMAP_SEARCH_TYPE_DELETED, NULL,
+							 NULL, full_search ? NULL:imapset, &uids);
 				if (r == MAILIMAP_NO_ERROR) {
-					GSList * uidlist;
-
-					uidlist = imap_uid_list_from_lep(lep_uidlist, NULL);
-					mailimap_search_result_free(lep_uidlist);
-
-					deleted = g_slist_concat(deleted, uidlist);
+					imap_uid_set_union(deleted, uids);
+					imap_uid_set_free(uids);
 				} else {
 					imap_handle_error(SESSION(session), NULL, r);
 					goto bail;
@@ -5272,6 +6251,35 @@ static /*gint*/ void *imap_get_flags_thread(void *data)
 			}
 		}
 
+	} else if (IMAP_FOLDER_ITEM(fitem)->changed_flags != NULL) {
+		/* fetched along with the UIDs by imap_resync_uids() */
+		flags_hash = IMAP_FOLDER_ITEM(fitem)->changed_flags;
+		tags_hash = IMAP_FOLDER_ITEM(fitem)->changed_tags;
+		IMAP_FOLDER_ITEM(fitem)->changed_flags = NULL;
+		IMAP_FOLDER_ITEM(fitem)->changed_tags = NULL;
+		changed_only = TRUE;
+	} else if (IMAP_FOLDER_ITEM(fitem)->highestmodseq != 0
+		   && session->highestmodseq != 0
+		   && session->uid_validity == fitem->mtime) {
+		struct mailimap_set *vanished = NULL;
+		guint64 modseq = 0;
+
+		/* the UIDs are left alone, so this doesn't move highestmodseq */
+		r = imap_threaded_fetch_uid_flags_changed(folder,
+				IMAP_FOLDER_ITEM(fitem)->highestmodseq, FALSE,
+				&lep_uidtab, &vanished, &modseq);
+		if (r == MAILIMAP_NO_ERROR) {
+			if (vanished != NULL)
+				mailimap_set_free(vanished);
+			flags_hash = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
+			tags_hash = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
+			imap_flags_hash_from_lep_uid_flags_tab(lep_uidtab, flags_hash, tags_hash);
+			imap_fetch_uid_flags_list_free(lep_uidtab);
+			changed_only = TRUE;
+		} else {
+			imap_handle_error(SESSION(session), NULL, r);
+			goto bail;
+		}
 	} else {
 		r = imap_threaded_fetch_uid_flags(folder, 1, &lep_uidtab);
 		if (r == MAILIMAP_NO_ERROR) {
@@ -5285,11 +6293,18 @@ static /*gint*/ void *imap_get_flags_thread(void *data)
 		}
 	}
 
+	/* the cached flags are now up to date with the listed UIDs */
+	if (r == MAILIMAP_NO_ERROR && flags_hash != NULL
+	    && IMAP_FOLDER_ITEM(fitem)->resync_modseq != 0) {
+		IMAP_FOLDER_ITEM(fitem)->highestmodseq = IMAP_FOLDER_ITEM(fitem)->resync_modseq;
+		IMAP_FOLDER_ITEM(fitem)->resync_modseq = 0;
+	}
+
 bail:
 	if (r == MAILIMAP_NO_ERROR)
 		unlock_session(session);
 	
-	for (elem = sorted_list; elem != NULL; elem = g_slist_next(elem)) {
+	for (elem = msginfo_list; elem != NULL; elem = g_slist_next(elem)) {
 		MsgInfo *msginfo;
 		MsgPermFlags flags, oldflags;
 		gboolean wasnew;
@@ -5307,7 +6322,7 @@ bail:
 			}
 			if (reverse_seen)
 				flags |= MSG_UNREAD | (wasnew ? MSG_NEW : 0);
-			if (gslist_find_next_num(&unseen, msginfo->msgnum) == msginfo->msgnum) {
+			if (imap_uid_set_contains(unseen, msginfo->msgnum)) {
 				if (!reverse_seen) {
 					flags |= MSG_UNREAD | (wasnew ? MSG_NEW : 0);
 				} else {
@@ -5315,34 +6330,38 @@ bail:
 				}
 			}
 
-			if (gslist_find_next_num(&flagged, msginfo->msgnum) == msginfo->msgnum)
+			if (imap_uid_set_contains(flagged, msginfo->msgnum))
 				flags |= MSG_MARKED;
 			else
 				flags &= ~MSG_MARKED;
 
 			if (fitem->opened || fitem->processing_pending || fitem == folder->inbox) {
-				if (gslist_find_next_num(&answered, msginfo->msgnum) == msginfo->msgnum)
+				if (imap_uid_set_contains(answered, msginfo->msgnum))
 					flags |= MSG_REPLIED;
 				else
 					flags &= ~MSG_REPLIED;
-				if (gslist_find_next_num(&forwarded, msginfo->msgnum) == msginfo->msgnum)
+				if (imap_uid_set_contains(forwarded, msginfo->msgnum))
 					flags |= MSG_FORWARDED;
 				else
 					flags &= ~MSG_FORWARDED;
-				if (gslist_find_next_num(&spam, msginfo->msgnum) == msginfo->msgnum)
+				if (imap_uid_set_contains(spam, msginfo->msgnum))
 					flags |= MSG_SPAM;
 				else
 					flags &= ~MSG_SPAM;
-				if (gslist_find_next_num(&deleted, msginfo->msgnum) == msginfo->msgnum)
+				if (imap_uid_set_contains(deleted, msginfo->msgnum))
 					flags |= MSG_DELETED;
 				else
 					flags &= ~MSG_DELETED;
 			}
 		} else {
 			if (flags_hash != NULL) {
+				gpointer value = NULL;
 
-				flags = GPOINTER_TO_INT(g_hash_table_lookup(flags_hash, 
-						GINT_TO_POINTER(msginfo->msgnum)));
+				if (!g_hash_table_lookup_extended(flags_hash,
+						GINT_TO_POINTER(msginfo->msgnum), NULL, &value)
+				    && changed_only)
+					continue; /* unchanged since the last resync */
+				flags = GPOINTER_TO_INT(value);
 			}
 
 			if ((flags & MSG_UNREAD) == 0)
@@ -5372,6 +6391,7 @@ bail:
 					g_free(real_tag);
 				}
 				slist_free_strings_full(tags);
+				g_hash_table_remove(tags_hash, GINT_TO_POINTER(msginfo->msgnum));
 			}
 		}
 
@@ -5386,16 +6406,15 @@ bail:
 	if (flags_hash)
 		g_hash_table_destroy(flags_hash);
 	if (tags_hash)
-		g_hash_table_destroy(tags_hash);
+		imap_tags_hash_destroy(tags_hash);
 
 	imap_lep_set_free(seq_list);
-	g_slist_free(flagged);
-	g_slist_free(deleted);
-	g_slist_free(answered);
-	g_slist_free(forwarded);
-	g_slist_free(spam);
-	g_slist_free(unseen);
-	g_slist_free(sorted_list);
+	imap_uid_set_free(flagged);
+	imap_uid_set_free(deleted);
+	imap_uid_set_free(answered);
+	imap_uid_set_free(forwarded);
+	imap_uid_set_free(spam);
+	imap_uid_set_free(unseen);
 
 	stuff->done = TRUE;
 	return GINT_TO_POINTER(0);
@@ -5453,12 +6472,10 @@ static gboolean process_flags(gpointer key, gpointer value, gpointer user_data)
 	debug_print("getting session...\n");
 	session = imap_session_get(item->folder);
 
-	data->msglist = g_slist_reverse(data->msglist);
-	
 	debug_print("IMAP %ssetting flags to %d for %d messages\n",
 		flags_set?"":"un",
 		flags_value,
-		g_slist_length(data->msglist));
+		imap_uid_set_count(data->uids));
 	
 	lock_session(session);
 	if (session) {
@@ -5466,8 +6483,8 @@ static gboolean process_flags(gpointer key, gpointer value, gpointer user_data)
 			 NULL, NULL, NULL, NULL, NULL, FALSE);
 	}
 	if (ok == MAILIMAP_NO_ERROR) {
-		ok = imap_set_message_flags(session, IMAP_FOLDER_ITEM(item),
-			data->msglist, flags_value, NULL, flags_set);
+		ok = imap_set_message_flags_uids(session, IMAP_FOLDER_ITEM(item),
+			data->uids, flags_value, NULL, flags_set);
 	} else {
 		g_warning("can't select mailbox %s", item->path);
 	}
@@ -5475,7 +6492,7 @@ static gboolean process_flags(gpointer key, gpointer value, gpointer user_data)
 	if (!is_fatal(ok))
 		unlock_session(session);
 
-	g_slist_free(data->msglist);	
+	imap_uid_set_free(data->uids);
 	g_free(data);
 	return TRUE;
 }
@@ -5493,12 +6510,10 @@ static gboolean process_tags(gpointer key, gpointer value, gpointer user_data)
 	debug_print("getting session...\n");
 	session = imap_session_get(item->folder);
 
-	data->msglist = g_slist_reverse(data->msglist);
-	
 	debug_print("IMAP %ssetting tags %s for %d messages\n",
 		tags_set?"":"un",
 		str,
-		g_slist_length(data->msglist));
+		imap_uid_set_count(data->uids));
 	
 	lock_session(session);
 	if (session) {
@@ -5509,8 +6524,8 @@ static gboolean process_tags(gpointer key, gpointer value, gpointer user_data)
 		GSList list;
 		list.data = str;
 		list.next = NULL;
-		ok = imap_set_message_flags(session, IMAP_FOLDER_ITEM(item),
-			data->msglist, 0, &list, tags_set);
+		ok = imap_set_message_flags_uids(session, IMAP_FOLDER_ITEM(item),
+			data->uids, 0, &list, tags_set);
 	} else {
 		g_warning("can't select mailbox %s", item->path);
 	}
@@ -5518,7 +6533,7 @@ static gboolean process_tags(gpointer key, gpointer value, gpointer user_data)
 	if (!is_fatal(ok))
 		unlock_session(session);
 
-	g_slist_free(data->msglist);	
+	imap_uid_set_free(data->uids);
 	g_free(data->str);
 	g_free(data);
 	return TRUE;
@@ -5722,66 +6737,17 @@ static GSList * imap_list_from_lep(IMAPFolder * folder,
 
 static GSList * imap_get_lep_set_from_numlist(IMAPFolder *folder, MsgNumberList *numlist)
 {
-	GSList *sorted_list, *cur;
-	guint first, last, next;
-	GSList *ret_list = NULL, *llast = NULL;
-	struct mailimap_set * current_set;
-	unsigned int item_count;
-	
+	IMAPUidSet *uids;
+	GSList *seq_list;
+
 	if (numlist == NULL)
 		return NULL;
-	
-	current_set = mailimap_set_new_empty();
-	
-	sorted_list = g_slist_copy(numlist);
-	sorted_list = g_slist_sort(sorted_list, g_int_compare);
-
-	first = GPOINTER_TO_INT(sorted_list->data);
-	
-	item_count = 0;
-	for (cur = sorted_list; cur != NULL; cur = g_slist_next(cur)) {
-		if (GPOINTER_TO_INT(cur->data) == 0)
-			continue;
-		
-		item_count ++;
-
-		last = GPOINTER_TO_INT(cur->data);
-		if (cur->next)
-			next = GPOINTER_TO_INT(cur->next->data);
-		else
-			next = 0;
-
-		if (last + 1 != next || next == 0 || item_count >= folder->max_set_size) {
-
-			struct mailimap_set_item * item;
-			item = mailimap_set_item_new(first, last);
-			mailimap_set_add(current_set, item);
-			
-			first = next;
-
-			if (item_count >= folder->max_set_size) {
-				if (ret_list == NULL)
-					llast = ret_list = g_slist_append(ret_list,
-							  current_set);
-				else {
-					llast = g_slist_append(llast, current_set);
-					llast = llast->next;
-				}
 
-				current_set = mailimap_set_new_empty();
-				item_count = 0;
-			}
-		} 
-	}
-	
-	if (clist_count(current_set->set_list) > 0) {
-		ret_list = g_slist_append(ret_list,
-					  current_set);
-	}
-	
-	g_slist_free(sorted_list);
+	uids = imap_uid_set_new_from_list(numlist);
+	seq_list = imap_uid_set_to_lep_sets(uids, folder->max_set_size);
+	imap_uid_set_free(uids);
 
-	return ret_list;
+	return seq_list;
 }
 
 static GSList * imap_get_lep_set_from_msglist(IMAPFolder *folder, MsgInfoList *msglist)
@@ -5797,44 +6763,19 @@ static GSList * imap_get_lep_set_from_msglist(IMAPFolder *folder, MsgInfoList *m
 	return seq_list;
 }
 
-static GSList * imap_uid_list_from_lep(clist * list, gint* length)
-{
-	clistiter * iter;
-	GSList * result;
-	gint len = 0;
-	
-	result = NULL;
-	
-	if (list) {
-		for(iter = clist_begin(list) ; iter != NULL ;
-		    iter = clist_next(iter)) {
-			uint32_t * puid;
-
-			puid = clist_content(iter);
-			result = g_slist_prepend(result, GINT_TO_POINTER(* puid));
-			len++;
-		}
-		result = g_slist_reverse(result);
-	}
-	if (length)
-		*length = len;
-	return result;
-}
-
-static GSList * imap_uid_list_from_lep_tab(carray * list)
+static IMAPUidSet * imap_uid_set_from_lep_tab(carray * list)
 {
+	IMAPUidSet * result;
 	unsigned int i;
-	GSList * result;
 	
-	result = NULL;
+	result = imap_uid_set_new();
 	
 	for(i = 0 ; i < carray_count(list) ; i ++) {
 		uint32_t * puid;
 		
 		puid = carray_get(list, i);
-		result = g_slist_prepend(result, GINT_TO_POINTER(* puid));
+		imap_uid_set_add(result, * puid);
 	}
-	result = g_slist_reverse(result);
 	return result;
 }
 
@@ -5979,6 +6920,13 @@ void imap_disconnect_all(gboolean have_connectivity)
 		PrefsAccount *account = list->data;
 		if (account->protocol == A_IMAP4) {
 			RemoteFolder *folder = (RemoteFolder *)account->folder;
+			if (folder) {
+				imap_threaded_idle_stop(FOLDER(folder), have_connectivity);
+				/* let the downloads of a synchronisation end */
+				if (have_connectivity)
+					imap_threaded_pool_wait(FOLDER(folder));
+				imap_threaded_pool_stop(FOLDER(folder), have_connectivity);
+			}
 			if (folder && folder->session) {
 				if (imap_is_busy(FOLDER(folder)))
 					imap_threaded_cancel(FOLDER(folder));
@@ -6148,6 +7096,10 @@ void imap_cache_msg(FolderItem *item, gint msgnum)
 {
 }
 
+void imap_cache_msgs(FolderItem *item, GSList *msgnum_list)
+{
+}
+
 void imap_cancel_all(void)
 {
 }
@@ -6190,6 +7142,8 @@ static void imap_item_set_xml(Folder *folder, FolderItem *item, XMLTag *tag)
 			IMAP_FOLDER_ITEM(item)->last_sync = atoi(attr->value);
 		if (!strcmp(attr->name, "last_change"))
 			IMAP_FOLDER_ITEM(item)->last_change = atoi(attr->value);
+		if (!strcmp(attr->name, "highestmodseq"))
+			IMAP_FOLDER_ITEM(item)->highestmodseq = g_ascii_strtoull(attr->value, NULL, 10);
 	}
 	if (IMAP_FOLDER_ITEM(item)->last_change == 0)
 		IMAP_FOLDER_ITEM(item)->last_change = time(NULL);
@@ -6209,6 +7163,12 @@ static XMLTag *imap_item_get_xml(Folder *folder, FolderItem *item)
 			IMAP_FOLDER_ITEM(item)->last_sync));
 	xml_tag_add_attr(tag, xml_attr_new_int("last_change", 
 			IMAP_FOLDER_ITEM(item)->last_change));
+	if (IMAP_FOLDER_ITEM(item)->highestmodseq != 0) {
+		gchar *modseq = g_strdup_printf("%"G_GUINT64_FORMAT,
+				IMAP_FOLDER_ITEM(item)->highestmodseq);
+		xml_tag_add_attr(tag, xml_attr_new("highestmodseq", modseq));
+		g_free(modseq);
+	}
 
 #endif
 	return tag;
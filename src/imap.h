@@ -43,6 +43,7 @@ void imap_disconnect_all(gboolean have_connectivity);
 gint imap_subscribe(Folder *folder, FolderItem *item, gchar *rpath, gboolean sub);
 GList *imap_scan_subtree(Folder *folder, FolderItem *item, gboolean unsubs_only, gboolean recursive);
 void imap_cache_msg(FolderItem *item, gint msgnum);
+void imap_cache_msgs(FolderItem *item, GSList *msgnum_list);
 
 void imap_cancel_all(void);
 gboolean imap_cancel_all_enabled(void);
@@ -443,13 +443,15 @@ void imap_gtk_synchronise(FolderItem *item, gint days)
 		gint num = 0;
 		gint total = item->total_msgs;
 		time_t t = time(NULL);
+		GSList *msgnum_list = NULL;
 
 		mlist = folder_item_get_msg_list(item);
 		for (cur = mlist; cur != NULL; cur = cur->next) {
 			MsgInfo *msginfo = (MsgInfo *)cur->data;
 			gint age = (t - msginfo->date_t) / (60*60*24);
 			if (days == 0 || age <= days)
-				imap_cache_msg(msginfo->folder, msginfo->msgnum);
+				msgnum_list = g_slist_prepend(msgnum_list,
+						GINT_TO_POINTER(msginfo->msgnum));
 			statusbar_progress_all(num++,total, 100);
 			if (num % 100 == 0)
 				GTK_EVENTS_FLUSH();
@@ -457,6 +459,12 @@ void imap_gtk_synchronise(FolderItem *item, gint days)
 
 		statusbar_progress_all(0,0,0);
 		procmsg_msg_list_free(mlist);
+
+		/* may return before the messages are downloaded, see
+		 * imap_cache_msgs() */
+		msgnum_list = g_slist_reverse(msgnum_list);
+		imap_cache_msgs(item, msgnum_list);
+		g_slist_free(msgnum_list);
 	}
 
 	folder_set_ui_func(item->folder, NULL, NULL);
@@ -228,6 +228,7 @@ static void open_compose_new		(const gchar	*address,
 
 static void send_queue			(void);
 static void initial_processing		(FolderItem *item, gpointer data);
+static void prefetch_processing_cache	(FolderItem *item, gpointer data);
 static void quit_signal_handler         (int sig);
 static void install_basic_sighandlers   (void);
 #if (defined linux && defined SIGIO)
@@ -1428,6 +1429,7 @@ int main(int argc, char *argv[])
 
 	/* make one all-folder processing before using claws */
 	main_window_cursor_wait(mainwin);
+	folder_func_to_all_folders(prefetch_processing_cache, NULL);
 	folder_func_to_all_folders(initial_processing, (gpointer *)mainwin);
 
 	/* if claws crashed, rebuild caches */
@@ -2074,6 +2076,12 @@ static void parse_cmd_opt(int argc, char *argv[])
 	}
 }
 
+static void prefetch_processing_cache(FolderItem *item, gpointer data)
+{
+	if (folder_item_parent(item) != NULL && item->prefs->enable_processing)
+		folder_item_prefetch_cache(item, FALSE);
+}
+
 static void initial_processing(FolderItem *item, gpointer data)
 {
 	MainWindow *mainwin = (MainWindow *)data;
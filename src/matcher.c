@@ -209,6 +209,10 @@ enum {
 
 static gchar *context_str[N_CONTEXT_STRS];
 
+/* bumped each time a MatcherProp is freed, so that a program never
+ * refers to a freed condition */
+static guint matcher_generation = 0;
+
 void matcher_init(void)
 {
 	if (context_str[CONTEXT_SUBJECT] != NULL)
@@ -340,6 +344,7 @@ MatcherProp *matcherprop_new(gint criteria, const gchar *header,
  */
 void matcherprop_free(MatcherProp *prop)
 {
+	matcher_generation++;
 	g_free(prop->expr);
 	g_free(prop->header);
 #ifndef G_OS_WIN32
@@ -466,6 +471,436 @@ static gboolean match_with_addresses_in_addressbook
 	return found;
 }
 
+/* ********************* MatcherProgram *************************** */
+
+/*
+ * A MatcherProgram is built from a set of matcher lists (typically all
+ * the rules of one filtering list) and evaluates, once per message, all
+ * "contains" conditions on the headers stored in MsgInfo: the patterns
+ * testing the same header are merged into one Aho-Corasick automaton
+ * which is run over the header value a single time, and the result of
+ * each condition is stored in its MatcherProp for matcherprop_string_match()
+ * to pick up. Casefolded header values are shared by all the conditions
+ * while the program is running.
+ */
+
+#define MATCHER_N_FIELDS	CONTEXT_REFERENCES
+
+typedef struct _MatcherACState MatcherACState;
+typedef struct _MatcherAutomaton MatcherAutomaton;
+
+struct _MatcherACState {
+	gint child;		/* first child state, or 0 */
+	gint sibling;		/* next state with the same parent, or 0 */
+	gint fail;		/* longest proper suffix in the trie */
+	gint out;		/* nearest state on the fail chain with props */
+	GSList *props;		/* conditions whose pattern ends here */
+	guchar label;
+};
+
+struct _MatcherAutomaton {
+	GArray *states;		/* MatcherACState, state 0 is the root */
+	GSList *props;		/* all the conditions of this automaton */
+	GSList *empty;		/* conditions with an empty pattern */
+};
+
+struct _MatcherProgram {
+	/* automatons[field][casefold] */
+	MatcherAutomaton *automatons[MATCHER_N_FIELDS][2];
+	guint generation;
+	guint n_props;
+};
+
+/* message being evaluated by the running program */
+static MsgInfo *matcher_program_info = NULL;
+static guint matcher_program_stamp = 0;
+static gchar *matcher_casefold_cache[MATCHER_N_FIELDS];
+
+#define AC_STATE(states, i) (&g_array_index((states), MatcherACState, (i)))
+
+static const gchar *matcher_msginfo_field(MsgInfo *info, gint field)
+{
+	switch (field) {
+	case CONTEXT_SUBJECT:
+		return info->subject;
+	case CONTEXT_FROM:
+		return info->from;
+	case CONTEXT_TO:
+		return info->to;
+	case CONTEXT_CC:
+		return info->cc;
+	case CONTEXT_NEWSGROUPS:
+		return info->newsgroups;
+	case CONTEXT_MESSAGEID:
+		return info->msgid;
+	case CONTEXT_IN_REPLY_TO:
+		return info->inreplyto;
+	default:
+		return NULL;
+	}
+}
+
+/*!
+ *\brief	Casefold a string, reusing the casefolded header values
+ *		of the message evaluated by the running program
+ *
+ *\param	str String to casefold
+ *\param	should_free Set to TRUE if the returned string must be freed
+ */
+static gchar *matcher_casefold(const gchar *str, gboolean *should_free)
+{
+	gint field;
+
+	if (matcher_program_info != NULL) {
+		for (field = 0; field < MATCHER_N_FIELDS; field++) {
+			if (matcher_msginfo_field(matcher_program_info, field) != str)
+				continue;
+			if (matcher_casefold_cache[field] == NULL)
+				matcher_casefold_cache[field] = g_utf8_casefold(str, -1);
+			*should_free = FALSE;
+			return matcher_casefold_cache[field];
+		}
+	}
+
+	*should_free = TRUE;
+	return g_utf8_casefold(str, -1);
+}
+
+/* field tested by a "contains" condition that a program can compile,
+ * or -1 */
+static gint matcherprop_program_field(MatcherProp *prop)
+{
+	if (prop->expr == NULL)
+		return -1;
+	if (prop->matchtype != MATCHTYPE_MATCH &&
+	    prop->matchtype != MATCHTYPE_MATCHCASE)
+		return -1;
+
+	switch (prop->criteria) {
+	case MATCHCRITERIA_SUBJECT:
+	case MATCHCRITERIA_NOT_SUBJECT:
+		return CONTEXT_SUBJECT;
+	case MATCHCRITERIA_FROM:
+	case MATCHCRITERIA_NOT_FROM:
+		return CONTEXT_FROM;
+	case MATCHCRITERIA_TO:
+	case MATCHCRITERIA_NOT_TO:
+		return CONTEXT_TO;
+	case MATCHCRITERIA_CC:
+	case MATCHCRITERIA_NOT_CC:
+		return CONTEXT_CC;
+	case MATCHCRITERIA_NEWSGROUPS:
+	case MATCHCRITERIA_NOT_NEWSGROUPS:
+		return CONTEXT_NEWSGROUPS;
+	case MATCHCRITERIA_MESSAGEID:
+	case MATCHCRITERIA_NOT_MESSAGEID:
+		return CONTEXT_MESSAGEID;
+	case MATCHCRITERIA_INREPLYTO:
+	case MATCHCRITERIA_NOT_INREPLYTO:
+		return CONTEXT_IN_REPLY_TO;
+	default:
+		return -1;
+	}
+}
+
+static gint matcher_automaton_goto(GArray *states, gint state, guchar c)
+{
+	gint s;
+
+	for (s = AC_STATE(states, state)->child; s != 0;
+	     s = AC_STATE(states, s)->sibling) {
+		if (AC_STATE(states, s)->label == c)
+			return s;
+	}
+	return -1;
+}
+
+static MatcherAutomaton *matcher_automaton_new(void)
+{
+	MatcherAutomaton *ac = g_new0(MatcherAutomaton, 1);
+	MatcherACState root = { 0 };
+
+	ac->states = g_array_new(FALSE, FALSE, sizeof(MatcherACState));
+	g_array_append_val(ac->states, root);
+
+	return ac;
+}
+
+static void matcher_automaton_add(MatcherAutomaton *ac, MatcherProp *prop,
+				  const gchar *pattern)
+{
+	const guchar *p;
+	gint state = 0;
+
+	ac->props = g_slist_prepend(ac->props, prop);
+
+	if (*pattern == '\0') {
+		ac->empty = g_slist_prepend(ac->empty, prop);
+		return;
+	}
+
+	for (p = (const guchar *)pattern; *p != '\0'; p++) {
+		gint next = matcher_automaton_goto(ac->states, state, *p);
+
+		if (next < 0) {
+			MatcherACState new_state = { 0 };
+
+			new_state.label = *p;
+			new_state.sibling = AC_STATE(ac->states, state)->child;
+			g_array_append_val(ac->states, new_state);
+			next = ac->states->len - 1;
+			AC_STATE(ac->states, state)->child = next;
+		}
+		state = next;
+	}
+
+	AC_STATE(ac->states, state)->props =
+		g_slist_prepend(AC_STATE(ac->states, state)->props, prop);
+}
+
+/* compute the failure and output links, breadth first */
+static void matcher_automaton_link(MatcherAutomaton *ac)
+{
+	GArray *states = ac->states;
+	GQueue queue = G_QUEUE_INIT;
+	gint s;
+
+	for (s = AC_STATE(states, 0)->child; s != 0;
+	     s = AC_STATE(states, s)->sibling)
+		g_queue_push_tail(&queue, GINT_TO_POINTER(s));
+
+	while (!g_queue_is_empty(&queue)) {
+		gint r = GPOINTER_TO_INT(g_queue_pop_head(&queue));
+
+		for (s = AC_STATE(states, r)->child; s != 0;
+		     s = AC_STATE(states, s)->sibling) {
+			guchar c = AC_STATE(states, s)->label;
+			gint f = AC_STATE(states, r)->fail;
+			gint next;
+
+			while (f != 0 &&
+			       matcher_automaton_goto(states, f, c) < 0)
+				f = AC_STATE(states, f)->fail;
+			next = matcher_automaton_goto(states, f, c);
+			if (next < 0 || next == s)
+				next = 0;
+
+			AC_STATE(states, s)->fail = next;
+			AC_STATE(states, s)->out =
+				AC_STATE(states, next)->props != NULL ?
+				next : AC_STATE(states, next)->out;
+
+			g_queue_push_tail(&queue, GINT_TO_POINTER(s));
+		}
+	}
+}
+
+static void matcher_automaton_free(MatcherAutomaton *ac)
+{
+	guint i;
+
+	if (ac == NULL)
+		return;
+
+	for (i = 0; i < ac->states->len; i++)
+		g_slist_free(AC_STATE(ac->states, i)->props);
+	g_array_free(ac->states, TRUE);
+	g_slist_free(ac->props);
+	g_slist_free(ac->empty);
+	g_free(ac);
+}
+
+static void matcher_automaton_set_result(GSList *props, gboolean result)
+{
+	for (; props != NULL; props = props->next) {
+		MatcherProp *prop = (MatcherProp *)props->data;
+
+		prop->program_result = result;
+	}
+}
+
+static void matcher_automaton_run(MatcherAutomaton *ac, const gchar *str,
+				  const gchar *text)
+{
+	GArray *states = ac->states;
+	const guchar *p;
+	GSList *cur;
+	gint state = 0;
+
+	for (cur = ac->props; cur != NULL; cur = cur->next) {
+		MatcherProp *prop = (MatcherProp *)cur->data;
+
+		prop->program_stamp = matcher_program_stamp;
+		prop->program_str = str;
+		prop->program_result = FALSE;
+	}
+
+	if (text == NULL)
+		return;
+
+	matcher_automaton_set_result(ac->empty, TRUE);
+
+	for (p = (const guchar *)text; *p != '\0'; p++) {
+		gint next;
+
+		while (state != 0 &&
+		       matcher_automaton_goto(states, state, *p) < 0)
+			state = AC_STATE(states, state)->fail;
+		next = matcher_automaton_goto(states, state, *p);
+		state = next < 0 ? 0 : next;
+
+		for (next = AC_STATE(states, state)->props != NULL ?
+			    state : AC_STATE(states, state)->out;
+		     next != 0; next = AC_STATE(states, next)->out)
+			matcher_automaton_set_result(
+				AC_STATE(states, next)->props, TRUE);
+	}
+}
+
+/*!
+ *\brief	Compile the "contains" conditions on message headers
+ *		of several lists of conditions
+ *
+ *\param	lists List of MatcherList *
+ *
+ *\return	MatcherProgram * Program, free with #matcher_program_free
+ */
+MatcherProgram *matcher_program_new(GSList *lists)
+{
+	MatcherProgram *program = g_new0(MatcherProgram, 1);
+	gint field, casefold;
+
+	program->generation = matcher_generation;
+
+	for (; lists != NULL; lists = lists->next) {
+		MatcherList *matchers = (MatcherList *)lists->data;
+		GSList *cur;
+
+		if (matchers == NULL)
+			continue;
+
+		for (cur = matchers->matchers; cur != NULL; cur = cur->next) {
+			MatcherProp *prop = (MatcherProp *)cur->data;
+			const gchar *pattern;
+
+			field = matcherprop_program_field(prop);
+			if (field < 0)
+				continue;
+
+			casefold = (prop->matchtype == MATCHTYPE_MATCHCASE);
+			if (casefold) {
+				if (!prop->casefold_expr)
+					prop->casefold_expr = g_utf8_casefold(prop->expr, -1);
+				pattern = prop->casefold_expr;
+			} else {
+				pattern = prop->expr;
+			}
+
+			if (program->automatons[field][casefold] == NULL)
+				program->automatons[field][casefold] =
+					matcher_automaton_new();
+			matcher_automaton_add(program->automatons[field][casefold],
+					      prop, pattern);
+			program->n_props++;
+		}
+	}
+
+	for (field = 0; field < MATCHER_N_FIELDS; field++) {
+		for (casefold = 0; casefold < 2; casefold++) {
+			if (program->automatons[field][casefold] != NULL)
+				matcher_automaton_link(program->automatons[field][casefold]);
+		}
+	}
+
+	debug_print("compiled %d header conditions\n", program->n_props);
+
+	return program;
+}
+
+void matcher_program_free(MatcherProgram *program)
+{
+	gint field, casefold;
+
+	if (program == NULL)
+		return;
+
+	for (field = 0; field < MATCHER_N_FIELDS; field++)
+		for (casefold = 0; casefold < 2; casefold++)
+			matcher_automaton_free(program->automatons[field][casefold]);
+	g_free(program);
+}
+
+/*!
+ *\brief	Check that none of the conditions of a program were freed
+ *		since it was compiled
+ */
+gboolean matcher_program_is_valid(MatcherProgram *program)
+{
+	cm_return_val_if_fail(program != NULL, FALSE);
+
+	return program->generation == matcher_generation;
+}
+
+/*!
+ *\brief	Evaluate the compiled conditions of a program on a message.
+ *		Until #matcher_program_finish is called, matching these
+ *		conditions on the message only looks up the results.
+ *
+ *\param	program Program, must be valid
+ *\param	info Message
+ */
+void matcher_program_run(MatcherProgram *program, MsgInfo *info)
+{
+	gint field, casefold;
+
+	cm_return_if_fail(program != NULL);
+	cm_return_if_fail(info != NULL);
+	cm_return_if_fail(matcher_program_is_valid(program));
+
+	matcher_program_finish(program);
+	matcher_program_info = info;
+
+	for (field = 0; field < MATCHER_N_FIELDS; field++) {
+		const gchar *str = matcher_msginfo_field(info, field);
+
+		for (casefold = 0; casefold < 2; casefold++) {
+			MatcherAutomaton *ac = program->automatons[field][casefold];
+			const gchar *text = str;
+			gboolean should_free = FALSE;
+
+			if (ac == NULL)
+				continue;
+			if (casefold && str != NULL)
+				text = matcher_casefold(str, &should_free);
+			matcher_automaton_run(ac, str, text);
+			if (should_free)
+				g_free((gchar *)text);
+		}
+	}
+}
+
+void matcher_program_finish(MatcherProgram *program)
+{
+	gint field;
+
+	/* results of the previous run don't apply anymore */
+	matcher_program_stamp++;
+	matcher_program_info = NULL;
+
+	for (field = 0; field < MATCHER_N_FIELDS; field++) {
+		g_free(matcher_casefold_cache[field]);
+		matcher_casefold_cache[field] = NULL;
+	}
+}
+
+/* TRUE if the result of prop on str was computed by the running program */
+static gboolean matcherprop_program_done(MatcherProp *prop, const gchar *str)
+{
+	return matcher_program_info != NULL &&
+		prop->program_stamp == matcher_program_stamp &&
+		prop->program_str == str;
+}
+
 /*!
  *\brief	Find out if a string matches a condition
  *
@@ -485,15 +920,17 @@ static gboolean matcherprop_string_match(MatcherProp *prop, const gchar *str,
 	if (str == NULL)
 		return FALSE;
 
+	/* the debug output needs the match to be done again */
+	if (!debug_filtering_session && matcherprop_program_done(prop, str))
+		return prop->program_result;
+
 	if (prop->matchtype == MATCHTYPE_REGEXPCASE ||
 	    prop->matchtype == MATCHTYPE_MATCHCASE) {
-		str1 = g_utf8_casefold(str, -1);
+		str1 = matcher_casefold(str, &should_free);
 		if (!prop->casefold_expr) {
 			prop->casefold_expr = g_utf8_casefold(prop->expr, -1);
 		}
 		down_expr = prop->casefold_expr;
-
-		should_free = TRUE;
 	} else {
 		str1 = (gchar *)str;
 		down_expr = (gchar *)prop->expr;
@@ -1872,6 +2309,103 @@ static gboolean matcherlist_match_file(MatcherList *matchers, MsgInfo *info,
 	return result;
 }
 
+/* evaluation cost of the conditions tested on MsgInfo */
+enum {
+	MATCHER_COST_CHEAP,	/* flags, numbers and precomputed results */
+	MATCHER_COST_STRING,	/* string and regexp matches */
+	MATCHER_COST_COMMAND,	/* running an external command */
+	MATCHER_N_COSTS
+};
+
+/*!
+ *\brief	Get the evaluation cost of a condition on a message
+ *
+ *\return	gint MATCHER_COST_XXX, or -1 if the condition is tested
+ *		on the message file
+ */
+static gint matcherprop_cost(MatcherProp *prop, MsgInfo *info)
+{
+	gint field;
+
+	switch(prop->criteria) {
+	case MATCHCRITERIA_TEST:
+	case MATCHCRITERIA_NOT_TEST:
+		return MATCHER_COST_COMMAND;
+	case MATCHCRITERIA_SUBJECT:
+	case MATCHCRITERIA_NOT_SUBJECT:
+	case MATCHCRITERIA_FROM:
+	case MATCHCRITERIA_NOT_FROM:
+	case MATCHCRITERIA_TO:
+	case MATCHCRITERIA_NOT_TO:
+	case MATCHCRITERIA_CC:
+	case MATCHCRITERIA_NOT_CC:
+	case MATCHCRITERIA_NEWSGROUPS:
+	case MATCHCRITERIA_NOT_NEWSGROUPS:
+	case MATCHCRITERIA_MESSAGEID:
+	case MATCHCRITERIA_NOT_MESSAGEID:
+	case MATCHCRITERIA_INREPLYTO:
+	case MATCHCRITERIA_NOT_INREPLYTO:
+		field = matcherprop_program_field(prop);
+		if (field >= 0 && matcherprop_program_done(prop,
+				matcher_msginfo_field(info, field)))
+			return MATCHER_COST_CHEAP;
+		return MATCHER_COST_STRING;
+	case MATCHCRITERIA_TO_OR_CC:
+	case MATCHCRITERIA_NOT_TO_AND_NOT_CC:
+	case MATCHCRITERIA_TAG:
+	case MATCHCRITERIA_NOT_TAG:
+	case MATCHCRITERIA_REFERENCES:
+	case MATCHCRITERIA_NOT_REFERENCES:
+		return MATCHER_COST_STRING;
+	case MATCHCRITERIA_ALL:
+	case MATCHCRITERIA_UNREAD:
+	case MATCHCRITERIA_NOT_UNREAD:
+	case MATCHCRITERIA_NEW:
+	case MATCHCRITERIA_NOT_NEW:
+	case MATCHCRITERIA_MARKED:
+	case MATCHCRITERIA_NOT_MARKED:
+	case MATCHCRITERIA_DELETED:
+	case MATCHCRITERIA_NOT_DELETED:
+	case MATCHCRITERIA_REPLIED:
+	case MATCHCRITERIA_NOT_REPLIED:
+	case MATCHCRITERIA_FORWARDED:
+	case MATCHCRITERIA_NOT_FORWARDED:
+	case MATCHCRITERIA_LOCKED:
+	case MATCHCRITERIA_NOT_LOCKED:
+	case MATCHCRITERIA_SPAM:
+	case MATCHCRITERIA_NOT_SPAM:
+	case MATCHCRITERIA_HAS_ATTACHMENT:
+	case MATCHCRITERIA_HAS_NO_ATTACHMENT:
+	case MATCHCRITERIA_SIGNED:
+	case MATCHCRITERIA_NOT_SIGNED:
+	case MATCHCRITERIA_COLORLABEL:
+	case MATCHCRITERIA_NOT_COLORLABEL:
+	case MATCHCRITERIA_IGNORE_THREAD:
+	case MATCHCRITERIA_NOT_IGNORE_THREAD:
+	case MATCHCRITERIA_WATCH_THREAD:
+	case MATCHCRITERIA_NOT_WATCH_THREAD:
+	case MATCHCRITERIA_TAGGED:
+	case MATCHCRITERIA_NOT_TAGGED:
+	case MATCHCRITERIA_AGE_GREATER:
+	case MATCHCRITERIA_AGE_LOWER:
+	case MATCHCRITERIA_AGE_GREATER_HOURS:
+	case MATCHCRITERIA_AGE_LOWER_HOURS:
+	case MATCHCRITERIA_DATE_AFTER:
+	case MATCHCRITERIA_DATE_BEFORE:
+	case MATCHCRITERIA_SCORE_GREATER:
+	case MATCHCRITERIA_SCORE_LOWER:
+	case MATCHCRITERIA_SCORE_EQUAL:
+	case MATCHCRITERIA_SIZE_GREATER:
+	case MATCHCRITERIA_SIZE_SMALLER:
+	case MATCHCRITERIA_SIZE_EQUAL:
+	case MATCHCRITERIA_PARTIAL:
+	case MATCHCRITERIA_NOT_PARTIAL:
+		return MATCHER_COST_CHEAP;
+	default:
+		return -1;
+	}
+}
+
 /*!
  *\brief	Test list of conditions on a message.
  *
@@ -1884,6 +2418,7 @@ gboolean matcherlist_match(MatcherList *matchers, MsgInfo *info)
 {
 	GSList *l;
 	gboolean result;
+	gint cost;
 
 	if (!matchers)
 		return FALSE;
@@ -1893,83 +2428,21 @@ gboolean matcherlist_match(MatcherList *matchers, MsgInfo *info)
 	else
 		result = FALSE;
 
-	/* test the cached elements */
+	/* test the cached elements, cheapest first */
 
-	for (l = matchers->matchers; l != NULL ;l = g_slist_next(l)) {
-		MatcherProp *matcher = (MatcherProp *) l->data;
+	for (cost = 0; cost < MATCHER_N_COSTS; cost++) {
+		for (l = matchers->matchers; l != NULL ;l = g_slist_next(l)) {
+			MatcherProp *matcher = (MatcherProp *) l->data;
 
-		if (debug_filtering_session) {
-			gchar *buf = matcherprop_to_string(matcher);
-			log_print(LOG_DEBUG_FILTERING, _("checking if message matches [ %s ]\n"), buf);
-			g_free(buf);
-		}
+			if (matcherprop_cost(matcher, info) != cost)
+				continue;
+
+			if (debug_filtering_session) {
+				gchar *buf = matcherprop_to_string(matcher);
+				log_print(LOG_DEBUG_FILTERING, _("checking if message matches [ %s ]\n"), buf);
+				g_free(buf);
+			}
 
-		switch(matcher->criteria) {
-		case MATCHCRITERIA_ALL:
-		case MATCHCRITERIA_UNREAD:
-		case MATCHCRITERIA_NOT_UNREAD:
-		case MATCHCRITERIA_NEW:
-		case MATCHCRITERIA_NOT_NEW:
-		case MATCHCRITERIA_MARKED:
-		case MATCHCRITERIA_NOT_MARKED:
-		case MATCHCRITERIA_DELETED:
-		case MATCHCRITERIA_NOT_DELETED:
-		case MATCHCRITERIA_REPLIED:
-		case MATCHCRITERIA_NOT_REPLIED:
-		case MATCHCRITERIA_FORWARDED:
-		case MATCHCRITERIA_NOT_FORWARDED:
-		case MATCHCRITERIA_LOCKED:
-		case MATCHCRITERIA_NOT_LOCKED:
-		case MATCHCRITERIA_SPAM:
-		case MATCHCRITERIA_NOT_SPAM:
-		case MATCHCRITERIA_HAS_ATTACHMENT:
-		case MATCHCRITERIA_HAS_NO_ATTACHMENT:
-		case MATCHCRITERIA_SIGNED:
-		case MATCHCRITERIA_NOT_SIGNED:
-		case MATCHCRITERIA_COLORLABEL:
-		case MATCHCRITERIA_NOT_COLORLABEL:
-		case MATCHCRITERIA_IGNORE_THREAD:
-		case MATCHCRITERIA_NOT_IGNORE_THREAD:
-		case MATCHCRITERIA_WATCH_THREAD:
-		case MATCHCRITERIA_NOT_WATCH_THREAD:
-		case MATCHCRITERIA_SUBJECT:
-		case MATCHCRITERIA_NOT_SUBJECT:
-		case MATCHCRITERIA_FROM:
-		case MATCHCRITERIA_NOT_FROM:
-		case MATCHCRITERIA_TO:
-		case MATCHCRITERIA_NOT_TO:
-		case MATCHCRITERIA_CC:
-		case MATCHCRITERIA_NOT_CC:
-		case MATCHCRITERIA_TO_OR_CC:
-		case MATCHCRITERIA_NOT_TO_AND_NOT_CC:
-		case MATCHCRITERIA_TAG:
-		case MATCHCRITERIA_NOT_TAG:
-		case MATCHCRITERIA_TAGGED:
-		case MATCHCRITERIA_NOT_TAGGED:
-		case MATCHCRITERIA_AGE_GREATER:
-		case MATCHCRITERIA_AGE_LOWER:
-		case MATCHCRITERIA_AGE_GREATER_HOURS:
-		case MATCHCRITERIA_AGE_LOWER_HOURS:
-		case MATCHCRITERIA_DATE_AFTER:
-		case MATCHCRITERIA_DATE_BEFORE:
-		case MATCHCRITERIA_NEWSGROUPS:
-		case MATCHCRITERIA_NOT_NEWSGROUPS:
-		case MATCHCRITERIA_MESSAGEID:
-		case MATCHCRITERIA_NOT_MESSAGEID:
-		case MATCHCRITERIA_INREPLYTO:
-		case MATCHCRITERIA_NOT_INREPLYTO:
-		case MATCHCRITERIA_REFERENCES:
-		case MATCHCRITERIA_NOT_REFERENCES:
-		case MATCHCRITERIA_SCORE_GREATER:
-		case MATCHCRITERIA_SCORE_LOWER:
-		case MATCHCRITERIA_SCORE_EQUAL:
-		case MATCHCRITERIA_SIZE_GREATER:
-		case MATCHCRITERIA_SIZE_SMALLER:
-		case MATCHCRITERIA_SIZE_EQUAL:
-		case MATCHCRITERIA_TEST:
-		case MATCHCRITERIA_NOT_TEST:
-		case MATCHCRITERIA_PARTIAL:
-		case MATCHCRITERIA_NOT_PARTIAL:
 			if (matcherprop_match(matcher, info)) {
 				if (!matchers->bool_and) {
 					if (debug_filtering_session)
@@ -43,6 +43,10 @@ struct _MatcherProp {
 	regex_t *preg;
 	/* Allows casefolding expr each time */
 	gchar *casefold_expr;
+	/* Result precomputed by a MatcherProgram */
+	guint program_stamp;
+	const gchar *program_str;
+	gboolean program_result;
 };
 
 struct _MatcherList {
@@ -178,6 +182,13 @@ MatcherList *matcherlist_parse		(gchar		**str);
 gboolean matcherlist_match		(MatcherList	*cond, 
 					 MsgInfo	*info);
 
+MatcherProgram *matcher_program_new	(GSList		*lists);
+void matcher_program_free		(MatcherProgram	*program);
+gboolean matcher_program_is_valid	(MatcherProgram	*program);
+void matcher_program_run		(MatcherProgram	*program,
+					 MsgInfo	*info);
+void matcher_program_finish		(MatcherProgram	*program);
+
 gint matcher_parse_keyword		(gchar		**str);
 gint matcher_parse_number		(gchar		**str);
 gboolean matcher_parse_boolean_op	(gchar		**str);
@@ -26,4 +26,7 @@ typedef struct _MatcherProp MatcherProp;
 struct _MatcherList;
 typedef struct _MatcherList MatcherList;
 
+struct _MatcherProgram;
+typedef struct _MatcherProgram MatcherProgram;
+
 #endif
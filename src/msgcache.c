@@ -85,8 +85,6 @@ static gboolean msgcache_use_mmap_read = TRUE;
 static gboolean msgcache_use_mmap_read = TRUE;
 #endif
 
-static gboolean swapping = TRUE;
-
 typedef enum
 {
 	DATA_READ,
@@ -94,11 +92,112 @@ typedef enum
 	DATA_APPEND
 } DataOpenMode;
 
+/* A message's place in its thread, as saved in the cache file */
+typedef struct _MsgCacheThread MsgCacheThread;
+struct _MsgCacheThread {
+	guint32		 msgnum;
+	guint32		 parent;
+	guint32		 top;
+	guint32		 thread_date;
+};
+
 struct _MsgCache {
 	GHashTable	*msgnum_table;
 	GHashTable	*msgid_table;
 	guint		 memusage;
 	time_t		 last_access;
+	/* records appended to the mark and tags files since they
+	 * were last written in full */
+	guint		 mark_journal;
+	guint		 tags_journal;
+	/* block new MsgInfos are being allocated from */
+	MsgCacheBlock	*block;
+	/* the folder using this cache, and its place in msgcache_lru */
+	FolderItem	*item;
+	GList		 lru_link;
+	gboolean	 trimmed;
+	/* built when the folder is first shown threaded */
+	MsgThreadIndex	*threads;
+	/* the thread structure from the cache file or the summary, for
+	 * as long as no message is added or removed */
+	MsgCacheThread	*saved_threads;
+	guint		 saved_threads_len;
+	guint32		 saved_threads_settings;
+};
+
+/* Caches attached to a folder, most recently used first. Their memory
+ * usage is summed up as it changes, so that finding what to free does
+ * not need to look at every folder. Only used from the main thread. */
+static GQueue msgcache_lru = G_QUEUE_INIT;
+static gsize msgcache_lru_memusage = 0;
+static MsgCacheStats msgcache_stats;
+
+/* Flag and tag changes are appended to the mark and tags files as
+ * records of the same format, which the readers apply in order. Once
+ * there are more appended records than this (or than an eighth of
+ * the messages, if that is more), the file should be rewritten. */
+#define JOURNAL_MIN_RECORDS	64
+
+/* A private mapping of a cache file, kept around for as long as
+ * any MsgInfo still points into it. */
+struct _MsgCacheMap {
+	gint		 refcnt;
+	gchar		*data;
+	gsize		 len;
+};
+
+/* MsgInfos read from a cache file are allocated in blocks instead of
+ * one by one. Each of them holds a reference to its block, as does the
+ * cache for the block it is filling, so a message still in use
+ * elsewhere after the cache is gone (by a filter, the summary or a
+ * compose window) only keeps its own small block alive. */
+struct _MsgCacheBlock {
+	gint		 refcnt;
+	guint		 used;
+	MsgInfo		 msgs[];
+};
+
+#define CACHE_BLOCK_SIZE	128
+
+/* CACHE_VERSION files carry a header after the version and charset:
+ *
+ *   guint32 number of message records
+ *   guint32 number of sections
+ *   { guint32 id, guint32 offset, guint32 size } for each section
+ *
+ * It is followed by the message records, whose strings are
+ * NUL-terminated so that they can be used from a read-only mapping,
+ * and then by the sections. Offsets are from the start of the file,
+ * and unknown sections are skipped.
+ *
+ * The index sections are open-addressed hash tables of size slots
+ * (a power of two), each slot holding { guint32 key, guint32 offset
+ * of the message record }, keyed by message number or by the hash
+ * of the Message-ID. An offset of 0 marks a free slot.
+ *
+ * The thread section is only written for folders that were shown
+ * threaded. It holds the threading settings it was built with, then
+ * { guint32 msgnum, parent msgnum (0 for none), msgnum of the top of
+ * the thread, date of the thread } for every message. Its offset is 0
+ * when there is none. */
+typedef enum
+{
+	CACHE_SECTION_NUM_INDEX		= 1,
+	CACHE_SECTION_MSGID_INDEX	= 2,
+	CACHE_SECTION_THREADS		= 3
+} CacheSectionId;
+
+#define CACHE_SECTION_COUNT	3
+
+typedef struct _MsgCacheHeader MsgCacheHeader;
+struct _MsgCacheHeader {
+	guint32		 count;
+	guint32		 num_index;
+	guint32		 num_index_size;
+	guint32		 msgid_index;
+	guint32		 msgid_index_size;
+	guint32		 threads;
+	guint32		 threads_size;
 };
 
 typedef struct _StringConverter StringConverter;
@@ -128,23 +227,118 @@ MsgCache *msgcache_new(void)
 	cache->msgnum_table = g_hash_table_new(g_int_hash, g_int_equal);
 	cache->msgid_table = g_hash_table_new(g_str_hash, g_str_equal);
 	cache->last_access = time(NULL);
+	cache->lru_link.data = cache;
 
 	return cache;
 }
 
-static gboolean msgcache_msginfo_free_func(gpointer num, gpointer msginfo, gpointer user_data)
+static void msgcache_touch(MsgCache *cache)
+{
+	cache->last_access = time(NULL);
+	if (cache->item != NULL && msgcache_lru.head != &cache->lru_link) {
+		g_queue_unlink(&msgcache_lru, &cache->lru_link);
+		g_queue_push_head_link(&msgcache_lru, &cache->lru_link);
+	}
+}
+
+static void msgcache_add_memusage(MsgCache *cache, gint delta)
+{
+	/* the sizes of a message can change while it is in the cache */
+	if (delta < 0 && (guint) -delta > cache->memusage)
+		delta = -(gint) cache->memusage;
+
+	cache->memusage += delta;
+	if (cache->item != NULL)
+		msgcache_lru_memusage += delta;
+}
+
+static void msgcache_set_saved_threads(MsgCache *cache,
+				       MsgCacheThread *threads, guint len,
+				       guint32 settings)
+{
+	if (cache->saved_threads != NULL) {
+		msgcache_add_memusage(cache, -(gint)
+			(cache->saved_threads_len * sizeof(MsgCacheThread)));
+		g_free(cache->saved_threads);
+	}
+	cache->saved_threads = threads;
+	cache->saved_threads_len = threads ? len : 0;
+	cache->saved_threads_settings = settings;
+	if (threads != NULL)
+		msgcache_add_memusage(cache, len * sizeof(MsgCacheThread));
+}
+
+static void msgcache_thread_index_update(MsgCache *cache, MsgInfo *msginfo,
+					gboolean add)
+{
+	gsize before;
+
+	/* the saved threads no longer match the messages */
+	if (cache->saved_threads != NULL)
+		msgcache_set_saved_threads(cache, NULL, 0, 0);
+
+	if (cache->threads == NULL)
+		return;
+
+	before = procmsg_thread_index_memusage(cache->threads);
+	if (add)
+		procmsg_thread_index_add(cache->threads, msginfo);
+	else
+		procmsg_thread_index_remove(cache->threads, msginfo);
+	msgcache_add_memusage(cache, (gint)
+		(procmsg_thread_index_memusage(cache->threads) - before));
+}
+
+/**
+ * msgcache_attach:
+ * @cache: a cache that isn't used by any folder yet
+ * @item: the folder it now belongs to
+ *
+ * Makes @cache count towards msgcache_get_total_memory_usage() and
+ * puts it at the front of the list of recently used caches.
+ */
+void msgcache_attach(MsgCache *cache, FolderItem *item)
+{
+	cm_return_if_fail(cache != NULL);
+	cm_return_if_fail(item != NULL);
+	cm_return_if_fail(cache->item == NULL);
+
+	cache->item = item;
+	cache->last_access = time(NULL);
+	g_queue_push_head_link(&msgcache_lru, &cache->lru_link);
+	msgcache_lru_memusage += cache->memusage;
+	msgcache_stats.loads++;
+}
+
+static void msgcache_detach(MsgCache *cache)
+{
+	if (cache->item == NULL)
+		return;
+
+	g_queue_unlink(&msgcache_lru, &cache->lru_link);
+	msgcache_lru_memusage -= cache->memusage;
+	cache->item = NULL;
+}
+
+static void msgcache_msginfo_free_func(gpointer num, gpointer msginfo, gpointer user_data)
 {
 	procmsg_msginfo_free((MsgInfo **)&msginfo);
-	return TRUE;
 }											  
 
 void msgcache_destroy(MsgCache *cache)
 {
 	cm_return_if_fail(cache != NULL);
 
-	g_hash_table_foreach_remove(cache->msgnum_table, msgcache_msginfo_free_func, NULL);
+	msgcache_detach(cache);
+	procmsg_thread_index_free(cache->threads);
+	g_free(cache->saved_threads);
+	/* the tables are dropped as a whole, nothing looks at their
+	 * keys once the messages are gone */
+	g_hash_table_foreach(cache->msgnum_table, msgcache_msginfo_free_func, NULL);
 	g_hash_table_destroy(cache->msgid_table);
 	g_hash_table_destroy(cache->msgnum_table);
+	if (cache->block)
+		msgcache_block_unref(cache->block);
 	g_free(cache);
 }
 
@@ -159,8 +353,10 @@ void msgcache_add_msg(MsgCache *cache, MsgInfo *msginfo)
 	g_hash_table_insert(cache->msgnum_table, &newmsginfo->msgnum, newmsginfo);
 	if(newmsginfo->msgid != NULL)
 		g_hash_table_insert(cache->msgid_table, newmsginfo->msgid, newmsginfo);
-	cache->memusage += procmsg_msginfo_memusage(msginfo);
-	cache->last_access = time(NULL);
+	msgcache_add_memusage(cache, procmsg_msginfo_memusage(msginfo));
+	msgcache_thread_index_update(cache, newmsginfo, TRUE);
+	msgcache_touch(cache);
+	cache->trimmed = FALSE;
 
 	msginfo->folder->cache_dirty = TRUE;
 
@@ -177,7 +373,8 @@ void msgcache_remove_msg(MsgCache *cache, guint msgnum)
 	if(!msginfo)
 		return;
 
-	cache->memusage -= procmsg_msginfo_memusage(msginfo);
+	msgcache_add_memusage(cache, -(gint) procmsg_msginfo_memusage(msginfo));
+	msgcache_thread_index_update(cache, msginfo, FALSE);
 	if(msginfo->msgid)
 		g_hash_table_remove(cache->msgid_table, msginfo->msgid);
 	g_hash_table_remove(cache->msgnum_table, &msginfo->msgnum);
@@ -185,7 +382,7 @@ void msgcache_remove_msg(MsgCache *cache, guint msgnum)
 	msginfo->folder->cache_dirty = TRUE;
 
 	procmsg_msginfo_free(&msginfo);
-	cache->last_access = time(NULL);
+	msgcache_touch(cache);
 
 
 	debug_print("Cache size: %d messages, %u bytes\n", g_hash_table_size(cache->msgnum_table), cache->memusage);
@@ -203,7 +400,8 @@ void msgcache_update_msg(MsgCache *cache, MsgInfo *msginfo)
 		g_hash_table_remove(cache->msgid_table, oldmsginfo->msgid);
 	if (oldmsginfo) {
 		g_hash_table_remove(cache->msgnum_table, &oldmsginfo->msgnum);
-		cache->memusage -= procmsg_msginfo_memusage(oldmsginfo);
+		msgcache_add_memusage(cache, -(gint) procmsg_msginfo_memusage(oldmsginfo));
+		msgcache_thread_index_update(cache, oldmsginfo, FALSE);
 		procmsg_msginfo_free(&oldmsginfo);
 	}
 
@@ -211,8 +409,10 @@ void msgcache_update_msg(MsgCache *cache, MsgInfo *msginfo)
 	g_hash_table_insert(cache->msgnum_table, &newmsginfo->msgnum, newmsginfo);
 	if(newmsginfo->msgid)
 		g_hash_table_insert(cache->msgid_table, newmsginfo->msgid, newmsginfo);
-	cache->memusage += procmsg_msginfo_memusage(newmsginfo);
-	cache->last_access = time(NULL);
+	msgcache_add_memusage(cache, procmsg_msginfo_memusage(newmsginfo));
+	msgcache_thread_index_update(cache, newmsginfo, TRUE);
+	msgcache_touch(cache);
+	cache->trimmed = FALSE;
 	
 	debug_print("Cache size: %d messages, %u bytes\n", g_hash_table_size(cache->msgnum_table), cache->memusage);
 
@@ -228,9 +428,12 @@ MsgInfo *msgcache_get_msg(MsgCache *cache, guint num)
 	cm_return_val_if_fail(cache != NULL, NULL);
 
 	msginfo = g_hash_table_lookup(cache->msgnum_table, &num);
-	if(!msginfo)
+	if(!msginfo) {
+		msgcache_stats.misses++;
 		return NULL;
-	cache->last_access = time(NULL);
+	}
+	msgcache_stats.hits++;
+	msgcache_touch(cache);
 	
 	return procmsg_msginfo_new_ref(msginfo);
 }
@@ -243,9 +446,12 @@ MsgInfo *msgcache_get_msg_by_id(MsgCache *cache, const gchar *msgid)
 	cm_return_val_if_fail(msgid != NULL, NULL);
 
 	msginfo = g_hash_table_lookup(cache->msgid_table, msgid);
-	if(!msginfo)
+	if(!msginfo) {
+		msgcache_stats.misses++;
 		return NULL;
-	cache->last_access = time(NULL);
+	}
+	msgcache_stats.hits++;
+	msgcache_touch(cache);
 	
 	return procmsg_msginfo_new_ref(msginfo);	
 }
@@ -265,7 +471,7 @@ MsgInfoList *msgcache_get_msg_list(MsgCache *cache)
 	cm_return_val_if_fail(cache != NULL, NULL);
 
 	g_hash_table_foreach((GHashTable *)cache->msgnum_table, msgcache_get_msg_list_func, (gpointer)&msg_list);	
-	cache->last_access = time(NULL);
+	msgcache_touch(cache);
 	
 	msg_list = g_slist_reverse(msg_list);
 	END_TIMING();
@@ -286,13 +492,226 @@ gint msgcache_get_memory_usage(MsgCache *cache)
 	return cache->memusage;
 }
 
+FolderItem *msgcache_get_item(MsgCache *cache)
+{
+	cm_return_val_if_fail(cache != NULL, NULL);
+
+	return cache->item;
+}
+
+/* Sum of the memory usage of every cache attached to a folder. */
+gsize msgcache_get_total_memory_usage(void)
+{
+	return msgcache_lru_memusage;
+}
+
+/* The least recently used cache attached to a folder, and the one used
+ * right after @cache; the list can be walked while freeing caches. */
+MsgCache *msgcache_get_lru_oldest(void)
+{
+	GList *link = g_queue_peek_tail_link(&msgcache_lru);
+
+	return link != NULL ? (MsgCache *)link->data : NULL;
+}
+
+MsgCache *msgcache_get_lru_newer(MsgCache *cache)
+{
+	cm_return_val_if_fail(cache != NULL, NULL);
+
+	return cache->lru_link.prev != NULL ?
+		(MsgCache *)cache->lru_link.prev->data : NULL;
+}
+
+static void msgcache_trim_func(gpointer key, gpointer value, gpointer user_data)
+{
+	MsgInfo *msginfo = (MsgInfo *)value;
+	guint *freed = (guint *)user_data;
+	guint before;
+
+	/* leave the messages someone else is looking at alone */
+	if (msginfo->refcnt > 1 || (msginfo->extradata == NULL &&
+				    msginfo->fromspace == NULL))
+		return;
+
+	before = procmsg_msginfo_memusage(msginfo);
+	procmsg_msginfo_free_extradata(msginfo);
+	*freed += before - procmsg_msginfo_memusage(msginfo);
+}
+
+/**
+ * msgcache_trim:
+ * @cache: the cache
+ *
+ * Frees what the cached messages got from parsing the messages
+ * themselves and isn't written to the cache file, so the same data
+ * as after reading the cache again is left, and the thread index.
+ *
+ * Return value: the number of bytes freed
+ */
+guint msgcache_trim(MsgCache *cache)
+{
+	guint freed = 0;
+
+	cm_return_val_if_fail(cache != NULL, 0);
+
+	if (cache->trimmed)
+		return 0;
+
+	g_hash_table_foreach(cache->msgnum_table, msgcache_trim_func, &freed);
+	if (cache->threads != NULL) {
+		freed += procmsg_thread_index_memusage(cache->threads);
+		procmsg_thread_index_free(cache->threads);
+		cache->threads = NULL;
+	}
+	msgcache_add_memusage(cache, -(gint) freed);
+	cache->trimmed = TRUE;
+	if (freed > 0)
+		msgcache_stats.trims++;
+
+	return freed;
+}
+
+/* Counts a cache dropped to bring the memory usage down, rather than
+ * because its folder went away or was closed for good */
+void msgcache_count_eviction(void)
+{
+	msgcache_stats.evictions++;
+}
+
+void msgcache_get_stats(MsgCacheStats *stats)
+{
+	cm_return_if_fail(stats != NULL);
+
+	*stats = msgcache_stats;
+}
+
+static void msgcache_thread_index_add_func(gpointer key, gpointer value,
+					   gpointer user_data)
+{
+	procmsg_thread_index_add((MsgThreadIndex *)user_data, (MsgInfo *)value);
+}
+
+/* The thread index of the cached messages, kept up to date as they
+ * are added and removed from then on. */
+MsgThreadIndex *msgcache_get_thread_index(MsgCache *cache)
+{
+	cm_return_val_if_fail(cache != NULL, NULL);
+
+	if (cache->threads == NULL) {
+		cache->threads = procmsg_thread_index_new();
+		g_hash_table_foreach(cache->msgnum_table,
+				     msgcache_thread_index_add_func,
+				     cache->threads);
+		msgcache_add_memusage(cache,
+			procmsg_thread_index_memusage(cache->threads));
+		cache->trimmed = FALSE;
+	}
+	msgcache_touch(cache);
+
+	return cache->threads;
+}
+
+static MsgCacheMap *msgcache_map_new(gchar *data, gsize len)
+{
+	MsgCacheMap *map;
+
+	map = g_new0(MsgCacheMap, 1);
+	map->refcnt = 1;
+	map->data = data;
+	map->len = len;
+
+	return map;
+}
+
+MsgCacheMap *msgcache_map_ref(MsgCacheMap *map)
+{
+	cm_return_val_if_fail(map != NULL, NULL);
+
+	g_atomic_int_inc(&map->refcnt);
+
+	return map;
+}
+
+void msgcache_map_unref(MsgCacheMap *map)
+{
+	cm_return_if_fail(map != NULL);
+
+	if (!g_atomic_int_dec_and_test(&map->refcnt))
+		return;
+
+#ifdef G_OS_WIN32
+	UnmapViewOfFile((void*) map->data);
+#else
+	munmap(map->data, map->len);
+#endif
+	g_free(map);
+}
+
+gboolean msgcache_map_contains(MsgCacheMap *map, gconstpointer ptr)
+{
+	cm_return_val_if_fail(map != NULL, FALSE);
+
+	return (const gchar *)ptr >= map->data &&
+	       (const gchar *)ptr < map->data + map->len;
+}
+
+/* A MsgInfo for @cache, or a plain one if there is no cache, as when
+ * peeking at a single message */
+static MsgInfo *msgcache_block_alloc(MsgCache *cache)
+{
+	MsgCacheBlock *block;
+	MsgInfo *msginfo;
+
+	if (cache == NULL)
+		return procmsg_msginfo_new();
+
+	block = cache->block;
+	if (block == NULL || block->used == CACHE_BLOCK_SIZE) {
+		if (block != NULL)
+			msgcache_block_unref(block);
+		block = g_malloc0(sizeof(MsgCacheBlock) +
+				  CACHE_BLOCK_SIZE * sizeof(MsgInfo));
+		block->refcnt = 1;
+		cache->block = block;
+	}
+	msginfo = &block->msgs[block->used++];
+
+	msginfo->refcnt = 1;
+	msginfo->cache_block = block;
+	g_atomic_int_inc(&block->refcnt);
+
+	return msginfo;
+}
+
+void msgcache_block_unref(MsgCacheBlock *block)
+{
+	cm_return_if_fail(block != NULL);
+
+	if (!g_atomic_int_dec_and_test(&block->refcnt))
+		return;
+
+	g_free(block);
+}
+
+/* Renaming over a mapped file is not possible on Windows, so the
+ * cache could never be rewritten while its strings are in use. */
+static gboolean msgcache_use_zero_copy(void)
+{
+#ifdef G_OS_WIN32
+	return FALSE;
+#else
+	return prefs_common.cache_zero_copy;
+#endif
+}
+
 /*
  *  Cache saving functions
  */
 
 #define READ_CACHE_DATA(data, fp, total_len) \
 { \
-	if ((tmp_len = msgcache_read_cache_data_str(fp, &data, conv)) < 0) { \
+	if ((tmp_len = msgcache_read_cache_data_str(fp, &data, terminator, conv, \
+			swapping)) < 0) { \
 		procmsg_msginfo_free(&msginfo); \
 		error = TRUE; \
 		goto bail_err; \
@@ -329,19 +748,24 @@ gint msgcache_get_memory_usage(MsgCache *cache)
 #define GET_CACHE_DATA(data, total_len) \
 { \
 	GET_CACHE_DATA_INT(tmp_len);	\
-	if (rem_len < tmp_len) {								\
+	if (tmp_len < 0 || rem_len < tmp_len + terminator) {					\
 		g_print("error at rem_len:%d (tmp_len %d)\n", rem_len, tmp_len);		\
 		error = TRUE;									\
 		goto bail_err;									\
 	}											\
-	if ((tmp_len = msgcache_get_cache_data_str(walk_data, &data, tmp_len, conv)) < 0) { \
+	if (map != NULL)									\
+		tmp_len = msgcache_map_cache_data_str(walk_data, &data, tmp_len, terminator);	\
+	else											\
+		tmp_len = msgcache_get_cache_data_str(walk_data, &data, tmp_len, conv);	\
+	if (tmp_len < 0) { \
 		g_print("error at rem_len:%d\n", rem_len);\
 		procmsg_msginfo_free(&msginfo); \
 		error = TRUE; \
 		goto bail_err; \
 	} \
-	total_len += tmp_len; \
-	walk_data += tmp_len; rem_len -= tmp_len; \
+	if (map == NULL) \
+		total_len += tmp_len; \
+	walk_data += tmp_len + terminator; rem_len -= tmp_len + terminator; \
 }
 
 
@@ -378,6 +802,9 @@ gint msgcache_get_memory_usage(MsgCache *cache)
 			w_err = 1;			\
 		wrote += len;				\
 	} \
+	if (w_err == 0 && claws_fputc('\0', fp) == EOF)	\
+		w_err = 1;				\
+	wrote += 1;					\
 }
 
 #define PUT_CACHE_DATA(data)				\
@@ -457,7 +884,9 @@ static FILE *msgcache_open_data_file(const gchar *file, guint version,
 }
 
 static gint msgcache_read_cache_data_str(FILE *fp, gchar **str, 
-					 StringConverter *conv)
+					 gint terminator,
+					 StringConverter *conv,
+					 gboolean swapping)
 {
 	gchar *tmpstr = NULL;
 	size_t ni;
@@ -483,8 +912,14 @@ static gint msgcache_read_cache_data_str(FILE *fp, gchar **str,
 		len = bswap_32(len);
 	}
 
-	if (len == 0)
+	if (len == 0) {
+		if (terminator && claws_fgetc(fp) != '\0') {
+			g_warning("read_data_str: Cache data corrupted, missing "
+				  "terminator at offset %ld", ftell(fp));
+			return -1;
+		}
 		return 0;
+	}
 
 	tmpstr = g_try_malloc(len + 1);
 
@@ -492,10 +927,10 @@ static gint msgcache_read_cache_data_str(FILE *fp, gchar **str,
 		return -1;
 	}
 
-	if ((ni = claws_fread(tmpstr, 1, len, fp)) != len) {
+	if ((ni = claws_fread(tmpstr, 1, len + terminator, fp)) != len + terminator) {
 		g_warning("read_data_str: Cache data corrupted, read %zd of %u "
 			  "bytes at offset %ld",
-			  ni, len, ftell(fp));
+			  ni, len + terminator, ftell(fp));
 		g_free(tmpstr);
 		return -1;
 	}
@@ -515,58 +950,512 @@ static gint msgcache_get_cache_data_str(gchar *src, gchar **str, gint len,
 {
 	gchar *tmpstr = NULL;
 
-	*str = NULL;
+	*str = NULL;
+
+	if (len == 0)
+		return 0;
+
+	if(len > 2*1024*1024) {
+		g_warning("read_data_str: refusing to allocate %d bytes.", len);
+		return -1;
+	}
+
+	tmpstr = g_try_malloc(len + 1);
+
+	if(tmpstr == NULL) {
+		return -1;
+	}
+
+	memcpy(tmpstr, src, len);
+	tmpstr[len] = 0;
+
+	if (conv != NULL) {
+		*str = conv->convert(conv, tmpstr);
+		g_free(tmpstr);
+	} else 
+		*str = tmpstr;
+
+	return len;
+}
+
+static gint msgcache_map_cache_data_str(gchar *src, gchar **str, gint len,
+					gint terminator)
+{
+	*str = NULL;
+
+	if (len == 0)
+		return 0;
+
+	if (len < 0 || len > 2*1024*1024) {
+		g_warning("read_data_str: refusing to map %d bytes.", len);
+		return -1;
+	}
+
+	if (terminator) {
+		if (src[len] != '\0') {
+			g_warning("read_data_str: Cache data corrupted, missing terminator.");
+			return -1;
+		}
+		*str = src;
+		return len;
+	}
+
+	/* The length prefix has been consumed already: slide the string
+	 * over its last byte to make room for the terminating NUL. */
+	memmove(src - 1, src, len);
+	src[len - 1] = '\0';
+	*str = src - 1;
+
+	return len;
+}
+
+static gchar *strconv_charset_convert(StringConverter *conv, gchar *srcstr)
+{
+	CharsetConverter *charsetconv = (CharsetConverter *) conv;
+
+	return conv_codeset_strdup(srcstr, charsetconv->srccharset, charsetconv->dstcharset);
+}
+
+static void strconv_charset_free(StringConverter *conv)
+{
+	CharsetConverter *charsetconv = (CharsetConverter *) conv;
+
+	g_free(charsetconv->srccharset);
+	g_free(charsetconv->dstcharset);
+}
+
+/* CACHE_VERSION files are always written little-endian */
+static guint32 msgcache_map_get_int(const gchar *data)
+{
+	return MMAP_TO_GUINT32_SWAPPED(data);
+}
+
+static guint32 msgcache_msgid_hash(const gchar *msgid)
+{
+	const guchar *p;
+	guint32 hash = 5381;
+
+	for (p = (const guchar *)msgid; *p != '\0'; p++)
+		hash = (hash << 5) + hash + *p;
+
+	return hash;
+}
+
+static guint32 msgcache_index_start(guint32 key, guint32 slots)
+{
+	return (key * 2654435761U) & (slots - 1);
+}
+
+static gchar *msgcache_mmap_file(FILE *fp, gint map_len, gboolean writable)
+{
+	gchar *data = NULL;
+#ifdef G_OS_WIN32
+	HANDLE hFile, hMapping;
+
+	hFile = (HANDLE) _get_osfhandle (fileno(fp));
+	if (hFile == (HANDLE) -1)
+		return NULL;
+	hMapping = CreateFileMapping(hFile, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	if (!hMapping)
+		return NULL;
+	data = (gchar *)MapViewOfFile(hMapping, FILE_MAP_COPY, 0, 0, 0);
+	CloseHandle (hMapping);
+#else
+	data = mmap(NULL, map_len, writable ? PROT_READ|PROT_WRITE : PROT_READ,
+		    MAP_PRIVATE, fileno(fp), 0);
+	if (data == MAP_FAILED)
+		data = NULL;
+#endif
+	return data;
+}
+
+static void msgcache_munmap_file(gchar *data, gint map_len)
+{
+#ifdef G_OS_WIN32
+	UnmapViewOfFile((void*) data);
+#else
+	munmap(data, map_len);
+#endif
+}
+
+/* Opens a cache file of the current or of the previous version, which
+ * is still read so that it gets migrated on the next write. */
+static FILE *msgcache_open_cache_file(const gchar *cache_file, guint *version,
+				      gboolean *swapping,
+				      gchar *buf, size_t buf_size)
+{
+	const guint versions[] = { CACHE_VERSION, OLD_CACHE_VERSION };
+	FILE *fp;
+	guint i;
+
+	/* In case we can't open the cache file with a version, check if we can
+	 * open it with the swapped version. As msgcache_open_data_file swaps it
+	 * too, if this succeeds, it means it's the old version (not little-endian)
+	 * on a big-endian machine. The code has no effect on x86 as their file
+	 * doesn't change. */
+	for (i = 0; i < G_N_ELEMENTS(versions); i++) {
+		*version = versions[i];
+		*swapping = TRUE;
+		if ((fp = msgcache_open_data_file(cache_file, versions[i],
+				DATA_READ, buf, buf_size)) != NULL)
+			return fp;
+		*swapping = FALSE;
+		if ((fp = msgcache_open_data_file(cache_file, bswap_32(versions[i]),
+				DATA_READ, buf, buf_size)) != NULL)
+			return fp;
+	}
+
+	return NULL;
+}
+
+/* the smallest possible record: eight integers and ten empty strings */
+#define CACHE_RECORD_MIN_SIZE	(8 * 4 + 10 * 5)
+
+static gboolean msgcache_read_cache_header(FILE *fp, MsgCacheHeader *header)
+{
+	guint32 data[3], nsections, i;
+	struct stat st;
+
+	memset(header, 0, sizeof(MsgCacheHeader));
+
+	if (claws_fread(data, sizeof(guint32), 2, fp) != 2)
+		return FALSE;
+	header->count = bswap_32(data[0]);
+	nsections = bswap_32(data[1]);
+
+	/* the count sizes allocations, so it has to be sane */
+	if (fstat(fileno(fp), &st) < 0 ||
+	    header->count > st.st_size / CACHE_RECORD_MIN_SIZE)
+		return FALSE;
+
+	for (i = 0; i < nsections; i++) {
+		if (claws_fread(data, sizeof(guint32), 3, fp) != 3)
+			return FALSE;
+		switch (bswap_32(data[0])) {
+		case CACHE_SECTION_NUM_INDEX:
+			header->num_index = bswap_32(data[1]);
+			header->num_index_size = bswap_32(data[2]);
+			break;
+		case CACHE_SECTION_MSGID_INDEX:
+			header->msgid_index = bswap_32(data[1]);
+			header->msgid_index_size = bswap_32(data[2]);
+			break;
+		case CACHE_SECTION_THREADS:
+			header->threads = bswap_32(data[1]);
+			header->threads_size = bswap_32(data[2]);
+			break;
+		default:
+			break;
+		}
+	}
+
+	return TRUE;
+}
+
+/* The threading settings a saved thread structure depends on */
+static guint32 msgcache_thread_settings(void)
+{
+	if (!prefs_common.thread_by_subject)
+		return 0;
+
+	return 1 | (prefs_common.thread_by_subject_max_age << 1);
+}
+
+static MsgCacheThread *msgcache_read_threads(FILE *fp, MsgCacheHeader *header,
+					     guint32 *settings)
+{
+	MsgCacheThread *threads;
+	guint32 *data;
+	guint i, len = header->threads_size;
+
+	if (header->threads == 0 || len != header->count)
+		return NULL;
+	if (fseek(fp, header->threads, SEEK_SET) < 0)
+		return NULL;
+
+	data = g_new(guint32, 1 + len * 4);
+	if (claws_fread(data, sizeof(guint32), 1 + len * 4, fp) != 1 + len * 4) {
+		g_free(data);
+		return NULL;
+	}
+
+	*settings = bswap_32(data[0]);
+	threads = g_new(MsgCacheThread, len);
+	for (i = 0; i < len; i++) {
+		threads[i].msgnum = bswap_32(data[1 + i * 4]);
+		threads[i].parent = bswap_32(data[2 + i * 4]);
+		threads[i].top = bswap_32(data[3 + i * 4]);
+		threads[i].thread_date = bswap_32(data[4 + i * 4]);
+	}
+	g_free(data);
+
+	return threads;
+}
+
+/* Checks that saved threads are made of the messages of the cache, each
+ * of them once, and that following the parents always ends at the top
+ * of the thread given, without going round in circles. */
+static gboolean msgcache_check_threads(MsgCache *cache, MsgCacheThread *threads,
+				       guint len)
+{
+	GHashTable *pos;
+	guint8 *state;
+	guint32 top;
+	guint i, j, k;
+	gboolean ok = TRUE;
+
+	if (len != g_hash_table_size(cache->msgnum_table))
+		return FALSE;
+
+	pos = g_hash_table_new(g_direct_hash, g_direct_equal);
+	for (i = 0; i < len && ok; i++) {
+		guint32 num = threads[i].msgnum;
+
+		if (num == 0 ||
+		    g_hash_table_lookup(cache->msgnum_table, &num) == NULL ||
+		    g_hash_table_lookup(pos, GUINT_TO_POINTER(num)) != NULL)
+			ok = FALSE;
+		else
+			g_hash_table_insert(pos, GUINT_TO_POINTER(num),
+					    GUINT_TO_POINTER(i + 1));
+	}
+
+	/* 0: not seen yet, 1: on the current way up, 2: checked */
+	state = g_new0(guint8, len);
+	for (i = 0; i < len && ok; i++) {
+		for (j = i; state[j] == 0; j = k) {
+			state[j] = 1;
+			if (threads[j].parent == 0)
+				break;
+			k = GPOINTER_TO_UINT(g_hash_table_lookup(pos,
+					GUINT_TO_POINTER(threads[j].parent)));
+			if (k-- == 0) {
+				ok = FALSE;
+				break;
+			}
+		}
+		if (!ok || (state[j] == 1 && threads[j].parent != 0)) {
+			ok = FALSE;
+			break;
+		}
+
+		top = state[j] == 2 ? threads[j].top : threads[j].msgnum;
+		for (j = i; state[j] == 1; ) {
+			if (threads[j].top != top) {
+				ok = FALSE;
+				break;
+			}
+			state[j] = 2;
+			if (threads[j].parent == 0)
+				break;
+			j = GPOINTER_TO_UINT(g_hash_table_lookup(pos,
+					GUINT_TO_POINTER(threads[j].parent))) - 1;
+		}
+	}
+	g_free(state);
+	g_hash_table_destroy(pos);
+
+	return ok;
+}
+
+/**
+ * msgcache_get_thread_tree:
+ * @cache: the cache
+ * @mlist: the messages to show
+ *
+ * Builds the thread tree of @mlist from the thread structure saved
+ * with the cache, which is only possible as long as the cache has
+ * not changed since and @mlist holds all of its messages. The thread
+ * date of the messages at the top of the threads is set too.
+ *
+ * Return value: the tree, like procmsg_get_thread_tree() makes it,
+ * or NULL if it has to be built from scratch
+ */
+GNode *msgcache_get_thread_tree(MsgCache *cache, GSList *mlist)
+{
+	MsgCacheThread *threads;
+	GHashTable *pos;
+	GNode **nodes, *root, *last_root = NULL;
+	guint *order;
+	guint i, n = 0, len;
+	GSList *cur;
+	START_TIMING("");
+
+	cm_return_val_if_fail(cache != NULL, NULL);
+
+	threads = cache->saved_threads;
+	len = cache->saved_threads_len;
+	if (threads == NULL ||
+	    cache->saved_threads_settings != msgcache_thread_settings()) {
+		END_TIMING();
+		return NULL;
+	}
+
+	pos = g_hash_table_new(g_direct_hash, g_direct_equal);
+	for (i = 0; i < len; i++)
+		g_hash_table_insert(pos, GUINT_TO_POINTER(threads[i].msgnum),
+				    GUINT_TO_POINTER(i + 1));
+
+	nodes = g_new0(GNode *, len);
+	order = g_new(guint, len);
+	for (cur = mlist; cur != NULL; cur = cur->next) {
+		MsgInfo *msginfo = (MsgInfo *)cur->data;
+
+		i = GPOINTER_TO_UINT(g_hash_table_lookup(pos,
+				GUINT_TO_POINTER(msginfo->msgnum)));
+		if (i-- == 0 || nodes[i] != NULL)
+			break;
+		nodes[i] = g_node_new(msginfo);
+		order[n++] = i;
+	}
+
+	root = NULL;
+	if (cur == NULL && n == len) {
+		/* the threads are reversed like the ones of
+		 * procmsg_get_thread_tree(), replies are in the order
+		 * they were saved in, which lists them top down */
+		root = g_node_new(NULL);
+		while (n-- > 0) {
+			MsgCacheThread *thread = &threads[order[n]];
+			GNode *node = nodes[order[n]];
+
+			if (thread->parent != 0)
+				continue;
+			((MsgInfo *)node->data)->thread_date =
+				thread->thread_date;
+			g_node_insert_after(root, last_root, node);
+			last_root = node;
+		}
+		for (n = len; n-- > 0; ) {
+			if (threads[n].parent == 0)
+				continue;
+			i = GPOINTER_TO_UINT(g_hash_table_lookup(pos,
+				GUINT_TO_POINTER(threads[n].parent))) - 1;
+			g_node_prepend(nodes[i], nodes[n]);
+		}
+	} else {
+		for (i = 0; i < n; i++)
+			g_node_destroy(nodes[order[i]]);
+	}
+
+	g_free(order);
+	g_free(nodes);
+	g_hash_table_destroy(pos);
+	END_TIMING();
+
+	return root;
+}
+
+MsgTmpFlags msgcache_get_tmp_flags(FolderItem *item)
+{
+	if (folder_has_parent_of_type(item, F_QUEUE))
+		return MSG_QUEUED;
+	else if (folder_has_parent_of_type(item, F_DRAFT))
+		return MSG_DRAFT;
+
+	return 0;
+}
+
+/* Parses the message record at *walk and moves *walk past it. Strings
+ * point into the mapping if map is given, and are copied otherwise. */
+static MsgInfo *msgcache_get_cache_record(gchar **walk, gint *remaining,
+					  MsgCache *cache,
+					  MsgCacheMap *map, gint terminator,
+					  gboolean swapping,
+					  StringConverter *conv,
+					  guint *total_memusage)
+{
+	MsgInfo *msginfo = NULL;
+	gchar *walk_data = *walk;
+	gint rem_len = *remaining;
+	gint tmp_len = 0;
+	guint32 num;
+	guint refnum;
+	gchar *ref = NULL;
+	guint memusage = 0;
+	gboolean error = FALSE;
+
+	GET_CACHE_DATA_INT(num);
 
-	if (len == 0)
-		return 0;
+	msginfo = msgcache_block_alloc(cache);
+	msginfo->msgnum = num;
+	if (map != NULL)
+		msginfo->cache_map = msgcache_map_ref(map);
+	memusage += sizeof(MsgInfo);
 
-	if(len > 2*1024*1024) {
-		g_warning("read_data_str: refusing to allocate %d bytes.", len);
-		return -1;
-	}
+	GET_CACHE_DATA_INT(msginfo->size);
+	GET_CACHE_DATA_INT(msginfo->mtime);
+	GET_CACHE_DATA_INT(msginfo->date_t);
+	GET_CACHE_DATA_INT(msginfo->flags.tmp_flags);
 
-	tmpstr = g_try_malloc(len + 1);
+	GET_CACHE_DATA(msginfo->fromname, memusage);
 
-	if(tmpstr == NULL) {
-		return -1;
-	}
+	GET_CACHE_DATA(msginfo->date, memusage);
+	GET_CACHE_DATA(msginfo->from, memusage);
+	GET_CACHE_DATA(msginfo->to, memusage);
+	GET_CACHE_DATA(msginfo->cc, memusage);
+	GET_CACHE_DATA(msginfo->newsgroups, memusage);
+	GET_CACHE_DATA(msginfo->subject, memusage);
+	GET_CACHE_DATA(msginfo->msgid, memusage);
+	GET_CACHE_DATA(msginfo->inreplyto, memusage);
+	GET_CACHE_DATA(msginfo->xref, memusage);
 
-	memcpy(tmpstr, src, len);
-	tmpstr[len] = 0;
+	GET_CACHE_DATA_INT(msginfo->planned_download);
+	GET_CACHE_DATA_INT(msginfo->total_size);
+	GET_CACHE_DATA_INT(refnum);
 
-	if (conv != NULL) {
-		*str = conv->convert(conv, tmpstr);
-		g_free(tmpstr);
-	} else 
-		*str = tmpstr;
+	for (; refnum != 0; refnum--) {
+		ref = NULL;
 
-	return len;
-}
+		GET_CACHE_DATA(ref, memusage);
 
-static gchar *strconv_charset_convert(StringConverter *conv, gchar *srcstr)
-{
-	CharsetConverter *charsetconv = (CharsetConverter *) conv;
+		if (ref && *ref)
+			msginfo->references =
+				g_slist_prepend(msginfo->references, ref);
+	}
+	if (msginfo->references)
+		msginfo->references =
+			g_slist_reverse(msginfo->references);
 
-	return conv_codeset_strdup(srcstr, charsetconv->srccharset, charsetconv->dstcharset);
+bail_err:
+	if (error) {
+		if (msginfo != NULL)
+			procmsg_msginfo_free(&msginfo);
+		return NULL;
+	}
+
+	*walk = walk_data;
+	*remaining = rem_len;
+	*total_memusage += memusage;
+
+	return msginfo;
 }
 
-static void strconv_charset_free(StringConverter *conv)
+MsgCache *msgcache_read_cache(FolderItem *item, const gchar *cache_file)
 {
-	CharsetConverter *charsetconv = (CharsetConverter *) conv;
+	cm_return_val_if_fail(item != NULL, NULL);
 
-	g_free(charsetconv->srccharset);
-	g_free(charsetconv->dstcharset);
+	return msgcache_read_cache_full(item, cache_file,
+					msgcache_get_tmp_flags(item));
 }
 
-MsgCache *msgcache_read_cache(FolderItem *item, const gchar *cache_file)
+/* Does not look at item beyond storing it in the messages, so it
+ * can be called from another thread with the item's flags from
+ * msgcache_get_tmp_flags() */
+MsgCache *msgcache_read_cache_full(FolderItem *item, const gchar *cache_file,
+				   MsgTmpFlags tmp_flags)
 {
 	MsgCache *cache;
 	FILE *fp;
-	MsgInfo *msginfo;
-	MsgTmpFlags tmp_flags = 0;
+	MsgInfo *msginfo = NULL;
+	MsgCacheHeader header;
 	gchar file_buf[BUFFSIZE];
 	guint32 num;
         guint refnum;
+	guint version, nread = 0;
+	gboolean swapping;
+	gboolean indexed;
+	gint terminator;
 	gboolean error = FALSE;
 	StringConverter *conv = NULL;
 	gchar *srccharset = NULL;
@@ -575,36 +1464,32 @@ MsgCache *msgcache_read_cache(FolderItem *item, const gchar *cache_file)
 	guint memusage = 0;
 	gint tmp_len = 0, map_len = -1;
 	char *cache_data = NULL;
+	MsgCacheMap *map = NULL;
+	gboolean zero_copy;
 	struct stat st;
 
 	cm_return_val_if_fail(cache_file != NULL, NULL);
 	cm_return_val_if_fail(item != NULL, NULL);
 
-	swapping = TRUE;
-
-	/* In case we can't open the mark file with MARK_VERSION, check if we can open it with the
-	 * swapped MARK_VERSION. As msgcache_open_data_file swaps it too, if this succeeds, 
-	 * it means it's the old version (not little-endian) on a big-endian machine. The code has
-	 * no effect on x86 as their file doesn't change. */
+	if ((fp = msgcache_open_cache_file(cache_file, &version, &swapping,
+			file_buf, sizeof(file_buf))) == NULL)
+		return NULL;
 
-	if ((fp = msgcache_open_data_file
-		(cache_file, CACHE_VERSION, DATA_READ, file_buf, sizeof(file_buf))) == NULL) {
-		if ((fp = msgcache_open_data_file
-		(cache_file, bswap_32(CACHE_VERSION), DATA_READ, file_buf, sizeof(file_buf))) == NULL)
-			return NULL;
-		else
-			swapping = FALSE;
-	}
+	debug_print("\tReading %sswapped message cache (version %u) from %s...\n",
+		    swapping?"":"un", version, cache_file);
 
-	debug_print("\tReading %sswapped message cache from %s...\n", swapping?"":"un", cache_file);
+	/* Only the current version has an index, and NUL-terminated strings */
+	indexed = (version == CACHE_VERSION);
+	terminator = indexed ? 1 : 0;
 
-	if (folder_has_parent_of_type(item, F_QUEUE)) {
-		tmp_flags |= MSG_QUEUED;
-	} else if (folder_has_parent_of_type(item, F_DRAFT)) {
-		tmp_flags |= MSG_DRAFT;
+	if (msgcache_read_cache_data_str(fp, &srccharset, terminator, NULL,
+					 swapping) < 0) {
+		claws_fclose(fp);
+		return NULL;
 	}
-
-	if (msgcache_read_cache_data_str(fp, &srccharset, NULL) < 0) {
+	if (indexed && !msgcache_read_cache_header(fp, &header)) {
+		g_warning("%s: cache header corrupted", cache_file);
+		g_free(srccharset);
 		claws_fclose(fp);
 		return NULL;
 	}
@@ -632,90 +1517,59 @@ MsgCache *msgcache_read_cache(FolderItem *item, const gchar *cache_file)
 
 	cache = msgcache_new();
 
+	/* Strings needing conversion can't be used in place, and those of
+	 * older caches have to be terminated inside the mapping. */
+	zero_copy = msgcache_use_mmap_read && conv == NULL &&
+		    msgcache_use_zero_copy();
+
 	if (msgcache_use_mmap_read == TRUE) {
 		if (fstat(fileno(fp), &st) >= 0)
 			map_len = st.st_size;
 		else
 			map_len = -1;
-		if (map_len > 0) {
-#ifdef G_OS_WIN32
-			cache_data = NULL;
-			HANDLE hFile, hMapping;
-			hFile = (HANDLE) _get_osfhandle (fileno(fp));
-			if (hFile == (HANDLE) -1)
-				goto w32_fail;
-			hMapping = CreateFileMapping(hFile, NULL, PAGE_WRITECOPY, 0, 0, NULL);
-			if (!hMapping)
-				goto w32_fail;
-			cache_data = (unsigned char *)MapViewOfFile(hMapping, FILE_MAP_COPY, 0, 0, 0);
-			CloseHandle (hMapping);
-		w32_fail:
-			;
-#else
-			cache_data = mmap(NULL, map_len, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
-#endif
-		}
+		if (map_len > 0)
+			cache_data = msgcache_mmap_file(fp, map_len,
+							zero_copy && !indexed);
 	} else {
 		cache_data = NULL;
 	}
-	if (cache_data != NULL && cache_data != MAP_FAILED) {
+	if (cache_data != NULL) {
 		int rem_len = map_len-ftell(fp);
 		char *walk_data = cache_data+ftell(fp);
 
-		while(rem_len > 0) {
-			GET_CACHE_DATA_INT(num);
-			
-			msginfo = procmsg_msginfo_new();
-			msginfo->msgnum = num;
-			memusage += sizeof(MsgInfo);
-
-			GET_CACHE_DATA_INT(msginfo->size);
-			GET_CACHE_DATA_INT(msginfo->mtime);
-			GET_CACHE_DATA_INT(msginfo->date_t);
-			GET_CACHE_DATA_INT(msginfo->flags.tmp_flags);
-
-			GET_CACHE_DATA(msginfo->fromname, memusage);
-
-			GET_CACHE_DATA(msginfo->date, memusage);
-			GET_CACHE_DATA(msginfo->from, memusage);
-			GET_CACHE_DATA(msginfo->to, memusage);
-			GET_CACHE_DATA(msginfo->cc, memusage);
-			GET_CACHE_DATA(msginfo->newsgroups, memusage);
-			GET_CACHE_DATA(msginfo->subject, memusage);
-			GET_CACHE_DATA(msginfo->msgid, memusage);
-			GET_CACHE_DATA(msginfo->inreplyto, memusage);
-			GET_CACHE_DATA(msginfo->xref, memusage);
-
-			GET_CACHE_DATA_INT(msginfo->planned_download);
-			GET_CACHE_DATA_INT(msginfo->total_size);
-			GET_CACHE_DATA_INT(refnum);
-
-			for (; refnum != 0; refnum--) {
-				ref = NULL;
-
-				GET_CACHE_DATA(ref, memusage);
+		if (zero_copy) {
+			/* MsgInfo strings will point into the mapping,
+			 * which is accounted for as a whole. */
+			map = msgcache_map_new(cache_data, map_len);
+			memusage += map_len;
+		}
 
-				if (ref && *ref)
-					msginfo->references =
-						g_slist_prepend(msginfo->references, ref);
+		while(rem_len > 0 && (!indexed || nread < header.count)) {
+			msginfo = msgcache_get_cache_record(&walk_data, &rem_len,
+					cache, map, terminator, swapping,
+					conv, &memusage);
+			if (msginfo == NULL) {
+				error = TRUE;
+				goto bail_err;
 			}
-			if (msginfo->references)
-				msginfo->references =
-					g_slist_reverse(msginfo->references);
 
+			memusage -= procmsg_msginfo_intern_strings(msginfo);
 			msginfo->folder = item;
 			msginfo->flags.tmp_flags |= tmp_flags;
 
 			g_hash_table_insert(cache->msgnum_table, &msginfo->msgnum, msginfo);
 			if(msginfo->msgid)
 				g_hash_table_insert(cache->msgid_table, msginfo->msgid, msginfo);
+			msginfo = NULL;
+			nread++;
 		}
 	} else {
-		while (claws_fread(&num, sizeof(num), 1, fp) == 1) {
+		while ((!indexed || nread < header.count) &&
+		       claws_fread(&num, sizeof(num), 1, fp) == 1) {
 			if (swapping)
 				num = bswap_32(num);
 
-			msginfo = procmsg_msginfo_new();
+			msginfo = msgcache_block_alloc(cache);
 			msginfo->msgnum = num;
 			memusage += sizeof(MsgInfo);
 
@@ -753,22 +1607,41 @@ MsgCache *msgcache_read_cache(FolderItem *item, const gchar *cache_file)
 				msginfo->references =
 					g_slist_reverse(msginfo->references);
 
+			memusage -= procmsg_msginfo_intern_strings(msginfo);
 			msginfo->folder = item;
 			msginfo->flags.tmp_flags |= tmp_flags;
 
 			g_hash_table_insert(cache->msgnum_table, &msginfo->msgnum, msginfo);
 			if(msginfo->msgid)
 				g_hash_table_insert(cache->msgid_table, msginfo->msgid, msginfo);
+			msginfo = NULL;
+			nread++;
 		}
 	}
-bail_err:
-	if (cache_data != NULL && cache_data != MAP_FAILED) {
-#ifdef G_OS_WIN32
-		UnmapViewOfFile((void*) cache_data);
-#else
-		munmap(cache_data, map_len);
-#endif
+
+	if (indexed && header.threads != 0) {
+		MsgCacheThread *threads;
+		guint32 settings = 0;
+
+		threads = msgcache_read_threads(fp, &header, &settings);
+		if (threads != NULL && msgcache_check_threads(cache, threads,
+						header.threads_size)) {
+			cache->saved_threads = threads;
+			cache->saved_threads_len = header.threads_size;
+			cache->saved_threads_settings = settings;
+			memusage += header.threads_size * sizeof(MsgCacheThread);
+		} else {
+			debug_print("ignoring the saved threads of %s\n", cache_file);
+			g_free(threads);
+		}
 	}
+bail_err:
+	if (msginfo != NULL)
+		procmsg_msginfo_free(&msginfo);
+	if (map != NULL)
+		msgcache_map_unref(map);
+	else if (cache_data != NULL)
+		msgcache_munmap_file(cache_data, map_len);
 	claws_fclose(fp);
 	if (conv != NULL) {
 		if (conv->free != NULL)
@@ -790,18 +1663,137 @@ bail_err:
 	return cache;
 }
 
+/* Looks a single message up through the index of a CACHE_VERSION file,
+ * without reading the rest of the cache. Returns NULL if the message
+ * isn't there or the file has no usable index. */
+static MsgInfo *msgcache_peek(FolderItem *item, const gchar *cache_file,
+			      const gchar *mark_file, const gchar *tags_file,
+			      guint num, const gchar *msgid)
+{
+	MsgCache *cache;
+	MsgCacheHeader header;
+	MsgInfo *msginfo = NULL;
+	FILE *fp;
+	gchar *charset = NULL;
+	gchar *cache_data;
+	guint32 index, slots, key, slot, i;
+	gint map_len;
+	guint memusage = 0;
+	gboolean swapping = TRUE;
+	struct stat st;
+
+	cm_return_val_if_fail(item != NULL, NULL);
+	cm_return_val_if_fail(cache_file != NULL, NULL);
+
+	if (!msgcache_use_mmap_read)
+		return NULL;
+
+	if ((fp = msgcache_open_data_file(cache_file, CACHE_VERSION,
+			DATA_READ, NULL, 0)) == NULL)
+		return NULL;
+
+	if (msgcache_read_cache_data_str(fp, &charset, 1, NULL, swapping) < 0 ||
+	    g_strcmp0(charset, CS_UTF_8) != 0 ||
+	    !msgcache_read_cache_header(fp, &header) ||
+	    fstat(fileno(fp), &st) < 0) {
+		g_free(charset);
+		claws_fclose(fp);
+		return NULL;
+	}
+	g_free(charset);
+
+	if (msgid != NULL) {
+		index = header.msgid_index;
+		slots = header.msgid_index_size;
+		key = msgcache_msgid_hash(msgid);
+	} else {
+		index = header.num_index;
+		slots = header.num_index_size;
+		key = num;
+	}
+
+	map_len = st.st_size;
+	if (index == 0 || slots == 0 || (slots & (slots - 1)) != 0 ||
+	    (guint64)index + (guint64)slots * 8 > (guint64)map_len ||
+	    (cache_data = msgcache_mmap_file(fp, map_len, FALSE)) == NULL) {
+		claws_fclose(fp);
+		return NULL;
+	}
+
+	slot = msgcache_index_start(key, slots);
+	for (i = 0; i < slots && msginfo == NULL; i++) {
+		gchar *entry = cache_data + index + slot * 8;
+		guint32 offset = msgcache_map_get_int(entry + 4);
+		gchar *walk_data;
+		gint rem_len;
+
+		slot = (slot + 1) & (slots - 1);
+		if (offset == 0)
+			break;
+		if (msgcache_map_get_int(entry) != key || offset >= (guint32)map_len)
+			continue;
+
+		walk_data = cache_data + offset;
+		rem_len = map_len - offset;
+		msginfo = msgcache_get_cache_record(&walk_data, &rem_len,
+				NULL, NULL, 1, swapping, NULL, &memusage);
+		if (msginfo == NULL)
+			break;
+		/* different Message-ID with the same hash */
+		if (msgid != NULL && g_strcmp0(msginfo->msgid, msgid) != 0)
+			procmsg_msginfo_free(&msginfo);
+	}
+
+	msgcache_munmap_file(cache_data, map_len);
+	claws_fclose(fp);
+
+	if (msginfo == NULL)
+		return NULL;
+
+	msginfo->folder = item;
+	msginfo->flags.tmp_flags |= msgcache_get_tmp_flags(item);
+
+	/* Let the regular readers pick this message's flags and tags */
+	cache = msgcache_new();
+	g_hash_table_insert(cache->msgnum_table, &msginfo->msgnum,
+			    procmsg_msginfo_new_ref(msginfo));
+	if (mark_file != NULL)
+		msgcache_read_mark(cache, mark_file);
+	if (tags_file != NULL)
+		msgcache_read_tags(cache, tags_file);
+	msgcache_destroy(cache);
+
+	return msginfo;
+}
+
+MsgInfo *msgcache_peek_msg(FolderItem *item, const gchar *cache_file,
+			   const gchar *mark_file, const gchar *tags_file,
+			   guint num)
+{
+	return msgcache_peek(item, cache_file, mark_file, tags_file, num, NULL);
+}
+
+MsgInfo *msgcache_peek_msg_by_id(FolderItem *item, const gchar *cache_file,
+				 const gchar *mark_file, const gchar *tags_file,
+				 const gchar *msgid)
+{
+	cm_return_val_if_fail(msgid != NULL, NULL);
+
+	return msgcache_peek(item, cache_file, mark_file, tags_file, 0, msgid);
+}
+
 void msgcache_read_mark(MsgCache *cache, const gchar *mark_file)
 {
 	FILE *fp;
 	MsgInfo *msginfo;
 	MsgPermFlags perm_flags;
 	guint32 num;
+	guint records = 0, count;
 	gint map_len = -1;
 	char *cache_data = NULL;
 	struct stat st;
 	gboolean error = FALSE;
-
-	swapping = TRUE;
+	gboolean swapping = TRUE;
 
 	/* In case we can't open the mark file with MARK_VERSION, check if we can open it with the
 	 * swapped MARK_VERSION. As msgcache_open_data_file swaps it too, if this succeeds, 
@@ -850,6 +1842,7 @@ void msgcache_read_mark(MsgCache *cache, const gchar *mark_file)
 		while(rem_len > 0) {
 			GET_CACHE_DATA_INT(num);
 			GET_CACHE_DATA_INT(perm_flags);
+			records++;
 			msginfo = g_hash_table_lookup(cache->msgnum_table, &num);
 			if(msginfo) {
 				msginfo->flags.perm_flags = perm_flags;
@@ -865,6 +1858,7 @@ void msgcache_read_mark(MsgCache *cache, const gchar *mark_file)
 			}
 			if (swapping)
 				perm_flags = bswap_32(perm_flags);
+			records++;
 			msginfo = g_hash_table_lookup(cache->msgnum_table, &num);
 			if(msginfo) {
 				msginfo->flags.perm_flags = perm_flags;
@@ -883,6 +1877,9 @@ bail_err:
 	if (error) {
 		debug_print("error reading cache mark from %s\n", mark_file);
 	}
+
+	count = g_hash_table_size(cache->msgnum_table);
+	cache->mark_journal = records > count ? records - count : 0;
 }
 
 static void printAll(gpointer key, gpointer value, gpointer foo) {
@@ -895,13 +1892,14 @@ void msgcache_read_tags(MsgCache *cache, const gchar *tags_file)
     printf("***file*** %s\n", tags_file);
 	FILE *fp;
 	MsgInfo *msginfo;
+	GSList *tags = NULL;
 	guint32 num;
+	guint records = 0, count;
 	gint map_len = -1;
 	char *cache_data = NULL;
 	struct stat st;
 	gboolean error = FALSE;
-
-	swapping = TRUE;
+	gboolean swapping = TRUE;
 
 	/* In case we can't open the mark file with MARK_VERSION, check if we can open it with the
 	 * swapped MARK_VERSION. As msgcache_open_data_file swaps it too, if this succeeds, 
@@ -950,43 +1948,51 @@ void msgcache_read_tags(MsgCache *cache, const gchar *tags_file)
 		while(rem_len > 0) {
 			gint id = -1;
 			GET_CACHE_DATA_INT(num);
+			records++;
+			/* the ids have to be consumed even if the message
+			 * isn't in the cache */
+			tags = NULL;
+			do {
+				GET_CACHE_DATA_INT(id);
+				if (id > 0) {
+					tags = g_slist_prepend(tags,
+						GINT_TO_POINTER(id));
+				}
+			} while (id > 0);
 			msginfo = g_hash_table_lookup(cache->msgnum_table, &num);
 			if(msginfo) {
 				g_slist_free(msginfo->tags);
-				msginfo->tags = NULL;
-				do {
-					GET_CACHE_DATA_INT(id);
-					if (id > 0) {
-						msginfo->tags = g_slist_prepend(
-							msginfo->tags, 
-							GINT_TO_POINTER(id));
-					}
-				} while (id > 0);
-				msginfo->tags = g_slist_reverse(msginfo->tags);
+				msginfo->tags = g_slist_reverse(tags);
+			} else {
+				g_slist_free(tags);
 			}
+			tags = NULL;
 		}
 	} else {
 		while (claws_fread(&num, sizeof(num), 1, fp) == 1) {
 			gint id = -1;
 			if (swapping)
 				num = bswap_32(num);
+			records++;
+			tags = NULL;
+			do {
+				if (claws_fread(&id, sizeof(id), 1, fp) != 1) 
+					id = -1;
+				if (swapping)
+					id = bswap_32(id);
+				if (id > 0) {
+					tags = g_slist_prepend(tags,
+						GINT_TO_POINTER(id));
+				}
+			} while (id > 0);
 			msginfo = g_hash_table_lookup(cache->msgnum_table, &num);
 			if(msginfo) {
 				g_slist_free(msginfo->tags);
-				msginfo->tags = NULL;
-				do {
-					if (claws_fread(&id, sizeof(id), 1, fp) != 1) 
-						id = -1;
-					if (swapping)
-						id = bswap_32(id);
-					if (id > 0) {
-						msginfo->tags = g_slist_prepend(
-							msginfo->tags, 
-							GINT_TO_POINTER(id));
-					}
-				} while (id > 0);
-				msginfo->tags = g_slist_reverse(msginfo->tags);
+				msginfo->tags = g_slist_reverse(tags);
+			} else {
+				g_slist_free(tags);
 			}
+			tags = NULL;
 		}
 	}
 bail_err:
@@ -1001,6 +2007,11 @@ bail_err:
 	if (error) {
 		debug_print("error reading cache tags from %s\n", tags_file);
 	}
+	/* set if the file was truncated in the middle of a record */
+	g_slist_free(tags);
+
+	count = g_hash_table_size(cache->msgnum_table);
+	cache->tags_journal = records > count ? records - count : 0;
 
     g_hash_table_foreach(cache->msgnum_table, printAll, NULL);
 }
@@ -1065,6 +2076,313 @@ static int msgcache_write_tags(MsgInfo *msginfo, FILE *fp)
 	return w_err ? -1 : wrote;
 }
 
+/* Opens a mark or tags file for appending records, if it exists and
+ * is in the current format. Otherwise the whole file needs to be
+ * written. */
+static FILE *msgcache_open_journal(const gchar *file, guint version)
+{
+	FILE *fp;
+
+	if ((fp = msgcache_open_data_file(file, version, DATA_READ, NULL, 0)) == NULL)
+		return NULL;
+	claws_fclose(fp);
+
+	if ((fp = claws_fopen(file, "ab")) == NULL)
+		FILE_OP_ERROR(file, "claws_fopen");
+
+	return fp;
+}
+
+static gboolean msgcache_journal_full(MsgCache *cache, guint journal)
+{
+	return journal > MAX(JOURNAL_MIN_RECORDS,
+			     g_hash_table_size(cache->msgnum_table) / 8);
+}
+
+/* @cache may be NULL when it isn't loaded: the records appended
+ * meanwhile are counted when it is read. */
+gint msgcache_append_mark(MsgCache *cache, const gchar *mark_file,
+			  MsgInfo *msginfo)
+{
+	FILE *fp;
+	gint ret;
+
+	cm_return_val_if_fail(mark_file != NULL, -1);
+	cm_return_val_if_fail(msginfo != NULL, -1);
+
+	if (cache != NULL &&
+	    msgcache_journal_full(cache, cache->mark_journal))
+		return -1;
+	if ((fp = msgcache_open_journal(mark_file, MARK_VERSION)) == NULL)
+		return -1;
+
+	ret = msgcache_write_flags(msginfo, fp);
+	if (claws_safe_fclose(fp) != 0)
+		ret = -1;
+	if (ret < 0) {
+		FILE_OP_ERROR(mark_file, "claws_fwrite");
+		return -1;
+	}
+
+	if (cache != NULL)
+		cache->mark_journal++;
+	return 0;
+}
+
+gint msgcache_append_tags(MsgCache *cache, const gchar *tags_file,
+			  MsgInfo *msginfo)
+{
+	FILE *fp;
+	gint ret;
+
+	cm_return_val_if_fail(tags_file != NULL, -1);
+	cm_return_val_if_fail(msginfo != NULL, -1);
+
+	if (cache != NULL &&
+	    msgcache_journal_full(cache, cache->tags_journal))
+		return -1;
+	if ((fp = msgcache_open_journal(tags_file, TAGS_VERSION)) == NULL)
+		return -1;
+
+	ret = msgcache_write_tags(msginfo, fp);
+	if (claws_safe_fclose(fp) != 0)
+		ret = -1;
+	if (ret < 0) {
+		FILE_OP_ERROR(tags_file, "claws_fwrite");
+		return -1;
+	}
+
+	if (cache != NULL)
+		cache->tags_journal++;
+	return 0;
+}
+
+gboolean msgcache_needs_compaction(MsgCache *cache)
+{
+	cm_return_val_if_fail(cache != NULL, FALSE);
+
+	return msgcache_journal_full(cache, cache->mark_journal) ||
+	       msgcache_journal_full(cache, cache->tags_journal);
+}
+
+typedef struct _MsgCacheIndexEntry MsgCacheIndexEntry;
+struct _MsgCacheIndexEntry {
+	guint32		 num;
+	guint32		 offset;
+	guint32		 msgid_hash;
+	gboolean	 has_msgid;
+};
+
+static gint msgcache_write_cache_header(FILE *fp, MsgCacheHeader *header)
+{
+	int w_err = 0, wrote = 0;
+
+	WRITE_CACHE_DATA_INT(header->count, fp);
+	WRITE_CACHE_DATA_INT(CACHE_SECTION_COUNT, fp);
+	WRITE_CACHE_DATA_INT(CACHE_SECTION_NUM_INDEX, fp);
+	WRITE_CACHE_DATA_INT(header->num_index, fp);
+	WRITE_CACHE_DATA_INT(header->num_index_size, fp);
+	WRITE_CACHE_DATA_INT(CACHE_SECTION_MSGID_INDEX, fp);
+	WRITE_CACHE_DATA_INT(header->msgid_index, fp);
+	WRITE_CACHE_DATA_INT(header->msgid_index_size, fp);
+	WRITE_CACHE_DATA_INT(CACHE_SECTION_THREADS, fp);
+	WRITE_CACHE_DATA_INT(header->threads, fp);
+	WRITE_CACHE_DATA_INT(header->threads_size, fp);
+
+	return w_err ? -1 : wrote;
+}
+
+static gint msgcache_write_cache_index(FILE *fp, GArray *entries,
+				       gboolean by_msgid, guint32 *size)
+{
+	guint32 *table;
+	guint32 slots = 16, key, slot, i;
+	size_t len;
+
+	while (slots < entries->len * 2)
+		slots <<= 1;
+
+	table = g_new0(guint32, slots * 2);
+	for (i = 0; i < entries->len; i++) {
+		MsgCacheIndexEntry *entry = &g_array_index(entries,
+				MsgCacheIndexEntry, i);
+
+		if (by_msgid && !entry->has_msgid)
+			continue;
+		key = by_msgid ? entry->msgid_hash : entry->num;
+
+		slot = msgcache_index_start(key, slots);
+		while (table[slot * 2 + 1] != 0)
+			slot = (slot + 1) & (slots - 1);
+		table[slot * 2] = bswap_32(key);
+		table[slot * 2 + 1] = bswap_32(entry->offset);
+	}
+
+	len = claws_fwrite(table, sizeof(guint32), slots * 2, fp);
+	g_free(table);
+	*size = slots;
+
+	return len != slots * 2 ? -1 : slots * 2 * sizeof(guint32);
+}
+
+typedef struct _MsgCacheThreadFill MsgCacheThreadFill;
+struct _MsgCacheThreadFill {
+	MsgCacheThread	*threads;
+	guint		 len;
+	guint32		 top;
+	time_t		 date;
+};
+
+static gboolean msgcache_thread_date_func(GNode *node, gpointer data)
+{
+	MsgInfo *msginfo = (MsgInfo *)node->data;
+	MsgCacheThreadFill *fill = (MsgCacheThreadFill *)data;
+
+	if (msginfo->date_t > fill->date)
+		fill->date = msginfo->date_t;
+	return FALSE;
+}
+
+static gboolean msgcache_thread_fill_func(GNode *node, gpointer data)
+{
+	MsgInfo *msginfo = (MsgInfo *)node->data;
+	MsgInfo *parent = (MsgInfo *)node->parent->data;
+	MsgCacheThreadFill *fill = (MsgCacheThreadFill *)data;
+	MsgCacheThread *thread = &fill->threads[fill->len++];
+
+	thread->msgnum = msginfo->msgnum;
+	thread->parent = parent ? parent->msgnum : 0;
+	thread->top = fill->top;
+	thread->thread_date = fill->date;
+	return FALSE;
+}
+
+typedef struct _MsgCacheThreadCheck MsgCacheThreadCheck;
+struct _MsgCacheThreadCheck {
+	MsgCache	*cache;
+	guint		 found;
+};
+
+static gboolean msgcache_thread_check_func(GNode *node, gpointer data)
+{
+	MsgInfo *msginfo = (MsgInfo *)node->data;
+	MsgCacheThreadCheck *check = (MsgCacheThreadCheck *)data;
+
+	if (msginfo == NULL || g_hash_table_lookup(check->cache->msgnum_table,
+						   &msginfo->msgnum) != msginfo)
+		return TRUE;
+	check->found++;
+	return FALSE;
+}
+
+/**
+ * msgcache_set_thread_tree:
+ * @cache: the cache
+ * @root: a tree made by procmsg_get_thread_tree()
+ *
+ * Keeps the structure of @root to be written with the cache, if it
+ * holds exactly the messages of the cache. It then stays valid until
+ * a message is added, removed or updated.
+ */
+void msgcache_set_thread_tree(MsgCache *cache, GNode *root)
+{
+	MsgCacheThreadFill fill;
+	MsgCacheThreadCheck check;
+	GNode *node;
+	guint count;
+
+	cm_return_if_fail(cache != NULL);
+	cm_return_if_fail(root != NULL);
+
+	if (cache->saved_threads != NULL &&
+	    cache->saved_threads_settings == msgcache_thread_settings())
+		return;
+
+	/* only a tree of the whole folder can be saved */
+	count = g_node_n_nodes(root, G_TRAVERSE_ALL) - 1;
+	if (count != g_hash_table_size(cache->msgnum_table))
+		return;
+	check.cache = cache;
+	check.found = 0;
+	for (node = root->children; node != NULL; node = node->next)
+		g_node_traverse(node, G_PRE_ORDER, G_TRAVERSE_ALL, -1,
+				msgcache_thread_check_func, &check);
+	if (check.found != count)
+		return;
+
+	fill.threads = g_new(MsgCacheThread, count);
+	fill.len = 0;
+	for (node = root->children; node != NULL; node = node->next) {
+		MsgInfo *msginfo = (MsgInfo *)node->data;
+
+		fill.top = msginfo->msgnum;
+		fill.date = msginfo->date_t;
+		g_node_traverse(node, G_PRE_ORDER, G_TRAVERSE_ALL, -1,
+				msgcache_thread_date_func, &fill);
+		g_node_traverse(node, G_PRE_ORDER, G_TRAVERSE_ALL, -1,
+				msgcache_thread_fill_func, &fill);
+	}
+
+	msgcache_set_saved_threads(cache, fill.threads, fill.len,
+				   msgcache_thread_settings());
+}
+
+static gint msgcache_write_threads(FILE *fp, MsgCacheThread *threads,
+				   guint len, guint32 settings)
+{
+	guint32 *data;
+	guint i;
+	size_t n;
+
+	data = g_new(guint32, 1 + len * 4);
+	data[0] = bswap_32(settings);
+	for (i = 0; i < len; i++) {
+		data[1 + i * 4] = bswap_32(threads[i].msgnum);
+		data[2 + i * 4] = bswap_32(threads[i].parent);
+		data[3 + i * 4] = bswap_32(threads[i].top);
+		data[4 + i * 4] = bswap_32(threads[i].thread_date);
+	}
+	n = claws_fwrite(data, sizeof(guint32), 1 + len * 4, fp);
+	g_free(data);
+
+	return n != 1 + len * 4 ? -1 : n * sizeof(guint32);
+}
+
+/* Appends the index sections, and the thread section if there are
+ * threads, and fills in the header written as a placeholder at
+ * header_pos */
+static gint msgcache_write_cache_sections(FILE *fp, glong header_pos,
+					  GArray *entries, MsgCache *cache)
+{
+	MsgCacheHeader header;
+
+	memset(&header, 0, sizeof(MsgCacheHeader));
+	header.count = entries->len;
+
+	header.num_index = ftell(fp);
+	if (msgcache_write_cache_index(fp, entries, FALSE,
+			&header.num_index_size) < 0)
+		return -1;
+	header.msgid_index = ftell(fp);
+	if (msgcache_write_cache_index(fp, entries, TRUE,
+			&header.msgid_index_size) < 0)
+		return -1;
+	if (cache->saved_threads != NULL) {
+		header.threads = ftell(fp);
+		header.threads_size = cache->saved_threads_len;
+		if (msgcache_write_threads(fp, cache->saved_threads,
+				cache->saved_threads_len,
+				cache->saved_threads_settings) < 0)
+			return -1;
+	}
+
+	if (fseek(fp, header_pos, SEEK_SET) < 0 ||
+	    msgcache_write_cache_header(fp, &header) < 0)
+		return -1;
+
+	return 0;
+}
+
 struct write_fps
 {
 	FILE *cache_fp;
@@ -1074,6 +2392,7 @@ struct write_fps
 	guint cache_size;
 	guint mark_size;
 	guint tags_size;
+	GArray *index;
 };
 
 static void msgcache_write_func(gpointer key, gpointer value, gpointer user_data)
@@ -1086,6 +2405,15 @@ static void msgcache_write_func(gpointer key, gpointer value, gpointer user_data
 	write_fps = user_data;
 
 	if (write_fps->cache_fp) {
+		MsgCacheIndexEntry entry;
+
+		entry.num = msginfo->msgnum;
+		entry.offset = write_fps->cache_size;
+		entry.has_msgid = (msginfo->msgid != NULL);
+		entry.msgid_hash = entry.has_msgid ?
+			msgcache_msgid_hash(msginfo->msgid) : 0;
+		g_array_append_val(write_fps->index, entry);
+
 		tmp = msgcache_write_cache(msginfo, write_fps->cache_fp);
 		if (tmp < 0)
 			write_fps->error = 1;
@@ -1112,6 +2440,8 @@ gint msgcache_write(const gchar *cache_file, const gchar *mark_file, const gchar
 {
 	struct write_fps write_fps;
 	gchar *new_cache, *new_mark, *new_tags;
+	MsgCacheHeader header;
+	glong header_pos = 0;
 	int w_err = 0, wrote = 0;
 
 	START_TIMING("");
@@ -1125,6 +2455,7 @@ gint msgcache_write(const gchar *cache_file, const gchar *mark_file, const gchar
 	write_fps.cache_size = 0;
 	write_fps.mark_size = 0;
 	write_fps.tags_size = 0;
+	write_fps.index = NULL;
 
 	/* open files and write headers */
 
@@ -1138,6 +2469,15 @@ gint msgcache_write(const gchar *cache_file, const gchar *mark_file, const gchar
 			return -1;
 		}
 		WRITE_CACHE_DATA(CS_UTF_8, write_fps.cache_fp);
+
+		/* filled in once the records are written */
+		memset(&header, 0, sizeof(MsgCacheHeader));
+		header_pos = ftell(write_fps.cache_fp);
+		if (w_err == 0 && msgcache_write_cache_header(write_fps.cache_fp, &header) < 0)
+			w_err = 1;
+		write_fps.index = g_array_sized_new(FALSE, FALSE,
+				sizeof(MsgCacheIndexEntry),
+				g_hash_table_size(cache->msgnum_table));
 	} else {
 		write_fps.cache_fp = NULL;
 	}
@@ -1146,6 +2486,8 @@ gint msgcache_write(const gchar *cache_file, const gchar *mark_file, const gchar
 		g_warning("failed to write charset");
 		if (write_fps.cache_fp)
 			claws_fclose(write_fps.cache_fp);
+		if (write_fps.index)
+			g_array_free(write_fps.index, TRUE);
 		claws_unlink(new_cache);
 		g_free(new_cache);
 		g_free(new_mark);
@@ -1159,6 +2501,8 @@ gint msgcache_write(const gchar *cache_file, const gchar *mark_file, const gchar
 		if (write_fps.mark_fp == NULL) {
 			if (write_fps.cache_fp)
 				claws_fclose(write_fps.cache_fp);
+			if (write_fps.index)
+				g_array_free(write_fps.index, TRUE);
 			claws_unlink(new_cache);
 			g_free(new_cache);
 			g_free(new_mark);
@@ -1177,6 +2521,8 @@ gint msgcache_write(const gchar *cache_file, const gchar *mark_file, const gchar
 				claws_fclose(write_fps.cache_fp);
 			if (write_fps.mark_fp)
 				claws_fclose(write_fps.mark_fp);
+			if (write_fps.index)
+				g_array_free(write_fps.index, TRUE);
 			claws_unlink(new_cache);
 			claws_unlink(new_mark);
 			g_free(new_cache);
@@ -1204,6 +2550,14 @@ gint msgcache_write(const gchar *cache_file, const gchar *mark_file, const gchar
 	/* write data to the files */
 	g_hash_table_foreach(cache->msgnum_table, msgcache_write_func, (gpointer)&write_fps);
 
+	/* write the index and complete the cache header */
+	if (write_fps.cache_fp && write_fps.error == 0 &&
+	    msgcache_write_cache_sections(write_fps.cache_fp, header_pos,
+					  write_fps.index, cache) < 0)
+		write_fps.error = 1;
+	if (write_fps.index)
+		g_array_free(write_fps.index, TRUE);
+
 	/* close files */
 	if (write_fps.cache_fp)
 		write_fps.error |= (claws_safe_fclose(write_fps.cache_fp) != 0);
@@ -1226,11 +2580,15 @@ gint msgcache_write(const gchar *cache_file, const gchar *mark_file, const gchar
 		/* switch files */
 		if (cache_file)
 			move_file(new_cache, cache_file, TRUE);
-		if (mark_file)
+		if (mark_file) {
 			move_file(new_mark, mark_file, TRUE);
-		if (tags_file)
+			cache->mark_journal = 0;
+		}
+		if (tags_file) {
 			move_file(new_tags, tags_file, TRUE);
-		cache->last_access = time(NULL);
+			cache->tags_journal = 0;
+		}
+		msgcache_touch(cache);
 	}
 
 	g_free(new_cache);
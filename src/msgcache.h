@@ -27,6 +27,19 @@
 #include <glib.h>
 
 typedef struct _MsgCache MsgCache;
+typedef struct _MsgCacheStats MsgCacheStats;
+
+struct _MsgCacheStats {
+	/* lookups of a single message */
+	guint	hits;
+	guint	misses;
+	/* caches attached to a folder, and dropped again to free
+	 * memory */
+	guint	loads;
+	guint	evictions;
+	/* caches shrunk by msgcache_trim() */
+	guint	trims;
+};
 
 #include "procmsg.h"
 #include "folder.h"
@@ -35,6 +48,20 @@ MsgCache   	*msgcache_new				(void);
 void	   	 msgcache_destroy			(MsgCache *cache);
 MsgCache   	*msgcache_read_cache			(FolderItem *item,
 							 const gchar *cache_file);
+MsgCache   	*msgcache_read_cache_full		(FolderItem *item,
+							 const gchar *cache_file,
+							 MsgTmpFlags tmp_flags);
+MsgTmpFlags	 msgcache_get_tmp_flags			(FolderItem *item);
+MsgInfo		*msgcache_peek_msg			(FolderItem *item,
+							 const gchar *cache_file,
+							 const gchar *mark_file,
+							 const gchar *tags_file,
+							 guint num);
+MsgInfo		*msgcache_peek_msg_by_id		(FolderItem *item,
+							 const gchar *cache_file,
+							 const gchar *mark_file,
+							 const gchar *tags_file,
+							 const gchar *msgid);
 void	   	 msgcache_read_mark			(MsgCache *cache,
 							 const gchar *mark_file);
 void	   	 msgcache_read_tags			(MsgCache *cache,
@@ -43,6 +70,13 @@ gint	   	 msgcache_write				(const gchar *cache_file,
 							 const gchar *mark_file,
 							 const gchar *tags_file,
 							 MsgCache *cache);
+gint		 msgcache_append_mark			(MsgCache *cache,
+							 const gchar *mark_file,
+							 MsgInfo *msginfo);
+gint		 msgcache_append_tags			(MsgCache *cache,
+							 const gchar *tags_file,
+							 MsgInfo *msginfo);
+gboolean	 msgcache_needs_compaction		(MsgCache *cache);
 void 	   	 msgcache_add_msg			(MsgCache *cache,
 							 MsgInfo *msginfo);
 void 	   	 msgcache_remove_msg			(MsgCache *cache,
@@ -57,4 +91,26 @@ MsgInfoList	*msgcache_get_msg_list			(MsgCache *cache);
 time_t	   	 msgcache_get_last_access_time		(MsgCache *cache);
 gint	   	 msgcache_get_memory_usage		(MsgCache *cache);
 
+void		 msgcache_attach			(MsgCache *cache,
+							 FolderItem *item);
+FolderItem	*msgcache_get_item			(MsgCache *cache);
+gsize		 msgcache_get_total_memory_usage	(void);
+MsgCache	*msgcache_get_lru_oldest		(void);
+MsgCache	*msgcache_get_lru_newer			(MsgCache *cache);
+guint		 msgcache_trim				(MsgCache *cache);
+void		 msgcache_count_eviction		(void);
+void		 msgcache_get_stats			(MsgCacheStats *stats);
+MsgThreadIndex	*msgcache_get_thread_index		(MsgCache *cache);
+GNode		*msgcache_get_thread_tree		(MsgCache *cache,
+							 GSList *mlist);
+void		 msgcache_set_thread_tree		(MsgCache *cache,
+							 GNode *root);
+
+MsgCacheMap	*msgcache_map_ref			(MsgCacheMap *map);
+void		 msgcache_map_unref			(MsgCacheMap *map);
+gboolean	 msgcache_map_contains			(MsgCacheMap *map,
+							 gconstpointer ptr);
+
+void		 msgcache_block_unref			(MsgCacheBlock *block);
+
 #endif
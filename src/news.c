@@ -282,37 +282,50 @@ static void news_session_destroy(Session *session)
 		g_free(news_session->group);
 }
 
+static void nntp_ping_done(Folder *folder, int error, const struct tm *lt,
+			   gpointer data)
+{
+	Session *session = (Session *)data;
+	NewsSession *news_session = NEWS_SESSION(session);
+
+	news_folder_unlock(NEWS_FOLDER(folder));
+
+	/* the session may have been replaced meanwhile */
+	if (REMOTE_FOLDER(folder)->session != session)
+		return;
+
+	if (error != NEWSNNTP_NO_ERROR &&
+	    error != NEWSNNTP_ERROR_COMMAND_NOT_SUPPORTED &&
+	    error != NEWSNNTP_ERROR_COMMAND_NOT_UNDERSTOOD) {
+		log_warning(LOG_PROTOCOL, _("NNTP connection to %s:%d has been"
+		      " disconnected.\n"),
+		    news_session->folder->account->nntp_server,
+		    news_session->folder->account->set_nntpport ?
+		    news_session->folder->account->nntpport : NNTP_PORT);
+		REMOTE_FOLDER(news_session->folder)->session = NULL;
+		session_register_ping(session, NULL);
+		session->state = SESSION_DISCONNECTED;
+		session->sock = NULL;
+		session_destroy(session);
+		return;
+	}
+
+	session_set_access_time(session);
+}
+
+/* The DATE command is queued without waiting for it, so that the main
+ * loop isn't re-entered from this timeout. */
 static gboolean nntp_ping(gpointer data)
 {
 	Session *session = (Session *)data;
 	NewsSession *news_session = NEWS_SESSION(session);
-	int r;
-	struct tm lt;
 
 	if (session->state != SESSION_READY || news_folder_locked(news_session->folder))
 		return FALSE;
 	
 	news_folder_lock(NEWS_FOLDER(news_session->folder));
+	nntp_threaded_date_async(news_session->folder, nntp_ping_done, session);
 
-	if ((r = nntp_threaded_date(news_session->folder, &lt)) != NEWSNNTP_NO_ERROR) {
-		if (r != NEWSNNTP_ERROR_COMMAND_NOT_SUPPORTED &&
-		    r != NEWSNNTP_ERROR_COMMAND_NOT_UNDERSTOOD) {
-			log_warning(LOG_PROTOCOL, _("NNTP connection to %s:%d has been"
-			      " disconnected.\n"),
-			    news_session->folder->account->nntp_server,
-			    news_session->folder->account->set_nntpport ?
-			    news_session->folder->account->nntpport : NNTP_PORT);
-			REMOTE_FOLDER(news_session->folder)->session = NULL;
-			news_folder_unlock(NEWS_FOLDER(news_session->folder));
-			session->state = SESSION_DISCONNECTED;
-			session->sock = NULL;
-			session_destroy(session);
-			return FALSE;
-		}
-	}
-
-	news_folder_unlock(NEWS_FOLDER(news_session->folder));
-	session_set_access_time(session);
 	return TRUE;
 }
 
@@ -1158,9 +1171,8 @@ static void news_get_extra_fields(NewsSession *session, FolderItem *item, GSList
 		struct newsnntp_xhdr_resp_item *hdrval = clist_content(hdr);
 		msginfo = g_hash_table_lookup(hash_table, GINT_TO_POINTER(hdrval->hdr_article));
 		if (msginfo) {
-			if (msginfo->newsgroups)
-				g_free(msginfo->newsgroups);
-			msginfo->newsgroups = g_strdup(hdrval->hdr_value);
+			procmsg_msginfo_set_string(msginfo, &msginfo->newsgroups,
+						   hdrval->hdr_value);
 		}
 	}
 	newsnntp_xhdr_free(hdrlist);
@@ -1185,9 +1197,8 @@ static void news_get_extra_fields(NewsSession *session, FolderItem *item, GSList
 		struct newsnntp_xhdr_resp_item *hdrval = clist_content(hdr);
 		msginfo = g_hash_table_lookup(hash_table, GINT_TO_POINTER(hdrval->hdr_article));
 		if (msginfo) {
-			if (msginfo->to)
-				g_free(msginfo->to);
-			msginfo->to = g_strdup(hdrval->hdr_value);
+			procmsg_msginfo_set_string(msginfo, &msginfo->to,
+						   hdrval->hdr_value);
 		}
 	}
 	newsnntp_xhdr_free(hdrlist);
@@ -1212,9 +1223,8 @@ static void news_get_extra_fields(NewsSession *session, FolderItem *item, GSList
 		struct newsnntp_xhdr_resp_item *hdrval = clist_content(hdr);
 		msginfo = g_hash_table_lookup(hash_table, GINT_TO_POINTER(hdrval->hdr_article));
 		if (msginfo) {
-			if (msginfo->cc)
-				g_free(msginfo->cc);
-			msginfo->cc = g_strdup(hdrval->hdr_value);
+			procmsg_msginfo_set_string(msginfo, &msginfo->cc,
+						   hdrval->hdr_value);
 		}
 	}
 	newsnntp_xhdr_free(hdrlist);
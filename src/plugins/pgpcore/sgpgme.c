@@ -454,13 +454,20 @@ gpgme_data_t sgpgme_data_from_mimeinfo(MimeInfo *mimeinfo)
 {
 	gpgme_data_t data = NULL;
 	gpgme_error_t err;
-	FILE *fp = claws_fopen(mimeinfo->data.filename, "rb");
+	FILE *fp;
 
-	if (!fp) 
-		return NULL;
+	if (mimeinfo->content == MIMECONTENT_MEM) {
+		/* decoded in memory, no file to read it from */
+		err = gpgme_data_new_from_mem(&data, mimeinfo->data.mem,
+				strlen(mimeinfo->data.mem), 1);
+	} else {
+		fp = claws_fopen(mimeinfo->data.filename, "rb");
+		if (!fp) 
+			return NULL;
 
-	err = gpgme_data_new_from_filepart(&data, NULL, fp, mimeinfo->offset, mimeinfo->length);
-	claws_fclose(fp);
+		err = gpgme_data_new_from_filepart(&data, NULL, fp, mimeinfo->offset, mimeinfo->length);
+		claws_fclose(fp);
+	}
 
 	debug_print("data %p (%d %d)\n", (void *)&data, mimeinfo->offset, mimeinfo->length);
 	if (err) {
@@ -597,7 +597,9 @@ static gboolean pgpinline_sign(MimeInfo *mimeinfo, PrefsAccount *account, const
 	    	if (msgcontent->tmp == TRUE)
 			claws_unlink(msgcontent->data.filename);
 		g_free(msgcontent->data.filename);
-	}
+	} else if (msgcontent->content == MIMECONTENT_MEM &&
+		   msgcontent->tmp == TRUE)
+		g_free(msgcontent->data.mem);
 	msgcontent->data.mem = g_strdup(tmp);
 	msgcontent->content = MIMECONTENT_MEM;
 	g_free(tmp);
@@ -745,7 +747,9 @@ static gboolean pgpinline_encrypt(MimeInfo *mimeinfo, const gchar *encrypt_data)
 	    	if (msgcontent->tmp == TRUE)
 			claws_unlink(msgcontent->data.filename);
 		g_free(msgcontent->data.filename);
-	}
+	} else if (msgcontent->content == MIMECONTENT_MEM &&
+		   msgcontent->tmp == TRUE)
+		g_free(msgcontent->data.mem);
 	msgcontent->data.mem = g_strdup(tmp);
 	msgcontent->content = MIMECONTENT_MEM;
 	g_free(tmp);
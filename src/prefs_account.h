@@ -193,6 +193,7 @@ struct _PrefsAccount
 	gchar *imap_dir;
 	gboolean imap_subsonly;
 	gboolean low_bandwidth;
+	gint imap_max_connections;
 
 	gboolean set_sent_folder;
 	gchar *sent_folder;
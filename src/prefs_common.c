@@ -1162,6 +1162,10 @@ static PrefParam param[] = {
 	{"cache_min_keep_time", "0", &prefs_common.cache_min_keep_time, P_INT,
 	 NULL, NULL, NULL},
 #endif
+	{"cache_read_threads", "4", &prefs_common.cache_read_threads, P_INT,
+	 NULL, NULL, NULL},
+	{"cache_zero_copy", "TRUE", &prefs_common.cache_zero_copy, P_BOOL,
+	 NULL, NULL, NULL},
 	{"thread_by_subject_max_age", "10", &prefs_common.thread_by_subject_max_age,
 	P_INT, NULL, NULL, NULL },
 	{"last_opened_folder", "", &prefs_common.last_opened_folder,
@@ -1182,6 +1186,14 @@ static PrefParam param[] = {
 	 NULL, NULL, NULL},
 	{"live_dangerously", "FALSE", &prefs_common.live_dangerously, P_BOOL,
 	 NULL, NULL, NULL},
+	{"imap_idle", "TRUE", &prefs_common.imap_idle, P_BOOL,
+	 NULL, NULL, NULL},
+	{"imap_fetch_window", "50", &prefs_common.imap_fetch_window, P_INT,
+	 NULL, NULL, NULL},
+	{"imap_compress", "TRUE", &prefs_common.imap_compress, P_BOOL,
+	 NULL, NULL, NULL},
+	{"imap_prefetch_max", "200", &prefs_common.imap_prefetch_max, P_INT,
+	 NULL, NULL, NULL},
 	{"save_parts_readwrite", "FALSE", &prefs_common.save_parts_readwrite, P_BOOL,
 	 NULL, NULL, NULL},
 	{"hide_quotes", "0", &prefs_common.hide_quotes, P_INT,
@@ -456,6 +456,8 @@ struct _PrefsCommon
 	/* Memory cache*/
 	gint cache_max_mem_usage;
 	gint cache_min_keep_time;
+	gint cache_read_threads;
+	gboolean cache_zero_copy;
 	
 	/* boolean for work offline 
 	   stored here for use in inc.c */
@@ -528,6 +530,10 @@ struct _PrefsCommon
 	gint broken_are_utf8;
 	gint skip_ssl_cert_check;
 	gint live_dangerously;
+	gboolean imap_idle;
+	gint imap_fetch_window;
+	gboolean imap_compress;
+	gint imap_prefetch_max;
 	gint save_parts_readwrite;
 	gint never_send_retrcpt;
 	gint hide_quotes;
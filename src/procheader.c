@@ -42,6 +42,7 @@
 #include "utils.h"
 #include "defs.h"
 #include "file-utils.h"
+#include "headerblock.h"
 
 #define BUFFSIZE	8192
 
@@ -493,92 +494,43 @@ MsgInfo *procheader_parse_str(const gchar *str, MsgFlags flags, gboolean full,
 	return parse_stream(&str, TRUE, flags, full, decrypted);
 }
 
-enum
+/* Reads the header block of @fp at once, leaving @fp after the empty
+ * line closing it. */
+static gchar *procheader_read_header_block(FILE *fp, gsize *length)
 {
-	H_DATE = 0,
-	H_FROM,
-	H_TO,
-	H_CC,
-	H_NEWSGROUPS,
-	H_SUBJECT,
-	H_MSG_ID,
-	H_REFERENCES,
-	H_IN_REPLY_TO,
-	H_CONTENT_TYPE,
-	H_SEEN,
-	H_STATUS,
-	H_FROM_SPACE,
-	H_SC_PLANNED_DOWNLOAD,
-	H_SC_MESSAGE_SIZE,
-	H_FACE,
-	H_X_FACE,
-	H_DISPOSITION_NOTIFICATION_TO,
-	H_RETURN_RECEIPT_TO,
-	H_SC_PARTIALLY_RETRIEVED,
-	H_SC_ACCOUNT_SERVER,
-	H_SC_ACCOUNT_LOGIN,
-	H_LIST_POST,
-	H_LIST_SUBSCRIBE,
-	H_LIST_UNSUBSCRIBE,
-	H_LIST_HELP,
-	H_LIST_ARCHIVE,
-	H_LIST_OWNER,
-	H_RESENT_FROM,
-};
-
-static HeaderEntry hentry_full[] = {
-				   {"Date:",		NULL, FALSE},
-				   {"From:",		NULL, TRUE},
-				   {"To:",		NULL, TRUE},
-				   {"Cc:",		NULL, TRUE},
-				   {"Newsgroups:",	NULL, TRUE},
-				   {"Subject:",		NULL, TRUE},
-				   {"Message-ID:",	NULL, FALSE},
-				   {"References:",	NULL, FALSE},
-				   {"In-Reply-To:",	NULL, FALSE},
-				   {"Content-Type:",	NULL, FALSE},
-				   {"Seen:",		NULL, FALSE},
-				   {"Status:",          NULL, FALSE},
-				   {"From ",		NULL, FALSE},
-				   {"SC-Marked-For-Download:", NULL, FALSE},
-				   {"SC-Message-Size:", NULL, FALSE},
-				   {"Face:",		NULL, FALSE},
-				   {"X-Face:",		NULL, FALSE},
-				   {"Disposition-Notification-To:", NULL, FALSE},
-				   {"Return-Receipt-To:", NULL, FALSE},
-				   {"SC-Partially-Retrieved:", NULL, FALSE},
-				   {"SC-Account-Server:", NULL, FALSE},
-				   {"SC-Account-Login:",NULL, FALSE},
-				   {"List-Post:",	NULL, TRUE},
-				   {"List-Subscribe:",	NULL, TRUE},
-				   {"List-Unsubscribe:",NULL, TRUE},
-				   {"List-Help:",	NULL, TRUE},
- 				   {"List-Archive:",	NULL, TRUE},
- 				   {"List-Owner:",	NULL, TRUE},
- 				   {"Resent-From:",	NULL, TRUE},
-				   {NULL,		NULL, FALSE}};
-
-static HeaderEntry hentry_short[] = {
-				    {"Date:",		NULL, FALSE},
-				    {"From:",		NULL, TRUE},
-				    {"To:",		NULL, TRUE},
-				    {"Cc:",		NULL, TRUE},
-				    {"Newsgroups:",	NULL, TRUE},
-				    {"Subject:",	NULL, TRUE},
-				    {"Message-ID:",	NULL, FALSE},
-				    {"References:",	NULL, FALSE},
-				    {"In-Reply-To:",	NULL, FALSE},
-				    {"Content-Type:",	NULL, FALSE},
-				    {"Seen:",		NULL, FALSE},
-				    {"Status:",		NULL, FALSE},
-				    {"From ",		NULL, FALSE},
-				    {"SC-Marked-For-Download:", NULL, FALSE},
-				    {"SC-Message-Size:",NULL, FALSE},
-				    {NULL,		NULL, FALSE}};
-
-static HeaderEntry* procheader_get_headernames(gboolean full)
-{
-	return full ? hentry_full : hentry_short;
+	gsize size = BUFFSIZE;
+	gsize len = 0, scanned = 0, n;
+	gboolean found = FALSE, eof = FALSE;
+	long start;
+	gchar *buf;
+
+	start = ftell(fp);
+	buf = g_malloc(size + 1);
+
+	while (!found && !eof) {
+		if (len == size) {
+			size *= 2;
+			buf = g_realloc(buf, size + 1);
+		}
+		n = claws_fread(buf + len, 1, size - len, fp);
+		eof = (n < size - len);
+		len += n;
+		found = header_block_find_end(buf, len, &scanned, eof);
+	}
+
+	if (found) {
+		gchar *p = buf + scanned;
+
+		if (start >= 0 &&
+		    fseek(fp, start + (header_block_next_line(p, buf + len) - buf),
+			  SEEK_SET) < 0)
+			FILE_OP_ERROR("header block", "fseek");
+		len = scanned;
+	}
+	buf[len] = '\0';
+	*length = len;
+
+	return buf;
 }
 
 MsgInfo *procheader_parse_stream(FILE *fp, MsgFlags flags, gboolean full,
@@ -594,12 +546,12 @@ static gboolean avatar_from_some_face(gpointer source, gpointer userdata)
 	if (*(acd->content) == '\0') /* won't be null, but may be empty */
 		return FALSE;
 
-	if (!strcmp(acd->header, hentry_full[H_FACE].name)) {
+	if (!strcmp(acd->header, header_block_entries[H_FACE].name)) {
 		debug_print("avatar_from_some_face: found 'Face' header\n");
 		procmsg_msginfo_add_avatar(acd->msginfo, AVATAR_FACE, acd->content);
 	}
 #if HAVE_LIBCOMPFACE
-	else if (!strcmp(acd->header, hentry_full[H_X_FACE].name)) {
+	else if (!strcmp(acd->header, header_block_entries[H_X_FACE].name)) {
 		debug_print("avatar_from_some_face: found 'X-Face' header\n");
 		procmsg_msginfo_add_avatar(acd->msginfo, AVATAR_XFACE, acd->content);
 	}
@@ -616,7 +568,8 @@ static MsgInfo *parse_stream(void *data, gboolean isstring, MsgFlags flags,
 	gchar *buf = NULL;
 	gchar *p, *tmp;
 	gchar *hp;
-	HeaderEntry *hentry;
+	gchar *block, *pos;
+	gsize len;
 	gint hnum;
 	void *orig_data = data;
 
@@ -624,8 +577,6 @@ static MsgInfo *parse_stream(void *data, gboolean isstring, MsgFlags flags,
 		isstring ? (get_one_field_func)string_get_one_field
 			 : (get_one_field_func)procheader_get_one_field;
 
-	hentry = procheader_get_headernames(full);
-
 	if (MSG_IS_QUEUED(flags) || MSG_IS_DRAFT(flags)) {
 		while (get_one_field(&buf, data, NULL) != -1) {
 			if ((!strncmp(buf, "X-Claws-End-Special-Headers: 1",
@@ -670,10 +621,21 @@ static MsgInfo *parse_stream(void *data, gboolean isstring, MsgFlags flags,
 		avatar_hook_id = HOOK_NONE;
 	}
 
-	while ((hnum = get_one_field(&buf, data, hentry)) != -1) {
-		hp = buf + strlen(hentry[hnum].name);
-		while (*hp == ' ' || *hp == '\t') hp++;
-
+	/* the header block is read once and split in place */
+	if (isstring) {
+		gsize scanned = 0;
+
+		block = g_strdup(*(gchar **)data);
+		len = strlen(block);
+		if (header_block_find_end(block, len, &scanned, TRUE))
+			len = scanned;
+		block[len] = '\0';
+	} else
+		block = procheader_read_header_block((FILE *)data, &len);
+
+	pos = block;
+	while ((hnum = header_block_next_field(&pos, block + len, full,
+					       &hp)) != -1) {
 		switch (hnum) {
 		case H_DATE:
 			if (msginfo->date) break;
@@ -689,7 +651,7 @@ static MsgInfo *parse_stream(void *data, gboolean isstring, MsgFlags flags,
 				if (utf == NULL || 
 				    !g_utf8_validate(utf, -1, NULL)) {
 					g_free(utf);
-					utf = g_malloc(strlen(buf)*2+1);
+					utf = g_malloc(strlen(hp)*2+1);
 					conv_localetodisp(utf, 
 						strlen(hp)*2+1, hp);
 				}
@@ -867,19 +829,20 @@ static MsgInfo *parse_stream(void *data, gboolean isstring, MsgFlags flags,
 			/* no extra memory is wasted, hooks are expected to
 			   take care of copying members when needed */
 			acd->msginfo = msginfo;
-			acd->header  = hentry_full[hnum].name;
+			acd->header  = header_block_entries[hnum].name;
 			acd->content = hp;
 			hooks_invoke(AVATAR_HEADER_UPDATE_HOOKLIST, (gpointer)acd);
 			g_free(acd);
 		}
-		g_free(buf);
-		buf = NULL;
 	}
+	g_free(block);
 
 	if (!msginfo->inreplyto && msginfo->references)
 		msginfo->inreplyto =
 			g_strdup((gchar *)msginfo->references->data);
 
+	procmsg_msginfo_intern_strings(msginfo);
+
 	return msginfo;
 }
 
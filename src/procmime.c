@@ -101,6 +101,9 @@ void procmime_force_charset(const gchar *str)
 
 static EncodingType forced_encoding = 0;
 
+/* biggest text parts decoded in memory rather than to a temporary file */
+#define PROCMIME_MEM_DECODE_MAX		(512 * 1024)
+
 void procmime_force_encoding(EncodingType encoding)
 {
 	forced_encoding = encoding;
@@ -257,6 +260,36 @@ const gchar *procmime_mimeinfo_get_parameter(MimeInfo *mimeinfo, const gchar *na
 	return value;
 }
 
+/* Opens the content of mimeinfo for reading, from the start of its file
+ * or memory buffer; content in memory is read in place. */
+FILE *procmime_open_content(MimeInfo *mimeinfo)
+{
+	FILE *fp;
+
+	cm_return_val_if_fail(mimeinfo != NULL, NULL);
+
+	switch (mimeinfo->content) {
+	case MIMECONTENT_FILE:
+		cm_return_val_if_fail(mimeinfo->data.filename != NULL, NULL);
+		if ((fp = claws_fopen(mimeinfo->data.filename, "rb")) == NULL)
+			FILE_OP_ERROR(mimeinfo->data.filename, "claws_fopen");
+		return fp;
+
+	case MIMECONTENT_MEM:
+		cm_return_val_if_fail(mimeinfo->data.mem != NULL, NULL);
+#if HAVE_FMEMOPEN
+		if (*mimeinfo->data.mem != '\0' &&
+		    (fp = fmemopen(mimeinfo->data.mem,
+				   strlen(mimeinfo->data.mem), "rb")) != NULL)
+			return fp;
+#endif
+		return str_open_as_stream(mimeinfo->data.mem);
+
+	default:
+		return NULL;
+	}
+}
+
 #define FLUSH_LASTLINE() {							\
 	if (*lastline != '\0') {						\
 		gint llen = 0;							\
@@ -283,8 +316,10 @@ gboolean procmime_decode_content(MimeInfo *mimeinfo)
 {
 	gchar buf[BUFFSIZE];
 	gint readend;
-	gchar *tmpfilename;
-	FILE *outfp, *infp;
+	gchar *tmpfilename = NULL;
+	gchar *membuf = NULL;
+	size_t memlen = 0;
+	FILE *outfp = NULL, *infp;
 	GStatBuf statbuf;
 	gboolean tmp_file = FALSE;
 	gboolean flowed = FALSE;
@@ -327,18 +362,29 @@ gboolean procmime_decode_content(MimeInfo *mimeinfo)
 	if (mimeinfo->data.filename == NULL)
 		return FALSE;
 
-	infp = claws_fopen(mimeinfo->data.filename, "rb");
-	if (!infp) {
-		FILE_OP_ERROR(mimeinfo->data.filename, "claws_fopen");
-		return FALSE;
-	}
-	if (fseek(infp, mimeinfo->offset, SEEK_SET) < 0) {
-		FILE_OP_ERROR(mimeinfo->data.filename, "fseek");
-		claws_fclose(infp);
+	infp = procmime_open_content(mimeinfo);
+	if (!infp)
 		return FALSE;
+	if (mimeinfo->content == MIMECONTENT_MEM) {
+		/* the buffer holds the part only */
+		readend = strlen(mimeinfo->data.mem);
+	} else {
+		if (fseek(infp, mimeinfo->offset, SEEK_SET) < 0) {
+			FILE_OP_ERROR(mimeinfo->data.filename, "fseek");
+			claws_fclose(infp);
+			return FALSE;
+		}
+		readend = mimeinfo->offset + mimeinfo->length;
 	}
 
-	outfp = get_tmpfile_in_dir(get_mime_tmp_dir(), &tmpfilename);
+	/* text parts we're about to show or search are decoded in memory */
+#if HAVE_OPEN_MEMSTREAM
+	if (mimeinfo->type == MIMETYPE_TEXT &&
+	    mimeinfo->length <= PROCMIME_MEM_DECODE_MAX)
+		outfp = open_memstream(&membuf, &memlen);
+#endif
+	if (!outfp)
+		outfp = get_tmpfile_in_dir(get_mime_tmp_dir(), &tmpfilename);
 	if (!outfp) {
 		perror("tmpfile");
 		claws_fclose(infp);
@@ -346,7 +392,6 @@ gboolean procmime_decode_content(MimeInfo *mimeinfo)
 	}
 
 	tmp_file = TRUE;
-	readend = mimeinfo->offset + mimeinfo->length;
 
 	account_signatures_matchlist_create(); /* FLUSH_LASTLINE will use it */
 
@@ -383,6 +428,7 @@ gboolean procmime_decode_content(MimeInfo *mimeinfo)
 				if (tmp_file) 
 					claws_fclose(outfp);
 				claws_fclose(infp);
+				free(membuf);
 				return FALSE;
 			}
 		} else
@@ -471,21 +517,60 @@ gboolean procmime_decode_content(MimeInfo *mimeinfo)
 	account_signatures_matchlist_delete();
 
 	if (err == TRUE) {
+		free(membuf);
 		return FALSE;
 	}
 
-	if (g_stat(tmpfilename, &statbuf) < 0) {
+	if (membuf != NULL && memchr(membuf, '\0', memlen) != NULL) {
+		/* content in memory is a string, keep this one in a file */
+		outfp = get_tmpfile_in_dir(get_mime_tmp_dir(), &tmpfilename);
+		if (!outfp) {
+			perror("tmpfile");
+			free(membuf);
+			return FALSE;
+		}
+		err = claws_fwrite(membuf, 1, memlen, outfp) < memlen;
+		if (claws_fclose(outfp) == EOF)
+			err = TRUE;
+		free(membuf);
+		membuf = NULL;
+		if (err == TRUE) {
+			FILE_OP_ERROR(tmpfilename, "claws_fwrite");
+			claws_unlink(tmpfilename);
+			g_free(tmpfilename);
+			return FALSE;
+		}
+	}
+
+	if (membuf == NULL && g_stat(tmpfilename, &statbuf) < 0) {
 		FILE_OP_ERROR(tmpfilename, "stat");
 		return FALSE;
 	}
 
-	if (mimeinfo->tmp)
-		claws_unlink(mimeinfo->data.filename);
-	g_free(mimeinfo->data.filename);
-	mimeinfo->data.filename = tmpfilename;
+	if (mimeinfo->content == MIMECONTENT_FILE) {
+		if (mimeinfo->tmp)
+			claws_unlink(mimeinfo->data.filename);
+		g_free(mimeinfo->data.filename);
+	} else if (mimeinfo->content == MIMECONTENT_MEM) {
+		if (mimeinfo->tmp)
+			g_free(mimeinfo->data.mem);
+	}
+
+	if (membuf != NULL) {
+		/* open_memstream() buffers aren't ours to g_free() */
+		mimeinfo->content = MIMECONTENT_MEM;
+		mimeinfo->data.mem = g_malloc(memlen + 1);
+		memcpy(mimeinfo->data.mem, membuf, memlen);
+		mimeinfo->data.mem[memlen] = '\0';
+		mimeinfo->length = memlen;
+		free(membuf);
+	} else {
+		mimeinfo->content = MIMECONTENT_FILE;
+		mimeinfo->data.filename = tmpfilename;
+		mimeinfo->length = statbuf.st_size;
+	}
 	mimeinfo->tmp = TRUE;
 	mimeinfo->offset = 0;
-	mimeinfo->length = statbuf.st_size;
 	mimeinfo->encoding_type = ENC_BINARY;
 
 	return TRUE;
@@ -668,6 +753,17 @@ static gint procmime_get_part_to_stream(FILE *outfp, MimeInfo *mimeinfo)
 	if (mimeinfo->encoding_type != ENC_BINARY && !procmime_decode_content(mimeinfo))
 		return -EINVAL;
 
+	if (mimeinfo->content == MIMECONTENT_MEM) {
+		gsize len = strlen(mimeinfo->data.mem);
+
+		if (claws_fwrite(mimeinfo->data.mem, 1, len, outfp) < len) {
+			saved_errno = errno;
+			return -(saved_errno);
+		}
+		rewind(outfp);
+		return 0;
+	}
+
 	if ((infp = claws_fopen(mimeinfo->data.filename, "rb")) == NULL) {
 		saved_errno = errno;
 		FILE_OP_ERROR(mimeinfo->data.filename, "claws_fopen");
@@ -741,16 +837,22 @@ gboolean procmime_scan_text_content(MimeInfo *mimeinfo,
 	if (!procmime_decode_content(mimeinfo))
 		return TRUE;
 
-	tmpfp = my_tmpfile_with_len(mimeinfo->length * 2);
+	if (mimeinfo->content == MIMECONTENT_MEM) {
+		tmpfp = procmime_open_content(mimeinfo);
+		if (tmpfp == NULL)
+			return TRUE;
+	} else {
+		tmpfp = my_tmpfile_with_len(mimeinfo->length * 2);
 
-	if (tmpfp == NULL) {
-		FILE_OP_ERROR("tmpfile", "open");
-		return TRUE;
-	}
+		if (tmpfp == NULL) {
+			FILE_OP_ERROR("tmpfile", "open");
+			return TRUE;
+		}
 
-	if ((r = procmime_get_part_to_stream(tmpfp, mimeinfo)) < 0) {
-		g_warning("procmime_get_part_to_stream error %d\n", r);
-		return TRUE;
+		if ((r = procmime_get_part_to_stream(tmpfp, mimeinfo)) < 0) {
+			g_warning("procmime_get_part_to_stream error %d\n", r);
+			return TRUE;
+		}
 	}
 
 	src_codeset = forced_charset
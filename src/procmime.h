@@ -191,6 +191,7 @@ void procmime_scan_subject              (MimeInfo       *mimeinfo,
 			                 const gchar    *subject);
 MimeInfo *procmime_scan_mime_header	(FILE		*fp);
 
+FILE *procmime_open_content		(MimeInfo	*mimeinfo);
 gboolean procmime_decode_content	(MimeInfo	*mimeinfo);
 gboolean procmime_encode_content	(MimeInfo	*mimeinfo, EncodingType encoding);
 gint procmime_get_part			(const gchar	*outfile,
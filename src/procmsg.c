@@ -50,6 +50,7 @@
 #include "inc.h"
 #include "privacy.h"
 #include "file-utils.h"
+#include "stringtable.h"
 
 extern SessionStats session_stats;
 
@@ -205,110 +206,399 @@ static void subject_hashtable_free(gpointer key, gpointer value, gpointer data)
 	g_slist_free(value);
 }
 
+/* Threads are built the way jwz describes it: every message id seen
+ * in a Message-ID, In-Reply-To or References header has a container,
+ * linked to the container of its parent. Containers of messages that
+ * are missing still join their replies together. A folder keeps its
+ * index along with its cache and updates it as messages come and go,
+ * so only the tree of the messages to show is built each time. */
+typedef struct _MsgThreadContainer MsgThreadContainer;
+
+struct _MsgThreadContainer {
+	gchar			*msgid;
+	MsgThreadContainer	*parent;
+	guint			 nchildren;
+	/* messages with this id in the folder */
+	guint			 nmsgs;
+
+	/* set while building a tree: the node of the message shown
+	 * for it, and the nearest shown container above it */
+	guint			 stamp;
+	GNode			*node;
+	guint			 shown_stamp;
+	MsgThreadContainer	*shown;
+};
+
+struct _MsgThreadIndex {
+	GHashTable	*table;
+	gsize		 memusage;
+	guint		 stamp;
+};
+
+static void thread_container_free(gpointer data)
+{
+	MsgThreadContainer *container = (MsgThreadContainer *)data;
+
+	g_free(container->msgid);
+	g_free(container);
+}
+
+MsgThreadIndex *procmsg_thread_index_new(void)
+{
+	MsgThreadIndex *index;
+
+	index = g_new0(MsgThreadIndex, 1);
+	index->table = g_hash_table_new_full(g_str_hash, g_str_equal,
+					     NULL, thread_container_free);
+	index->memusage = sizeof(MsgThreadIndex);
+
+	return index;
+}
+
+void procmsg_thread_index_free(MsgThreadIndex *index)
+{
+	if (index == NULL)
+		return;
+
+	g_hash_table_destroy(index->table);
+	g_free(index);
+}
+
+gsize procmsg_thread_index_memusage(MsgThreadIndex *index)
+{
+	cm_return_val_if_fail(index != NULL, 0);
+
+	return index->memusage;
+}
+
+static MsgThreadContainer *thread_index_get(MsgThreadIndex *index,
+					    const gchar *msgid)
+{
+	MsgThreadContainer *container;
+
+	container = g_hash_table_lookup(index->table, msgid);
+	if (container == NULL) {
+		container = g_new0(MsgThreadContainer, 1);
+		container->msgid = g_strdup(msgid);
+		g_hash_table_insert(index->table, container->msgid, container);
+		index->memusage += sizeof(MsgThreadContainer)
+			+ strlen(msgid) + 1;
+	}
+
+	return container;
+}
+
+/* Links @container below @parent, unless that would close a loop.
+ * Only a container with replies can be above another one, so the
+ * walk up is skipped for the usual new message. */
+static void thread_container_set_parent(MsgThreadContainer *container,
+					MsgThreadContainer *parent)
+{
+	MsgThreadContainer *cur;
+
+	if (container->parent == parent || container == parent)
+		return;
+
+	if (parent != NULL && container->nchildren > 0) {
+		for (cur = parent; cur != NULL; cur = cur->parent)
+			if (cur == container)
+				return;
+	}
+
+	if (container->parent != NULL)
+		container->parent->nchildren--;
+	container->parent = parent;
+	if (parent != NULL)
+		parent->nchildren++;
+}
+
+void procmsg_thread_index_add(MsgThreadIndex *index, MsgInfo *msginfo)
+{
+	MsgThreadContainer *container, *parent = NULL, *prev = NULL;
+	GSList *cur;
+
+	cm_return_if_fail(index != NULL);
+	cm_return_if_fail(msginfo != NULL);
+
+	if (msginfo->msgid == NULL || *msginfo->msgid == '\0')
+		return;
+
+	container = thread_index_get(index, msginfo->msgid);
+	if (container->nmsgs++ > 0)
+		return;
+
+	/* the references are newest first; each one that has no
+	 * parent yet hangs below the one before it */
+	for (cur = msginfo->references; cur != NULL; cur = cur->next) {
+		MsgThreadContainer *ref;
+
+		if (cur->data == NULL || *(gchar *)cur->data == '\0')
+			continue;
+		ref = thread_index_get(index, (gchar *)cur->data);
+		if (prev == NULL)
+			parent = ref;
+		else if (prev->parent == NULL)
+			thread_container_set_parent(prev, ref);
+		prev = ref;
+	}
+	if (msginfo->inreplyto && *msginfo->inreplyto != '\0')
+		parent = thread_index_get(index, msginfo->inreplyto);
+
+	/* the message's own headers win over what its replies said */
+	if (parent != NULL)
+		thread_container_set_parent(container, parent);
+}
+
+void procmsg_thread_index_remove(MsgThreadIndex *index, MsgInfo *msginfo)
+{
+	MsgThreadContainer *container, *parent;
+
+	cm_return_if_fail(index != NULL);
+	cm_return_if_fail(msginfo != NULL);
+
+	if (msginfo->msgid == NULL)
+		return;
+
+	container = g_hash_table_lookup(index->table, msginfo->msgid);
+	if (container == NULL || container->nmsgs == 0)
+		return;
+	if (--container->nmsgs > 0)
+		return;
+
+	/* drop the containers nothing points to any more */
+	while (container != NULL && container->nmsgs == 0
+	       && container->nchildren == 0) {
+		parent = container->parent;
+		thread_container_set_parent(container, NULL);
+		index->memusage -= sizeof(MsgThreadContainer)
+			+ strlen(container->msgid) + 1;
+		g_hash_table_remove(index->table, container->msgid);
+		container = parent;
+	}
+}
+
+static void thread_container_reset_stamp(gpointer key, gpointer value,
+					 gpointer data)
+{
+	MsgThreadContainer *container = (MsgThreadContainer *)value;
+
+	container->stamp = 0;
+	container->shown_stamp = 0;
+}
+
+/* The nearest container at or above @container that has a message in
+ * the tree being built. What is found is remembered along the way, so
+ * long runs of hidden messages are only walked once. */
+static MsgThreadContainer *thread_container_find_shown(MsgThreadContainer *container,
+						       guint stamp)
+{
+	MsgThreadContainer *cur, *shown = NULL;
+
+	for (cur = container; cur != NULL; cur = cur->parent) {
+		if (cur->stamp == stamp) {
+			shown = cur;
+			break;
+		}
+		if (cur->shown_stamp == stamp) {
+			shown = cur->shown;
+			break;
+		}
+	}
+	for (cur = container; cur != NULL && cur->stamp != stamp
+	     && cur->shown_stamp != stamp; cur = cur->parent) {
+		cur->shown_stamp = stamp;
+		cur->shown = shown;
+	}
+
+	return shown;
+}
+
+static gboolean thread_set_top_func(GNode *node, gpointer data)
+{
+	GHashTable *tops = (GHashTable *)data;
+
+	/* parents come first, down from the top of the thread */
+	if (g_hash_table_lookup(tops, node) == NULL)
+		g_hash_table_insert(tops, node,
+				    g_hash_table_lookup(tops, node->parent));
+	return FALSE;
+}
+
+/* The thread @node ended up in, after the subject pass moved whole
+ * threads below others. */
+static GNode *thread_find_top(GHashTable *tops, GHashTable *merged, GNode *node)
+{
+	GNode *top, *next;
+
+	top = g_hash_table_lookup(tops, node);
+	while ((next = g_hash_table_lookup(merged, top)) != NULL) {
+		GNode *up = g_hash_table_lookup(merged, next);
+
+		/* halve the path for the next lookup */
+		if (up != NULL)
+			g_hash_table_insert(merged, top, up);
+		top = next;
+	}
+
+	return top;
+}
+
+static void thread_by_subject(GNode *root, GHashTable *subject_hashtable)
+{
+	GHashTable *tops, *merged;
+	GNode *node, *next, *parent;
+	START_TIMING("thread by subject");
+
+	tops = g_hash_table_new(g_direct_hash, g_direct_equal);
+	merged = g_hash_table_new(g_direct_hash, g_direct_equal);
+	for (node = root->children; node != NULL; node = node->next) {
+		g_hash_table_insert(tops, node, node);
+		if (node->children)
+			g_node_traverse(node, G_PRE_ORDER, G_TRAVERSE_ALL, -1,
+					thread_set_top_func, tops);
+	}
+
+	for (node = root->children; node != NULL; node = next) {
+		next = node->next;
+
+		parent = subject_hashtable_lookup(subject_hashtable,
+						  (MsgInfo *)node->data);
+
+		/* the node may already be threaded by IN-REPLY-TO, so
+		 * check that the parent isn't in its own thread */
+		if (parent == NULL || thread_find_top(tops, merged, parent) == node)
+			continue;
+
+		g_node_unlink(node);
+		g_node_append(parent, node);
+		g_hash_table_insert(merged, node,
+				    thread_find_top(tops, merged, parent));
+	}
+
+	g_hash_table_destroy(merged);
+	g_hash_table_destroy(tops);
+	END_TIMING();
+}
+
 /* return the reversed thread tree */
 GNode *procmsg_get_thread_tree(GSList *mlist)
 {
-	GNode *root, *parent, *node, *next;
-	GHashTable *msgid_table;
+	return procmsg_get_thread_tree_full(mlist, NULL);
+}
+
+/* Builds the thread tree of the messages in @mlist from @index, which
+ * must know all of them; if it is NULL, an index of @mlist is made
+ * for the purpose. */
+GNode *procmsg_get_thread_tree_full(GSList *mlist, MsgThreadIndex *index)
+{
+	MsgThreadIndex *tmp_index = NULL;
 	GHashTable *subject_hashtable = NULL;
+	GPtrArray *nodes, *starts;
+	GNode *root, *node, *last_root = NULL;
+	MsgThreadContainer *container, *from;
 	MsgInfo *msginfo;
-	const gchar *msgid;
-        GSList *reflist;
+	GSList *cur, *ref;
+	guint stamp;
+	gint i;
 	START_TIMING("");
+
+	if (index == NULL) {
+		tmp_index = index = procmsg_thread_index_new();
+		for (cur = mlist; cur != NULL; cur = cur->next)
+			procmsg_thread_index_add(index, (MsgInfo *)cur->data);
+	}
+
+	if (++index->stamp == 0) {
+		g_hash_table_foreach(index->table,
+				     thread_container_reset_stamp, NULL);
+		index->stamp = 1;
+	}
+	stamp = index->stamp;
+
 	root = g_node_new(NULL);
-	msgid_table = g_hash_table_new(g_str_hash, g_str_equal);
-	
-	if (prefs_common.thread_by_subject) {
+	nodes = g_ptr_array_new();
+	starts = g_ptr_array_new();
+
+	if (prefs_common.thread_by_subject)
 		subject_hashtable = g_hash_table_new(g_str_hash, g_str_equal);
-	}
 
-	for (; mlist != NULL; mlist = mlist->next) {
-		msginfo = (MsgInfo *)mlist->data;
-		parent = root;
+	for (cur = mlist; cur != NULL; cur = cur->next) {
+		msginfo = (MsgInfo *)cur->data;
+		node = NULL;
+		from = NULL;
 
-		if (msginfo->inreplyto) {
-			parent = g_hash_table_lookup(msgid_table, msginfo->inreplyto);
-			if (parent == NULL) {
-				parent = root;
+		if (msginfo->msgid && *msginfo->msgid != '\0') {
+			container = g_hash_table_lookup(index->table,
+							msginfo->msgid);
+			if (container == NULL || container->nmsgs == 0)
+				break;
+			/* later copies of a message are threaded like
+			 * the first, which gets the replies */
+			if (container->stamp != stamp) {
+				node = g_node_new(msginfo);
+				container->stamp = stamp;
+				container->node = node;
 			}
+			from = container->parent;
+		} else {
+			if (msginfo->inreplyto)
+				from = g_hash_table_lookup(index->table,
+							    msginfo->inreplyto);
+			for (ref = msginfo->references;
+			     from == NULL && ref != NULL; ref = ref->next)
+				from = g_hash_table_lookup(index->table,
+							    ref->data);
 		}
-		node = g_node_insert_data_before
-			(parent, parent == root ? parent->children : NULL,
-			 msginfo);
-		if ((msgid = msginfo->msgid) && g_hash_table_lookup(msgid_table, msgid) == NULL)
-			g_hash_table_insert(msgid_table, (gchar *)msgid, node);
-
-		/* CLAWS: add subject to hashtable (without prefix) */
-		if (prefs_common.thread_by_subject) {
+
+		if (node == NULL)
+			node = g_node_new(msginfo);
+		g_ptr_array_add(nodes, node);
+		g_ptr_array_add(starts, from);
+		if (subject_hashtable)
 			subject_hashtable_insert(subject_hashtable, node);
-		}
 	}
 
-	/* complete the unfinished threads */
-	for (node = root->children; node != NULL; ) {
-		next = node->next;
-		msginfo = (MsgInfo *)node->data;
-		parent = NULL;
-		
-                if (msginfo->inreplyto)
-			parent = g_hash_table_lookup(msgid_table, msginfo->inreplyto);
-
-		/* try looking for the indirect parent */
-		if (!parent && msginfo->references) {
-			for (reflist = msginfo->references;
-			     reflist != NULL; reflist = reflist->next)
-				if ((parent = g_hash_table_lookup
-					(msgid_table, reflist->data)) != NULL)
-					break;
-                }                                        
-              
-		/* node should not be the parent, and node should not
-		   be an ancestor of parent (circular reference) */
-		if (parent && parent != node &&
-		    !g_node_is_ancestor(node, parent)) {
-			g_node_unlink(node);
-			g_node_insert_before
-				(parent, parent->children, node);
+	if (cur != NULL) {
+		/* a message the index doesn't know about */
+		debug_print("thread index is missing %s, rebuilding\n",
+			    ((MsgInfo *)cur->data)->msgid);
+		for (i = 0; i < nodes->len; i++)
+			g_node_destroy(g_ptr_array_index(nodes, i));
+		g_ptr_array_free(nodes, TRUE);
+		g_ptr_array_free(starts, TRUE);
+		g_node_destroy(root);
+		if (subject_hashtable) {
+			g_hash_table_foreach(subject_hashtable, subject_hashtable_free, NULL);
+			g_hash_table_destroy(subject_hashtable);
 		}
-               
-		node = next;
+		END_TIMING();
+		return procmsg_get_thread_tree_full(mlist, NULL);
 	}
 
-	if (prefs_common.thread_by_subject) {
-		START_TIMING("thread by subject");
-		for (node = root->children; node && node != NULL;) {
-			next = node->next;
-			msginfo = (MsgInfo *) node->data;
-			
-			parent = subject_hashtable_lookup(subject_hashtable, msginfo);
-			
-			/* the node may already be threaded by IN-REPLY-TO, so go up 
-			 * in the tree to 
-			   find the parent node */
-			if (parent != NULL) {
-				if (g_node_is_ancestor(node, parent))
-					parent = NULL;
-				if (parent == node)
-					parent = NULL;
-			}
-			
-			if (parent) {
-				g_node_unlink(node);
-				g_node_append(parent, node);
-			}
+	/* going backwards, so that prepending keeps replies in list
+	 * order, while the threads end up reversed */
+	for (i = nodes->len - 1; i >= 0; i--) {
+		node = g_ptr_array_index(nodes, i);
+		from = g_ptr_array_index(starts, i);
+		container = from ? thread_container_find_shown(from, stamp) : NULL;
 
-			node = next;
-		}	
-		END_TIMING();
+		if (container != NULL && container->node != node) {
+			g_node_prepend(container->node, node);
+		} else {
+			g_node_insert_after(root, last_root, node);
+			last_root = node;
+		}
 	}
-	
-	if (prefs_common.thread_by_subject)
-	{
+	g_ptr_array_free(nodes, TRUE);
+	g_ptr_array_free(starts, TRUE);
+
+	if (subject_hashtable) {
+		thread_by_subject(root, subject_hashtable);
 		g_hash_table_foreach(subject_hashtable, subject_hashtable_free, NULL);
 		g_hash_table_destroy(subject_hashtable);
 	}
 
-	g_hash_table_destroy(msgid_table);
+	procmsg_thread_index_free(tmp_index);
 	END_TIMING();
 	return root;
 }
@@ -1220,6 +1510,151 @@ static void procmsg_msginfoavatar_free(MsgInfoAvatar *avatar)
 	}
 }
 
+/* Addresses, newsgroups and references repeat a lot across a folder
+ * (mailing lists, threads), so they are interned in a table shared by
+ * all messages. Caches are read in other threads too, hence the lock. */
+static StringTable *msginfo_string_table = NULL;
+G_LOCK_DEFINE_STATIC(msginfo_string_table);
+
+/* Strings of a zero-copy cache are not @owned: they stay in the
+ * mapping, which is unmapped with the cache */
+static gchar *procmsg_msginfo_intern_string(gchar *str, gboolean owned)
+{
+	gchar *interned;
+
+	if (str == NULL)
+		return NULL;
+
+	G_LOCK(msginfo_string_table);
+	if (msginfo_string_table == NULL)
+		msginfo_string_table = string_table_new();
+	interned = string_table_insert_string(msginfo_string_table, str);
+	G_UNLOCK(msginfo_string_table);
+
+	if (owned && interned != str)
+		g_free(str);
+
+	return interned;
+}
+
+static gboolean procmsg_msginfo_is_interned(const gchar *str)
+{
+	gboolean interned;
+
+	G_LOCK(msginfo_string_table);
+	interned = msginfo_string_table != NULL &&
+		   string_table_get_ref_count(msginfo_string_table, str) > 0;
+	G_UNLOCK(msginfo_string_table);
+
+	return interned;
+}
+
+/* Strings read by a zero-copy cache point into the cache file
+ * mapping, and interned ones belong to the string table; only
+ * separately allocated ones are ours to free. */
+static gboolean procmsg_msginfo_in_cache_map(MsgInfo *msginfo,
+					     const gchar *str)
+{
+	return str != NULL && msginfo->cache_map != NULL &&
+	       msgcache_map_contains(msginfo->cache_map, str);
+}
+
+static gboolean procmsg_msginfo_owns_string(MsgInfo *msginfo, const gchar *str)
+{
+	if (str == NULL)
+		return FALSE;
+	if (procmsg_msginfo_in_cache_map(msginfo, str))
+		return FALSE;
+	if (procmsg_msginfo_is_interned(str))
+		return FALSE;
+	return TRUE;
+}
+
+static void procmsg_msginfo_free_string(MsgInfo *msginfo, gchar *str)
+{
+	if (str == NULL || procmsg_msginfo_in_cache_map(msginfo, str))
+		return;
+
+	G_LOCK(msginfo_string_table);
+	if (msginfo_string_table != NULL &&
+	    string_table_get_ref_count(msginfo_string_table, str) > 0) {
+		string_table_free_string(msginfo_string_table, str);
+		str = NULL;
+	}
+	G_UNLOCK(msginfo_string_table);
+
+	g_free(str);
+}
+
+/* Copies share interned strings instead of duplicating them */
+static gchar *procmsg_msginfo_dup_string(const gchar *str)
+{
+	gchar *dup = NULL;
+
+	if (str == NULL)
+		return NULL;
+
+	G_LOCK(msginfo_string_table);
+	if (msginfo_string_table != NULL &&
+	    string_table_get_ref_count(msginfo_string_table, str) > 0)
+		dup = string_table_insert_string(msginfo_string_table, str);
+	G_UNLOCK(msginfo_string_table);
+
+	return dup != NULL ? dup : g_strdup(str);
+}
+
+void procmsg_msginfo_set_string(MsgInfo *msginfo, gchar **member,
+				const gchar *value)
+{
+	gchar *old;
+
+	cm_return_if_fail(msginfo != NULL);
+	cm_return_if_fail(member != NULL);
+
+	old = *member;
+	*member = g_strdup(value);
+	procmsg_msginfo_free_string(msginfo, old);
+}
+
+/* Returns the size of the allocated strings that are now shared, for
+ * callers that accounted for them already; those in a cache file
+ * mapping are accounted for with the mapping */
+#define INTERN(n) { if (procmsg_msginfo_in_cache_map(msginfo, n)) \
+			n = procmsg_msginfo_intern_string(n, FALSE); \
+		    else if (procmsg_msginfo_owns_string(msginfo, n)) { \
+			shared += strlen(n); \
+			n = procmsg_msginfo_intern_string(n, TRUE); } }
+guint procmsg_msginfo_intern_strings(MsgInfo *msginfo)
+{
+	GSList *cur;
+	guint shared = 0;
+
+	cm_return_val_if_fail(msginfo != NULL, 0);
+
+	INTERN(msginfo->fromname);
+	INTERN(msginfo->from);
+	INTERN(msginfo->to);
+	INTERN(msginfo->cc);
+	INTERN(msginfo->newsgroups);
+	for (cur = msginfo->references; cur != NULL; cur = cur->next)
+		INTERN(cur->data);
+
+	return shared;
+}
+#undef INTERN
+
+gsize procmsg_msginfo_strings_memusage(void)
+{
+	gsize memusage = 0;
+
+	G_LOCK(msginfo_string_table);
+	if (msginfo_string_table != NULL)
+		memusage = string_table_get_memusage(msginfo_string_table);
+	G_UNLOCK(msginfo_string_table);
+
+	return memusage;
+}
+
 MsgInfo *procmsg_msginfo_copy(MsgInfo *msginfo)
 {
 	MsgInfo *newmsginfo;
@@ -1234,6 +1669,8 @@ MsgInfo *procmsg_msginfo_copy(MsgInfo *msginfo)
 #define MEMBCOPY(mmb)	newmsginfo->mmb = msginfo->mmb
 #define MEMBDUP(mmb)	newmsginfo->mmb = msginfo->mmb ? \
 			g_strdup(msginfo->mmb) : NULL
+#define MEMBSHARE(mmb)	newmsginfo->mmb = \
+			procmsg_msginfo_dup_string(msginfo->mmb)
 
 	MEMBCOPY(msgnum);
 	MEMBCOPY(size);
@@ -1242,13 +1679,13 @@ MsgInfo *procmsg_msginfo_copy(MsgInfo *msginfo)
 
 	MEMBCOPY(flags);
 
-	MEMBDUP(fromname);
+	MEMBSHARE(fromname);
 
 	MEMBDUP(date);
-	MEMBDUP(from);
-	MEMBDUP(to);
-	MEMBDUP(cc);
-	MEMBDUP(newsgroups);
+	MEMBSHARE(from);
+	MEMBSHARE(to);
+	MEMBSHARE(cc);
+	MEMBSHARE(newsgroups);
 	MEMBDUP(subject);
 	MEMBDUP(msgid);
 	MEMBDUP(inreplyto);
@@ -1280,7 +1717,8 @@ MsgInfo *procmsg_msginfo_copy(MsgInfo *msginfo)
         refs = msginfo->references;
         for (refs = msginfo->references; refs != NULL; refs = refs->next) {
                 newmsginfo->references = g_slist_prepend
-                        (newmsginfo->references, g_strdup(refs->data)); 
+                        (newmsginfo->references,
+			 procmsg_msginfo_dup_string(refs->data)); 
         }
         newmsginfo->references = g_slist_reverse(newmsginfo->references);
 
@@ -1372,35 +1810,13 @@ MsgInfo *procmsg_msginfo_get_full_info(MsgInfo *msginfo)
 }
 
 #define FREENULL(n) { g_free(n); n = NULL; }
-void procmsg_msginfo_free(MsgInfo **msginfo_ptr)
+#define FREESTR(n) { procmsg_msginfo_free_string(msginfo, n); n = NULL; }
+/* Drops the data only known from parsing the message itself, which
+ * isn't kept in the folder cache either. */
+void procmsg_msginfo_free_extradata(MsgInfo *msginfo)
 {
-	MsgInfo *msginfo = *msginfo_ptr;
-
-	if (msginfo == NULL) return;
-
-	msginfo->refcnt--;
-	if (msginfo->refcnt > 0)
-		return;
-
-	if (msginfo->to_folder) {
-		msginfo->to_folder->op_count--;
-		folder_item_update(msginfo->to_folder, F_ITEM_UPDATE_MSGCNT);
-	}
-
 	FREENULL(msginfo->fromspace);
 
-	FREENULL(msginfo->fromname);
-
-	FREENULL(msginfo->date);
-	FREENULL(msginfo->from);
-	FREENULL(msginfo->to);
-	FREENULL(msginfo->cc);
-	FREENULL(msginfo->newsgroups);
-	FREENULL(msginfo->subject);
-	FREENULL(msginfo->msgid);
-	FREENULL(msginfo->inreplyto);
-	FREENULL(msginfo->xref);
-
 	if (msginfo->extradata) {
 		if (msginfo->extradata->avatars) {
 			g_slist_foreach(msginfo->extradata->avatars,
@@ -1423,46 +1839,87 @@ void procmsg_msginfo_free(MsgInfo **msginfo_ptr)
 		FREENULL(msginfo->extradata->resent_from);
 		FREENULL(msginfo->extradata);
 	}
-	slist_free_strings_full(msginfo->references);
+}
+
+void procmsg_msginfo_free(MsgInfo **msginfo_ptr)
+{
+	MsgInfo *msginfo = *msginfo_ptr;
+	GSList *cur;
+
+	if (msginfo == NULL) return;
+
+	msginfo->refcnt--;
+	if (msginfo->refcnt > 0)
+		return;
+
+	if (msginfo->to_folder) {
+		msginfo->to_folder->op_count--;
+		folder_item_update(msginfo->to_folder, F_ITEM_UPDATE_MSGCNT);
+	}
+
+	FREESTR(msginfo->fromname);
+
+	FREESTR(msginfo->date);
+	FREESTR(msginfo->from);
+	FREESTR(msginfo->to);
+	FREESTR(msginfo->cc);
+	FREESTR(msginfo->newsgroups);
+	FREESTR(msginfo->subject);
+	FREESTR(msginfo->msgid);
+	FREESTR(msginfo->inreplyto);
+	FREESTR(msginfo->xref);
+
+	procmsg_msginfo_free_extradata(msginfo);
+	for (cur = msginfo->references; cur != NULL; cur = cur->next)
+		procmsg_msginfo_free_string(msginfo, (gchar *)cur->data);
+	g_slist_free(msginfo->references);
 	msginfo->references = NULL;
 	g_slist_free(msginfo->tags);
 	msginfo->tags = NULL;
 
 	FREENULL(msginfo->plaintext_file);
 
-	g_free(msginfo);
+	if (msginfo->cache_map) {
+		msgcache_map_unref(msginfo->cache_map);
+		msginfo->cache_map = NULL;
+	}
+
+	if (msginfo->cache_block)
+		msgcache_block_unref(msginfo->cache_block);
+	else
+		g_free(msginfo);
 	*msginfo_ptr = NULL;
 }
+#undef FREESTR
 #undef FREENULL
 
+/* Strings living in a cache file mapping are accounted for once,
+ * by the cache that owns the mapping, and interned ones by
+ * procmsg_msginfo_strings_memusage(). */
+static guint procmsg_msginfo_string_memusage(MsgInfo *msginfo, const gchar *str)
+{
+	return procmsg_msginfo_owns_string(msginfo, str) ? strlen(str) : 0;
+}
+
 guint procmsg_msginfo_memusage(MsgInfo *msginfo)
 {
 	guint memusage = 0;
 	GSList *tmp;
 	
 	memusage += sizeof(MsgInfo);
-	if (msginfo->fromname)
-		memusage += strlen(msginfo->fromname);
-	if (msginfo->date)
-		memusage += strlen(msginfo->date);
-	if (msginfo->from)
-		memusage += strlen(msginfo->from);
-	if (msginfo->to)
-		memusage += strlen(msginfo->to);
-	if (msginfo->cc)
-		memusage += strlen(msginfo->cc);
-	if (msginfo->newsgroups)
-		memusage += strlen(msginfo->newsgroups);
-	if (msginfo->subject)
-		memusage += strlen(msginfo->subject);
-	if (msginfo->msgid)
-		memusage += strlen(msginfo->msgid);
-	if (msginfo->inreplyto)
-		memusage += strlen(msginfo->inreplyto);
+	memusage += procmsg_msginfo_string_memusage(msginfo, msginfo->fromname);
+	memusage += procmsg_msginfo_string_memusage(msginfo, msginfo->date);
+	memusage += procmsg_msginfo_string_memusage(msginfo, msginfo->from);
+	memusage += procmsg_msginfo_string_memusage(msginfo, msginfo->to);
+	memusage += procmsg_msginfo_string_memusage(msginfo, msginfo->cc);
+	memusage += procmsg_msginfo_string_memusage(msginfo, msginfo->newsgroups);
+	memusage += procmsg_msginfo_string_memusage(msginfo, msginfo->subject);
+	memusage += procmsg_msginfo_string_memusage(msginfo, msginfo->msgid);
+	memusage += procmsg_msginfo_string_memusage(msginfo, msginfo->inreplyto);
 
 	for (tmp = msginfo->references; tmp; tmp=tmp->next) {
 		gchar *r = (gchar *)tmp->data;
-		memusage += r?strlen(r):0 + sizeof(GSList);
+		memusage += procmsg_msginfo_string_memusage(msginfo, r) + sizeof(GSList);
 	}
 	if (msginfo->fromspace)
 		memusage += strlen(msginfo->fromspace);
@@ -232,6 +232,11 @@ struct _MsgInfo
 	GSList *tags;
 
 	MsgInfoExtraData *extradata;
+
+	/* cache file mapping holding some of the strings above, if any */
+	MsgCacheMap *cache_map;
+	/* block of MsgInfos this one was allocated from, if any */
+	MsgCacheBlock *cache_block;
 };
 
 struct _MsgInfoExtraData
@@ -304,6 +309,16 @@ void	procmsg_get_mark_sum		(const gchar	*folder,
 					 gint		 first);
 
 GNode  *procmsg_get_thread_tree		(GSList		*mlist);
+GNode  *procmsg_get_thread_tree_full	(GSList		*mlist,
+					 MsgThreadIndex	*index);
+
+MsgThreadIndex *procmsg_thread_index_new	(void);
+void	 procmsg_thread_index_free	(MsgThreadIndex	*index);
+void	 procmsg_thread_index_add	(MsgThreadIndex	*index,
+					 MsgInfo	*msginfo);
+void	 procmsg_thread_index_remove	(MsgThreadIndex	*index,
+					 MsgInfo	*msginfo);
+gsize	 procmsg_thread_index_memusage	(MsgThreadIndex	*index);
 
 gint	procmsg_move_messages		(GSList		*mlist);
 void	procmsg_copy_messages		(GSList		*mlist);
@@ -341,7 +356,13 @@ MsgInfo *procmsg_msginfo_get_full_info_from_file
 					(MsgInfo *msginfo, 
 					const gchar *file);
 void	 procmsg_msginfo_free		(MsgInfo	**msginfo);
+void	 procmsg_msginfo_free_extradata	(MsgInfo	*msginfo);
 guint	 procmsg_msginfo_memusage	(MsgInfo	*msginfo);
+void	 procmsg_msginfo_set_string	(MsgInfo	*msginfo,
+					 gchar		**member,
+					 const gchar	*value);
+guint	 procmsg_msginfo_intern_strings	(MsgInfo	*msginfo);
+gsize	 procmsg_msginfo_strings_memusage	(void);
 
 gint procmsg_send_message_queue_with_lock(const gchar *file,
 					  gchar **errstr,
@@ -49,6 +49,15 @@ typedef struct _MsgInfoExtraData	MsgInfoExtraData;
 struct _MsgInfoAvatar;
 typedef struct _MsgInfoAvatar		MsgInfoAvatar;
 
+struct _MsgCacheMap;
+typedef struct _MsgCacheMap		MsgCacheMap;
+
+struct _MsgCacheBlock;
+typedef struct _MsgCacheBlock		MsgCacheBlock;
+
+struct _MsgThreadIndex;
+typedef struct _MsgThreadIndex		MsgThreadIndex;
+
 typedef GSList MsgInfoList;
 typedef GSList MsgNumberList;
 
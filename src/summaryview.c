@@ -88,6 +88,11 @@
 #define SUMMARY_COL_LOCKED_WIDTH	13
 #define SUMMARY_COL_MIME_WIDTH		11
 
+/* rows keeping their formatted text, the others get it when shown */
+#define SUMMARY_FORMATTED_ROWS		2000
+/* messages from which threads are built without blocking the interface */
+#define SUMMARY_THREAD_IN_BACKGROUND	20000
+
 static int normal_row_height = -1;
 static GtkStyle *bold_style;
 static GtkStyle *bold_marked_style;
@@ -169,6 +174,9 @@ static void summary_set_ctree_from_list	(SummaryView		*summaryview,
 static inline void summary_set_header	(SummaryView		*summaryview,
 					 gchar			*text[],
 					 MsgInfo		*msginfo);
+static void summary_format_row		(GtkCMCList		*clist,
+					 GtkCMCListRow		*row,
+					 gpointer		 data);
 static void summary_display_msg		(SummaryView		*summaryview,
 					 GtkCMCTreeNode		*row);
 static void summary_display_msg_full	(SummaryView		*summaryview,
@@ -369,29 +377,16 @@ static gint summary_cmp_by_date		(GtkCMCList		*clist,
 static gint summary_cmp_by_thread_date	(GtkCMCList		*clist,
 					 gconstpointer		 ptr1,
 					 gconstpointer		 ptr2);
-static gint summary_cmp_by_from		(GtkCMCList		*clist,
-					 gconstpointer		 ptr1,
-					 gconstpointer		 ptr2);
-static gint summary_cmp_by_simplified_subject
-					(GtkCMCList 		*clist, 
-					 gconstpointer 		 ptr1, 
-					 gconstpointer 		 ptr2);
 static gint summary_cmp_by_score	(GtkCMCList		*clist,
 					 gconstpointer		 ptr1,
 					 gconstpointer		 ptr2);
 static gint summary_cmp_by_label	(GtkCMCList		*clist,
 					 gconstpointer		 ptr1,
 					 gconstpointer		 ptr2);
-static gint summary_cmp_by_to		(GtkCMCList		*clist,
-					 gconstpointer		 ptr1,
-					 gconstpointer		 ptr2);
-static gint summary_cmp_by_subject	(GtkCMCList		*clist,
-					 gconstpointer		 ptr1,
-					 gconstpointer		 ptr2);
 static gint summary_cmp_by_locked	(GtkCMCList 		*clist,
 				         gconstpointer 		 ptr1, 
 					 gconstpointer 		 ptr2);
-static gint summary_cmp_by_tags		(GtkCMCList 		*clist,
+static gint summary_cmp_by_sort_key	(GtkCMCList 		*clist,
 				         gconstpointer 		 ptr1, 
 					 gconstpointer 		 ptr2);
 
@@ -990,6 +985,10 @@ void summary_init(SummaryView *summaryview)
 
 	/* Init summaryview extra data */
 	summaryview->simplify_subject_preg = NULL;
+	summaryview->sort_keys = g_hash_table_new_full(g_direct_hash,
+						       g_direct_equal,
+						       NULL, g_free);
+	summaryview->sort_keys_by = SORT_BY_NONE;
 	summary_clear_list(summaryview);
 	summary_set_column_titles(summaryview);
 	summary_colorlabel_menu_create(summaryview, FALSE);
@@ -1158,6 +1157,7 @@ static void summaryview_quicksearch_recurse(SummaryView *summaryview)
 	summaryview_reset_recursive_folder_match(summaryview);
 	summaryview->search_root_folder = summaryview->folder_item;
 
+	folder_item_prefetch_cache(summaryview->folder_item, TRUE);
 	summaryview_quicksearch_search_subfolders(summaryview, summaryview->folder_item);
 	
 	main_window_cursor_normal(summaryview->mainwin);
@@ -1223,6 +1223,78 @@ gboolean summaryview_search_root_progress(gpointer data, guint at, guint matched
 	return TRUE;
 }
 
+typedef struct _SummaryShowData {
+	SummaryView *summaryview;
+	guint generation;
+} SummaryShowData;
+
+/* Shows the folder whose cache was read in the background, unless
+ * something else was shown meanwhile */
+static gboolean summary_show_pending(gpointer data)
+{
+	SummaryShowData *show = (SummaryShowData *)data;
+	SummaryView *summaryview = show->summaryview;
+	FolderItem *item = summaryview->pending_item;
+
+	if (show->generation != summaryview->show_generation ||
+	    item == NULL) {
+		g_free(show);
+		return FALSE;
+	}
+	if (summary_is_locked(summaryview)) {
+		g_timeout_add(100, summary_show_pending, show);
+		return FALSE;
+	}
+
+	g_free(show);
+	/* opened as a new folder, not refreshed */
+	summaryview->folder_item = NULL;
+	summary_show(summaryview, item);
+
+	return FALSE;
+}
+
+static void summary_cache_read(FolderItem *item, gpointer data)
+{
+	SummaryShowData *show = (SummaryShowData *)data;
+
+	STATUSBAR_POP(show->summaryview->mainwin);
+	if (item == NULL) {
+		g_free(show);
+		return;
+	}
+	summary_show_pending(show);
+}
+
+/* Has the cache of @item read by the cache readers, so that opening a
+ * big folder doesn't freeze the window; the folder is shown once the
+ * cache is there. */
+static gboolean summary_show_when_cached(SummaryView *summaryview,
+					 FolderItem *item)
+{
+	SummaryShowData *show;
+	gchar *buf;
+
+	if (item->cache != NULL)
+		return FALSE;
+
+	show = g_new0(SummaryShowData, 1);
+	show->summaryview = summaryview;
+	show->generation = summaryview->show_generation;
+	if (!folder_item_load_cache_in_background(item, summary_cache_read,
+						  show)) {
+		g_free(show);
+		return FALSE;
+	}
+	summaryview->pending_item = item;
+
+	buf = g_strdup_printf(_("Reading cache of %s..."), item->path);
+	STATUSBAR_PUSH(summaryview->mainwin, buf);
+	g_free(buf);
+
+	return TRUE;
+}
+
 gboolean summary_show(SummaryView *summaryview, FolderItem *item)
 {
 	GtkCMCTree *ctree = GTK_CMCTREE(summaryview->ctree);
@@ -1241,6 +1313,8 @@ gboolean summary_show(SummaryView *summaryview, FolderItem *item)
 	if (!summaryview->mainwin)
 		return FALSE;
 	START_TIMING("");
+	summaryview->show_generation++;
+	summaryview->pending_item = NULL;
 	summary_switch_from_to(summaryview, item);
 
 	inc_lock();
@@ -1338,6 +1412,19 @@ gboolean summary_show(SummaryView *summaryview, FolderItem *item)
 	if (!is_refresh)
 		messageview_clear(summaryview->messageview);
 
+	if (!is_refresh && summary_show_when_cached(summaryview, item)) {
+		/* empty until then; a refresh meanwhile reads the cache
+		 * itself */
+		summary_clear_all(summaryview);
+		summaryview->folder_item = item;
+		item->opened = TRUE;
+		summary_thaw(summaryview);
+		summary_unlock(summaryview);
+		inc_unlock();
+		END_TIMING();
+		return TRUE;
+	}
+
 	summaryview->folder_item = item;
 	item->opened = TRUE;
 
@@ -1684,6 +1771,8 @@ void summary_clear_list(SummaryView *summaryview)
 		g_hash_table_destroy(summaryview->subject_table);
 		summaryview->subject_table = NULL;
 	}
+	if (summaryview->sort_keys)
+		g_hash_table_remove_all(summaryview->sort_keys);
 	summaryview->mlist = NULL;
 
 	gtk_cmclist_clear(clist);
@@ -3020,13 +3109,10 @@ void summary_sort(SummaryView *summaryview,
 		cmp_func = (GtkCMCListCompareFunc)summary_cmp_by_thread_date;
 		break;
 	case SORT_BY_FROM:
-		cmp_func = (GtkCMCListCompareFunc)summary_cmp_by_from;
-		break;
 	case SORT_BY_SUBJECT:
-		if (summaryview->simplify_subject_preg)
-			cmp_func = (GtkCMCListCompareFunc)summary_cmp_by_simplified_subject;
-		else
-			cmp_func = (GtkCMCListCompareFunc)summary_cmp_by_subject;
+	case SORT_BY_TO:
+	case SORT_BY_TAGS:
+		cmp_func = (GtkCMCListCompareFunc)summary_cmp_by_sort_key;
 		break;
 	case SORT_BY_SCORE:
 		cmp_func = (GtkCMCListCompareFunc)summary_cmp_by_score;
@@ -3034,15 +3120,9 @@ void summary_sort(SummaryView *summaryview,
 	case SORT_BY_LABEL:
 		cmp_func = (GtkCMCListCompareFunc)summary_cmp_by_label;
 		break;
-	case SORT_BY_TO:
-		cmp_func = (GtkCMCListCompareFunc)summary_cmp_by_to;
-		break;
 	case SORT_BY_LOCKED:
 		cmp_func = (GtkCMCListCompareFunc)summary_cmp_by_locked;
 		break;
-	case SORT_BY_TAGS:
-		cmp_func = (GtkCMCListCompareFunc)summary_cmp_by_tags;
-		break;
 	case SORT_BY_NONE:
 		break;
 	default:
@@ -3162,6 +3242,56 @@ static gboolean summary_thread_is_selected(GNode *gnode, guint selected_msgnum)
 	return selected.is_selected;
 }
 
+/* The columns are formatted as the rows get shown, unless names come
+ * from the address book: completing them needs the whole address book
+ * loaded, which is only done while the summary is being built. */
+static gboolean summary_format_lazily(void)
+{
+	return !prefs_common.use_addr_book;
+}
+
+static void summary_format_row(GtkCMCList *clist, GtkCMCListRow *row,
+			       gpointer data)
+{
+	SummaryView *summaryview = (SummaryView *)data;
+	MsgInfo *msginfo = (MsgInfo *)row->data;
+	gchar *text[N_SUMMARY_COLS];
+	gint *col_pos = summaryview->col_pos;
+	gboolean vert_layout = (prefs_common.layout_mode == VERTICAL_LAYOUT);
+	gboolean small_layout = (prefs_common.layout_mode == SMALL_LAYOUT);
+
+	if (msginfo == NULL)
+		return;
+
+	summary_set_header(summaryview, text, msginfo);
+
+#define SET_TEXT(col) {						\
+	gtk_cmclist_row_set_text(clist, row, col_pos[col],	\
+				 text[col_pos[col]]);		\
+}
+
+	SET_TEXT(S_COL_SUBJECT);
+	if (summaryview->col_state[summaryview->col_pos[S_COL_NUMBER]].visible)
+		SET_TEXT(S_COL_NUMBER);
+	if (summaryview->col_state[summaryview->col_pos[S_COL_SCORE]].visible)
+		SET_TEXT(S_COL_SCORE);
+	if (summaryview->col_state[summaryview->col_pos[S_COL_SIZE]].visible)
+		SET_TEXT(S_COL_SIZE);
+	if (summaryview->col_state[summaryview->col_pos[S_COL_DATE]].visible)
+		SET_TEXT(S_COL_DATE);
+	if (summaryview->col_state[summaryview->col_pos[S_COL_FROM]].visible)
+		SET_TEXT(S_COL_FROM);
+	if (summaryview->col_state[summaryview->col_pos[S_COL_TO]].visible)
+		SET_TEXT(S_COL_TO);
+	if (summaryview->col_state[summaryview->col_pos[S_COL_TAGS]].visible)
+		SET_TEXT(S_COL_TAGS);
+
+#undef SET_TEXT
+
+	if ((vert_layout || small_layout) && prefs_common.two_line_vert)
+		g_free(text[summaryview->col_pos[S_COL_SUBJECT]]);
+}
+
 static gboolean summary_insert_gnode_func(GtkCMCTree *ctree, guint depth, GNode *gnode,
 				   GtkCMCTreeNode *cnode, gpointer data)
 {
@@ -3174,6 +3304,20 @@ static gboolean summary_insert_gnode_func(GtkCMCTree *ctree, guint depth, GNode
 	gboolean vert_layout = (prefs_common.layout_mode == VERTICAL_LAYOUT);
 	gboolean small_layout = (prefs_common.layout_mode == SMALL_LAYOUT);
 
+	if (summary_format_lazily()) {
+		gtk_cmctree_set_node_info(ctree, cnode, NULL, 2, NULL, NULL, FALSE,
+				summaryview->threaded && !summaryview->thread_collapsed);
+		GTKUT_CTREE_NODE_SET_ROW_DATA(cnode, msginfo);
+		gtk_cmclist_unformat_row(GTK_CMCLIST(ctree),
+					 &GTK_CMCTREE_ROW(cnode)->row);
+		summary_set_marks_func(ctree, cnode, summaryview);
+
+		if (msgid && msgid[0] != '\0')
+			g_hash_table_insert(msgid_table, (gchar *)msgid, cnode);
+
+		return TRUE;
+	}
+
 	summary_set_header(summaryview, text, msginfo);
 
 	gtk_cmctree_set_node_info(ctree, cnode, text[col_pos[S_COL_SUBJECT]], 2,
@@ -3212,6 +3356,167 @@ static gboolean summary_insert_gnode_func(GtkCMCTree *ctree, guint depth, GNode
 	return TRUE;
 }
 
+typedef struct _SummaryThreadData {
+	SummaryView *summaryview;
+	guint generation;
+	GSList *mlist;
+	GNode *root;
+} SummaryThreadData;
+
+static void summary_thread_data_free(SummaryThreadData *td)
+{
+	if (td->root != NULL)
+		g_node_destroy(td->root);
+	procmsg_msg_list_free(td->mlist);
+	g_free(td);
+}
+
+/* Shows the folder again with the threads built in the background,
+ * unless something else was shown meanwhile */
+static gboolean summary_thread_tree_install(gpointer data)
+{
+	SummaryThreadData *td = (SummaryThreadData *)data;
+	SummaryView *summaryview = td->summaryview;
+
+	if (td->generation != summaryview->show_generation ||
+	    !summaryview->threaded || summaryview->folder_item == NULL) {
+		summary_thread_data_free(td);
+		return FALSE;
+	}
+	if (summary_is_locked(summaryview)) {
+		g_timeout_add(100, summary_thread_tree_install, td);
+		return FALSE;
+	}
+
+	summaryview->thread_data = td;
+	summary_show(summaryview, summaryview->folder_item);
+	if (summaryview->thread_data == td) {
+		summaryview->thread_data = NULL;
+		summary_thread_data_free(td);
+	}
+
+	return FALSE;
+}
+
+static gboolean summary_thread_tree_done(gpointer data)
+{
+	SummaryThreadData *td = (SummaryThreadData *)data;
+
+	STATUSBAR_POP(td->summaryview->mainwin);
+
+	return summary_thread_tree_install(td);
+}
+
+static gpointer summary_thread_tree_func(gpointer data)
+{
+	SummaryThreadData *td = (SummaryThreadData *)data;
+
+	/* the thread index of the cache belongs to the main thread */
+	td->root = procmsg_get_thread_tree_full(td->mlist, NULL);
+	g_idle_add(summary_thread_tree_done, td);
+
+	return NULL;
+}
+
+static gboolean summary_thread_node_known(GNode *node, gpointer data)
+{
+	GHashTable *msgs = (GHashTable *)data;
+
+	if (node->data == NULL || g_hash_table_lookup(msgs, node->data))
+		return FALSE;
+
+	g_hash_table_remove_all(msgs);
+	return TRUE;
+}
+
+/* The threads built in the background, if they are those of @mlist */
+static GNode *summary_take_thread_tree(SummaryView *summaryview,
+				       GSList *mlist)
+{
+	SummaryThreadData *td = (SummaryThreadData *)summaryview->thread_data;
+	GHashTable *msgs;
+	GNode *root = NULL;
+	GSList *cur;
+
+	if (td == NULL)
+		return NULL;
+	summaryview->thread_data = NULL;
+
+	msgs = g_hash_table_new(g_direct_hash, g_direct_equal);
+	for (cur = mlist; cur != NULL; cur = cur->next)
+		g_hash_table_insert(msgs, cur->data, cur->data);
+	if (g_hash_table_size(msgs) + 1 ==
+	    g_node_n_nodes(td->root, G_TRAVERSE_ALL)) {
+		g_node_traverse(td->root, G_PRE_ORDER, G_TRAVERSE_ALL, -1,
+				summary_thread_node_known, msgs);
+		if (g_hash_table_size(msgs) > 0) {
+			root = td->root;
+			td->root = NULL;
+		}
+	}
+	g_hash_table_destroy(msgs);
+	summary_thread_data_free(td);
+
+	return root;
+}
+
+/* Threads the messages. Those of big folders are threaded in another
+ * thread: they are shown unthreaded meanwhile, with *@unthreaded set,
+ * and the folder is shown again once they are. */
+static GNode *summary_get_thread_tree(SummaryView *summaryview, GSList *mlist,
+				      gboolean *unthreaded)
+{
+	SummaryThreadData *td;
+	GThread *thread;
+	GNode *root;
+	GSList *cur;
+
+	*unthreaded = FALSE;
+
+	root = summary_take_thread_tree(summaryview, mlist);
+	if (root != NULL)
+		return root;
+
+	if (!sc_g_slist_bigger(mlist, SUMMARY_THREAD_IN_BACKGROUND))
+		return procmsg_get_thread_tree_full(mlist,
+			folder_item_get_thread_index(summaryview->folder_item));
+
+	/* compiles the reply prefix expression before the thread uses it */
+	if (prefs_common.thread_by_subject)
+		subject_get_prefix_length("Re: ");
+
+	td = g_new0(SummaryThreadData, 1);
+	td->summaryview = summaryview;
+	td->generation = summaryview->show_generation;
+	for (cur = mlist; cur != NULL; cur = cur->next)
+		td->mlist = g_slist_prepend(td->mlist,
+				procmsg_msginfo_new_ref((MsgInfo *)cur->data));
+	td->mlist = g_slist_reverse(td->mlist);
+#if GLIB_CHECK_VERSION(2,32,0)
+	thread = g_thread_try_new("summary threads", summary_thread_tree_func,
+				  td, NULL);
+	if (thread != NULL)
+		g_thread_unref(thread);
+#else
+	thread = g_thread_create(summary_thread_tree_func, td, FALSE, NULL);
+#endif
+	if (thread == NULL) {
+		summary_thread_data_free(td);
+		return procmsg_get_thread_tree_full(mlist,
+			folder_item_get_thread_index(summaryview->folder_item));
+	}
+
+	STATUSBAR_PUSH(summaryview->mainwin, _("Building threads..."));
+
+	root = g_node_new(NULL);
+	for (cur = mlist; cur != NULL; cur = cur->next)
+		g_node_prepend_data(root, cur->data);
+	g_node_reverse_children(root);
+	*unthreaded = TRUE;
+
+	return root;
+}
+
 static void summary_set_ctree_from_list(SummaryView *summaryview,
 					GSList *mlist, guint selected_msgnum)
 {
@@ -3223,6 +3528,7 @@ static void summary_set_ctree_from_list(SummaryView *summaryview,
 	GSList * cur;
 	gboolean vert_layout = (prefs_common.layout_mode == VERTICAL_LAYOUT);
 	gboolean small_layout = (prefs_common.layout_mode == SMALL_LAYOUT);
+	gboolean lazy = summary_format_lazily();
 	START_TIMING("");
 	
 	if (!mlist) return;
@@ -3250,16 +3556,27 @@ static void summary_set_ctree_from_list(SummaryView *summaryview,
 	
 	if (summaryview->threaded) {
 		GNode *root, *gnode;
+		gboolean saved_tree, unthreaded = FALSE;
 		START_TIMING("threaded");
-		root = procmsg_get_thread_tree(mlist);
+		/* the thread dates come with the saved tree */
+		root = folder_item_get_saved_thread_tree(summaryview->folder_item,
+							 mlist);
+		saved_tree = (root != NULL);
+		if (!saved_tree) {
+			root = summary_get_thread_tree(summaryview, mlist,
+						       &unthreaded);
+			if (!unthreaded)
+				folder_item_set_saved_thread_tree(
+					summaryview->folder_item, root);
+		}
 
-		
 		for (gnode = root->children; gnode != NULL;
 		     gnode = gnode->next) {
 			if (!summaryview->folder_item->hide_read_threads ||
 			    !summary_thread_is_read(gnode) ||
 			    summary_thread_is_selected(gnode, selected_msgnum)) {
-				summary_find_thread_age(gnode);
+				if (!saved_tree)
+					summary_find_thread_age(gnode);
 				node = gtk_sctree_insert_gnode
 					(ctree, NULL, node, gnode,
 					 summary_insert_gnode_func, summaryview);
@@ -3276,16 +3593,20 @@ static void summary_set_ctree_from_list(SummaryView *summaryview,
 		for (; mlist != NULL; mlist = mlist->next) {
 			msginfo = (MsgInfo *)mlist->data;
 
-			summary_set_header(summaryview, text, msginfo);
+			if (!lazy)
+				summary_set_header(summaryview, text, msginfo);
 
 			node = gtk_sctree_insert_node
-				(ctree, NULL, node, text, 2,
+				(ctree, NULL, node, lazy ? NULL : text, 2,
 				 NULL, NULL,
 				 FALSE, FALSE);
-			if ((vert_layout || small_layout) && prefs_common.two_line_vert)
+			if (!lazy && (vert_layout || small_layout) && prefs_common.two_line_vert)
 				g_free(text[summaryview->col_pos[S_COL_SUBJECT]]);
 
 			GTKUT_CTREE_NODE_SET_ROW_DATA(node, msginfo);
+			if (lazy)
+				gtk_cmclist_unformat_row(GTK_CMCLIST(ctree),
+							 &GTK_CMCTREE_ROW(node)->row);
 			summary_set_marks_func(ctree, node, summaryview);
 
 			if (msginfo->msgid && msginfo->msgid[0] != '\0')
@@ -5308,6 +5629,7 @@ static void summary_execute_move_func(GtkCMCTree *ctree, GtkCMCTreeNode *node,
 		summaryview->mlist =
 			g_slist_prepend(summaryview->mlist, msginfo);
 		gtk_cmctree_node_set_row_data(ctree, node, NULL);
+		g_hash_table_remove(summaryview->sort_keys, msginfo);
 
 		if (msginfo->msgid && *msginfo->msgid &&
 		    node == g_hash_table_lookup(summaryview->msgid_table,
@@ -5404,6 +5726,7 @@ static void summary_execute_delete_func(GtkCMCTree *ctree, GtkCMCTreeNode *node,
 		summaryview->mlist =
 			g_slist_prepend(summaryview->mlist, msginfo);
 		gtk_cmctree_node_set_row_data(ctree, node, NULL);
+		g_hash_table_remove(summaryview->sort_keys, msginfo);
 
 		if (msginfo->msgid && *msginfo->msgid &&
 		    node == g_hash_table_lookup(summaryview->msgid_table,
@@ -5433,6 +5756,7 @@ static void summary_execute_expunge_func(GtkCMCTree *ctree, GtkCMCTreeNode *node
 		summaryview->mlist =
 			g_slist_prepend(summaryview->mlist, msginfo);
 		gtk_cmctree_node_set_row_data(ctree, node, NULL);
+		g_hash_table_remove(summaryview->sort_keys, msginfo);
 
 		if (msginfo->msgid && *msginfo->msgid &&
 		    node == g_hash_table_lookup(summaryview->msgid_table,
@@ -6674,6 +6998,8 @@ static GtkWidget *summary_ctree_create(SummaryView *summaryview)
 
 	gtk_cmctree_set_indent(GTK_CMCTREE(ctree), 12);
 	g_object_set_data(G_OBJECT(ctree), "summaryview", (gpointer)summaryview); 
+	gtk_cmclist_set_row_format_func(GTK_CMCLIST(ctree), summary_format_row,
+					summaryview, SUMMARY_FORMATTED_ROWS);
 
 	for (pos = 0; pos < N_SUMMARY_COLS; pos++) {
 		gtk_widget_set_can_focus(GTK_CMCLIST(ctree)->column[pos].button,
@@ -7640,24 +7966,6 @@ CMP_FUNC_DEF(summary_cmp_by_size, msginfo1->size - msginfo2->size)
 
 #undef CMP_FUNC_DEF
 
-static gint summary_cmp_by_subject(GtkCMCList *clist,
-				   gconstpointer ptr1,
-				   gconstpointer ptr2)
-{
-	MsgInfo *msginfo1 = ((GtkCMCListRow *)ptr1)->data;
-	MsgInfo *msginfo2 = ((GtkCMCListRow *)ptr2)->data;
-	gint res;
-
-	if (!msginfo1->subject)
-		return (msginfo2->subject != NULL);
-	if (!msginfo2->subject)
-		return -1;
-
-	res = subject_compare_for_sort
-		(msginfo1->subject, msginfo2->subject);
-	return (res != 0)? res: summary_cmp_by_date(clist, ptr1, ptr2);
-}
-
 static gint summary_cmp_by_thread_date(GtkCMCList *clist,
 				   gconstpointer ptr1,
 				   gconstpointer ptr2)
@@ -7672,139 +7980,106 @@ static gint summary_cmp_by_thread_date(GtkCMCList *clist,
 		return msginfo1->date_t - msginfo2->date_t;
 }
 
-static gint summary_cmp_by_from(GtkCMCList *clist, gconstpointer ptr1,
-				gconstpointer ptr2)
+/* The keys of the text columns are expensive to compare: subjects
+ * are stripped of their prefixes and all of them collated. Each row's
+ * key is therefore built once per sort and compared with strcmp(). */
+static const gchar *summary_sort_text(SummaryView *sv, GtkCMCListRow *row,
+				      gint column, const gchar *fallback)
 {
-	const gchar *str1, *str2;
-	const GtkCMCListRow *r1 = (const GtkCMCListRow *) ptr1;
-	const GtkCMCListRow *r2 = (const GtkCMCListRow *) ptr2;
-	MsgInfo *msginfo1 = ((GtkCMCListRow *)ptr1)->data;
-	MsgInfo *msginfo2 = ((GtkCMCListRow *)ptr2)->data;
-	const SummaryView *sv = g_object_get_data(G_OBJECT(clist), "summaryview");
-	gint res;
-
-	cm_return_val_if_fail(sv, -1);
-	if (sv->col_state[sv->col_pos[S_COL_FROM]].visible) {
-		str1 = GTK_CMCELL_TEXT(r1->cell[sv->col_pos[S_COL_FROM]])->text;
-		str2 = GTK_CMCELL_TEXT(r2->cell[sv->col_pos[S_COL_FROM]])->text;
-	} else {
-		str1 = msginfo1->from;
-		str2 = msginfo2->from;
+	if (sv->col_state[sv->col_pos[column]].visible) {
+		gtk_cmclist_format_row(GTK_CMCLIST(sv->ctree), row);
+		return GTK_CMCELL_TEXT(row->cell[sv->col_pos[column]])->text;
 	}
-
-	if (!str1)
-		return str2 != NULL;
- 
-	if (!str2)
- 		return -1;
- 
-	res = g_utf8_collate(str1, str2);
-	return (res != 0)? res: summary_cmp_by_date(clist, ptr1, ptr2);
+	return fallback;
 }
- 
-static gint summary_cmp_by_to(GtkCMCList *clist, gconstpointer ptr1,
-				gconstpointer ptr2)
+
+static gchar *summary_make_sort_key(SummaryView *sv, GtkCMCListRow *row)
 {
-	const gchar *str1, *str2;
-	const GtkCMCListRow *r1 = (const GtkCMCListRow *) ptr1;
-	const GtkCMCListRow *r2 = (const GtkCMCListRow *) ptr2;
-	MsgInfo *msginfo1 = ((GtkCMCListRow *)ptr1)->data;
-	MsgInfo *msginfo2 = ((GtkCMCListRow *)ptr2)->data;
-	const SummaryView *sv = g_object_get_data(G_OBJECT(clist), "summaryview");
-	gint res;
-	cm_return_val_if_fail(sv, -1);
-	
-	if (sv->col_state[sv->col_pos[S_COL_TO]].visible) {
-		str1 = GTK_CMCELL_TEXT(r1->cell[sv->col_pos[S_COL_TO]])->text;
-		str2 = GTK_CMCELL_TEXT(r2->cell[sv->col_pos[S_COL_TO]])->text;
-	} else {
-		str1 = msginfo1->to;
-		str2 = msginfo2->to;
+	MsgInfo *msginfo = (MsgInfo *)row->data;
+	const gchar *str = NULL;
+	gchar *tags, *key;
+
+	switch (sv->sort_key) {
+	case SORT_BY_FROM:
+		str = summary_sort_text(sv, row, S_COL_FROM, msginfo->from);
+		break;
+	case SORT_BY_TO:
+		str = summary_sort_text(sv, row, S_COL_TO, msginfo->to);
+		break;
+	case SORT_BY_SUBJECT:
+		if (sv->simplify_subject_preg)
+			str = summary_sort_text(sv, row, S_COL_SUBJECT,
+						msginfo->subject);
+		else
+			str = msginfo->subject;
+		return str ? subject_collate_key_for_sort(str) : NULL;
+	case SORT_BY_TAGS:
+		if (sv->col_state[sv->col_pos[S_COL_TAGS]].visible)
+			tags = g_strdup(summary_sort_text(sv, row, S_COL_TAGS, NULL));
+		else
+			tags = procmsg_msginfo_get_tags_str(msginfo);
+		key = tags ? g_utf8_collate_key(tags, -1) : NULL;
+		g_free(tags);
+		return key;
+	default:
+		break;
 	}
 
-	if (!str1)
-		return str2 != NULL;
- 
-	if (!str2)
- 		return -1;
- 
-	res = g_utf8_collate(str1, str2);
-	return (res != 0)? res: summary_cmp_by_date(clist, ptr1, ptr2);
+	return str ? g_utf8_collate_key(str, -1) : NULL;
 }
- 
-static gint summary_cmp_by_tags(GtkCMCList *clist, gconstpointer ptr1,
-				gconstpointer ptr2)
+
+static const gchar *summary_get_sort_key(SummaryView *sv, GtkCMCListRow *row,
+					 gchar **tmp)
 {
-	gchar *str1, *str2;
-	const GtkCMCListRow *r1 = (const GtkCMCListRow *) ptr1;
-	const GtkCMCListRow *r2 = (const GtkCMCListRow *) ptr2;
-	const SummaryView *sv = g_object_get_data(G_OBJECT(clist), "summaryview");
-	MsgInfo *msginfo1 = ((GtkCMCListRow *)ptr1)->data;
-	MsgInfo *msginfo2 = ((GtkCMCListRow *)ptr2)->data;
-	gint res;
-	cm_return_val_if_fail(sv, -1);
-	
-	if (sv->col_state[sv->col_pos[S_COL_TAGS]].visible) {
-		str1 = g_strdup(GTK_CMCELL_TEXT(r1->cell[sv->col_pos[S_COL_TAGS]])->text);
-		str2 = g_strdup(GTK_CMCELL_TEXT(r2->cell[sv->col_pos[S_COL_TAGS]])->text);
-	} else {
-		str1 = procmsg_msginfo_get_tags_str(msginfo1);
-		str2 = procmsg_msginfo_get_tags_str(msginfo2);
-	}
+	gpointer key;
 
-	if (!str1) {
-		res = (str2 != NULL);
-		g_free(str2);
-		return res;
+	*tmp = NULL;
+	if (!sv->sort_keys)
+		return *tmp = summary_make_sort_key(sv, row);
+
+	if (sv->sort_keys_by != sv->sort_key) {
+		g_hash_table_remove_all(sv->sort_keys);
+		sv->sort_keys_by = sv->sort_key;
 	}
-	if (!str2) {
-		g_free(str1);
- 		return -1;
+	if (!g_hash_table_lookup_extended(sv->sort_keys, row->data, NULL, &key)) {
+		key = summary_make_sort_key(sv, row);
+		g_hash_table_insert(sv->sort_keys, row->data, key);
 	}
- 
-	res = g_utf8_collate(str1, str2);
-	g_free(str1);
-	g_free(str2);
-	return (res != 0)? res: summary_cmp_by_date(clist, ptr1, ptr2);
+	return (const gchar *)key;
 }
- 
-static gint summary_cmp_by_simplified_subject
-	(GtkCMCList *clist, gconstpointer ptr1, gconstpointer ptr2)
-{
-	const FolderItemPrefs *prefs;
-	const gchar *str1, *str2;
-	const GtkCMCListRow *r1 = (const GtkCMCListRow *) ptr1;
-	const GtkCMCListRow *r2 = (const GtkCMCListRow *) ptr2;
-	const MsgInfo *msginfo1 = r1->data;
-	const MsgInfo *msginfo2 = r2->data;
-	const SummaryView *sv = g_object_get_data(G_OBJECT(clist), "summaryview");
+
+/* The keys are those of g_utf8_collate_key(), so comparing their bytes
+ * orders the texts as g_utf8_collate() would; messages with the same
+ * text are ordered by date. */
+static gint summary_cmp_by_sort_key(GtkCMCList *clist,
+				    gconstpointer ptr1, gconstpointer ptr2)
+{
+	GtkCMCListRow *r1 = (GtkCMCListRow *) ptr1;
+	GtkCMCListRow *r2 = (GtkCMCListRow *) ptr2;
+	SummaryView *sv = g_object_get_data(G_OBJECT(clist), "summaryview");
+	const gchar *key1, *key2;
+	gchar *tmp1, *tmp2;
 	gint res;
 
 	cm_return_val_if_fail(sv, -1);
-	cm_return_val_if_fail(msginfo1 != NULL && msginfo2 != NULL, -1);
-	
-	if (sv->col_state[sv->col_pos[S_COL_SUBJECT]].visible) {
-		str1 = GTK_CMCELL_TEXT(r1->cell[sv->col_pos[S_COL_SUBJECT]])->text;
-		str2 = GTK_CMCELL_TEXT(r2->cell[sv->col_pos[S_COL_SUBJECT]])->text;
-	} else {
-		str1 = msginfo1->subject;
-		str2 = msginfo2->subject;
-	}
+	cm_return_val_if_fail(r1->data != NULL && r2->data != NULL, -1);
 
-	if (!str1)
-		return str2 != NULL;
+	key1 = summary_get_sort_key(sv, r1, &tmp1);
+	key2 = summary_get_sort_key(sv, r2, &tmp2);
 
-	if (!str2)
-		return -1;
+	if (!key1)
+		res = (key2 != NULL);
+	else if (!key2)
+		res = -1;
+	else {
+		res = strcmp(key1, key2);
+		if (res == 0)
+			res = summary_cmp_by_date(clist, ptr1, ptr2);
+	}
 
-	prefs = msginfo1->folder->prefs;
-	if (!prefs)
-		prefs = msginfo2->folder->prefs;
-	if (!prefs)
-		return -1;
-	
-	res = subject_compare_for_sort(str1, str2);
-	return (res != 0)? res: summary_cmp_by_date(clist, ptr1, ptr2);
+	g_free(tmp1);
+	g_free(tmp2);
+	return res;
 }
 
 static gint summary_cmp_by_score(GtkCMCList *clist,
@@ -8255,6 +8530,9 @@ static gboolean summary_update_msg(gpointer source, gpointer data)
 	if (msginfo_update->msginfo->folder != summaryview->folder_item)
 		return FALSE;
 
+	/* made again from what changed when next sorting */
+	g_hash_table_remove(summaryview->sort_keys, msginfo_update->msginfo);
+
 	if (msginfo_update->flags & MSGINFO_UPDATE_FLAGS) {
 		node = gtk_cmctree_find_by_row_data(
 				GTK_CMCTREE(summaryview->ctree), NULL, 
@@ -8329,6 +8607,16 @@ static gboolean summary_update_folder_hook(gpointer source, gpointer data)
 	FolderUpdateData *hookdata;
 	SummaryView *summaryview = (SummaryView *)data;
 	hookdata = source;
+	/* not to be shown once its cache is read */
+	if (summaryview->pending_item != NULL &&
+	    (((hookdata->update_flags & FOLDER_REMOVE_FOLDERITEM) &&
+	      hookdata->item == summaryview->pending_item) ||
+	     ((hookdata->update_flags & FOLDER_REMOVE_FOLDER) &&
+	      hookdata->folder == summaryview->pending_item->folder))) {
+		summaryview->pending_item = NULL;
+		summaryview->show_generation++;
+	}
+
 	if (hookdata->update_flags & FOLDER_REMOVE_FOLDERITEM) {
 		summary_update_unread(summaryview, hookdata->item);
 	} else
@@ -157,6 +157,18 @@ private:
 	/* table for looking up message-id */
 	GHashTable *msgid_table;
 	GHashTable *subject_table;
+	/* collation keys of the messages for sorting by a text column,
+	 * made for the sort_keys_by column as they are needed */
+	GHashTable *sort_keys;
+	FolderSortKey sort_keys_by;
+
+	/* bumped by summary_show(), so that work started for an earlier
+	 * one is dropped when it completes */
+	guint show_generation;
+	/* the folder shown once its cache is read */
+	FolderItem *pending_item;
+	/* threads built in the background, for summary_show() to use */
+	gpointer thread_data;
 
 	/* list for moving/deleting messages */
 	GSList *mlist;
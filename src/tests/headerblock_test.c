@@ -0,0 +1,218 @@
+#include <glib.h>
+#include <string.h>
+
+#include "headerblock.h"
+
+typedef struct {
+	gint hnum;
+	const gchar *value;
+} Field;
+
+/* Checks that the fields of interest of @block come out as @expected,
+ * ended by a -1 hnum */
+static void
+assert_fields(const gchar *block, gboolean full, const Field *expected)
+{
+	gchar *buf = g_strdup(block);
+	gchar *pos = buf, *value;
+	gint hnum, i = 0;
+
+	while ((hnum = header_block_next_field(&pos, buf + strlen(block),
+					       full, &value)) != -1) {
+		if (g_test_verbose())
+			g_printerr("%s '%s'\n",
+				   header_block_entries[hnum].name, value);
+		g_assert_cmpint(expected[i].hnum, !=, -1);
+		g_assert_cmpint(hnum, ==, expected[i].hnum);
+		g_assert_cmpstr(value, ==, expected[i].value);
+		i++;
+	}
+	g_assert_cmpint(expected[i].hnum, ==, -1);
+	g_free(buf);
+}
+
+static void
+test_headerblock_unfolded(void)
+{
+	const Field fields[] = {
+		{ H_FROM_SPACE, "someone@example.org Mon Jan  1 00:00:00 2024" },
+		{ H_FROM, "Someone <someone@example.org>" },
+		{ H_TO, "other@example.org" },
+		{ H_SUBJECT, "Hello" },
+		{ H_MSG_ID, "<1@example.org>" },
+		{ -1, NULL }
+	};
+
+	assert_fields("From someone@example.org Mon Jan  1 00:00:00 2024\n"
+		      "from:  Someone <someone@example.org>\n"
+		      "X-Mailer: test\n"
+		      "TO:\tother@example.org\n"
+		      "Subject:Hello\n"
+		      "Message-Id: <1@example.org>\n",
+		      TRUE, fields);
+}
+
+static void
+test_headerblock_folded(void)
+{
+	/* only some headers are unfolded, all continuations start
+	 * with a space */
+	const Field fields[] = {
+		{ H_SUBJECT, "a long  subject" },
+		{ H_REFERENCES, "<1@example.org>\n <2@example.org>\n <3@example.org>" },
+		{ H_TO, "a@example.org, b@example.org" },
+		{ -1, NULL }
+	};
+
+	assert_fields("Subject: a long\n"
+		      "  subject\n"
+		      "X-Folded: skipped\n"
+		      " with its continuation\n"
+		      "References: <1@example.org>\n"
+		      " <2@example.org>\n"
+		      "\t<3@example.org>\n"
+		      "To: a@example.org,\n"
+		      " b@example.org\n",
+		      TRUE, fields);
+}
+
+static void
+test_headerblock_line_ends(void)
+{
+	const Field fields[] = {
+		{ H_FROM, "a@example.org" },
+		{ H_SUBJECT, "folded over CRLF" },
+		{ H_TO, "b@example.org" },
+		{ H_CC, "c@example.org d@example.org" },
+		{ H_DATE, "Mon, 1 Jan 2024 00:00:00 +0000" },
+		{ -1, NULL }
+	};
+
+	/* CRLF, lone CR and LF, mixed */
+	assert_fields("From: a@example.org\r\n"
+		      "Subject: folded over\r\n"
+		      " CRLF\r\n"
+		      "To: b@example.org\r"
+		      "Cc: c@example.org\r"
+		      " d@example.org\r"
+		      "Date: Mon, 1 Jan 2024 00:00:00 +0000\n",
+		      TRUE, fields);
+}
+
+static void
+test_headerblock_unterminated(void)
+{
+	const gchar *block = "From: a@example.org\r\nSubject: last\r\n folded";
+	const Field fields[] = {
+		{ H_FROM, "a@example.org" },
+		{ H_SUBJECT, "last folded" },
+		{ -1, NULL }
+	};
+	gchar *buf = g_strdup(block);
+	gsize scanned = 0;
+
+	/* no empty line, so the block goes on to the end */
+	g_assert_false(header_block_find_end(buf, strlen(buf), &scanned, TRUE));
+	g_assert_cmpuint(scanned, ==, strlen(buf));
+	g_free(buf);
+
+	assert_fields(block, TRUE, fields);
+}
+
+static void
+test_headerblock_find_end(void)
+{
+	gchar *buf;
+	gsize scanned;
+
+	buf = g_strdup("From: a\r\nTo: b\r\n\r\nbody\r\n");
+	scanned = 0;
+	g_assert_true(header_block_find_end(buf, strlen(buf), &scanned, TRUE));
+	g_assert_cmpuint(scanned, ==, strlen("From: a\r\nTo: b\r\n"));
+	g_assert_true(header_block_next_line(buf + scanned, buf + strlen(buf))
+		      == buf + strlen("From: a\r\nTo: b\r\n\r\n"));
+	g_free(buf);
+
+	buf = g_strdup("From: a\rTo: b\r\rbody\r");
+	scanned = 0;
+	g_assert_true(header_block_find_end(buf, strlen(buf), &scanned, TRUE));
+	g_assert_cmpuint(scanned, ==, strlen("From: a\rTo: b\r"));
+	g_free(buf);
+
+	/* a CRLF cut after its CR has to be read on */
+	buf = g_strdup("From: a\r\nTo: b\r");
+	scanned = 0;
+	g_assert_false(header_block_find_end(buf, strlen(buf), &scanned, FALSE));
+	g_assert_cmpuint(scanned, ==, strlen("From: a\r\n"));
+	g_free(buf);
+}
+
+static void
+test_headerblock_short(void)
+{
+	/* the short list stops at SC-Message-Size */
+	const Field fields[] = {
+		{ H_FROM, "a@example.org" },
+		{ H_SC_MESSAGE_SIZE, "1234" },
+		{ -1, NULL }
+	};
+
+	assert_fields("From: a@example.org\n"
+		      "List-Post: <mailto:list@example.org>\n"
+		      "SC-Message-Size: 1234\n"
+		      "X-Face: abc\n",
+		      FALSE, fields);
+}
+
+static void
+test_headerblock_lookup(void)
+{
+	gint i;
+
+	for (i = 0; header_block_entries[i].name != NULL; i++) {
+		const gchar *name = header_block_entries[i].name;
+		gsize len = strlen(name) - 1;
+		gchar *lower, *upper;
+
+		/* "From " has no colon, and is matched on its own */
+		if (i == H_FROM_SPACE)
+			continue;
+
+		if (g_test_verbose())
+			g_printerr("%s\n", name);
+		g_assert_cmpint(header_block_lookup_name(name, len), ==, i);
+
+		lower = g_ascii_strdown(name, len);
+		upper = g_ascii_strup(name, len);
+		g_assert_cmpint(header_block_lookup_name(lower, len), ==, i);
+		g_assert_cmpint(header_block_lookup_name(upper, len), ==, i);
+		g_free(lower);
+		g_free(upper);
+
+		/* neither a prefix nor a longer name */
+		g_assert_cmpint(header_block_lookup_name(name, len - 1), ==, -1);
+		upper = g_strdup_printf("Old-%.*s", (gint)len, name);
+		g_assert_cmpint(header_block_lookup_name(upper, len + 4), ==, -1);
+		g_free(upper);
+	}
+
+	g_assert_cmpint(header_block_lookup_name("X-Mailer", 8), ==, -1);
+	g_assert_cmpint(header_block_lookup_name("Received", 8), ==, -1);
+	g_assert_cmpint(header_block_lookup_name("T", 1), ==, -1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/core/headerblock/unfolded", test_headerblock_unfolded);
+	g_test_add_func("/core/headerblock/folded", test_headerblock_folded);
+	g_test_add_func("/core/headerblock/line_ends", test_headerblock_line_ends);
+	g_test_add_func("/core/headerblock/unterminated", test_headerblock_unterminated);
+	g_test_add_func("/core/headerblock/find_end", test_headerblock_find_end);
+	g_test_add_func("/core/headerblock/short", test_headerblock_short);
+	g_test_add_func("/core/headerblock/lookup", test_headerblock_lookup);
+
+	return g_test_run();
+}
@@ -0,0 +1,283 @@
+#include <glib.h>
+
+#include "etpan/imap-uidset.h"
+
+static void
+assert_set(IMAPUidSet *set, const gchar *expected, guint count)
+{
+	gchar *str = imap_uid_set_to_string(set);
+
+	if (g_test_verbose())
+		g_printerr("set '%s'\n", str);
+	g_assert_cmpstr(str, ==, expected);
+	g_assert_cmpuint(imap_uid_set_count(set), ==, count);
+	g_free(str);
+}
+
+static IMAPUidSet *
+set_from_string(const gchar *str)
+{
+	IMAPUidSet *set = imap_uid_set_new_from_string(str);
+
+	g_assert_nonnull(set);
+	return set;
+}
+
+static void
+test_uidset_add_range(void)
+{
+	IMAPUidSet *set = imap_uid_set_new();
+
+	assert_set(set, "", 0);
+	g_assert_cmpuint(imap_uid_set_max(set), ==, 0);
+
+	/* ascending, touching ranges are merged */
+	imap_uid_set_add_range(set, 1, 3);
+	imap_uid_set_add_range(set, 4, 5);
+	imap_uid_set_add(set, 7);
+	assert_set(set, "1:5,7", 6);
+
+	/* reversed bounds, and UID 0 doesn't exist */
+	imap_uid_set_add_range(set, 12, 10);
+	imap_uid_set_add_range(set, 0, 0);
+	assert_set(set, "1:5,7,10:12", 9);
+
+	/* out of order, filling a gap and bridging two ranges */
+	imap_uid_set_add(set, 6);
+	assert_set(set, "1:7,10:12", 10);
+	imap_uid_set_add_range(set, 8, 9);
+	assert_set(set, "1:12", 12);
+
+	/* covering several ranges at once */
+	imap_uid_set_add_range(set, 20, 22);
+	imap_uid_set_add_range(set, 30, 31);
+	imap_uid_set_add_range(set, 15, 40);
+	assert_set(set, "1:12,15:40", 38);
+
+	/* already there */
+	imap_uid_set_add_range(set, 2, 11);
+	assert_set(set, "1:12,15:40", 38);
+
+	g_assert_true(imap_uid_set_contains(set, 1));
+	g_assert_true(imap_uid_set_contains(set, 15));
+	g_assert_true(imap_uid_set_contains(set, 40));
+	g_assert_false(imap_uid_set_contains(set, 0));
+	g_assert_false(imap_uid_set_contains(set, 13));
+	g_assert_false(imap_uid_set_contains(set, 41));
+	g_assert_cmpuint(imap_uid_set_max(set), ==, 40);
+
+	imap_uid_set_free(set);
+}
+
+static void
+test_uidset_remove_range(void)
+{
+	IMAPUidSet *set = set_from_string("1:10,20:30,40");
+
+	/* punching a hole */
+	imap_uid_set_remove_range(set, 4, 6);
+	assert_set(set, "1:3,7:10,20:30,40", 19);
+
+	/* cutting the ends of ranges */
+	imap_uid_set_remove_range(set, 9, 22);
+	assert_set(set, "1:3,7:8,23:30,40", 14);
+	imap_uid_set_remove_range(set, 30, 29);
+	assert_set(set, "1:3,7:8,23:28,40", 12);
+
+	/* whole ranges, and nothing at all */
+	imap_uid_set_remove_range(set, 5, 35);
+	assert_set(set, "1:3,40", 4);
+	imap_uid_set_remove_range(set, 10, 20);
+	assert_set(set, "1:3,40", 4);
+
+	imap_uid_set_remove(set, 40);
+	imap_uid_set_remove(set, 1);
+	assert_set(set, "2:3", 2);
+	imap_uid_set_remove_range(set, 1, G_MAXUINT32);
+	assert_set(set, "", 0);
+
+	imap_uid_set_free(set);
+}
+
+static void
+test_uidset_union(void)
+{
+	IMAPUidSet *set = set_from_string("1:5,10,20:25");
+	IMAPUidSet *other = set_from_string("3:8,9,11,15,26:*");
+
+	imap_uid_set_union(set, other);
+	assert_set(set, "1:11,15,20:*", G_MAXUINT32 - 19 + 12);
+
+	/* with an empty set, either way */
+	imap_uid_set_clear(other);
+	imap_uid_set_union(set, other);
+	imap_uid_set_union(set, NULL);
+	assert_set(set, "1:11,15,20:*", G_MAXUINT32 - 19 + 12);
+	imap_uid_set_union(other, set);
+	assert_set(other, "1:11,15,20:*", G_MAXUINT32 - 19 + 12);
+
+	imap_uid_set_free(other);
+	imap_uid_set_free(set);
+}
+
+static void
+test_uidset_difference(void)
+{
+	IMAPUidSet *set = set_from_string("1:10,20:30,40:50");
+	IMAPUidSet *other = set_from_string("2,5:6,10:25,45:*");
+	IMAPUidSet *copy;
+
+	copy = imap_uid_set_copy(set);
+	imap_uid_set_difference(set, other);
+	assert_set(set, "1,3:4,7:9,26:30,40:44", 16);
+
+	/* the copy is left alone */
+	assert_set(copy, "1:10,20:30,40:50", 32);
+
+	/* nothing in common */
+	imap_uid_set_difference(set, copy);
+	assert_set(set, "", 0);
+	imap_uid_set_difference(copy, set);
+	imap_uid_set_difference(copy, NULL);
+	assert_set(copy, "1:10,20:30,40:50", 32);
+
+	imap_uid_set_difference(copy, copy);
+	assert_set(copy, "", 0);
+
+	imap_uid_set_free(copy);
+	imap_uid_set_free(other);
+	imap_uid_set_free(set);
+}
+
+static void
+test_uidset_string(void)
+{
+	IMAPUidSet *set;
+	GSList *list;
+
+	/* unsorted, overlapping and reversed ranges are normalized */
+	set = set_from_string("9,3:1,4,7:8,2");
+	assert_set(set, "1:4,7:9", 7);
+	imap_uid_set_free(set);
+
+	set = set_from_string("5:*");
+	g_assert_cmpuint(imap_uid_set_max(set), ==, G_MAXUINT32);
+	assert_set(set, "5:*", G_MAXUINT32 - 4);
+	imap_uid_set_free(set);
+
+	set = set_from_string("");
+	assert_set(set, "", 0);
+	imap_uid_set_free(set);
+
+	g_assert_null(imap_uid_set_new_from_string("0"));
+	g_assert_null(imap_uid_set_new_from_string("1,"));
+	g_assert_null(imap_uid_set_new_from_string(",1"));
+	g_assert_null(imap_uid_set_new_from_string("1:"));
+	g_assert_null(imap_uid_set_new_from_string("1::2"));
+	g_assert_null(imap_uid_set_new_from_string("1 2"));
+	g_assert_null(imap_uid_set_new_from_string("a"));
+	g_assert_null(imap_uid_set_new_from_string("4294967296"));
+
+	/* and through a MsgNumberList */
+	set = set_from_string("3:5,8");
+	list = imap_uid_set_to_list(set);
+	g_assert_cmpuint(g_slist_length(list), ==, 4);
+	g_assert_cmpuint(GPOINTER_TO_UINT(list->data), ==, 3);
+	g_assert_cmpuint(GPOINTER_TO_UINT(g_slist_last(list)->data), ==, 8);
+	imap_uid_set_free(set);
+	set = imap_uid_set_new_from_list(list);
+	assert_set(set, "3:5,8", 4);
+	g_slist_free(list);
+	imap_uid_set_free(set);
+}
+
+static gchar *
+lep_set_to_string(struct mailimap_set *lep_set)
+{
+	GString *str = g_string_new(NULL);
+	clistiter *cur;
+
+	for (cur = clist_begin(lep_set->set_list); cur != NULL;
+	     cur = clist_next(cur)) {
+		struct mailimap_set_item *item = clist_content(cur);
+
+		if (str->len > 0)
+			g_string_append_c(str, ',');
+		g_string_append_printf(str, "%u", item->set_first);
+		if (item->set_last == 0)
+			g_string_append(str, ":*");
+		else if (item->set_last != item->set_first)
+			g_string_append_printf(str, ":%u", item->set_last);
+	}
+
+	return g_string_free(str, FALSE);
+}
+
+static void
+assert_lep_sets(IMAPUidSet *set, guint max_count, const gchar **expected)
+{
+	GSList *lep_sets, *cur;
+	guint i = 0;
+
+	lep_sets = imap_uid_set_to_lep_sets(set, max_count);
+	for (cur = lep_sets; cur != NULL; cur = cur->next, i++) {
+		gchar *str = lep_set_to_string(cur->data);
+
+		if (g_test_verbose())
+			g_printerr("lep set %u '%s'\n", i, str);
+		g_assert_nonnull(expected[i]);
+		g_assert_cmpstr(str, ==, expected[i]);
+		g_free(str);
+		mailimap_set_free(cur->data);
+	}
+	g_assert_null(expected[i]);
+	g_slist_free(lep_sets);
+}
+
+static void
+test_uidset_lep_sets(void)
+{
+	IMAPUidSet *set = set_from_string("1:5,8,10:14");
+	const gchar *whole[] = { "1:5,8,10:14", NULL };
+	const gchar *by_four[] = { "1:4", "5,8,10:11", "12:14", NULL };
+	const gchar *by_five[] = { "1:5", "8,10:13", "14", NULL };
+	const gchar *by_one[] = { "1", "2", NULL };
+	const gchar *open[] = { "3:*", NULL };
+	const gchar *none[] = { NULL };
+
+	assert_lep_sets(set, 0, whole);
+	assert_lep_sets(set, 11, whole);
+	assert_lep_sets(set, 100, whole);
+	assert_lep_sets(set, 4, by_four);
+	assert_lep_sets(set, 5, by_five);
+	imap_uid_set_free(set);
+
+	set = set_from_string("1:2");
+	assert_lep_sets(set, 1, by_one);
+	imap_uid_set_free(set);
+
+	/* '*' is 0 to libetpan */
+	set = set_from_string("3:*");
+	assert_lep_sets(set, 0, open);
+	imap_uid_set_free(set);
+
+	set = imap_uid_set_new();
+	assert_lep_sets(set, 0, none);
+	assert_lep_sets(set, 4, none);
+	imap_uid_set_free(set);
+}
+
+int
+main(int argc, char *argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/core/imap_uidset/add_range", test_uidset_add_range);
+	g_test_add_func("/core/imap_uidset/remove_range", test_uidset_remove_range);
+	g_test_add_func("/core/imap_uidset/union", test_uidset_union);
+	g_test_add_func("/core/imap_uidset/difference", test_uidset_difference);
+	g_test_add_func("/core/imap_uidset/string", test_uidset_string);
+	g_test_add_func("/core/imap_uidset/lep_sets", test_uidset_lep_sets);
+
+	return g_test_run();
+}
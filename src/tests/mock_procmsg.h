@@ -0,0 +1,101 @@
+/* Just enough of procmsg.c for the message cache: MsgInfos are freed
+ * like procmsg_msginfo_free() does, threads are not indexed */
+
+MsgInfo *procmsg_msginfo_new(void)
+{
+	MsgInfo *msginfo = g_new0(MsgInfo, 1);
+
+	msginfo->refcnt = 1;
+	return msginfo;
+}
+
+MsgInfo *procmsg_msginfo_new_ref(MsgInfo *msginfo)
+{
+	msginfo->refcnt++;
+	return msginfo;
+}
+
+static void mock_free_string(MsgInfo *msginfo, gchar *str)
+{
+	if (msginfo->cache_map == NULL ||
+	    !msgcache_map_contains(msginfo->cache_map, str))
+		g_free(str);
+}
+
+void procmsg_msginfo_free_extradata(MsgInfo *msginfo)
+{
+}
+
+void procmsg_msginfo_free(MsgInfo **msginfo_ptr)
+{
+	MsgInfo *msginfo = *msginfo_ptr;
+	GSList *cur;
+
+	if (msginfo == NULL || --msginfo->refcnt > 0)
+		return;
+
+	mock_free_string(msginfo, msginfo->fromname);
+	mock_free_string(msginfo, msginfo->date);
+	mock_free_string(msginfo, msginfo->from);
+	mock_free_string(msginfo, msginfo->to);
+	mock_free_string(msginfo, msginfo->cc);
+	mock_free_string(msginfo, msginfo->newsgroups);
+	mock_free_string(msginfo, msginfo->subject);
+	mock_free_string(msginfo, msginfo->msgid);
+	mock_free_string(msginfo, msginfo->inreplyto);
+	mock_free_string(msginfo, msginfo->xref);
+	for (cur = msginfo->references; cur != NULL; cur = cur->next)
+		mock_free_string(msginfo, (gchar *)cur->data);
+	g_slist_free(msginfo->references);
+	g_slist_free(msginfo->tags);
+
+	if (msginfo->cache_map != NULL)
+		msgcache_map_unref(msginfo->cache_map);
+	if (msginfo->cache_block != NULL)
+		msgcache_block_unref(msginfo->cache_block);
+	else
+		g_free(msginfo);
+	*msginfo_ptr = NULL;
+}
+
+guint procmsg_msginfo_memusage(MsgInfo *msginfo)
+{
+	return sizeof(MsgInfo);
+}
+
+guint procmsg_msginfo_intern_strings(MsgInfo *msginfo)
+{
+	return 0;
+}
+
+gchar *procmsg_msginfo_get_identifier(MsgInfo *msginfo)
+{
+	return NULL;
+}
+
+gchar *procmsg_msginfo_get_tags_str(MsgInfo *msginfo)
+{
+	return NULL;
+}
+
+MsgThreadIndex *procmsg_thread_index_new(void)
+{
+	return NULL;
+}
+
+void procmsg_thread_index_free(MsgThreadIndex *index)
+{
+}
+
+void procmsg_thread_index_add(MsgThreadIndex *index, MsgInfo *msginfo)
+{
+}
+
+void procmsg_thread_index_remove(MsgThreadIndex *index, MsgInfo *msginfo)
+{
+}
+
+gsize procmsg_thread_index_memusage(MsgThreadIndex *index)
+{
+	return 0;
+}
@@ -0,0 +1,200 @@
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "msgcache.h"
+#include "prefs_common.h"
+
+#include "mock_procmsg.h"
+#include "common/tests/mock_prefs_common_get_use_shred.h"
+#include "common/tests/mock_prefs_common_get_flush_metadata.h"
+
+PrefsCommon prefs_common;
+
+gboolean folder_has_parent_of_type(FolderItem *item,
+				   SpecialFolderItemType type)
+{
+	return FALSE;
+}
+
+const gchar *tags_get_tag(gint id)
+{
+	return NULL;
+}
+
+#define N_MSGS 300
+
+typedef struct {
+	gchar *dir;
+	gchar *cache_file;
+	gchar *mark_file;
+	gchar *tags_file;
+	FolderItem *item;
+} Fixture;
+
+static MsgInfo *
+new_msg(FolderItem *item, guint num)
+{
+	MsgInfo *msginfo = procmsg_msginfo_new();
+
+	msginfo->folder = item;
+	msginfo->msgnum = num;
+	msginfo->size = num * 10;
+	msginfo->subject = g_strdup_printf("message %u", num);
+	msginfo->from = g_strdup("someone@example.org");
+	msginfo->msgid = g_strdup_printf("<%u@example.org>", num);
+	MSG_SET_PERM_FLAGS(msginfo->flags, MSG_UNREAD);
+
+	return msginfo;
+}
+
+/* Writes a cache of N_MSGS messages numbered from 1 */
+static void
+fixture_setup(Fixture *fixture, gconstpointer data)
+{
+	MsgCache *cache;
+	guint i;
+
+	fixture->dir = g_dir_make_tmp("msgcache_test-XXXXXX", NULL);
+	g_assert_nonnull(fixture->dir);
+	fixture->cache_file = g_build_filename(fixture->dir, ".claws_cache", NULL);
+	fixture->mark_file = g_build_filename(fixture->dir, ".claws_mark", NULL);
+	fixture->tags_file = g_build_filename(fixture->dir, ".claws_tags", NULL);
+	fixture->item = g_new0(FolderItem, 1);
+
+	cache = msgcache_new();
+	for (i = 1; i <= N_MSGS; i++) {
+		MsgInfo *msginfo = new_msg(fixture->item, i);
+
+		msgcache_add_msg(cache, msginfo);
+		procmsg_msginfo_free(&msginfo);
+	}
+	g_assert_cmpint(msgcache_write(fixture->cache_file, fixture->mark_file,
+				       fixture->tags_file, cache), ==, 0);
+	msgcache_destroy(cache);
+}
+
+static void
+fixture_teardown(Fixture *fixture, gconstpointer data)
+{
+	g_unlink(fixture->cache_file);
+	g_unlink(fixture->mark_file);
+	g_unlink(fixture->tags_file);
+	g_rmdir(fixture->dir);
+	g_free(fixture->cache_file);
+	g_free(fixture->mark_file);
+	g_free(fixture->tags_file);
+	g_free(fixture->dir);
+	g_free(fixture->item);
+}
+
+static void
+test_msgcache_peek(Fixture *fixture, gconstpointer data)
+{
+	MsgInfo *msginfo;
+
+	/* no cache is loaded for the folder */
+	msginfo = msgcache_peek_msg(fixture->item, fixture->cache_file,
+				    fixture->mark_file, fixture->tags_file, 42);
+	g_assert_nonnull(msginfo);
+	g_assert_cmpuint(msginfo->msgnum, ==, 42);
+	g_assert_cmpstr(msginfo->subject, ==, "message 42");
+	g_assert_cmpuint(msginfo->size, ==, 420);
+	g_assert_true(MSG_IS_UNREAD(msginfo->flags));
+	g_assert_true(msginfo->folder == fixture->item);
+	/* a single message doesn't take a block */
+	g_assert_null(msginfo->cache_block);
+	procmsg_msginfo_free(&msginfo);
+
+	msginfo = msgcache_peek_msg_by_id(fixture->item, fixture->cache_file,
+					  fixture->mark_file,
+					  fixture->tags_file,
+					  "<7@example.org>");
+	g_assert_nonnull(msginfo);
+	g_assert_cmpuint(msginfo->msgnum, ==, 7);
+	g_assert_null(msginfo->cache_block);
+	procmsg_msginfo_free(&msginfo);
+
+	g_assert_null(msgcache_peek_msg(fixture->item, fixture->cache_file,
+					fixture->mark_file, fixture->tags_file,
+					N_MSGS + 1));
+	g_assert_null(msgcache_peek_msg_by_id(fixture->item,
+					      fixture->cache_file,
+					      fixture->mark_file,
+					      fixture->tags_file,
+					      "<missing@example.org>"));
+}
+
+static void
+test_msgcache_read(Fixture *fixture, gconstpointer data)
+{
+	MsgCache *cache;
+	MsgInfo *kept, *msginfo;
+	guint i;
+
+	cache = msgcache_read_cache(fixture->item, fixture->cache_file);
+	g_assert_nonnull(cache);
+	for (i = 1; i <= N_MSGS; i++) {
+		msginfo = msgcache_get_msg(cache, i);
+		g_assert_nonnull(msginfo);
+		g_assert_nonnull(msginfo->cache_block);
+		procmsg_msginfo_free(&msginfo);
+	}
+
+	/* a message outliving its cache keeps its block */
+	kept = msgcache_get_msg(cache, N_MSGS);
+	msgcache_destroy(cache);
+	g_assert_cmpstr(kept->subject, ==, "message " G_STRINGIFY(N_MSGS));
+	g_assert_cmpint(kept->refcnt, ==, 1);
+	procmsg_msginfo_free(&kept);
+}
+
+static void
+test_msgcache_append_unloaded(Fixture *fixture, gconstpointer data)
+{
+	MsgCache *cache;
+	MsgInfo *msginfo;
+
+	/* a peeked message changed without loading the cache */
+	msginfo = msgcache_peek_msg(fixture->item, fixture->cache_file,
+				    fixture->mark_file, fixture->tags_file, 42);
+	g_assert_nonnull(msginfo);
+	msginfo->flags.perm_flags = MSG_MARKED;
+	g_assert_cmpint(msgcache_append_mark(NULL, fixture->mark_file,
+					     msginfo), ==, 0);
+	procmsg_msginfo_free(&msginfo);
+
+	msginfo = msgcache_peek_msg(fixture->item, fixture->cache_file,
+				    fixture->mark_file, fixture->tags_file, 42);
+	g_assert_nonnull(msginfo);
+	g_assert_true(MSG_IS_MARKED(msginfo->flags));
+	g_assert_false(MSG_IS_UNREAD(msginfo->flags));
+	procmsg_msginfo_free(&msginfo);
+
+	cache = msgcache_read_cache(fixture->item, fixture->cache_file);
+	g_assert_nonnull(cache);
+	msgcache_read_mark(cache, fixture->mark_file);
+	msginfo = msgcache_get_msg(cache, 42);
+	g_assert_true(MSG_IS_MARKED(msginfo->flags));
+	g_assert_false(MSG_IS_UNREAD(msginfo->flags));
+	procmsg_msginfo_free(&msginfo);
+	msginfo = msgcache_get_msg(cache, 43);
+	g_assert_true(MSG_IS_UNREAD(msginfo->flags));
+	procmsg_msginfo_free(&msginfo);
+	msgcache_destroy(cache);
+}
+
+int
+main(int argc, char *argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add("/core/msgcache/peek", Fixture, NULL,
+		   fixture_setup, test_msgcache_peek, fixture_teardown);
+	g_test_add("/core/msgcache/read", Fixture, NULL,
+		   fixture_setup, test_msgcache_read, fixture_teardown);
+	g_test_add("/core/msgcache/append_unloaded", Fixture, NULL,
+		   fixture_setup, test_msgcache_append_unloaded,
+		   fixture_teardown);
+
+	return g_test_run();
+}
@@ -686,12 +686,8 @@ static void textview_add_part(TextView *textview, MimeInfo *mimeinfo)
 
 	if ((mimeinfo->type == MIMETYPE_MESSAGE) && !g_ascii_strcasecmp(mimeinfo->subtype, "rfc822")) {
 		FILE *fp;
-		if (mimeinfo->content == MIMECONTENT_MEM)
-			fp = str_open_as_stream(mimeinfo->data.mem);
-		else
-			fp = claws_fopen(mimeinfo->data.filename, "rb");
+		fp = procmime_open_content(mimeinfo);
 		if (!fp) {
-			FILE_OP_ERROR(mimeinfo->data.filename, "claws_fopen");
 			END_TIMING();
 			return;
 		}
@@ -1088,29 +1084,47 @@ static void textview_write_body(TextView *textview, MimeInfo *mimeinfo)
 	    prefs_common.render_html) {
 		gchar *filename;
 		
-		filename = procmime_get_tmp_file_name(mimeinfo);
-		if (procmime_get_part(filename, mimeinfo) == 0) {
-			tmpfp = claws_fopen(filename, "rb");
+		if (mimeinfo->content == MIMECONTENT_MEM) {
+			/* decoded in memory, no need for a copy */
+			tmpfp = procmime_open_content(mimeinfo);
 			if (tmpfp) {
 				textview_show_html(textview, tmpfp, conv);
 				claws_fclose(tmpfp);
 			}
-			claws_unlink(filename);
+		} else {
+			filename = procmime_get_tmp_file_name(mimeinfo);
+			if (procmime_get_part(filename, mimeinfo) == 0) {
+				tmpfp = claws_fopen(filename, "rb");
+				if (tmpfp) {
+					textview_show_html(textview, tmpfp, conv);
+					claws_fclose(tmpfp);
+				}
+				claws_unlink(filename);
+			}
+			g_free(filename);
 		}
-		g_free(filename);
 	} else if (!g_ascii_strcasecmp(mimeinfo->subtype, "enriched")) {
 		gchar *filename;
 		
-		filename = procmime_get_tmp_file_name(mimeinfo);
-		if (procmime_get_part(filename, mimeinfo) == 0) {
-			tmpfp = claws_fopen(filename, "rb");
+		if (mimeinfo->content == MIMECONTENT_MEM) {
+			/* decoded in memory, no need for a copy */
+			tmpfp = procmime_open_content(mimeinfo);
 			if (tmpfp) {
 				textview_show_ertf(textview, tmpfp, conv);
 				claws_fclose(tmpfp);
 			}
-			claws_unlink(filename);
+		} else {
+			filename = procmime_get_tmp_file_name(mimeinfo);
+			if (procmime_get_part(filename, mimeinfo) == 0) {
+				tmpfp = claws_fopen(filename, "rb");
+				if (tmpfp) {
+					textview_show_ertf(textview, tmpfp, conv);
+					claws_fclose(tmpfp);
+				}
+				claws_unlink(filename);
+			}
+			g_free(filename);
 		}
-		g_free(filename);
 #ifndef G_OS_WIN32
 	} else if ( g_ascii_strcasecmp(mimeinfo->subtype, "plain") &&
 		   (cmd = prefs_common.mime_textviewer) && *cmd &&
@@ -1189,12 +1203,8 @@ textview_default:
 				mimeinfo->type != MIMETYPE_MESSAGE)
 			textview->is_attachment = TRUE;
 
-		if (mimeinfo->content == MIMECONTENT_MEM)
-			tmpfp = str_open_as_stream(mimeinfo->data.mem);
-		else
-			tmpfp = claws_fopen(mimeinfo->data.filename, "rb");
+		tmpfp = procmime_open_content(mimeinfo);
 		if (!tmpfp) {
-			FILE_OP_ERROR(mimeinfo->data.filename, "claws_fopen");
 			account_signatures_matchlist_delete();
 			return;
 		}